@@ -0,0 +1,207 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	AudioChannelMatrix.cpp
+
+=============================================================================*/
+
+#include "AudioChannelMatrix.h"
+#include <string.h>
+#include <algorithm>
+
+#if defined(__SSE__)
+	#include <xmmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+	#include <arm_neon.h>
+#endif
+
+AudioChannelMatrix::AudioChannelMatrix(UInt32 nInputs, UInt32 nOutputs) :
+	mNumberInputs(nInputs), mNumberOutputs(nOutputs),
+	mGains(nInputs * nOutputs, 0.f),
+	mInputScratch(nInputs), mOutputScratch(nOutputs)
+{
+	SetIdentity();
+}
+
+void	AudioChannelMatrix::SetIdentity()
+{
+	std::fill(mGains.begin(), mGains.end(), 0.f);
+	UInt32 n = std::min(mNumberInputs, mNumberOutputs);
+	for (UInt32 i = 0; i < n; ++i)
+		mGains[i * mNumberInputs + i] = 1.f;
+	Compile();
+}
+
+void	AudioChannelMatrix::Clear()
+{
+	std::fill(mGains.begin(), mGains.end(), 0.f);
+	Compile();
+}
+
+void	AudioChannelMatrix::SetGain(UInt32 inInput, UInt32 inOutput, Float32 inGain)
+{
+	if (inInput >= mNumberInputs || inOutput >= mNumberOutputs) return;
+	mGains[inOutput * mNumberInputs + inInput] = inGain;
+	Compile();
+}
+
+Float32	AudioChannelMatrix::GetGain(UInt32 inInput, UInt32 inOutput) const
+{
+	if (inInput >= mNumberInputs || inOutput >= mNumberOutputs) return 0.f;
+	return mGains[inOutput * mNumberInputs + inInput];
+}
+
+bool	AudioChannelMatrix::UpdateGain(UInt32 inInput, UInt32 inOutput, Float32 inGain)
+{
+	if (inInput >= mNumberInputs || inOutput >= mNumberOutputs || inGain == 0.f) return false;
+	for (UInt32 r = mRouteStart[inOutput]; r < mRouteStart[inOutput + 1]; ++r) {
+		if (mRoutes[r].mInput == inInput) {
+			mRoutes[r].mGain = inGain;
+			mGains[inOutput * mNumberInputs + inInput] = inGain;
+			return true;
+		}
+	}
+	return false;
+}
+
+void	AudioChannelMatrix::Compile()
+{
+	mRoutes.clear();
+	mRouteStart.resize(mNumberOutputs + 1);
+	for (UInt32 out = 0; out < mNumberOutputs; ++out) {
+		mRouteStart[out] = mRoutes.size();
+		const Float32 *row = &mGains[out * mNumberInputs];
+		for (UInt32 in = 0; in < mNumberInputs; ++in) {
+			if (row[in] != 0.f) {
+				Route r = { in, row[in] };
+				mRoutes.push_back(r);
+			}
+		}
+	}
+	mRouteStart[mNumberOutputs] = mRoutes.size();
+}
+
+#pragma mark -- Kernels --
+
+static void ScaleCopy(const Float32 *src, Float32 gain, Float32 *dest, UInt32 nFrames)
+{
+	UInt32 i = 0;
+#if defined(__SSE__)
+	__m128 g = _mm_set1_ps(gain);
+	for (; i + 4 <= nFrames; i += 4)
+		_mm_storeu_ps(dest + i, _mm_mul_ps(g, _mm_loadu_ps(src + i)));
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+	for (; i + 4 <= nFrames; i += 4)
+		vst1q_f32(dest + i, vmulq_n_f32(vld1q_f32(src + i), gain));
+#endif
+	for (; i < nFrames; ++i)
+		dest[i] = gain * src[i];
+}
+
+// dest[i] = sum over routes of gain * input[i], one pass over dest and over each input
+typedef AudioChannelMatrix::Route Route;
+
+static void MultiplyAccumulate(const Float32 * const *inInputs, const Route *routes, UInt32 nRoutes, Float32 *dest, UInt32 nFrames)
+{
+	UInt32 i = 0;
+#if defined(__SSE__)
+	for (; i + 8 <= nFrames; i += 8) {
+		__m128 g = _mm_set1_ps(routes[0].mGain);
+		const Float32 *src = inInputs[routes[0].mInput] + i;
+		__m128 acc0 = _mm_mul_ps(g, _mm_loadu_ps(src));
+		__m128 acc1 = _mm_mul_ps(g, _mm_loadu_ps(src + 4));
+		for (UInt32 r = 1; r < nRoutes; ++r) {
+			g = _mm_set1_ps(routes[r].mGain);
+			src = inInputs[routes[r].mInput] + i;
+			acc0 = _mm_add_ps(acc0, _mm_mul_ps(g, _mm_loadu_ps(src)));
+			acc1 = _mm_add_ps(acc1, _mm_mul_ps(g, _mm_loadu_ps(src + 4)));
+		}
+		_mm_storeu_ps(dest + i, acc0);
+		_mm_storeu_ps(dest + i + 4, acc1);
+	}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+	for (; i + 8 <= nFrames; i += 8) {
+		const Float32 *src = inInputs[routes[0].mInput] + i;
+		float32x4_t acc0 = vmulq_n_f32(vld1q_f32(src), routes[0].mGain);
+		float32x4_t acc1 = vmulq_n_f32(vld1q_f32(src + 4), routes[0].mGain);
+		for (UInt32 r = 1; r < nRoutes; ++r) {
+			src = inInputs[routes[r].mInput] + i;
+			acc0 = vmlaq_n_f32(acc0, vld1q_f32(src), routes[r].mGain);
+			acc1 = vmlaq_n_f32(acc1, vld1q_f32(src + 4), routes[r].mGain);
+		}
+		vst1q_f32(dest + i, acc0);
+		vst1q_f32(dest + i + 4, acc1);
+	}
+#endif
+	for (; i < nFrames; ++i) {
+		Float32 acc = 0.f;
+		for (UInt32 r = 0; r < nRoutes; ++r)
+			acc += routes[r].mGain * inInputs[routes[r].mInput][i];
+		dest[i] = acc;
+	}
+}
+
+void	AudioChannelMatrix::Mix(const Float32 * const *inInputs, Float32 * const *outOutputs, UInt32 nFrames) const
+{
+	for (UInt32 out = 0; out < mNumberOutputs; ++out) {
+		Float32 *dest = outOutputs[out];
+		UInt32 nRoutes = mRouteStart[out + 1] - mRouteStart[out];
+		const Route *routes = nRoutes ? &mRoutes[mRouteStart[out]] : NULL;
+
+		if (nRoutes == 0)
+			memset(dest, 0, nFrames * sizeof(Float32));
+		else if (nRoutes == 1 && routes->mGain == 1.f)
+			memcpy(dest, inInputs[routes->mInput], nFrames * sizeof(Float32));
+		else if (nRoutes == 1)
+			ScaleCopy(inInputs[routes->mInput], routes->mGain, dest, nFrames);
+		else
+			MultiplyAccumulate(inInputs, routes, nRoutes, dest, nFrames);
+	}
+}
+
+void	AudioChannelMatrix::Mix(Byte * const *inBuffers, UInt32 inByteOffset, AudioBufferList *outABL, UInt32 outByteOffset, UInt32 nFrames) const
+{
+	for (UInt32 in = 0; in < mNumberInputs; ++in)
+		mInputScratch[in] = (const Float32 *)(inBuffers[in] + inByteOffset);
+	for (UInt32 out = 0; out < mNumberOutputs; ++out)
+		mOutputScratch[out] = (Float32 *)((Byte *)outABL->mBuffers[out].mData + outByteOffset);
+	Mix(&mInputScratch[0], &mOutputScratch[0], nFrames);
+}
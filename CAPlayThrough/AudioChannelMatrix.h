@@ -0,0 +1,114 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	AudioChannelMatrix.h
+
+=============================================================================*/
+
+#ifndef __AudioChannelMatrix_h__
+#define __AudioChannelMatrix_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+#include <vector>
+
+/*
+	This class holds an N (input) by M (output) routing/gain matrix for deinterleaved
+	Float32 audio. The matrix is compiled into a per-output plan so that the common
+	cases stay cheap: an output fed by a single input at unity gain is a plain copy,
+	a single input at another gain is a scaled copy, and an output fed by several
+	inputs is mixed with a SIMD multiply-accumulate that reads every contributing
+	input once. A full mixdown (e.g. 64 in, 8 out) therefore takes one pass over
+	the source data and needs no intermediate buffer.
+
+	The default matrix is the identity over the lower of the two channel counts, which
+	matches the old behaviour of dropping the extra channels.
+*/
+
+class AudioChannelMatrix {
+public:
+	AudioChannelMatrix(UInt32 nInputs, UInt32 nOutputs);
+
+	UInt32		NumberInputs() const	{ return mNumberInputs; }
+	UInt32		NumberOutputs() const	{ return mNumberOutputs; }
+
+	void		SetIdentity();
+	void		Clear();
+
+	void		SetGain(UInt32 inInput, UInt32 inOutput, Float32 inGain);
+	Float32		GetGain(UInt32 inInput, UInt32 inOutput) const;
+	
+	bool		UpdateGain(UInt32 inInput, UInt32 inOutput, Float32 inGain);
+					// changes the gain of an existing route without recompiling, so it does not
+					// allocate and may be called on the IO thread. Returns false (and changes
+					// nothing) if the route does not exist or inGain is 0; use SetGain then.
+
+	void		Mix(const Float32 * const *inInputs, Float32 * const *outOutputs, UInt32 nFrames) const;
+					// inInputs has NumberInputs() entries, outOutputs NumberOutputs() entries.
+					// Outputs with no routes are zeroed. Safe to call from the IO thread.
+
+	void		Mix(Byte * const *inBuffers, UInt32 inByteOffset, AudioBufferList *outABL, UInt32 outByteOffset, UInt32 nFrames) const;
+					// same as above for channel buffers that share a byte offset, as in AudioRingBuffer.
+					// outABL must have NumberOutputs() buffers; only one thread may mix at a time.
+
+	struct Route {
+		UInt32		mInput;
+		Float32		mGain;
+	};
+
+private:
+	void		Compile();
+
+	UInt32					mNumberInputs;
+	UInt32					mNumberOutputs;
+	std::vector<Float32>	mGains;			// mNumberOutputs rows of mNumberInputs gains
+	std::vector<Route>		mRoutes;		// non-zero gains, grouped by output
+	std::vector<UInt32>		mRouteStart;	// mNumberOutputs + 1 offsets into mRoutes
+
+	mutable std::vector<const Float32 *>	mInputScratch;
+	mutable std::vector<Float32 *>			mOutputScratch;
+};
+
+#endif // __AudioChannelMatrix_h__
@@ -81,10 +81,11 @@
 =============================================================================*/
 
 #include "AudioDeviceList.h"
-#include "AudioDevice.h"
+#include "AudioDeviceRegistry.h"
+#include <string.h>
 
 AudioDeviceList::AudioDeviceList(bool inputs) :
-	mInputs(inputs)
+	mInputs(inputs), mGeneration(0)
 {
 	BuildList();
 }
@@ -93,26 +94,30 @@ AudioDeviceList::~AudioDeviceList()
 {
 }
 
+// The names and channel counts come from the registry's snapshot, so this does not touch the HAL.
 void	AudioDeviceList::BuildList()
 {
 	mDevices.clear();
 	
-	UInt32 propsize;
+	AudioDeviceRegistry &registry = AudioDeviceRegistry::Shared();
+	mGeneration = registry.GetGeneration();
 	
-	verify_noerr(AudioHardwareGetPropertyInfo(kAudioHardwarePropertyDevices, &propsize, NULL));
-	int nDevices = propsize / sizeof(AudioDeviceID);	
-	AudioDeviceID *devids = new AudioDeviceID[nDevices];
-	verify_noerr(AudioHardwareGetProperty(kAudioHardwarePropertyDevices, &propsize, devids));
+	AudioDeviceRegistry::DeviceInfoList infos;
+	registry.GetDevices(mInputs, infos);
 	
-	for (int i = 0; i < nDevices; ++i) {
-		AudioDevice dev(devids[i], mInputs);
-		if (dev.CountChannels() > 0) {
-			Device d;
-			
-			d.mID = devids[i];
-			dev.GetName(d.mName, sizeof(d.mName));
-			mDevices.push_back(d);
-		}
+	for (AudioDeviceRegistry::DeviceInfoList::iterator i = infos.begin(); i != infos.end(); ++i) {
+		Device d;
+		
+		d.mID = i->mID;
+		memcpy(d.mName, i->mName, sizeof(d.mName));
+		mDevices.push_back(d);
 	}
-	delete[] devids;
+}
+
+bool	AudioDeviceList::Update()
+{
+	if (AudioDeviceRegistry::Shared().GetGeneration() == mGeneration)
+		return false;
+	BuildList();
+	return true;
 }
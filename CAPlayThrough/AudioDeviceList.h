@@ -99,6 +99,10 @@ public:
 	~AudioDeviceList();
 
 	DeviceList &GetList() { return mDevices; }
+	
+	// Rebuilds the list if the device registry has changed since it was last built.
+	// Returns true if it did, in which case any menu built from the list is stale.
+	bool		Update();
 
 protected:
 	void		BuildList();
@@ -106,6 +110,7 @@ protected:
 
 	bool				mInputs;
 	DeviceList			mDevices;
+	UInt32				mGeneration;	// of the AudioDeviceRegistry snapshot mDevices was built from
 	
 };
 
@@ -0,0 +1,229 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	AudioDeviceRegistry.cpp
+	
+=============================================================================*/
+
+#include "AudioDeviceRegistry.h"
+#include <string.h>
+#include <algorithm>
+
+AudioDeviceRegistry::AudioDeviceRegistry(HAL *hal) :
+	mHAL(hal), mGeneration(0)
+{
+	pthread_mutex_init(&mUpdateMutex, NULL);
+	pthread_mutex_init(&mMutex, NULL);
+	
+	// listen first, so nothing that changes while we read is missed
+	mHAL->ListenToDeviceList(this, true);
+	DeviceListChanged();
+}
+
+AudioDeviceRegistry::~AudioDeviceRegistry()
+{
+	mHAL->ListenToDeviceList(this, false);
+	for (DeviceInfoList::iterator i = mDevices.begin(); i != mDevices.end(); ++i)
+		mHAL->ListenToDevice(this, i->mID, false);
+	delete mHAL;
+	pthread_mutex_destroy(&mMutex);
+	pthread_mutex_destroy(&mUpdateMutex);
+}
+
+AudioDeviceRegistry::DeviceInfo *	AudioDeviceRegistry::Find(AudioDeviceID inID)
+{
+	for (DeviceInfoList::iterator i = mDevices.begin(); i != mDevices.end(); ++i)
+		if (i->mID == inID)
+			return &*i;
+	return NULL;
+}
+
+bool	AudioDeviceRegistry::GetDevice(AudioDeviceID inID, DeviceInfo &outInfo)
+{
+	pthread_mutex_lock(&mMutex);
+	DeviceInfo *info = Find(inID);
+	if (info)
+		outInfo = *info;
+	pthread_mutex_unlock(&mMutex);
+	return info != NULL;
+}
+
+void	AudioDeviceRegistry::GetDevices(bool inputs, DeviceInfoList &outDevices)
+{
+	outDevices.clear();
+	pthread_mutex_lock(&mMutex);
+	for (DeviceInfoList::iterator i = mDevices.begin(); i != mDevices.end(); ++i)
+		if (i->mChannels[inputs ? kInput : kOutput] > 0)
+			outDevices.push_back(*i);
+	pthread_mutex_unlock(&mMutex);
+}
+
+UInt32	AudioDeviceRegistry::GetGeneration()
+{
+	pthread_mutex_lock(&mMutex);
+	UInt32 generation = mGeneration;
+	pthread_mutex_unlock(&mMutex);
+	return generation;
+}
+
+void	AudioDeviceRegistry::AddChangeListener(ChangeProc proc, void *refCon)
+{
+	ChangeListener listener = { proc, refCon };
+	pthread_mutex_lock(&mMutex);
+	mListeners.push_back(listener);
+	pthread_mutex_unlock(&mMutex);
+}
+
+void	AudioDeviceRegistry::RemoveChangeListener(ChangeProc proc, void *refCon)
+{
+	pthread_mutex_lock(&mMutex);
+	for (std::vector<ChangeListener>::iterator i = mListeners.begin(); i != mListeners.end(); ++i) {
+		if (i->mProc == proc && i->mRefCon == refCon) {
+			mListeners.erase(i);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&mMutex);
+}
+
+void	AudioDeviceRegistry::NotifyChangeListeners()
+{
+	// call out without the lock held, so a listener may query the registry
+	pthread_mutex_lock(&mMutex);
+	std::vector<ChangeListener> listeners = mListeners;
+	pthread_mutex_unlock(&mMutex);
+	
+	for (std::vector<ChangeListener>::iterator i = listeners.begin(); i != listeners.end(); ++i)
+		(i->mProc)(this, i->mRefCon);
+}
+
+// Two of these at once (the first scan and a HAL notification, or two notifications) would both
+// see a new device as added and listen to it twice, so they take turns.
+void	AudioDeviceRegistry::DeviceListChanged()
+{
+	pthread_mutex_lock(&mUpdateMutex);
+	
+	std::vector<AudioDeviceID> ids;
+	if (mHAL->GetDeviceIDs(ids)) {
+		pthread_mutex_unlock(&mUpdateMutex);
+		return;
+	}
+	
+	// work out what was added and removed, then only query the new devices
+	std::vector<AudioDeviceID> added, removed;
+	pthread_mutex_lock(&mMutex);
+	for (std::vector<AudioDeviceID>::iterator i = ids.begin(); i != ids.end(); ++i)
+		if (!Find(*i))
+			added.push_back(*i);
+	for (DeviceInfoList::iterator i = mDevices.begin(); i != mDevices.end(); ++i)
+		if (std::find(ids.begin(), ids.end(), i->mID) == ids.end())
+			removed.push_back(i->mID);
+	pthread_mutex_unlock(&mMutex);
+	
+	if (added.empty() && removed.empty()) {
+		pthread_mutex_unlock(&mUpdateMutex);
+		return;
+	}
+	
+	DeviceInfoList newDevices;
+	for (std::vector<AudioDeviceID>::iterator i = added.begin(); i != added.end(); ++i) {
+		mHAL->ListenToDevice(this, *i, true);
+		DeviceInfo info;
+		if (mHAL->GetDeviceInfo(*i, info) == noErr)
+			newDevices.push_back(info);
+	}
+	for (std::vector<AudioDeviceID>::iterator i = removed.begin(); i != removed.end(); ++i)
+		mHAL->ListenToDevice(this, *i, false);
+	
+	pthread_mutex_lock(&mMutex);
+	for (std::vector<AudioDeviceID>::iterator i = removed.begin(); i != removed.end(); ++i) {
+		for (DeviceInfoList::iterator d = mDevices.begin(); d != mDevices.end(); ++d) {
+			if (d->mID == *i) {
+				mDevices.erase(d);
+				break;
+			}
+		}
+	}
+	for (DeviceInfoList::iterator i = newDevices.begin(); i != newDevices.end(); ++i)
+		if (!Find(i->mID))
+			mDevices.push_back(*i);
+	
+	// keep the HAL's order, which is what the menus show
+	DeviceInfoList ordered;
+	ordered.reserve(mDevices.size());
+	for (std::vector<AudioDeviceID>::iterator i = ids.begin(); i != ids.end(); ++i) {
+		DeviceInfo *info = Find(*i);
+		if (info)
+			ordered.push_back(*info);
+	}
+	mDevices.swap(ordered);
+	++mGeneration;
+	pthread_mutex_unlock(&mMutex);
+	pthread_mutex_unlock(&mUpdateMutex);
+	
+	NotifyChangeListeners();
+}
+
+void	AudioDeviceRegistry::DevicePropertiesChanged(AudioDeviceID inID)
+{
+	// serialized with DeviceListChanged, so a device being added is in the snapshot by the time
+	// its first property change is looked at
+	pthread_mutex_lock(&mUpdateMutex);
+	
+	DeviceInfo info;
+	if (mHAL->GetDeviceInfo(inID, info)) {
+		pthread_mutex_unlock(&mUpdateMutex);
+		return;
+	}
+	
+	pthread_mutex_lock(&mMutex);
+	DeviceInfo *existing = Find(inID);
+	bool changed = existing && memcmp(existing, &info, sizeof(DeviceInfo)) != 0;
+	if (changed) {
+		*existing = info;
+		++mGeneration;
+	}
+	pthread_mutex_unlock(&mMutex);
+	pthread_mutex_unlock(&mUpdateMutex);
+	
+	if (changed)
+		NotifyChangeListeners();
+}
@@ -0,0 +1,138 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	AudioDeviceRegistry.h
+	
+=============================================================================*/
+
+#ifndef __AudioDeviceRegistry_h__
+#define __AudioDeviceRegistry_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreServices/CoreServices.h>
+	#include <CoreAudio/CoreAudio.h>
+#else
+	#include <CoreAudioTypes.h>
+	#include <AudioHardware.h>
+#endif
+#include <pthread.h>
+#include <vector>
+
+/*
+	A snapshot of every audio device's name and per-direction configuration, read once
+	and then kept current from HAL notifications: a change to the device list only
+	queries the devices that were added, and a change to one device only re-reads that
+	device. Lookups are served from memory and are safe from any thread.
+
+	The properties come from an AudioDeviceRegistry::HAL. Shared() uses the CoreAudio
+	one (CoreAudioDeviceRegistryHAL.cpp); tests can construct a registry on a mock that
+	calls DeviceListChanged and DevicePropertiesChanged itself.
+	
+	The HAL notifies on its own thread, and the first scan runs on the constructing one,
+	so updates are serialized: each works out its changes from the snapshot the one
+	before it left, and a device is listened to exactly once.
+*/
+
+class AudioDeviceRegistry {
+public:
+	enum { kOutput = 0, kInput = 1 };
+	
+	struct DeviceInfo {
+		AudioDeviceID					mID;
+		char							mName[64];
+		// indexed by kOutput / kInput
+		UInt32							mChannels[2];
+		UInt32							mSafetyOffset[2];
+		UInt32							mBufferSizeFrames[2];
+		AudioStreamBasicDescription		mFormat[2];
+	};
+	typedef std::vector<DeviceInfo> DeviceInfoList;
+	
+	class HAL {
+	public:
+		virtual ~HAL() { }
+		
+		virtual OSStatus	GetDeviceIDs(std::vector<AudioDeviceID> &outIDs) = 0;
+		virtual OSStatus	GetDeviceInfo(AudioDeviceID inID, DeviceInfo &outInfo) = 0;
+		
+		// Call registry->DeviceListChanged() / DevicePropertiesChanged(id) on changes, from any thread.
+		virtual void		ListenToDeviceList(AudioDeviceRegistry *registry, bool listen) = 0;
+		virtual void		ListenToDevice(AudioDeviceRegistry *registry, AudioDeviceID inID, bool listen) = 0;
+	};
+	
+	typedef void (*ChangeProc)(AudioDeviceRegistry *registry, void *refCon);
+	
+	AudioDeviceRegistry(HAL *hal);		// takes ownership of hal
+	~AudioDeviceRegistry();
+	
+	static AudioDeviceRegistry &	Shared();
+	
+	// Lookups. The results are copies.
+	bool		GetDevice(AudioDeviceID inID, DeviceInfo &outInfo);
+	void		GetDevices(bool inputs, DeviceInfoList &outDevices);	// devices with channels in that direction
+	UInt32		GetGeneration();										// changes whenever the snapshot does
+	
+	// Called after the snapshot changes, on the thread that delivered the notification.
+	void		AddChangeListener(ChangeProc proc, void *refCon);
+	void		RemoveChangeListener(ChangeProc proc, void *refCon);
+	
+	// Notifications from the HAL
+	void		DeviceListChanged();
+	void		DevicePropertiesChanged(AudioDeviceID inID);
+	
+private:
+	DeviceInfo *	Find(AudioDeviceID inID);
+	void			NotifyChangeListeners();
+	
+	struct ChangeListener {
+		ChangeProc		mProc;
+		void *			mRefCon;
+	};
+	
+	HAL *							mHAL;
+	pthread_mutex_t					mUpdateMutex;	// one update at a time, held across the HAL queries
+	pthread_mutex_t					mMutex;			// the snapshot and the listeners, never held across a call out
+	DeviceInfoList					mDevices;
+	std::vector<ChangeListener>		mListeners;
+	UInt32							mGeneration;
+};
+
+#endif // __AudioDeviceRegistry_h__
@@ -50,7 +50,9 @@
 #include <algorithm>
 
 AudioRingBuffer::AudioRingBuffer() :
-	mBuffers(NULL), mNumberChannels(0), mCapacityFrames(0), mCapacityBytes(0)
+	mBuffers(NULL), mNumberChannels(0), mCapacityFrames(0), mCapacityBytes(0),
+	mTimeBoundsQueue(mLocalTimeBoundsQueue), mTimeBoundsQueuePtr(&mLocalTimeBoundsQueuePtr),
+	mLocalTimeBoundsQueuePtr(0)
 {
 
 }
@@ -83,9 +85,31 @@ void	AudioRingBuffer::Allocate(int nChannels, UInt32 bytesPerFrame, UInt32 capac
 		mBuffers[i] = p;
 		p += mCapacityBytes;
 	}
+	mTimeBoundsQueue = mLocalTimeBoundsQueue;
+	mTimeBoundsQueuePtr = &mLocalTimeBoundsQueuePtr;
 	Clear();
 }
 
+void	AudioRingBuffer::UseExternalStorage(int nChannels, UInt32 bytesPerFrame, UInt32 capacityFrames, Byte *channelData,
+											TimeBounds *timeBoundsQueue, volatile UInt32 *timeBoundsQueuePtr)
+{
+	Deallocate();
+	
+	mNumberChannels = nChannels;
+	mBytesPerFrame = bytesPerFrame;
+	mCapacityFrames = capacityFrames;
+	mCapacityFramesMask = capacityFrames - 1;
+	mCapacityBytes = bytesPerFrame * capacityFrames;
+	
+	// only the channel pointers are ours
+	mBuffers = (Byte **)malloc(nChannels * sizeof(Byte *));
+	for (int i = 0; i < nChannels; ++i)
+		mBuffers[i] = channelData + i * mCapacityBytes;
+	
+	mTimeBoundsQueue = timeBoundsQueue;
+	mTimeBoundsQueuePtr = timeBoundsQueuePtr;
+}
+
 void	AudioRingBuffer::Clear()
 {
 	for (UInt32 i = 0; i<kTimeBoundsQueueSize; ++i)
@@ -94,7 +118,7 @@ void	AudioRingBuffer::Clear()
 		mTimeBoundsQueue[i].mEndTime = 0;
 		mTimeBoundsQueue[i].mUpdateCounter = 0;
 	}
-	mTimeBoundsQueuePtr = 0;
+	*mTimeBoundsQueuePtr = 0;
 }
 
 void	AudioRingBuffer::Deallocate()
@@ -106,6 +130,8 @@ void	AudioRingBuffer::Deallocate()
 	mNumberChannels = 0;
 	mCapacityBytes = 0;
 	mCapacityFrames = 0;
+	mTimeBoundsQueue = mLocalTimeBoundsQueue;
+	mTimeBoundsQueuePtr = &mLocalTimeBoundsQueuePtr;
 }
 
 inline void ZeroRange(Byte **buffers, int nchannels, int offset, int nbytes)
@@ -138,6 +164,11 @@ inline void FetchABL(AudioBufferList *abl, int destOffset, Byte **buffers, int s
 	}
 }
 
+inline void MixABL(AudioBufferList *abl, int destOffset, Byte **buffers, int srcOffset, int nbytes, const AudioChannelMatrix &matrix)
+{
+	matrix.Mix(buffers, srcOffset, abl, destOffset, nbytes / sizeof(Float32));
+}
+
 AudioRingBufferError	AudioRingBuffer::Store(const AudioBufferList *abl, UInt32 framesToWrite, SampleTime startWrite)
 {
 	if (framesToWrite > mCapacityFrames)
@@ -195,7 +226,7 @@ AudioRingBufferError	AudioRingBuffer::Store(const AudioBufferList *abl, UInt32 f
 
 void	AudioRingBuffer::SetTimeBounds(SampleTime startTime, SampleTime endTime)
 {
-	UInt32 nextPtr = mTimeBoundsQueuePtr + 1;
+	UInt32 nextPtr = *mTimeBoundsQueuePtr + 1;
 	UInt32 index = nextPtr & kTimeBoundsQueueMask;
 	
 	mTimeBoundsQueue[index].mStartTime = startTime;
@@ -203,9 +234,11 @@ void	AudioRingBuffer::SetTimeBounds(SampleTime startTime, SampleTime endTime)
 	mTimeBoundsQueue[index].mUpdateCounter = nextPtr;
 
 #if defined(__COREAUDIO_USE_FLAT_INCLUDES__)
-	CompareAndSwap(mTimeBoundsQueuePtr, mTimeBoundsQueuePtr + 1, &mTimeBoundsQueuePtr);
+	CompareAndSwap(*mTimeBoundsQueuePtr, *mTimeBoundsQueuePtr + 1, (UInt32 *)mTimeBoundsQueuePtr);
+#elif defined(__APPLE__)
+	OSAtomicCompareAndSwap32Barrier(*mTimeBoundsQueuePtr, *mTimeBoundsQueuePtr + 1, (int32_t*)mTimeBoundsQueuePtr);
 #else
-	OSAtomicCompareAndSwap32Barrier(mTimeBoundsQueuePtr, mTimeBoundsQueuePtr + 1, (int32_t*)&mTimeBoundsQueuePtr);
+	__sync_bool_compare_and_swap(mTimeBoundsQueuePtr, *mTimeBoundsQueuePtr, *mTimeBoundsQueuePtr + 1);
 #endif
 
 }
@@ -214,7 +247,7 @@ AudioRingBufferError	AudioRingBuffer::GetTimeBounds(SampleTime &startTime, Sampl
 {
 	for (int i=0; i<8; ++i) // fail after a few tries.
 	{
-		UInt32 curPtr = mTimeBoundsQueuePtr;
+		UInt32 curPtr = *mTimeBoundsQueuePtr;
 		UInt32 index = curPtr & kTimeBoundsQueueMask;
 		AudioRingBuffer::TimeBounds* bounds = mTimeBoundsQueue + index;
 		
@@ -289,3 +322,36 @@ AudioRingBufferError	AudioRingBuffer::Fetch(AudioBufferList *abl, UInt32 nFrames
 
 	return CheckTimeBounds(startRead, endRead);
 }
+
+AudioRingBufferError	AudioRingBuffer::Fetch(AudioBufferList *abl, UInt32 nFrames, SampleTime startRead, const AudioChannelMatrix &matrix)
+{
+	SampleTime endRead = startRead + nFrames;
+	AudioRingBufferError err;
+	
+	err = CheckTimeBounds(startRead, endRead);
+	if (err) return err;
+	
+	Byte **buffers = mBuffers;
+	int offset0 = FrameOffset(startRead);
+	int offset1 = FrameOffset(endRead);
+	int nbytes;
+	
+	if (offset0 < offset1) {
+		MixABL(abl, 0, buffers, offset0, nbytes = offset1 - offset0, matrix);
+	} else {
+		nbytes = mCapacityBytes - offset0;
+		MixABL(abl, 0, buffers, offset0, nbytes, matrix);
+		MixABL(abl, nbytes, buffers, 0, offset1, matrix);
+		nbytes += offset1;
+	}
+
+	int nchannels = abl->mNumberBuffers;
+	AudioBuffer *dest = abl->mBuffers;
+	while (--nchannels >= 0)
+	{
+		dest->mDataByteSize = nbytes;
+		dest++;
+	}
+
+	return CheckTimeBounds(startRead, endRead);
+}
@@ -48,12 +48,16 @@
 
 #if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
 	#include <CoreAudio/CoreAudioTypes.h>
-	#include <libkern/OSAtomic.h>
+	#if defined(__APPLE__)
+		#include <libkern/OSAtomic.h>
+	#endif
 #else
 	#include <CoreAudioTypes.h>
 	#include <DriverServices.h> // for CompareAndSwap
 #endif
 
+#include "AudioChannelMatrix.h"
+
 /*
 	This class implements an audio ring buffer. Multi-channel data can be either
 	interleaved or deinterleaved.
@@ -87,6 +91,8 @@ public:
 	
 	void					Clear();
 	
+	UInt32					CapacityFrames() const { return mCapacityFrames; }
+	
 	AudioRingBufferError	Store(const AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber);
 							// Copy nFrames of data into the ring buffer at the specified sample time.
 							// The sample time should normally increase sequentially, though gaps
@@ -99,7 +105,12 @@ public:
 				
 	AudioRingBufferError	Fetch(AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber);
 								// will alter mNumDataBytes of the buffers
-	
+
+	AudioRingBufferError	Fetch(AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber, const AudioChannelMatrix &matrix);
+								// Fetch deinterleaved Float32 data through a routing matrix: the ring's channels
+								// are the matrix inputs and the buffers of abl are its outputs. Channel counts
+								// may differ; the mix is done while copying out of the ring.
+
 	AudioRingBufferError	GetTimeBounds(SampleTime &startTime, SampleTime &endTime);
 	
 protected:
@@ -109,10 +120,23 @@ protected:
 	AudioRingBufferError	CheckTimeBounds(SampleTime startRead, SampleTime endRead);
 	
 	// these should only be called from Store.
-	SampleTime				StartTime() const { return mTimeBoundsQueue[mTimeBoundsQueuePtr & kTimeBoundsQueueMask].mStartTime; }
-	SampleTime				EndTime()   const { return mTimeBoundsQueue[mTimeBoundsQueuePtr & kTimeBoundsQueueMask].mEndTime; }
+	SampleTime				StartTime() const { return mTimeBoundsQueue[*mTimeBoundsQueuePtr & kTimeBoundsQueueMask].mStartTime; }
+	SampleTime				EndTime()   const { return mTimeBoundsQueue[*mTimeBoundsQueuePtr & kTimeBoundsQueueMask].mEndTime; }
 	void					SetTimeBounds(SampleTime startTime, SampleTime endTime);
 	
+	// range of valid sample time in the buffer
+	typedef struct {
+		volatile SampleTime		mStartTime;
+		volatile SampleTime		mEndTime;
+		volatile UInt32			mUpdateCounter;
+	} TimeBounds;
+	
+	void					UseExternalStorage(int nChannels, UInt32 bytesPerFrame, UInt32 capacityFrames, Byte *channelData,
+												TimeBounds *timeBoundsQueue, volatile UInt32 *timeBoundsQueuePtr);
+								// For subclasses that keep the ring somewhere else, e.g. in shared memory: the
+								// deinterleaved channels start at channelData, capacityFrames (a power of 2) each,
+								// and the time bounds queue has kTimeBoundsQueueSize entries. Nothing is cleared.
+	
 protected:
 	Byte **		mBuffers;				// allocated in one chunk of memory
 	int			mNumberChannels;
@@ -121,15 +145,11 @@ protected:
 	UInt32		mCapacityFramesMask;
 	UInt32		mCapacityBytes;			// per channel
 	
-	// range of valid sample time in the buffer
-	typedef struct {
-		volatile SampleTime		mStartTime;
-		volatile SampleTime		mEndTime;
-		volatile UInt32			mUpdateCounter;
-	} TimeBounds;
+	TimeBounds *			mTimeBoundsQueue;		// mLocalTimeBoundsQueue unless UseExternalStorage was called
+	volatile UInt32 *		mTimeBoundsQueuePtr;
 	
-	AudioRingBuffer::TimeBounds mTimeBoundsQueue[kTimeBoundsQueueSize];
-	UInt32 mTimeBoundsQueuePtr;
+	AudioRingBuffer::TimeBounds mLocalTimeBoundsQueue[kTimeBoundsQueueSize];
+	volatile UInt32 mLocalTimeBoundsQueuePtr;
 };
 
 
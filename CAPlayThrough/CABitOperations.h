@@ -78,7 +78,9 @@ static int CountLeadingZeroes( int arg )
 #else 
 
 static __inline__ int CountLeadingZeroes(int arg) {
-#if defined(__ppc__)
+#if defined(__x86_64__) || defined(__arm__) || defined(__arm64__) || defined(__aarch64__)
+	arg = (arg == 0) ? 32 : __builtin_clz((unsigned int)arg);
+#elif defined(__ppc__)
 	__asm__ volatile("cntlzw %0, %1" : "=r" (arg) : "r" (arg));
 #elif defined(__i386__)
 	__asm__ volatile(
@@ -44,6 +44,9 @@
 =============================================================================*/
 
 #include "CAPlayThrough.h"
+#include <libkern/OSAtomic.h>
+#include <unistd.h>
+#include <limits.h>
 
 #pragma mark -- CAPlayThrough
 
@@ -51,7 +54,7 @@
 class CAPlayThrough 
 {
 public:
-	CAPlayThrough(AudioDeviceID input, AudioDeviceID output);
+	CAPlayThrough(AudioDeviceID input, AudioDeviceID output, const CAPlayThroughRingSizing &sizing, bool trace);
 	~CAPlayThrough();
 	
 	OSStatus	Init(AudioDeviceID input, AudioDeviceID output);
@@ -61,9 +64,14 @@ public:
 	Boolean		IsRunning();
 	OSStatus	SetInputDeviceAsCurrent(AudioDeviceID in);
 	OSStatus	SetOutputDeviceAsCurrent(AudioDeviceID out);
+	OSStatus	SetChannelMatrix(const AudioChannelMatrix &matrix);
+	OSStatus	SetChannelGain(UInt32 input, UInt32 output, Float32 gain);
 	
 	AudioDeviceID GetInputDeviceID()	{ return mInputDevice.mID;	}
 	AudioDeviceID GetOutputDeviceID()	{ return mOutputDevice.mID; }
+	const AudioChannelMatrix *GetChannelMatrix() { return mEngine.GetChannelMatrix(); }
+	UInt32		GetMeasuredJitter();
+	bool		WriteTrace(const char *path);
 	
 
 private:
@@ -76,6 +84,12 @@ private:
 	OSStatus SetupBuffers();
 	
 	void ComputeThruOffset();
+	UInt32 ComputeRingCapacity();
+	
+	bool EnterIOProc();
+	void LeaveIOProc();
+	void StopIOProcs();
+	void ApplyCommandsIfStopped();
 	
 	static OSStatus InputProc(void *inRefCon,
 							  AudioUnitRenderActionFlags *ioActionFlags,
@@ -94,7 +108,9 @@ private:
 	AudioUnit mInputUnit;
 	AudioBufferList *mInputBuffer;
 	AudioDevice mInputDevice, mOutputDevice;
-	AudioRingBuffer *mBuffer;
+	
+	//Ring buffer, channel matrix and sample time bookkeeping
+	CAPlayThroughEngine mEngine;
 	
 	//AudioUnits and Graph
 	AUGraph mGraph;
@@ -103,24 +119,41 @@ private:
 	AUNode mOutputNode;
 	AudioUnit mOutputUnit;
 	
-	//Buffer sample info
-	Float64 mFirstInputTime;
-	Float64 mFirstOutputTime;
-	Float64 mInToOutSampleOffset;
+	//Ring buffer sizing
+	CAPlayThroughRingSizing mRingSizing;
+	Float64 mInputSampleRate;
+	Float64 mOutputSampleRate;
+	Float64 mRateRatio;				//input rate / output rate
+	
+	//Callback tracing, if enabled
+	CAPlayThroughTraceRecorder *mTraceRecorder;
+	
+	//Gate the IO procs pass through; see EnterIOProc
+	volatile int32_t mIOEnabled;
+	volatile int32_t mIOProcsInside;
 };
 
+// enough for about an hour and a half of 512 frame callbacks at 48kHz
+static const UInt32 kMaxTraceRecords = 1024 * 1024;
+
 
 #pragma mark ---Public Methods---
 
 
 #pragma mark ---CAPlayThrough Methods---
-CAPlayThrough::CAPlayThrough(AudioDeviceID input, AudioDeviceID output):
-mBuffer(NULL),
-mFirstInputTime(-1),
-mFirstOutputTime(-1),
-mInToOutSampleOffset(0)
+CAPlayThrough::CAPlayThrough(AudioDeviceID input, AudioDeviceID output, const CAPlayThroughRingSizing &sizing, bool trace):
+mRingSizing(sizing),
+mInputSampleRate(0),
+mOutputSampleRate(0),
+mRateRatio(1.0),
+mTraceRecorder(NULL),
+mIOEnabled(0),
+mIOProcsInside(0)
 {
 	OSStatus err = noErr;
+	if(trace)
+		mTraceRecorder = new CAPlayThroughTraceRecorder(kMaxTraceRecords);
+
 	err =Init(input,output);
     if(err) {
 		fprintf(stderr,"CAPlayThrough ERROR: Cannot Init CAPlayThrough");
@@ -171,8 +204,9 @@ void CAPlayThrough::Cleanup()
 	//clean up
 	Stop();
 									
-	delete mBuffer;
-	mBuffer = 0;
+	mEngine.Deallocate();
+	delete mTraceRecorder;
+	mTraceRecorder = 0;
 	if(mInputBuffer){
 		for(UInt32 i = 0; i<mInputBuffer->mNumberBuffers; i++)
 			free(mInputBuffer->mBuffers[i].mData);
@@ -191,16 +225,21 @@ OSStatus CAPlayThrough::Start()
 {
 	OSStatus err = noErr;
 	if(!IsRunning()){		
+		//reset the sample times, and apply whatever was changed while stopped, before the gate
+		//opens; the procs can't run yet, so this goes through the queues like any other change
+		//without having to wait for them
+		mEngine.RequestResetTiming();
+		ApplyCommandsIfStopped();
+		
+		mIOEnabled = 1;
+		OSMemoryBarrier();
+		
 		//Start pulling for audio data
 		err = AudioOutputUnitStart(mInputUnit);
 		checkErr(err);
 		
 		err = AUGraphStart(mGraph);
 		checkErr(err);
-		
-		//reset sample times
-		mFirstInputTime = -1;
-		mFirstOutputTime = -1;
 	}
 	return err;	
 }
@@ -212,12 +251,52 @@ OSStatus CAPlayThrough::Stop()
 		//Stop the AUHAL
 		err = AudioOutputUnitStop(mInputUnit);
 		err = AUGraphStop(mGraph);
-		mFirstInputTime = -1;
-		mFirstOutputTime = -1;
+		//the IO procs may still be called a few times, so let them reset themselves
+		mEngine.RequestResetTiming();
 	}
+	StopIOProcs();
+	//whatever the procs did not get to before the gate closed
+	ApplyCommandsIfStopped();
 	return err;
 }
 
+//The IO procs bracket everything they do with EnterIOProc and LeaveIOProc. The AUHAL and the graph
+//may still call them for a while after they have been stopped, so Stop closes the gate and then
+//waits for any proc already inside to leave; from then until the next Start the control thread is
+//the only one touching the engine and the trace recorder. Neither side takes a lock: the procs
+//only make an atomic increment and decrement.
+bool CAPlayThrough::EnterIOProc()
+{
+	OSAtomicIncrement32Barrier(&mIOProcsInside);
+	if (mIOEnabled)
+		return true;
+	OSAtomicDecrement32Barrier(&mIOProcsInside);
+	return false;
+}
+
+void CAPlayThrough::LeaveIOProc()
+{
+	OSAtomicDecrement32Barrier(&mIOProcsInside);
+}
+
+void CAPlayThrough::StopIOProcs()
+{
+	mIOEnabled = 0;
+	OSMemoryBarrier();
+	//a proc that got in before the gate closed finishes one buffer, well under a millisecond
+	while (mIOProcsInside)
+		usleep(100);
+}
+
+//Changes are posted to the engine's queues, which only the IO procs drain. While the gate is closed
+//they don't run, so the control thread applies the changes itself; otherwise a stopped play through
+//would take 64 changes and then refuse any more.
+void CAPlayThrough::ApplyCommandsIfStopped()
+{
+	if (!mIOEnabled)
+		mEngine.ApplyCommands();
+}
+
 Boolean CAPlayThrough::IsRunning()
 {	
 	OSStatus err = noErr;
@@ -266,6 +345,34 @@ OSStatus CAPlayThrough::SetOutputDeviceAsCurrent(AudioDeviceID out)
 	return err;
 }
 
+//The matrix must match the channel counts chosen in SetupBuffers (input device x output device).
+//The output proc swaps it in at the start of its next buffer.
+OSStatus CAPlayThrough::SetChannelMatrix(const AudioChannelMatrix &matrix)
+{
+	const AudioChannelMatrix *current = mEngine.GetChannelMatrix();
+	if(!current ||
+	   matrix.NumberInputs() != current->NumberInputs() ||
+	   matrix.NumberOutputs() != current->NumberOutputs())
+		return kAudioHardwareBadStreamError;
+	
+	if(!mEngine.RequestChannelMatrix(matrix))
+		return kAudioHardwareIllegalOperationError;		//too many changes pending
+	ApplyCommandsIfStopped();
+	return noErr;
+}
+
+OSStatus CAPlayThrough::SetChannelGain(UInt32 input, UInt32 output, Float32 gain)
+{
+	const AudioChannelMatrix *current = mEngine.GetChannelMatrix();
+	if(!current || input >= current->NumberInputs() || output >= current->NumberOutputs())
+		return kAudioHardwareBadStreamError;
+	
+	if(!mEngine.RequestGain(input, output, gain))
+		return kAudioHardwareIllegalOperationError;
+	ApplyCommandsIfStopped();
+	return noErr;
+}
+
 OSStatus CAPlayThrough::SetInputDeviceAsCurrent(AudioDeviceID in)
 {
     UInt32 size = sizeof(AudioDeviceID);
@@ -513,23 +620,28 @@ OSStatus CAPlayThrough::SetupBuffers()
 	
 	//////////////////////////////////////
 	//Set the format of all the AUs to the input/output devices channel count
-	//For a simple case, you want to set this to the lower of count of the channels
-	//in the input device vs output device
+	//The AUHAL and the ring buffer keep every channel of the input device, the varispeed and
+	//output units every channel of the output device. The channel matrix maps one onto the
+	//other while the output proc fetches from the ring buffer (identity by default).
 	//////////////////////////////////////
-	asbd.mChannelsPerFrame =((asbd_dev1_in.mChannelsPerFrame < asbd_dev2_out.mChannelsPerFrame) ?asbd_dev1_in.mChannelsPerFrame :asbd_dev2_out.mChannelsPerFrame) ;
-	//printf("Info: Input Device channel count=%ld\t Input Device channel count=%ld\n",asbd_dev1_in.mChannelsPerFrame,asbd_dev2_out.mChannelsPerFrame);	
-	//printf("Info: CAPlayThrough will use %ld channels\n",asbd.mChannelsPerFrame);	
+	UInt32 inputChannels = asbd_dev1_in.mChannelsPerFrame;
+	UInt32 outputChannels = asbd_dev2_out.mChannelsPerFrame;
+	asbd.mChannelsPerFrame = inputChannels;
+	//printf("Info: Input Device channel count=%ld\t Output Device channel count=%ld\n",inputChannels,outputChannels);	
 
 	
 	// We must get the sample rate of the input device and set it to the stream format of AUHAL
 	propertySize = sizeof(Float64);
 	AudioDeviceGetProperty(mInputDevice.mID, 0, 1, kAudioDevicePropertyNominalSampleRate, &propertySize, &rate);
 	asbd.mSampleRate =rate;
+	mInputSampleRate = rate;
 	propertySize = sizeof(asbd);
 	
 	//Set the new formats to the AUs...
 	err = AudioUnitSetProperty(mInputUnit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, 1, &asbd, propertySize);
 	checkErr(err);	
+	//everything after the ring buffer carries the output device's channels
+	asbd.mChannelsPerFrame = outputChannels;
 	err = AudioUnitSetProperty(mVarispeedUnit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Input, 0, &asbd, propertySize);
 	checkErr(err);
 	
@@ -537,6 +649,8 @@ OSStatus CAPlayThrough::SetupBuffers()
 	propertySize = sizeof(Float64);
 	AudioDeviceGetProperty(mOutputDevice.mID, 0, 0, kAudioDevicePropertyNominalSampleRate, &propertySize, &rate);
 	asbd.mSampleRate =rate;
+	mOutputSampleRate = rate;
+	mRateRatio = (mOutputSampleRate > 0. && mInputSampleRate > 0.) ? mInputSampleRate / mOutputSampleRate : 1.0;
 	propertySize = sizeof(asbd);
 	//Set the new audio stream formats for the rest of the AUs...
 	err = AudioUnitSetProperty(mVarispeedUnit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, 0, &asbd, propertySize);
@@ -545,11 +659,11 @@ OSStatus CAPlayThrough::SetupBuffers()
 	checkErr(err);
 
 	//calculate number of buffers from channels
-	propsize = offsetof(AudioBufferList, mBuffers[0]) + (sizeof(AudioBuffer) *asbd.mChannelsPerFrame);
+	propsize = offsetof(AudioBufferList, mBuffers[0]) + (sizeof(AudioBuffer) *inputChannels);
 
 	//malloc buffer lists
 	mInputBuffer = (AudioBufferList *)malloc(propsize);
-	mInputBuffer->mNumberBuffers = asbd.mChannelsPerFrame;
+	mInputBuffer->mNumberBuffers = inputChannels;
 	
 	//pre-malloc buffers for AudioBufferLists
 	for(UInt32 i =0; i< mInputBuffer->mNumberBuffers ; i++) {
@@ -559,17 +673,74 @@ OSStatus CAPlayThrough::SetupBuffers()
 	}
 	
 	//Alloc ring buffer that will hold data between the two audio devices
-	mBuffer = new AudioRingBuffer();	
-	mBuffer->Allocate(asbd.mChannelsPerFrame, asbd.mBytesPerFrame, bufferSizeFrames * 20);
+	UInt32 ringCapacity = ComputeRingCapacity();
+	mEngine.Allocate(inputChannels, outputChannels, ringCapacity);
+	
+	if(mTraceRecorder) {
+		CAPlayThroughTraceHeader header;
+		memset(&header, 0, sizeof(header));
+		header.mInputChannels = inputChannels;
+		header.mOutputChannels = outputChannels;
+		header.mRingCapacityFrames = ringCapacity;
+		header.mInputSampleRate = mInputSampleRate;
+		header.mOutputSampleRate = mOutputSampleRate;
+		mTraceRecorder->SetHeader(header);
+	}
 	
     return err;
 }
 
 void	CAPlayThrough::ComputeThruOffset()
 {
-	//The initial latency will at least be the saftey offset's of the devices + the buffer sizes
-	mInToOutSampleOffset = SInt32(mInputDevice.mSafetyOffset +  mInputDevice.mBufferSizeFrames +
-						mOutputDevice.mSafetyOffset + mOutputDevice.mBufferSizeFrames);
+	//The initial latency will at least be the saftey offset's of the devices + the buffer sizes,
+	//plus the jitter the ring was sized for, so a late input callback doesn't underrun the output
+	mEngine.RequestThruOffset(SInt32(mInputDevice.mSafetyOffset +  mInputDevice.mBufferSizeFrames +
+						mOutputDevice.mSafetyOffset + mOutputDevice.mBufferSizeFrames + mRingSizing.mJitterFrames));
+	ApplyCommandsIfStopped();
+}
+
+//Everything is measured in input device frames; the arithmetic is in CAPlayThroughEngine so the
+//trace replay and its tests size rings the same way.
+UInt32	CAPlayThrough::ComputeRingCapacity()
+{
+	UInt32 capacity = CAPlayThroughEngine::ComputeRingCapacity(mRingSizing,
+							mInputDevice.mBufferSizeFrames, mInputDevice.mSafetyOffset,
+							mOutputDevice.mBufferSizeFrames, mOutputDevice.mSafetyOffset, mRateRatio);
+	Float64 margin = (mRingSizing.mSafetyMargin < 1.0) ? 1.0 : mRingSizing.mSafetyMargin;
+	
+	fprintf(stdout, "CAPlayThrough Info: ring buffer %lu frames (in buffer %lu + safety %lu, out buffer %lu + safety %lu, rate ratio %.4f, jitter %lu, margin %.2f)\n",
+			(unsigned long)capacity,
+			(unsigned long)mInputDevice.mBufferSizeFrames, (unsigned long)mInputDevice.mSafetyOffset,
+			(unsigned long)mOutputDevice.mBufferSizeFrames, (unsigned long)mOutputDevice.mSafetyOffset,
+			mRateRatio, (unsigned long)mRingSizing.mJitterFrames, margin);
+	fflush(stdout);
+	
+	return capacity;
+}
+
+UInt32	CAPlayThrough::GetMeasuredJitter()
+{
+	return CAPlayThroughEngine::ExcessJitter(mEngine.GetFillSpread(),
+							mInputDevice.mBufferSizeFrames, mOutputDevice.mBufferSizeFrames, mRateRatio);
+}
+
+//Writes the callbacks recorded since the last write, with the configuration needed to replay them.
+//Returns false if tracing is off, nothing was recorded or the play through is running. Once Stop
+//has returned no IO proc is recording, so the records can be read and cleared.
+bool	CAPlayThrough::WriteTrace(const char *path)
+{
+	if(!mTraceRecorder || mIOEnabled || mTraceRecorder->NumberRecords() == 0) return false;
+	
+	//the channel counts, ring capacity and rates were filled in by SetupBuffers
+	CAPlayThroughTraceHeader header = mTraceRecorder->GetHeader();
+	header.mThruOffset = mEngine.GetThruOffset();
+	mTraceRecorder->SetHeader(header);
+	
+	OSStatus err = mTraceRecorder->WriteToFile(path);
+	if(err)
+		fprintf(stdout, "CAPlayThrough Error: cannot write trace %s (%ld)\n", path, (long)err);
+	mTraceRecorder->Clear();
+	return true;
 }
 
 #pragma mark -
@@ -584,8 +755,8 @@ OSStatus CAPlayThrough::InputProc(void *inRefCon,
     OSStatus err = noErr;
 	
 	CAPlayThrough *This = (CAPlayThrough *)inRefCon;
-	if (This->mFirstInputTime < 0.)
-		This->mFirstInputTime = inTimeStamp->mSampleTime;
+	if (!This->EnterIOProc())
+		return noErr;
 		
 	//Get the new audio data
 	err = AudioUnitRender(This->mInputUnit,
@@ -596,18 +767,16 @@ OSStatus CAPlayThrough::InputProc(void *inRefCon,
 						 This->mInputBuffer);// Audio Buffer List to hold data
 	checkErr(err);
 		
-	if(!err)
-		err = This->mBuffer->Store(This->mInputBuffer, Float64(inNumberFrames), SInt64(inTimeStamp->mSampleTime));
+	if(!err) {
+		if(This->mTraceRecorder)
+			This->mTraceRecorder->Record(kCAPlayThroughTrace_Input, *inTimeStamp, inNumberFrames, inTimeStamp->mRateScalar);
+		err = This->mEngine.StoreInput(This->mInputBuffer, inNumberFrames, inTimeStamp->mSampleTime);
+	}
 	
+	This->LeaveIOProc();
 	return err;
 }
 
-inline void MakeBufferSilent (AudioBufferList * ioData)
-{
-	for(UInt32 i=0; i<ioData->mNumberBuffers;i++)
-		memset(ioData->mBuffers[i].mData, 0, ioData->mBuffers[i].mDataByteSize);	
-}
-
 OSStatus CAPlayThrough::OutputProc(void *inRefCon,
 									 AudioUnitRenderActionFlags *ioActionFlags,
 									 const AudioTimeStamp *TimeStamp,
@@ -620,9 +789,15 @@ OSStatus CAPlayThrough::OutputProc(void *inRefCon,
 	Float64 rate = 0.0;
 	AudioTimeStamp inTS, outTS;
 
-	if (This->mFirstInputTime < 0.) {
+	if (!This->EnterIOProc()) {
+		CAPlayThroughEngine::MakeBufferSilent (ioData);
+		return noErr;
+	}
+	
+	if (!This->mEngine.InputStarted()) {
 		// input hasn't run yet -> silence
-		MakeBufferSilent (ioData);
+		CAPlayThroughEngine::MakeBufferSilent (ioData);
+		This->LeaveIOProc();
 		return noErr;
 	}
 	
@@ -632,7 +807,8 @@ OSStatus CAPlayThrough::OutputProc(void *inRefCon,
 	// this callback may still be called a few times after the device has been stopped
 	if (err)
 	{
-		MakeBufferSilent (ioData);
+		CAPlayThroughEngine::MakeBufferSilent (ioData);
+		This->LeaveIOProc();
 		return noErr;
 	}
 		
@@ -643,31 +819,13 @@ OSStatus CAPlayThrough::OutputProc(void *inRefCon,
 	err = AudioUnitSetParameter(This->mVarispeedUnit,kVarispeedParam_PlaybackRate,kAudioUnitScope_Global,0, rate,0);
 	checkErr(err);
 	
-	//get Delta between the devices and add it to the offset
-	if (This->mFirstOutputTime < 0.) {
-		This->mFirstOutputTime = TimeStamp->mSampleTime;
-		Float64 delta = (This->mFirstInputTime - This->mFirstOutputTime);
-		This->ComputeThruOffset();   
-		//changed: 3865519 11/10/04
-		if (delta < 0.0)
-			This->mInToOutSampleOffset -= delta;
-		else
-			This->mInToOutSampleOffset = -delta + This->mInToOutSampleOffset;
-					
-		MakeBufferSilent (ioData);
-		return noErr;
-	}
-
-	//copy the data from the buffers	
-	err = This->mBuffer->Fetch(ioData,inNumberFrames, SInt64(TimeStamp->mSampleTime - This->mInToOutSampleOffset));	
-	if(err != 0) // kAudioRingBufferError_WayBehind)
-	{
-		MakeBufferSilent (ioData);
-		SInt64 bufferStartTime, bufferEndTime;
-		This->mBuffer->GetTimeBounds(bufferStartTime, bufferEndTime);
-		This->mInToOutSampleOffset = TimeStamp->mSampleTime - bufferStartTime;
-	}
+	if(This->mTraceRecorder)
+		This->mTraceRecorder->Record(kCAPlayThroughTrace_Output, *TimeStamp, inNumberFrames, rate);
+	
+	//copy the data from the ring buffer, through the channel matrix
+	This->mEngine.FetchOutput(ioData, inNumberFrames, TimeStamp->mSampleTime);
 
+	This->LeaveIOProc();
 	return noErr;
 }
 
@@ -687,7 +845,10 @@ OSStatus CAPlayThroughHost::StreamListener( AudioStreamID         inStream,
 #pragma mark -- CAPlayThroughHost Methods --
 
 CAPlayThroughHost::CAPlayThroughHost(AudioDeviceID input, AudioDeviceID output):
-	mPlayThrough(NULL)
+	mPlayThrough(NULL),
+	mChannelMatrix(NULL),
+	mTracePath(NULL),
+	mTraceSession(0)
 {
 	CreatePlayThrough(input, output);
 }
@@ -695,11 +856,16 @@ CAPlayThroughHost::CAPlayThroughHost(AudioDeviceID input, AudioDeviceID output):
 CAPlayThroughHost::~CAPlayThroughHost()
 {
 	DeletePlayThrough();
+	delete mChannelMatrix;
+	free(mTracePath);
 }
 
 void CAPlayThroughHost::CreatePlayThrough(AudioDeviceID input, AudioDeviceID output)
 {
-	mPlayThrough = new CAPlayThrough(input, output);
+	mPlayThrough = new CAPlayThrough(input, output, mRingSizing, mTracePath != NULL);
+	// reapply the last routing if the new devices still have the same channel counts
+	if (mChannelMatrix)
+		mPlayThrough->SetChannelMatrix(*mChannelMatrix);
 	AddDeviceListeners(input);
 }
 
@@ -708,6 +874,7 @@ void CAPlayThroughHost::DeletePlayThrough()
 	if(mPlayThrough)
 	{
 		mPlayThrough->Stop();
+		WriteTrace();
 		RemoveDeviceListeners(mPlayThrough->GetInputDeviceID());
 		delete mPlayThrough;
 		mPlayThrough = NULL;
@@ -719,12 +886,43 @@ void CAPlayThroughHost::ResetPlayThrough ()
 	
 	AudioDeviceID input = mPlayThrough->GetInputDeviceID();
 	AudioDeviceID output = mPlayThrough->GetOutputDeviceID();
+	
+	//size the new ring buffer for the worst jitter we have seen so far, but never let one bad
+	//stretch (a device that stalled, a machine that slept) grow every ring from then on
+	UInt32 jitter = mPlayThrough->GetMeasuredJitter();
+	if (jitter > mRingSizing.mMaxJitterFrames)
+		jitter = mRingSizing.mMaxJitterFrames;
+	if (jitter > mRingSizing.mJitterFrames)
+		mRingSizing.mJitterFrames = jitter;
 
 	DeletePlayThrough();
 	CreatePlayThrough(input, output);
 	mPlayThrough->Start();
 }
 
+OSStatus CAPlayThroughHost::SetTraceFile(const char *path)
+{
+	if (IsRunning())
+		return kAudioHardwareIllegalOperationError;
+	
+	// the recorder belongs to the play through, so recreate it for the same devices;
+	// anything recorded under the old path is written out first
+	AudioDeviceID input = 0, output = 0;
+	if (mPlayThrough) {
+		input = mPlayThrough->GetInputDeviceID();
+		output = mPlayThrough->GetOutputDeviceID();
+		DeletePlayThrough();
+	}
+	
+	free(mTracePath);
+	mTracePath = path ? strdup(path) : NULL;
+	mTraceSession = 0;
+	
+	if (input && output)
+		CreatePlayThrough(input, output);
+	return noErr;
+}
+
 bool CAPlayThroughHost::PlayThroughExists()
 {
 	return (mPlayThrough != NULL) ? true : false;
@@ -736,10 +934,55 @@ OSStatus	CAPlayThroughHost::Start()
 	return noErr;
 }
 
+OSStatus	CAPlayThroughHost::SetChannelMatrix(const AudioChannelMatrix &matrix)
+{
+	if (!mPlayThrough) return noErr;
+	
+	OSStatus err = mPlayThrough->SetChannelMatrix(matrix);
+	if (!err) {
+		// keep a copy so the routing survives ResetPlayThrough
+		delete mChannelMatrix;
+		mChannelMatrix = new AudioChannelMatrix(matrix);
+	}
+	return err;
+}
+
+OSStatus	CAPlayThroughHost::SetChannelGain(UInt32 input, UInt32 output, Float32 gain)
+{
+	if (!mPlayThrough) return noErr;
+	
+	OSStatus err = mPlayThrough->SetChannelGain(input, output, gain);
+	if (!err) {
+		delete mChannelMatrix;
+		mChannelMatrix = new AudioChannelMatrix(*mPlayThrough->GetChannelMatrix());
+	}
+	return err;
+}
+
+const AudioChannelMatrix *	CAPlayThroughHost::GetChannelMatrix()
+{
+	if (mPlayThrough) return mPlayThrough->GetChannelMatrix();
+	return NULL;
+}
+
 OSStatus	CAPlayThroughHost::Stop()
 {
-	if (mPlayThrough) return mPlayThrough->Stop();
-	return noErr;
+	OSStatus err = noErr;
+	if (mPlayThrough) {
+		err = mPlayThrough->Stop();
+		WriteTrace();
+	}
+	return err;
+}
+
+void	CAPlayThroughHost::WriteTrace()
+{
+	if (!mTracePath) return;
+	
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s.%lu", mTracePath, (unsigned long)mTraceSession);
+	if (mPlayThrough->WriteTrace(path))
+		mTraceSession++;
 }
 
 Boolean		CAPlayThroughHost::IsRunning()
@@ -60,6 +60,9 @@ if(err) {\
 #include <AudioToolbox/AudioToolbox.h>
 #include <AudioUnit/AudioUnit.h>
 #include "AudioRingBuffer2.h"
+#include "AudioChannelMatrix.h"
+#include "CAPlayThroughEngine.h"
+#include "CAPlayThroughTrace.h"
 #include "AudioDevice.h"
 #include "CAStreamBasicDescription.h"
 
@@ -80,6 +83,23 @@ public:
 	OSStatus	Start();
 	OSStatus	Stop();
 	Boolean		IsRunning();
+	
+	// Routing from input device channels to output device channels. Changes take effect
+	// at the next output buffer, also while running.
+	OSStatus	SetChannelMatrix(const AudioChannelMatrix &matrix);
+	OSStatus	SetChannelGain(UInt32 input, UInt32 output, Float32 gain);
+	const AudioChannelMatrix *GetChannelMatrix();
+	
+	// Takes effect the next time the play through is created (device or format change).
+	// The jitter measured while running is folded in automatically on a reset, up to
+	// mMaxJitterFrames.
+	void		SetRingSizing(const CAPlayThroughRingSizing &sizing) { mRingSizing = sizing; }
+	const CAPlayThroughRingSizing &GetRingSizing() { return mRingSizing; }
+	
+	// Record every input and output callback for replay with CAPlayThroughReplay. Each stop
+	// writes the callbacks since the previous one to path.0, path.1, ... Pass NULL to stop
+	// tracing. Set while stopped.
+	OSStatus	SetTraceFile(const char *path);
 
 private:
 	CAPlayThrough* CAPlayThroughHost::GetPlayThrough() { return mPlayThrough; }
@@ -88,6 +108,7 @@ private:
 	void RemoveDeviceListeners(AudioDeviceID input);
 	
 	void ResetPlayThrough();
+	void WriteTrace();
 
 	static OSStatus StreamListener(	AudioStreamID           inStream,
 								UInt32                  inChannel,
@@ -96,6 +117,10 @@ private:
 										
 private:
 	CAPlayThrough *mPlayThrough;
+	AudioChannelMatrix *mChannelMatrix;		// last routing set by the client, if any
+	CAPlayThroughRingSizing mRingSizing;
+	char *mTracePath;
+	UInt32 mTraceSession;
 };
 
 #endif //__CAPlayThrough_H__
@@ -0,0 +1,104 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAPlayThroughCommandQueue.cpp
+
+=============================================================================*/
+
+#include "CAPlayThroughCommandQueue.h"
+#include "CABitOperations.h"
+#include <stdlib.h>
+
+#if defined(__APPLE__)
+	#include <libkern/OSAtomic.h>
+	#define CommandQueueBarrier()		OSMemoryBarrier()
+#else
+	#define CommandQueueBarrier()		__sync_synchronize()
+#endif
+
+CAPlayThroughCommandQueue::CAPlayThroughCommandQueue(UInt32 capacity) :
+	mWriteIndex(0), mReadIndex(0)
+{
+	capacity = NextPowerOfTwo(capacity);
+	mMask = capacity - 1;
+	mCommands = (CAPlayThroughCommand *)calloc(capacity, sizeof(CAPlayThroughCommand));
+}
+
+CAPlayThroughCommandQueue::~CAPlayThroughCommandQueue()
+{
+	free(mCommands);
+}
+
+bool	CAPlayThroughCommandQueue::Full() const
+{
+	return mWriteIndex - mReadIndex > mMask;
+}
+
+bool	CAPlayThroughCommandQueue::Push(const CAPlayThroughCommand &command)
+{
+	UInt32 writeIndex = mWriteIndex;
+	if (writeIndex - mReadIndex > mMask)
+		return false;
+	
+	mCommands[writeIndex & mMask] = command;
+	// the command must be visible before the consumer can see the new index
+	CommandQueueBarrier();
+	mWriteIndex = writeIndex + 1;
+	return true;
+}
+
+bool	CAPlayThroughCommandQueue::Peek(CAPlayThroughCommand &outCommand) const
+{
+	UInt32 readIndex = mReadIndex;
+	if (readIndex == mWriteIndex)
+		return false;
+	
+	CommandQueueBarrier();
+	outCommand = mCommands[readIndex & mMask];
+	return true;
+}
+
+void	CAPlayThroughCommandQueue::Pop()
+{
+	// finish reading the slot before the producer may reuse it
+	CommandQueueBarrier();
+	mReadIndex = mReadIndex + 1;
+}
@@ -0,0 +1,103 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAPlayThroughCommandQueue.h
+
+=============================================================================*/
+
+#ifndef __CAPlayThroughCommandQueue_h__
+#define __CAPlayThroughCommandQueue_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+class AudioChannelMatrix;
+
+/*
+	Messages from the control thread to an IO proc. The IO proc drains its queue at the
+	top of the callback, so every change lands on a buffer boundary and the state it
+	touches is only ever written by the thread that reads it.
+*/
+
+enum {
+	kCAPlayThroughCommand_ResetTiming		= 1,	// forget the device sample times
+	kCAPlayThroughCommand_SetThruOffset		= 2,	// mValue: frames
+	kCAPlayThroughCommand_SetGain			= 3,	// mInput, mOutput, mValue: gain of an existing route
+	kCAPlayThroughCommand_SwapRouting		= 4		// mMatrix: new matrix; comes back on the retire queue holding the old one
+};
+
+struct CAPlayThroughCommand {
+	UInt32					mKind;
+	UInt32					mInput;
+	UInt32					mOutput;
+	Float64					mValue;
+	AudioChannelMatrix *	mMatrix;
+};
+
+/*
+	Wait-free single producer, single consumer queue of CAPlayThroughCommands. Push and
+	Peek/Pop never block, allocate or take a lock, so either end may be an IO thread.
+*/
+
+class CAPlayThroughCommandQueue {
+public:
+	CAPlayThroughCommandQueue(UInt32 capacity);		// rounded up to a power of 2
+	~CAPlayThroughCommandQueue();
+	
+	// producer
+	bool		Push(const CAPlayThroughCommand &command);		// false if full
+	bool		Full() const;
+	
+	// consumer
+	bool		Peek(CAPlayThroughCommand &outCommand) const;	// false if empty
+	void		Pop();
+	
+private:
+	CAPlayThroughCommand *	mCommands;
+	UInt32					mMask;
+	volatile UInt32			mWriteIndex;	// only written by the producer
+	volatile UInt32			mReadIndex;		// only written by the consumer
+};
+
+#endif // __CAPlayThroughCommandQueue_h__
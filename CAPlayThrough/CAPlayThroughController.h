@@ -69,4 +69,5 @@
 - (void)start: (id)sender;
 - (void)stop: (id)sender;
 - (void)resetPlayThrough;
+- (void)deviceListChanged;
 @end
@@ -44,9 +44,11 @@
 =============================================================================*/
 
 #import "CAPlayThroughController.h"
+#include "AudioDeviceRegistry.h"
 
 @implementation CAPlayThroughController
 static void	BuildDeviceMenu(AudioDeviceList *devlist, NSPopUpButton *menu, AudioDeviceID initSel);
+static void	DeviceRegistryChanged(AudioDeviceRegistry *registry, void *refCon);
 
 - (id)init
 {
@@ -74,10 +76,15 @@ static void	BuildDeviceMenu(AudioDeviceList *devlist, NSPopUpButton *menu, Audio
 		NSLog(@"ERROR: playThroughHost init failed!");
 		exit(1);
 	}
+	
+	//rebuild the menus when devices come and go or change
+	AudioDeviceRegistry::Shared().AddChangeListener(DeviceRegistryChanged, self);
 }
 
 - (void) dealloc 
 {
+	AudioDeviceRegistry::Shared().RemoveChangeListener(DeviceRegistryChanged, self);
+	
 	delete playThroughHost;			
 	playThroughHost =0;
 
@@ -158,6 +165,23 @@ static void	BuildDeviceMenu(AudioDeviceList *devlist, NSPopUpButton *menu, Audio
 	}
 }
 
+- (void)deviceListChanged
+{
+	//the selected devices stay selected as long as they are still there
+	if(mInputDeviceList->Update())
+		BuildDeviceMenu(mInputDeviceList, mInputDevices, inputDevice);
+	if(mOutputDeviceList->Update())
+		BuildDeviceMenu(mOutputDeviceList, mOutputDevices, outputDevice);
+}
+
+//The registry calls this on the HAL's notification thread; the menus may only be touched on the main thread.
+static void	DeviceRegistryChanged(AudioDeviceRegistry *registry, void *refCon)
+{
+	NSAutoreleasePool *pool = [[NSAutoreleasePool alloc] init];
+	[(CAPlayThroughController *)refCon performSelectorOnMainThread:@selector(deviceListChanged) withObject:nil waitUntilDone:NO];
+	[pool release];
+}
+
 static void	BuildDeviceMenu(AudioDeviceList *devlist, NSPopUpButton *menu, AudioDeviceID initSel)
 {
 	[menu removeAllItems];
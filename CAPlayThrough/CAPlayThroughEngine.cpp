@@ -0,0 +1,332 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAPlayThroughEngine.cpp
+
+=============================================================================*/
+
+#include "CAPlayThroughEngine.h"
+#include "CABitOperations.h"
+#include <string.h>
+#include <math.h>
+
+static const UInt32 kCommandQueueSize = 64;
+
+CAPlayThroughEngine::CAPlayThroughEngine() :
+	mBuffer(NULL), mChannelMatrix(NULL), mControlMatrix(NULL),
+	mInputCommands(kCommandQueueSize), mOutputCommands(kCommandQueueSize), mRetired(kCommandQueueSize),
+	mFirstInputTime(-1), mFirstOutputTime(-1), mInToOutSampleOffset(0), mThruOffset(0),
+	mMinFill(0x7FFFFFFF), mMaxFill(-1)
+{
+}
+
+CAPlayThroughEngine::~CAPlayThroughEngine()
+{
+	Deallocate();
+}
+
+void	CAPlayThroughEngine::Allocate(UInt32 inputChannels, UInt32 outputChannels, UInt32 capacityFrames)
+{
+	Deallocate();
+	
+	//Alloc ring buffer that will hold data between the two audio devices
+	mBuffer = new AudioRingBuffer();
+	mBuffer->Allocate(inputChannels, sizeof(Float32), capacityFrames);
+	
+	//Route input channels to output channels, one to one until either side runs out
+	mChannelMatrix = new AudioChannelMatrix(inputChannels, outputChannels);
+	mControlMatrix = new AudioChannelMatrix(inputChannels, outputChannels);
+	
+	ResetTiming();
+}
+
+// Neither IO proc may be running.
+void	CAPlayThroughEngine::Deallocate()
+{
+	CollectRetired();
+	
+	// drop anything still queued; pending swaps own their matrices
+	CAPlayThroughCommand command;
+	while (mInputCommands.Peek(command))
+		mInputCommands.Pop();
+	while (mOutputCommands.Peek(command)) {
+		if (command.mKind == kCAPlayThroughCommand_SwapRouting)
+			delete command.mMatrix;
+		mOutputCommands.Pop();
+	}
+	
+	delete mBuffer;
+	mBuffer = NULL;
+	delete mChannelMatrix;
+	mChannelMatrix = NULL;
+	delete mControlMatrix;
+	mControlMatrix = NULL;
+}
+
+void	CAPlayThroughEngine::ResetTiming()
+{
+	mFirstInputTime = -1;
+	mFirstOutputTime = -1;
+	mMinFill = 0x7FFFFFFF;
+	mMaxFill = -1;
+}
+
+void	CAPlayThroughEngine::MakeBufferSilent(AudioBufferList *ioData)
+{
+	for(UInt32 i=0; i<ioData->mNumberBuffers;i++)
+		memset(ioData->mBuffers[i].mData, 0, ioData->mBuffers[i].mDataByteSize);	
+}
+
+//The output side reads mInToOutSampleOffset frames behind the input side's write position, and the
+//ring buffer has to hold that distance plus the input buffer being written, the output buffer being
+//read (in input frames, scaled by the sample rate ratio) and any callback jitter.
+UInt32	CAPlayThroughEngine::ComputeRingCapacity(const CAPlayThroughRingSizing &sizing,
+											UInt32 inBufferFrames, UInt32 inSafetyOffset,
+											UInt32 outBufferFrames, UInt32 outSafetyOffset, Float64 rateRatio)
+{
+	Float64 inBuffer = inBufferFrames;
+	Float64 outBuffer = outBufferFrames * rateRatio;
+	Float64 thruOffset = inSafetyOffset + inBuffer + outSafetyOffset * rateRatio + outBuffer;
+	Float64 worstCase = thruOffset + inBuffer + outBuffer + sizing.mJitterFrames;
+	
+	Float64 margin = (sizing.mSafetyMargin < 1.0) ? 1.0 : sizing.mSafetyMargin;
+	return NextPowerOfTwo(UInt32(ceil(worstCase * margin)));
+}
+
+//The fill level seen by the output side swings by about one input buffer plus one output buffer;
+//anything beyond that is jitter in the callbacks.
+UInt32	CAPlayThroughEngine::ExcessJitter(SInt32 fillSpread, UInt32 inBufferFrames, UInt32 outBufferFrames, Float64 rateRatio)
+{
+	if (fillSpread < 0) return 0;	//nothing was fetched yet
+	
+	Float64 expected = inBufferFrames + outBufferFrames * rateRatio;
+	return (fillSpread > expected) ? UInt32(fillSpread - expected) : 0;
+}
+
+#pragma mark -- Commands --
+
+bool	CAPlayThroughEngine::RequestResetTiming()
+{
+	CAPlayThroughCommand command = { kCAPlayThroughCommand_ResetTiming, 0, 0, 0., NULL };
+	if (mInputCommands.Full() || mOutputCommands.Full())
+		return false;
+	mInputCommands.Push(command);
+	mOutputCommands.Push(command);
+	return true;
+}
+
+bool	CAPlayThroughEngine::RequestThruOffset(Float64 frames)
+{
+	CAPlayThroughCommand command = { kCAPlayThroughCommand_SetThruOffset, 0, 0, frames, NULL };
+	return mOutputCommands.Push(command);
+}
+
+bool	CAPlayThroughEngine::RequestGain(UInt32 input, UInt32 output, Float32 gain)
+{
+	if (!mControlMatrix) return false;
+	
+	// a gain change on an existing route is applied in place on the output side;
+	// anything that adds or removes a route needs a recompiled matrix
+	AudioChannelMatrix updated(*mControlMatrix);
+	if (updated.UpdateGain(input, output, gain)) {
+		CAPlayThroughCommand command = { kCAPlayThroughCommand_SetGain, input, output, gain, NULL };
+		if (!mOutputCommands.Push(command))
+			return false;
+		*mControlMatrix = updated;
+		return true;
+	}
+	
+	updated.SetGain(input, output, gain);
+	return RequestChannelMatrix(updated);
+}
+
+bool	CAPlayThroughEngine::RequestChannelMatrix(const AudioChannelMatrix &matrix)
+{
+	if (!mControlMatrix) return false;
+	
+	if (!PostSwap(new AudioChannelMatrix(matrix)))
+		return false;
+	*mControlMatrix = matrix;
+	return true;
+}
+
+bool	CAPlayThroughEngine::PostSwap(AudioChannelMatrix *matrix)
+{
+	CollectRetired();
+	
+	CAPlayThroughCommand command = { kCAPlayThroughCommand_SwapRouting, 0, 0, 0., matrix };
+	if (!mOutputCommands.Push(command)) {
+		delete matrix;
+		return false;
+	}
+	return true;
+}
+
+void	CAPlayThroughEngine::CollectRetired()
+{
+	CAPlayThroughCommand command;
+	while (mRetired.Peek(command)) {
+		delete command.mMatrix;
+		mRetired.Pop();
+	}
+}
+
+void	CAPlayThroughEngine::ApplyCommands()
+{
+	ProcessInputCommands();
+	
+	// a routing swap waits while the retire queue is full, so empty it until the swaps are through
+	CAPlayThroughCommand command;
+	do {
+		ProcessOutputCommands();
+		CollectRetired();
+	} while (mOutputCommands.Peek(command));
+}
+
+void	CAPlayThroughEngine::ProcessInputCommands()
+{
+	CAPlayThroughCommand command;
+	while (mInputCommands.Peek(command)) {
+		if (command.mKind == kCAPlayThroughCommand_ResetTiming)
+			mFirstInputTime = -1;
+		mInputCommands.Pop();
+	}
+}
+
+void	CAPlayThroughEngine::ProcessOutputCommands()
+{
+	CAPlayThroughCommand command;
+	while (mOutputCommands.Peek(command)) {
+		switch (command.mKind) {
+			case kCAPlayThroughCommand_ResetTiming:
+				mFirstOutputTime = -1;
+				mMinFill = 0x7FFFFFFF;
+				mMaxFill = -1;
+				break;
+			case kCAPlayThroughCommand_SetThruOffset:
+				mThruOffset = command.mValue;
+				break;
+			case kCAPlayThroughCommand_SetGain:
+				mChannelMatrix->UpdateGain(command.mInput, command.mOutput, Float32(command.mValue));
+				break;
+			case kCAPlayThroughCommand_SwapRouting: {
+				// the old matrix goes back to the control thread to be deleted; if it
+				// has not caught up, leave the swap for the next callback
+				CAPlayThroughCommand retired = { kCAPlayThroughCommand_SwapRouting, 0, 0, 0., mChannelMatrix };
+				if (!mRetired.Push(retired))
+					return;
+				mChannelMatrix = command.mMatrix;
+				break;
+			}
+		}
+		mOutputCommands.Pop();
+	}
+}
+
+#pragma mark -- IO --
+
+AudioRingBufferError	CAPlayThroughEngine::StoreInput(const AudioBufferList *abl, UInt32 nFrames, Float64 sampleTime)
+{
+	ProcessInputCommands();
+	
+	if (mFirstInputTime < 0.)
+		mFirstInputTime = sampleTime;
+	
+	return mBuffer->Store(abl, nFrames, SInt64(sampleTime));
+}
+
+bool	CAPlayThroughEngine::FetchOutput(AudioBufferList *ioData, UInt32 nFrames, Float64 sampleTime)
+{
+	ProcessOutputCommands();
+	
+	if (mFirstInputTime < 0.) {
+		// input hasn't run yet -> silence
+		MakeBufferSilent (ioData);
+		return false;
+	}
+	
+	//get Delta between the devices and add it to the offset
+	if (mFirstOutputTime < 0.) {
+		mFirstOutputTime = sampleTime;
+		Float64 delta = (mFirstInputTime - mFirstOutputTime);
+		mInToOutSampleOffset = mThruOffset;
+		//changed: 3865519 11/10/04
+		if (delta < 0.0)
+			mInToOutSampleOffset -= delta;
+		else
+			mInToOutSampleOffset = -delta + mInToOutSampleOffset;
+					
+		MakeBufferSilent (ioData);
+		return false;
+	}
+
+	//copy the data from the buffers	
+	SInt64 readTime = SInt64(sampleTime - mInToOutSampleOffset);
+	AudioRingBufferError err = mBuffer->Fetch(ioData, nFrames, readTime, *mChannelMatrix);	
+	SInt64 bufferStartTime, bufferEndTime;
+	mBuffer->GetTimeBounds(bufferStartTime, bufferEndTime);
+	if(err != kAudioRingBufferError_OK)
+	{
+		MakeBufferSilent (ioData);
+		//right after the timelines are lined up the read position is the thru offset ahead of
+		//the first input frame; play silence until it gets there instead of skipping the
+		//latency the thru offset is there to provide
+		if (readTime < bufferStartTime && bufferStartTime <= SInt64(mFirstInputTime))
+			return false;
+		//pick up again half the ring behind the newest frame, or at the oldest one if the ring
+		//holds less than that. The ring is sized to twice the worst case distance between the
+		//two sides, so this leaves as much room for the input to be late as for it to run ahead;
+		//staying at the oldest frame of a full ring falls behind again at the next store
+		SInt64 halfway = bufferEndTime - SInt64(mBuffer->CapacityFrames() / 2);
+		mInToOutSampleOffset = sampleTime - ((halfway > bufferStartTime) ? halfway : bufferStartTime);
+		//the read position just jumped, so the fill levels seen before no longer compare with
+		//the ones that follow; start the jitter measurement over
+		mMinFill = 0x7FFFFFFF;
+		mMaxFill = -1;
+		return false;
+	}
+	
+	//track how far ahead of us the input is, for jitter measurement
+	SInt32 fill = SInt32(bufferEndTime - (readTime + nFrames));
+	if (fill > mMaxFill) mMaxFill = fill;
+	if (fill < mMinFill) mMinFill = fill;
+	return true;
+}
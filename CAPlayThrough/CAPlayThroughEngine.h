@@ -0,0 +1,163 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAPlayThroughEngine.h
+
+=============================================================================*/
+
+#ifndef __CAPlayThroughEngine_h__
+#define __CAPlayThroughEngine_h__
+
+#include "AudioRingBuffer2.h"
+#include "AudioChannelMatrix.h"
+#include "CAPlayThroughCommandQueue.h"
+
+// Controls how the ring buffer between the two devices is sized. The capacity is derived from
+// both devices' buffer sizes and safety offsets and the sample rate ratio; the jitter and the
+// margin add headroom on top of that.
+struct CAPlayThroughRingSizing
+{
+	Float64		mSafetyMargin;		// multiplier on the worst case write-to-read distance
+	UInt32		mJitterFrames;		// callback jitter to allow for, in input device frames
+	UInt32		mMaxJitterFrames;	// ceiling on the measured jitter carried into the next ring
+	
+	CAPlayThroughRingSizing() : mSafetyMargin(2.0), mJitterFrames(0), mMaxJitterFrames(4096) { }
+};
+
+/*
+	This class holds the device independent part of the play through: the ring buffer
+	between the two devices, the channel matrix, and the sample time bookkeeping that
+	lines the output device's timeline up with the input device's. CAPlayThrough feeds it
+	from the AUHAL input callback and the varispeed render callback; the trace replay
+	(CAPlayThroughTrace.h) feeds it from a recorded callback sequence, so both run the
+	same code.
+	
+	While the IO procs may be running, the control thread does not touch the engine's
+	state directly: it posts commands (the Request methods), and StoreInput and
+	FetchOutput apply the ones addressed to their side before doing anything else.
+	Replaced channel matrices come back on a retire queue and are deleted by the control
+	thread. While neither IO proc can run, ApplyCommands does their part and the
+	changes take effect at once. The direct setters are only for when neither IO proc
+	can run, and for driving the engine without a control thread, as the replay does.
+*/
+
+class CAPlayThroughEngine {
+public:
+	CAPlayThroughEngine();
+	~CAPlayThroughEngine();
+	
+	void		Allocate(UInt32 inputChannels, UInt32 outputChannels, UInt32 capacityFrames);
+	void		Deallocate();
+	
+	// Forget the sample times of both devices, e.g. when the devices are (re)started.
+	void		ResetTiming();
+	
+	// Minimum latency between the devices (safety offsets + buffer sizes), used when
+	// the first output callback lines up the two timelines.
+	void		SetThruOffset(Float64 frames)		{ mThruOffset = frames; }
+	Float64		GetThruOffset() const				{ return mThruOffset; }
+	
+	// Control thread, safe while running. Each returns false if its queue is full.
+	bool		RequestResetTiming();
+	bool		RequestThruOffset(Float64 frames);
+	bool		RequestGain(UInt32 input, UInt32 output, Float32 gain);
+	bool		RequestChannelMatrix(const AudioChannelMatrix &matrix);
+	void		CollectRetired();		// delete the matrices the output side has let go of
+	
+	// Control thread, only while neither IO proc can run: applies everything requested so far,
+	// as the two procs would at the start of their next buffers. Without it the queues only
+	// drain while the devices run, and fill up with changes made while they are stopped.
+	void		ApplyCommands();
+	
+	bool		InputStarted() const				{ return mFirstInputTime >= 0.; }
+	
+	// Called from the input callback with the frames just rendered from the input device.
+	AudioRingBufferError	StoreInput(const AudioBufferList *abl, UInt32 nFrames, Float64 sampleTime);
+	
+	// Called from the output callback. Fills ioData from the ring buffer through the
+	// channel matrix, or silences it and returns false if there is nothing to play yet
+	// or the read position had to be resynchronized.
+	bool		FetchOutput(AudioBufferList *ioData, UInt32 nFrames, Float64 sampleTime);
+	
+	AudioRingBuffer *		GetBuffer()				{ return mBuffer; }
+	
+	// The routing as last requested by the control thread; the output side may not have picked it up yet.
+	const AudioChannelMatrix *	GetChannelMatrix() const	{ return mControlMatrix; }
+	Float64		GetInToOutSampleOffset() const		{ return mInToOutSampleOffset; }
+	
+	// Spread of the ring fill level seen by FetchOutput, -1 if nothing was fetched yet.
+	SInt32		GetFillSpread() const				{ return (mMaxFill < mMinFill) ? -1 : mMaxFill - mMinFill; }
+	
+	static void	MakeBufferSilent(AudioBufferList *ioData);
+	
+	// Ring capacity in input device frames for devices with these buffer sizes and safety offsets
+	// (the output's in output device frames), rounded up to a power of two.
+	static UInt32	ComputeRingCapacity(const CAPlayThroughRingSizing &sizing,
+									UInt32 inBufferFrames, UInt32 inSafetyOffset,
+									UInt32 outBufferFrames, UInt32 outSafetyOffset, Float64 rateRatio);
+	
+	// The part of a fill spread that the two buffer sizes don't explain, in input device frames.
+	static UInt32	ExcessJitter(SInt32 fillSpread, UInt32 inBufferFrames, UInt32 outBufferFrames, Float64 rateRatio);
+
+private:
+	void		ProcessInputCommands();
+	void		ProcessOutputCommands();
+	bool		PostSwap(AudioChannelMatrix *matrix);
+	
+	AudioRingBuffer *		mBuffer;
+	AudioChannelMatrix *	mChannelMatrix;		// output side's
+	AudioChannelMatrix *	mControlMatrix;		// control thread's copy
+	
+	CAPlayThroughCommandQueue	mInputCommands;		// control -> input proc
+	CAPlayThroughCommandQueue	mOutputCommands;	// control -> output proc
+	CAPlayThroughCommandQueue	mRetired;			// output proc -> control, old matrices
+	
+	//Buffer sample info
+	volatile Float64	mFirstInputTime;		// written by the input side, read by both
+	Float64			mFirstOutputTime;
+	Float64			mInToOutSampleOffset;
+	Float64			mThruOffset;
+	
+	volatile SInt32	mMinFill;		//frames between the read and write positions, as seen by the output callback
+	volatile SInt32	mMaxFill;
+};
+
+#endif // __CAPlayThroughEngine_h__
@@ -0,0 +1,238 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAPlayThroughTrace.cpp
+
+=============================================================================*/
+
+#include "CAPlayThroughTrace.h"
+#include "CAPlayThroughEngine.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <vector>
+
+#if defined(__APPLE__)
+	#include <libkern/OSAtomic.h>
+	#define TraceAtomicIncrement(p)		OSAtomicIncrement32Barrier(p)
+#else
+	#define TraceAtomicIncrement(p)		__sync_add_and_fetch(p, 1)
+#endif
+
+#pragma mark -- Recorder --
+
+CAPlayThroughTraceRecorder::CAPlayThroughTraceRecorder(UInt32 maxRecords) :
+	mMaxRecords(maxRecords), mNextRecord(0)
+{
+	memset(&mHeader, 0, sizeof(mHeader));
+	mRecords = (CAPlayThroughTraceRecord *)calloc(maxRecords, sizeof(CAPlayThroughTraceRecord));
+	if (!mRecords) mMaxRecords = 0;
+}
+
+CAPlayThroughTraceRecorder::~CAPlayThroughTraceRecorder()
+{
+	free(mRecords);
+}
+
+void	CAPlayThroughTraceRecorder::Record(UInt32 kind, const AudioTimeStamp &timeStamp, UInt32 nFrames, Float64 rateScalar)
+{
+	// claim a slot; both IO threads may be in here at once
+	UInt32 index = UInt32(TraceAtomicIncrement(&mNextRecord) - 1);
+	if (index >= mMaxRecords) return;
+	
+	CAPlayThroughTraceRecord &r = mRecords[index];
+	r.mHostTime = timeStamp.mHostTime;
+	r.mSampleTime = timeStamp.mSampleTime;
+	r.mRateScalar = rateScalar;
+	r.mFrames = nFrames;
+	r.mKind = kind;
+}
+
+UInt32	CAPlayThroughTraceRecorder::NumberRecords() const
+{
+	UInt32 n = UInt32(mNextRecord);
+	return (n < mMaxRecords) ? n : mMaxRecords;
+}
+
+void	CAPlayThroughTraceRecorder::Clear()
+{
+	mNextRecord = 0;
+}
+
+OSStatus	CAPlayThroughTraceRecorder::WriteToFile(const char *path)
+{
+	FILE *f = fopen(path, "wb");
+	if (!f) return errno;
+	
+	CAPlayThroughTraceHeader header = mHeader;
+	header.mMagic = kCAPlayThroughTraceMagic;
+	header.mVersion = kCAPlayThroughTraceVersion;
+	header.mRecordSize = sizeof(CAPlayThroughTraceRecord);
+	header.mNumberRecords = NumberRecords();
+	header.mDroppedRecords = UInt32(mNextRecord) - header.mNumberRecords;
+	
+	OSStatus err = noErr;
+	if (fwrite(&header, sizeof(header), 1, f) != 1
+	 || fwrite(mRecords, sizeof(CAPlayThroughTraceRecord), header.mNumberRecords, f) != header.mNumberRecords)
+		err = errno;
+	if (fclose(f) && !err)
+		err = errno;
+	return err;
+}
+
+#pragma mark -- Replay --
+
+// deterministic input: every channel gets a distinct ramp keyed on the sample time,
+// so any change in what the engine fetches changes the output checksum
+static void	FillInput(AudioBufferList *abl, UInt32 nFrames, SInt64 sampleTime)
+{
+	for (UInt32 c = 0; c < abl->mNumberBuffers; ++c) {
+		Float32 *p = (Float32 *)abl->mBuffers[c].mData;
+		for (UInt32 i = 0; i < nFrames; ++i)
+			p[i] = Float32(((sampleTime + i) * 31 + c * 7919) & 0xFFFF) * (1.f / 65536.f);
+		abl->mBuffers[c].mDataByteSize = nFrames * sizeof(Float32);
+	}
+}
+
+static UInt64	Checksum(UInt64 hash, const AudioBufferList *abl, UInt32 nFrames)
+{
+	for (UInt32 c = 0; c < abl->mNumberBuffers; ++c) {
+		const Byte *p = (const Byte *)abl->mBuffers[c].mData;
+		for (UInt32 i = 0; i < nFrames * sizeof(Float32); ++i) {
+			hash ^= p[i];
+			hash *= 0x100000001B3ULL;
+		}
+	}
+	return hash;
+}
+
+static AudioBufferList *	NewBufferList(UInt32 nChannels, UInt32 maxFrames)
+{
+	AudioBufferList *abl = (AudioBufferList *)calloc(1, offsetof(AudioBufferList, mBuffers[0]) + sizeof(AudioBuffer) * nChannels);
+	abl->mNumberBuffers = nChannels;
+	for (UInt32 c = 0; c < nChannels; ++c) {
+		abl->mBuffers[c].mNumberChannels = 1;
+		abl->mBuffers[c].mDataByteSize = maxFrames * sizeof(Float32);
+		abl->mBuffers[c].mData = calloc(maxFrames, sizeof(Float32));
+	}
+	return abl;
+}
+
+static void	DisposeBufferList(AudioBufferList *abl)
+{
+	for (UInt32 c = 0; c < abl->mNumberBuffers; ++c)
+		free(abl->mBuffers[c].mData);
+	free(abl);
+}
+
+OSStatus	CAPlayThroughReplay(const char *path, CAPlayThroughReplayResult &outResult)
+{
+	memset(&outResult, 0, sizeof(outResult));
+	outResult.mChecksum = 0xCBF29CE484222325ULL;
+	
+	FILE *f = fopen(path, "rb");
+	if (!f) return errno;
+	
+	CAPlayThroughTraceHeader header;
+	std::vector<CAPlayThroughTraceRecord> records;
+	OSStatus err = noErr;
+	if (fread(&header, sizeof(header), 1, f) != 1
+	 || header.mMagic != kCAPlayThroughTraceMagic
+	 || header.mVersion != kCAPlayThroughTraceVersion
+	 || header.mRecordSize != sizeof(CAPlayThroughTraceRecord))
+		err = -1;
+	else {
+		records.resize(header.mNumberRecords);
+		if (header.mNumberRecords && fread(&records[0], sizeof(CAPlayThroughTraceRecord), header.mNumberRecords, f) != header.mNumberRecords)
+			err = -1;
+	}
+	fclose(f);
+	if (err) return err;
+	
+	// the largest callback decides the scratch buffer size
+	UInt32 maxFrames = 1;
+	for (UInt32 i = 0; i < records.size(); ++i)
+		if (records[i].mFrames > maxFrames) maxFrames = records[i].mFrames;
+	
+	CAPlayThroughEngine engine;
+	engine.Allocate(header.mInputChannels, header.mOutputChannels, header.mRingCapacityFrames);
+	engine.SetThruOffset(header.mThruOffset);
+	AudioBufferList *input = NewBufferList(header.mInputChannels, maxFrames);
+	AudioBufferList *output = NewBufferList(header.mOutputChannels, maxFrames);
+	
+	bool filled = false;
+	struct timeval start, end;
+	gettimeofday(&start, NULL);
+	
+	for (UInt32 i = 0; i < records.size(); ++i) {
+		const CAPlayThroughTraceRecord &r = records[i];
+		if (r.mKind == kCAPlayThroughTrace_Input) {
+			FillInput(input, r.mFrames, SInt64(r.mSampleTime));
+			engine.StoreInput(input, r.mFrames, r.mSampleTime);
+			++outResult.mInputCallbacks;
+		} else {
+			for (UInt32 c = 0; c < output->mNumberBuffers; ++c)
+				output->mBuffers[c].mDataByteSize = r.mFrames * sizeof(Float32);
+			if (engine.FetchOutput(output, r.mFrames, r.mSampleTime))
+				filled = true;
+			else {
+				++outResult.mSilentOutputs;
+				if (filled)
+					++outResult.mUnderruns;
+			}
+			outResult.mChecksum = Checksum(outResult.mChecksum, output, r.mFrames);
+			outResult.mOutputFrames += r.mFrames;
+			++outResult.mOutputCallbacks;
+		}
+	}
+	
+	gettimeofday(&end, NULL);
+	outResult.mElapsedSeconds = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) * 1e-6;
+	outResult.mFillSpread = engine.GetFillSpread();
+	if (header.mInputSampleRate > 0.)
+		outResult.mAudioSeconds = outResult.mOutputFrames / header.mInputSampleRate;
+	
+	DisposeBufferList(input);
+	DisposeBufferList(output);
+	return noErr;
+}
@@ -0,0 +1,140 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAPlayThroughTrace.h
+
+=============================================================================*/
+
+#ifndef __CAPlayThroughTrace_h__
+#define __CAPlayThroughTrace_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+/*
+	Record and replay of the play through callback sequence.
+	
+	While tracing, CAPlayThrough appends one record per input and output callback that
+	reaches the CAPlayThroughEngine: host time, frame count, sample time and rate scalar.
+	Records go into a preallocated array, so recording is safe on the IO threads; the file
+	is written when the play through stops. CAPlayThroughReplay feeds such a file back into
+	a CAPlayThroughEngine offline, as fast as possible, with a deterministic input signal,
+	and returns a checksum of everything the output side produced. Two runs of the same
+	trace must give the same checksum, which makes traces usable as regression tests and
+	as benchmarks of the engine.
+	
+	File layout (native byte order): one CAPlayThroughTraceHeader followed by
+	mNumberRecords CAPlayThroughTraceRecords.
+*/
+
+enum {
+	kCAPlayThroughTraceMagic		= 'CAPT',
+	kCAPlayThroughTraceVersion		= 1
+};
+
+enum {
+	kCAPlayThroughTrace_Input		= 0,
+	kCAPlayThroughTrace_Output		= 1
+};
+
+struct CAPlayThroughTraceHeader {
+	UInt32		mMagic;
+	UInt32		mVersion;
+	UInt32		mRecordSize;			// sizeof(CAPlayThroughTraceRecord)
+	UInt32		mNumberRecords;
+	UInt32		mDroppedRecords;		// callbacks after the record array filled up
+	UInt32		mInputChannels;
+	UInt32		mOutputChannels;
+	UInt32		mRingCapacityFrames;
+	Float64		mThruOffset;
+	Float64		mInputSampleRate;
+	Float64		mOutputSampleRate;
+};
+
+struct CAPlayThroughTraceRecord {
+	UInt64		mHostTime;
+	Float64		mSampleTime;
+	Float64		mRateScalar;			// input: device rate scalar, output: varispeed rate
+	UInt32		mFrames;
+	UInt32		mKind;
+};
+
+class CAPlayThroughTraceRecorder {
+public:
+	CAPlayThroughTraceRecorder(UInt32 maxRecords);
+	~CAPlayThroughTraceRecorder();
+	
+	void		SetHeader(const CAPlayThroughTraceHeader &header)	{ mHeader = header; }
+	const CAPlayThroughTraceHeader &GetHeader() const				{ return mHeader; }
+	
+	// safe to call from the IO threads
+	void		Record(UInt32 kind, const AudioTimeStamp &timeStamp, UInt32 nFrames, Float64 rateScalar);
+	
+	UInt32		NumberRecords() const;
+	void		Clear();
+	OSStatus	WriteToFile(const char *path);
+
+private:
+	CAPlayThroughTraceHeader	mHeader;
+	CAPlayThroughTraceRecord *	mRecords;
+	UInt32						mMaxRecords;
+	volatile SInt32				mNextRecord;
+};
+
+struct CAPlayThroughReplayResult {
+	UInt32		mInputCallbacks;
+	UInt32		mOutputCallbacks;
+	UInt32		mSilentOutputs;			// output callbacks the engine could not fill
+	UInt32		mUnderruns;				// the silent ones after the first filled one
+	SInt32		mFillSpread;			// CAPlayThroughEngine::GetFillSpread() at the end
+	UInt64		mOutputFrames;
+	Float64		mAudioSeconds;			// mOutputFrames at the input device's sample rate
+	UInt64		mChecksum;				// FNV-1a over every output sample
+	Float64		mElapsedSeconds;		// wall clock time spent replaying
+};
+
+// Replays the trace file at path through a new CAPlayThroughEngine.
+OSStatus	CAPlayThroughReplay(const char *path, CAPlayThroughReplayResult &outResult);
+
+#endif // __CAPlayThroughTrace_h__
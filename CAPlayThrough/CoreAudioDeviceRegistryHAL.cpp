@@ -0,0 +1,168 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CoreAudioDeviceRegistryHAL.cpp
+	
+=============================================================================*/
+
+/*
+	The CoreAudio source of device properties and notifications behind
+	AudioDeviceRegistry::Shared(). It lives apart from the registry itself so the
+	registry builds, and is tested against a mock HAL, without the CoreAudio framework.
+*/
+
+#include "AudioDeviceRegistry.h"
+#include <stdlib.h>
+#include <string.h>
+
+// The CoreAudio backed source used by Shared().
+class CoreAudioDeviceRegistryHAL : public AudioDeviceRegistry::HAL {
+public:
+	virtual OSStatus	GetDeviceIDs(std::vector<AudioDeviceID> &outIDs);
+	virtual OSStatus	GetDeviceInfo(AudioDeviceID inID, AudioDeviceRegistry::DeviceInfo &outInfo);
+	virtual void		ListenToDeviceList(AudioDeviceRegistry *registry, bool listen);
+	virtual void		ListenToDevice(AudioDeviceRegistry *registry, AudioDeviceID inID, bool listen);
+
+private:
+	static OSStatus		HardwareListener(AudioHardwarePropertyID inPropertyID, void *inClientData);
+	static OSStatus		DeviceListener(AudioDeviceID inDevice, UInt32 inChannel, Boolean isInput,
+										AudioDevicePropertyID inPropertyID, void *inClientData);
+};
+
+// everything that goes into a DeviceInfo
+static const AudioDevicePropertyID kWatchedDeviceProperties[] = {
+	kAudioDevicePropertyDeviceName,
+	kAudioDevicePropertyStreamConfiguration,
+	kAudioDevicePropertyStreamFormat,
+	kAudioDevicePropertySafetyOffset,
+	kAudioDevicePropertyBufferFrameSize
+};
+static const int kNumWatchedDeviceProperties = sizeof(kWatchedDeviceProperties) / sizeof(kWatchedDeviceProperties[0]);
+
+OSStatus	CoreAudioDeviceRegistryHAL::GetDeviceIDs(std::vector<AudioDeviceID> &outIDs)
+{
+	UInt32 propsize;
+	OSStatus err = AudioHardwareGetPropertyInfo(kAudioHardwarePropertyDevices, &propsize, NULL);
+	if (err) return err;
+	
+	outIDs.resize(propsize / sizeof(AudioDeviceID));
+	if (outIDs.empty()) return noErr;
+	err = AudioHardwareGetProperty(kAudioHardwarePropertyDevices, &propsize, &outIDs[0]);
+	outIDs.resize(propsize / sizeof(AudioDeviceID));
+	return err;
+}
+
+OSStatus	CoreAudioDeviceRegistryHAL::GetDeviceInfo(AudioDeviceID inID, AudioDeviceRegistry::DeviceInfo &outInfo)
+{
+	memset(&outInfo, 0, sizeof(outInfo));
+	outInfo.mID = inID;
+	
+	UInt32 propsize = sizeof(outInfo.mName);
+	OSStatus err = AudioDeviceGetProperty(inID, 0, false, kAudioDevicePropertyDeviceName, &propsize, outInfo.mName);
+	if (err) return err;
+	outInfo.mName[sizeof(outInfo.mName) - 1] = 0;
+	
+	for (int dir = 0; dir < 2; ++dir) {
+		Boolean isInput = (dir == AudioDeviceRegistry::kInput);
+		
+		// one stream configuration read per direction, the same query AudioDevice::CountChannels makes
+		if (AudioDeviceGetPropertyInfo(inID, 0, isInput, kAudioDevicePropertyStreamConfiguration, &propsize, NULL))
+			continue;
+		AudioBufferList *buflist = (AudioBufferList *)malloc(propsize);
+		if (!AudioDeviceGetProperty(inID, 0, isInput, kAudioDevicePropertyStreamConfiguration, &propsize, buflist))
+			for (UInt32 i = 0; i < buflist->mNumberBuffers; ++i)
+				outInfo.mChannels[dir] += buflist->mBuffers[i].mNumberChannels;
+		free(buflist);
+		
+		if (outInfo.mChannels[dir] == 0)
+			continue;
+		
+		propsize = sizeof(UInt32);
+		AudioDeviceGetProperty(inID, 0, isInput, kAudioDevicePropertySafetyOffset, &propsize, &outInfo.mSafetyOffset[dir]);
+		propsize = sizeof(UInt32);
+		AudioDeviceGetProperty(inID, 0, isInput, kAudioDevicePropertyBufferFrameSize, &propsize, &outInfo.mBufferSizeFrames[dir]);
+		propsize = sizeof(AudioStreamBasicDescription);
+		AudioDeviceGetProperty(inID, 0, isInput, kAudioDevicePropertyStreamFormat, &propsize, &outInfo.mFormat[dir]);
+	}
+	return noErr;
+}
+
+void	CoreAudioDeviceRegistryHAL::ListenToDeviceList(AudioDeviceRegistry *registry, bool listen)
+{
+	if (listen)
+		AudioHardwareAddPropertyListener(kAudioHardwarePropertyDevices, HardwareListener, registry);
+	else
+		AudioHardwareRemovePropertyListener(kAudioHardwarePropertyDevices, HardwareListener);
+}
+
+void	CoreAudioDeviceRegistryHAL::ListenToDevice(AudioDeviceRegistry *registry, AudioDeviceID inID, bool listen)
+{
+	for (int dir = 0; dir < 2; ++dir) {
+		for (int p = 0; p < kNumWatchedDeviceProperties; ++p) {
+			if (listen)
+				AudioDeviceAddPropertyListener(inID, 0, dir, kWatchedDeviceProperties[p], DeviceListener, registry);
+			else
+				AudioDeviceRemovePropertyListener(inID, 0, dir, kWatchedDeviceProperties[p], DeviceListener);
+		}
+	}
+}
+
+OSStatus	CoreAudioDeviceRegistryHAL::HardwareListener(AudioHardwarePropertyID inPropertyID, void *inClientData)
+{
+	((AudioDeviceRegistry *)inClientData)->DeviceListChanged();
+	return noErr;
+}
+
+OSStatus	CoreAudioDeviceRegistryHAL::DeviceListener(AudioDeviceID inDevice, UInt32 inChannel, Boolean isInput,
+														AudioDevicePropertyID inPropertyID, void *inClientData)
+{
+	((AudioDeviceRegistry *)inClientData)->DevicePropertiesChanged(inDevice);
+	return noErr;
+}
+
+AudioDeviceRegistry &	AudioDeviceRegistry::Shared()
+{
+	static AudioDeviceRegistry *sRegistry = NULL;
+	static pthread_once_t sOnce = PTHREAD_ONCE_INIT;
+	struct Init { static void Create() { sRegistry = new AudioDeviceRegistry(new CoreAudioDeviceRegistryHAL); } };
+	pthread_once(&sOnce, Init::Create);
+	return *sRegistry;
+}
@@ -0,0 +1,140 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAPlayThroughTraceSynthesis.cpp
+	
+=============================================================================*/
+
+#include "CAPlayThroughTraceSynthesis.h"
+#include <string.h>
+#include <math.h>
+
+CAPlayThroughTraceModel::CAPlayThroughTraceModel() :
+	mInputSampleRate(48000.), mOutputSampleRate(48000.),
+	mInputBufferFrames(512), mOutputBufferFrames(512),
+	mInputSafetyOffset(0), mOutputSafetyOffset(0),
+	mInputChannels(2), mOutputChannels(2),
+	mSeconds(10.), mJitterFrames(0), mStallStart(0.), mStallSeconds(0.), mSeed(1)
+{
+}
+
+UInt32	CAPlayThroughTraceModelRingCapacity(const CAPlayThroughTraceModel &model)
+{
+	return CAPlayThroughEngine::ComputeRingCapacity(model.mSizing,
+					model.mInputBufferFrames, model.mInputSafetyOffset,
+					model.mOutputBufferFrames, model.mOutputSafetyOffset,
+					model.mInputSampleRate / model.mOutputSampleRate);
+}
+
+// a small generator of our own, so a seed gives the same trace everywhere
+static UInt32	NextRandom(UInt32 &ioState)
+{
+	ioState = ioState * 1664525 + 1013904223;
+	return ioState >> 8;
+}
+
+OSStatus	CAPlayThroughSynthesizeTrace(const CAPlayThroughTraceModel &model, const char *path)
+{
+	const Float64 ratio = model.mInputSampleRate / model.mOutputSampleRate;
+	const Float64 inPeriod = model.mInputBufferFrames / model.mInputSampleRate;
+	const Float64 outPeriod = model.mOutputBufferFrames / model.mOutputSampleRate;
+	const UInt32 inCallbacks = UInt32(model.mSeconds / inPeriod);
+	const UInt32 outCallbacks = UInt32(model.mSeconds / outPeriod);
+	const Float64 stallEnd = model.mStallStart + model.mStallSeconds;
+	
+	CAPlayThroughTraceRecorder recorder(inCallbacks + outCallbacks);
+	CAPlayThroughTraceHeader header;
+	memset(&header, 0, sizeof(header));
+	header.mInputChannels = model.mInputChannels;
+	header.mOutputChannels = model.mOutputChannels;
+	header.mRingCapacityFrames = CAPlayThroughTraceModelRingCapacity(model);
+	header.mThruOffset = SInt32(model.mInputSafetyOffset + model.mInputBufferFrames +
+								model.mOutputSafetyOffset + model.mOutputBufferFrames + model.mSizing.mJitterFrames);
+	header.mInputSampleRate = model.mInputSampleRate;
+	header.mOutputSampleRate = model.mOutputSampleRate;
+	recorder.SetHeader(header);
+	
+	AudioTimeStamp ts;
+	memset(&ts, 0, sizeof(ts));
+	ts.mRateScalar = 1.;
+	
+	UInt32 random = model.mSeed;
+	UInt32 in = 0, out = 0;
+	Float64 inDelivered = 0.;		// callbacks arrive in order, however late
+	Float64 inNext = 0., outNext = 0.;
+	Float64 pulled = 0.;			// input frames the varispeed has asked for so far
+	bool haveIn = false;
+	
+	while (in < inCallbacks || out < outCallbacks) {
+		// when the next input callback arrives: after its buffer is full, plus jitter, never
+		// before the previous one and never during the stall
+		if (!haveIn && in < inCallbacks) {
+			Float64 t = (in + 1) * inPeriod;
+			if (model.mJitterFrames)
+				t += (NextRandom(random) % (model.mJitterFrames + 1)) / model.mInputSampleRate;
+			if (t < inDelivered) t = inDelivered;
+			if (model.mStallSeconds > 0. && t >= model.mStallStart && t < stallEnd) t = stallEnd;
+			inNext = inDelivered = t;
+			haveIn = true;
+		}
+		outNext = out * outPeriod;
+		
+		if (haveIn && (out >= outCallbacks || inNext <= outNext)) {
+			ts.mSampleTime = Float64(in) * model.mInputBufferFrames;
+			ts.mHostTime = UInt64(inNext * 1e9);
+			recorder.Record(kCAPlayThroughTrace_Input, ts, model.mInputBufferFrames, 1.);
+			++in;
+			haveIn = false;
+		} else {
+			// the varispeed pulls the output buffer's worth of input frames, rounded so
+			// that the pulls add up
+			Float64 next = pulled + model.mOutputBufferFrames * ratio;
+			UInt32 frames = UInt32(floor(next) - floor(pulled));
+			ts.mSampleTime = floor(pulled);
+			ts.mHostTime = UInt64(outNext * 1e9);
+			recorder.Record(kCAPlayThroughTrace_Output, ts, frames, ratio);
+			pulled = next;
+			++out;
+		}
+	}
+	
+	return recorder.WriteToFile(path);
+}
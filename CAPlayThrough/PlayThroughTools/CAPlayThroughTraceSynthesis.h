@@ -0,0 +1,88 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAPlayThroughTraceSynthesis.h
+	
+=============================================================================*/
+
+#ifndef __CAPlayThroughTraceSynthesis_h__
+#define __CAPlayThroughTraceSynthesis_h__
+
+#include "CAPlayThroughEngine.h"
+#include "CAPlayThroughTrace.h"
+
+/*
+	Writes CAPlayThroughTrace files for device configurations nobody has to own: two
+	free running device clocks, the input callbacks arriving late by up to a given jitter,
+	and optionally the input device stalling for a while. The output records are the
+	varispeed's pulls, in input device frames, as CAPlayThrough records them. The header
+	gets the thru offset CAPlayThrough::ComputeThruOffset would use and a ring sized by
+	CAPlayThroughEngine::ComputeRingCapacity, so a replay behaves as the play through
+	would on such devices.
+*/
+
+struct CAPlayThroughTraceModel {
+	Float64		mInputSampleRate;
+	Float64		mOutputSampleRate;
+	UInt32		mInputBufferFrames;
+	UInt32		mOutputBufferFrames;
+	UInt32		mInputSafetyOffset;
+	UInt32		mOutputSafetyOffset;
+	UInt32		mInputChannels;
+	UInt32		mOutputChannels;
+	Float64		mSeconds;
+	
+	UInt32		mJitterFrames;		// each input callback arrives up to this many input frames late
+	Float64		mStallStart;		// seconds; the input device delivers nothing from here ...
+	Float64		mStallSeconds;		// ... for this long, then catches up (0: no stall)
+	UInt32		mSeed;				// for the jitter
+	
+	CAPlayThroughRingSizing	mSizing;
+	
+	CAPlayThroughTraceModel();
+};
+
+// The ring the header will ask for.
+UInt32		CAPlayThroughTraceModelRingCapacity(const CAPlayThroughTraceModel &model);
+
+OSStatus	CAPlayThroughSynthesizeTrace(const CAPlayThroughTraceModel &model, const char *path);
+
+#endif // __CAPlayThroughTraceSynthesis_h__
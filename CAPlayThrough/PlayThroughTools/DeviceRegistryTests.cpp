@@ -0,0 +1,321 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	DeviceRegistryTests.cpp
+	
+=============================================================================*/
+
+/*
+	deviceregistrytests: runs AudioDeviceRegistry on a mock HAL and checks that it keeps
+	its snapshot in step with the devices, queries only what changed, listens to every
+	device exactly once and tells its change listeners. See README for building.
+	
+	The mock answers from a list the test edits and counts the queries and listener
+	registrations; it can also be made slow, so that notifications arriving on several
+	threads at once overlap the way HAL notifications and the first scan can.
+*/
+
+#include "AudioDeviceRegistry.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+
+// What the mock HAL serves, kept outside it: the registry owns and deletes the HAL.
+struct MockDevices {
+	pthread_mutex_t								mMutex;
+	std::vector<AudioDeviceRegistry::DeviceInfo>	mDevices;
+	std::map<AudioDeviceID, int>				mListens;		// registrations per device
+	int											mListListens;
+	int											mInfoQueries;
+	useconds_t									mQueryDelay;
+	
+	MockDevices() : mListListens(0), mInfoQueries(0), mQueryDelay(0) { pthread_mutex_init(&mMutex, NULL); }
+	~MockDevices() { pthread_mutex_destroy(&mMutex); }
+	
+	void	Add(AudioDeviceID inID, UInt32 inInputs, UInt32 inOutputs)
+	{
+		AudioDeviceRegistry::DeviceInfo info;
+		memset(&info, 0, sizeof(info));
+		info.mID = inID;
+		snprintf(info.mName, sizeof(info.mName), "Device %lu", (unsigned long)inID);
+		info.mChannels[AudioDeviceRegistry::kInput] = inInputs;
+		info.mChannels[AudioDeviceRegistry::kOutput] = inOutputs;
+		info.mBufferSizeFrames[AudioDeviceRegistry::kInput] = info.mBufferSizeFrames[AudioDeviceRegistry::kOutput] = 512;
+		pthread_mutex_lock(&mMutex);
+		mDevices.push_back(info);
+		pthread_mutex_unlock(&mMutex);
+	}
+	
+	void	Remove(AudioDeviceID inID)
+	{
+		pthread_mutex_lock(&mMutex);
+		for (size_t i = 0; i < mDevices.size(); ++i)
+			if (mDevices[i].mID == inID) {
+				mDevices.erase(mDevices.begin() + i);
+				break;
+			}
+		pthread_mutex_unlock(&mMutex);
+	}
+	
+	void	SetBufferSize(AudioDeviceID inID, UInt32 inFrames)
+	{
+		pthread_mutex_lock(&mMutex);
+		for (size_t i = 0; i < mDevices.size(); ++i)
+			if (mDevices[i].mID == inID)
+				mDevices[i].mBufferSizeFrames[AudioDeviceRegistry::kOutput] = inFrames;
+		pthread_mutex_unlock(&mMutex);
+	}
+	
+	int		Listens(AudioDeviceID inID)
+	{
+		pthread_mutex_lock(&mMutex);
+		int listens = mListens[inID];
+		pthread_mutex_unlock(&mMutex);
+		return listens;
+	}
+};
+
+class MockHAL : public AudioDeviceRegistry::HAL {
+public:
+	MockHAL(MockDevices &devices) : mState(devices) { }
+	
+	virtual OSStatus	GetDeviceIDs(std::vector<AudioDeviceID> &outIDs)
+	{
+		outIDs.clear();
+		pthread_mutex_lock(&mState.mMutex);
+		for (size_t i = 0; i < mState.mDevices.size(); ++i)
+			outIDs.push_back(mState.mDevices[i].mID);
+		pthread_mutex_unlock(&mState.mMutex);
+		return noErr;
+	}
+	
+	virtual OSStatus	GetDeviceInfo(AudioDeviceID inID, AudioDeviceRegistry::DeviceInfo &outInfo)
+	{
+		if (mState.mQueryDelay)
+			usleep(mState.mQueryDelay);
+		OSStatus err = -1;
+		pthread_mutex_lock(&mState.mMutex);
+		++mState.mInfoQueries;
+		for (size_t i = 0; i < mState.mDevices.size(); ++i)
+			if (mState.mDevices[i].mID == inID) {
+				outInfo = mState.mDevices[i];
+				err = noErr;
+			}
+		pthread_mutex_unlock(&mState.mMutex);
+		return err;
+	}
+	
+	virtual void		ListenToDeviceList(AudioDeviceRegistry *, bool listen)
+	{
+		pthread_mutex_lock(&mState.mMutex);
+		mState.mListListens += listen ? 1 : -1;
+		pthread_mutex_unlock(&mState.mMutex);
+	}
+	
+	virtual void		ListenToDevice(AudioDeviceRegistry *, AudioDeviceID inID, bool listen)
+	{
+		pthread_mutex_lock(&mState.mMutex);
+		mState.mListens[inID] += listen ? 1 : -1;
+		pthread_mutex_unlock(&mState.mMutex);
+	}
+
+private:
+	MockDevices &	mState;
+};
+
+static UInt32	sFailures = 0;
+
+static void	Check(bool inPassed, const char *inName)
+{
+	printf("%-4s  %s\n", inPassed ? "ok" : "FAIL", inName);
+	if (!inPassed) ++sFailures;
+}
+
+static void	CountChange(AudioDeviceRegistry *, void *refCon)
+{
+	__sync_fetch_and_add((volatile int *)refCon, 1);
+}
+
+static bool	Lists(AudioDeviceRegistry &inRegistry, bool inInputs, const AudioDeviceID *inIDs, size_t inCount)
+{
+	AudioDeviceRegistry::DeviceInfoList devices;
+	inRegistry.GetDevices(inInputs, devices);
+	if (devices.size() != inCount) return false;
+	for (size_t i = 0; i < inCount; ++i)
+		if (devices[i].mID != inIDs[i]) return false;
+	return true;
+}
+
+#pragma mark ____Updates
+
+static void	TestUpdates()
+{
+	MockDevices mock;
+	mock.Add(1, 0, 2);		// output only
+	mock.Add(2, 2, 0);		// input only
+	mock.Add(3, 1, 2);
+	
+	{
+		AudioDeviceRegistry registry(new MockHAL(mock));
+		volatile int changes = 0;
+		registry.AddChangeListener(CountChange, (void *)&changes);
+		
+		static const AudioDeviceID kInputs[] = { 2, 3 }, kOutputs[] = { 1, 3 };
+		Check(Lists(registry, true, kInputs, 2) && Lists(registry, false, kOutputs, 2) &&
+				mock.mInfoQueries == 3 && mock.mListListens == 1 &&
+				mock.Listens(1) == 1 && mock.Listens(2) == 1 && mock.Listens(3) == 1,
+				"first scan lists every device in HAL order and listens to each");
+		
+		UInt32 generation = registry.GetGeneration();
+		int queries = mock.mInfoQueries;
+		mock.Add(4, 2, 2);
+		registry.DeviceListChanged();
+		static const AudioDeviceID kAfterAdd[] = { 1, 3, 4 };
+		Check(Lists(registry, false, kAfterAdd, 3) && mock.mInfoQueries == queries + 1 &&
+				mock.Listens(4) == 1 && changes == 1 && registry.GetGeneration() != generation,
+				"an added device is the only one queried");
+		
+		generation = registry.GetGeneration();
+		queries = mock.mInfoQueries;
+		mock.Remove(3);
+		registry.DeviceListChanged();
+		static const AudioDeviceID kAfterRemove[] = { 1, 4 };
+		AudioDeviceRegistry::DeviceInfo info;
+		Check(Lists(registry, false, kAfterRemove, 2) && !registry.GetDevice(3, info) &&
+				mock.mInfoQueries == queries && mock.Listens(3) == 0 && changes == 2 &&
+				registry.GetGeneration() != generation,
+				"a removed device is dropped and no longer listened to");
+		
+		generation = registry.GetGeneration();
+		registry.DeviceListChanged();
+		Check(changes == 2 && registry.GetGeneration() == generation, "an unchanged list notifies nobody");
+		
+		mock.SetBufferSize(4, 128);
+		registry.DevicePropertiesChanged(4);
+		bool updated = registry.GetDevice(4, info) && info.mBufferSizeFrames[AudioDeviceRegistry::kOutput] == 128;
+		Check(updated && changes == 3 && registry.GetGeneration() != generation, "a property change re-reads that device");
+		
+		generation = registry.GetGeneration();
+		registry.DevicePropertiesChanged(4);
+		Check(changes == 3 && registry.GetGeneration() == generation, "an unchanged device notifies nobody");
+		
+		registry.RemoveChangeListener(CountChange, (void *)&changes);
+		mock.Add(5, 2, 2);
+		registry.DeviceListChanged();
+		Check(changes == 3, "a removed change listener is not called");
+	}
+	
+	Check(mock.mListListens == 0 && mock.Listens(1) == 0 && mock.Listens(2) == 0 && mock.Listens(4) == 0 &&
+			mock.Listens(5) == 0, "the registry stops listening when it goes away");
+}
+
+#pragma mark ____Concurrency
+
+struct Notifier {
+	AudioDeviceRegistry *	mRegistry;
+	AudioDeviceID			mDevice;		// 0: the device list changed
+};
+
+static void *	Notify(void *inNotifier)
+{
+	Notifier *notifier = (Notifier *)inNotifier;
+	if (notifier->mDevice)
+		notifier->mRegistry->DevicePropertiesChanged(notifier->mDevice);
+	else
+		notifier->mRegistry->DeviceListChanged();
+	return NULL;
+}
+
+// Several notifications for the same new devices at once, as the HAL thread can deliver them while
+// the first scan or another notification is still querying.
+static void	TestConcurrency()
+{
+	const int kRounds = 50, kThreads = 4, kNewDevices = 3;
+	bool once = true, complete = true;
+	
+	for (int round = 0; round < kRounds && once && complete; ++round) {
+		MockDevices mock;
+		mock.Add(1, 2, 2);
+		AudioDeviceRegistry registry(new MockHAL(mock));
+		
+		mock.mQueryDelay = 200;
+		for (int d = 0; d < kNewDevices; ++d)
+			mock.Add(10 + d, 2, 2);
+		mock.SetBufferSize(10, 64);
+		
+		pthread_t threads[kThreads + 1];
+		Notifier notifiers[kThreads + 1];
+		for (int t = 0; t <= kThreads; ++t) {
+			notifiers[t].mRegistry = &registry;
+			notifiers[t].mDevice = (t == kThreads) ? 10 : 0;
+			pthread_create(&threads[t], NULL, Notify, &notifiers[t]);
+		}
+		for (int t = 0; t <= kThreads; ++t)
+			pthread_join(threads[t], NULL);
+		
+		AudioDeviceRegistry::DeviceInfoList devices;
+		registry.GetDevices(false, devices);
+		AudioDeviceRegistry::DeviceInfo info;
+		complete = devices.size() == size_t(kNewDevices + 1) && registry.GetDevice(10, info) &&
+					info.mBufferSizeFrames[AudioDeviceRegistry::kOutput] == 64;
+		for (int d = 0; d < kNewDevices; ++d)
+			if (mock.Listens(10 + d) != 1)
+				once = false;
+	}
+	
+	Check(once, "overlapping notifications listen to a new device once");
+	Check(complete, "overlapping notifications leave a complete snapshot");
+}
+
+int main(int argc, char *const [])
+{
+	if (argc != 1) {
+		fprintf(stderr, "usage: deviceregistrytests\n");
+		return 2;
+	}
+	
+	TestUpdates();
+	TestConcurrency();
+	
+	printf("%lu failed\n", (unsigned long)sFailures);
+	return sFailures ? 1 : 0;
+}
@@ -0,0 +1,210 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	PlayThroughReplay.cpp
+	
+=============================================================================*/
+
+/*
+	playthroughreplay: replays CAPlayThroughTrace files through CAPlayThroughReplay and
+	reports what the engine made of them, or writes synthetic traces to replay. See README
+	for building and the options.
+	
+	Every trace is replayed --runs times; the runs must agree on the checksum, and the
+	fastest one gives the speed. The exit status is 1 if any trace can't be read, or its
+	runs disagree.
+*/
+
+#include "CAPlayThroughTrace.h"
+#include "CAPlayThroughTraceSynthesis.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+static bool	Replay(const char *inPath, UInt32 inRuns)
+{
+	CAPlayThroughReplayResult first, result;
+	Float64 fastest = 0.;
+	for (UInt32 run = 0; run < inRuns; ++run) {
+		OSStatus err = CAPlayThroughReplay(inPath, result);
+		if (err) {
+			fprintf(stderr, "%s: not a play through trace (%ld)\n", inPath, (long)err);
+			return false;
+		}
+		if (run == 0) {
+			first = result;
+			fastest = result.mElapsedSeconds;
+		} else if (result.mChecksum != first.mChecksum) {
+			fprintf(stderr, "%s: run %lu gave checksum %016llx, run 0 %016llx\n", inPath, (unsigned long)run,
+					(unsigned long long)result.mChecksum, (unsigned long long)first.mChecksum);
+			return false;
+		} else if (result.mElapsedSeconds < fastest)
+			fastest = result.mElapsedSeconds;
+	}
+	
+	printf("%s: %lu input and %lu output callbacks, %lu silent (%lu underruns), fill spread %ld frames\n",
+			inPath, (unsigned long)first.mInputCallbacks, (unsigned long)first.mOutputCallbacks,
+			(unsigned long)first.mSilentOutputs, (unsigned long)first.mUnderruns, (long)first.mFillSpread);
+	printf("%s: checksum %016llx, %.1f s of audio in %.3f s (%.0fx real time)\n", inPath,
+			(unsigned long long)first.mChecksum, first.mAudioSeconds, fastest,
+			fastest > 0. ? first.mAudioSeconds / fastest : 0.);
+	return true;
+}
+
+#pragma mark ____Options
+
+static void	Usage()
+{
+	fprintf(stderr,
+		"usage: playthroughreplay [-r runs] trace ...\n"
+		"       playthroughreplay -s trace [model options]\n"
+		"  -r, --runs N           replays of each trace, which must agree (3)\n"
+		"  -s, --synthesize PATH  write a trace of the model below instead\n"
+		"model:\n"
+		"      --rates IN:OUT     device sample rates (48000:48000)\n"
+		"      --buffers IN:OUT   device buffer sizes in frames (512:512)\n"
+		"      --safety IN:OUT    device safety offsets in frames (0:0)\n"
+		"      --channels IN:OUT  (2:2)\n"
+		"      --seconds S        length (10)\n"
+		"      --jitter N         input callbacks arrive up to N frames late (0)\n"
+		"      --stall AT:S       the input device stalls at AT seconds for S seconds\n"
+		"      --margin M         ring sizing safety margin (2)\n"
+		"      --seed N           for the jitter (1)\n");
+}
+
+static bool	ParsePair(const char *inText, Float64 &outFirst, Float64 &outSecond)
+{
+	char *end;
+	outFirst = strtod(inText, &end);
+	if (*end != ':') return false;
+	outSecond = strtod(end + 1, &end);
+	return *end == 0;
+}
+
+static bool	ParsePair(const char *inText, UInt32 &outFirst, UInt32 &outSecond)
+{
+	Float64 first, second;
+	if (!ParsePair(inText, first, second) || first < 0. || second < 0.) return false;
+	outFirst = UInt32(first);
+	outSecond = UInt32(second);
+	return true;
+}
+
+int main(int argc, char *const argv[])
+{
+	CAPlayThroughTraceModel model;
+	const char *synthesize = NULL;
+	UInt32 runs = 3;
+	
+	enum { kOptionRates = 256, kOptionBuffers, kOptionSafety, kOptionChannels, kOptionSeconds,
+			kOptionJitter, kOptionStall, kOptionMargin, kOptionSeed };
+	static const struct option options[] = {
+		{ "runs",		required_argument,	NULL, 'r' },
+		{ "synthesize",	required_argument,	NULL, 's' },
+		{ "rates",		required_argument,	NULL, kOptionRates },
+		{ "buffers",	required_argument,	NULL, kOptionBuffers },
+		{ "safety",		required_argument,	NULL, kOptionSafety },
+		{ "channels",	required_argument,	NULL, kOptionChannels },
+		{ "seconds",	required_argument,	NULL, kOptionSeconds },
+		{ "jitter",		required_argument,	NULL, kOptionJitter },
+		{ "stall",		required_argument,	NULL, kOptionStall },
+		{ "margin",		required_argument,	NULL, kOptionMargin },
+		{ "seed",		required_argument,	NULL, kOptionSeed },
+		{ NULL,			0,					NULL, 0 }
+	};
+	
+	int ch;
+	bool ok = true;
+	while (ok && (ch = getopt_long(argc, argv, "r:s:", options, NULL)) != -1) {
+		switch (ch) {
+			case 'r':	runs = strtoul(optarg, NULL, 0);						break;
+			case 's':	synthesize = optarg;									break;
+			case kOptionRates:
+				ok = ParsePair(optarg, model.mInputSampleRate, model.mOutputSampleRate);
+				break;
+			case kOptionBuffers:
+				ok = ParsePair(optarg, model.mInputBufferFrames, model.mOutputBufferFrames);
+				break;
+			case kOptionSafety:
+				ok = ParsePair(optarg, model.mInputSafetyOffset, model.mOutputSafetyOffset);
+				break;
+			case kOptionChannels:
+				ok = ParsePair(optarg, model.mInputChannels, model.mOutputChannels);
+				break;
+			case kOptionSeconds:	model.mSeconds = strtod(optarg, NULL);		break;
+			case kOptionJitter:		model.mJitterFrames = strtoul(optarg, NULL, 0);	break;
+			case kOptionStall:
+				ok = ParsePair(optarg, model.mStallStart, model.mStallSeconds);
+				break;
+			case kOptionMargin:		model.mSizing.mSafetyMargin = strtod(optarg, NULL);	break;
+			case kOptionSeed:		model.mSeed = strtoul(optarg, NULL, 0);		break;
+			default:	ok = false;												break;
+		}
+	}
+	const int numInputs = argc - optind;
+	if (!ok || runs == 0 || (synthesize ? numInputs != 0 : numInputs < 1) ||
+		model.mInputSampleRate <= 0. || model.mOutputSampleRate <= 0. ||
+		model.mInputBufferFrames == 0 || model.mOutputBufferFrames == 0 ||
+		model.mInputChannels == 0 || model.mOutputChannels == 0 || model.mSeconds <= 0.) {
+		Usage();
+		return 2;
+	}
+	
+	if (synthesize) {
+		// the device model gets the jitter it will see as ring headroom, as a host that had measured it would
+		model.mSizing.mJitterFrames = model.mJitterFrames;
+		OSStatus err = CAPlayThroughSynthesizeTrace(model, synthesize);
+		if (err) {
+			fprintf(stderr, "%s: cannot write (%ld)\n", synthesize, (long)err);
+			return 1;
+		}
+		printf("%s: %.1f s, ring %lu frames\n", synthesize, model.mSeconds,
+				(unsigned long)CAPlayThroughTraceModelRingCapacity(model));
+		return 0;
+	}
+	
+	int result = 0;
+	for (int i = optind; i < argc; ++i)
+		if (!Replay(argv[i], runs))
+			result = 1;
+	return result;
+}
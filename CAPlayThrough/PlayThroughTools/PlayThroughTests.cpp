@@ -0,0 +1,271 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	PlayThroughTests.cpp
+	
+=============================================================================*/
+
+/*
+	playthroughtests: checks the ring sizing and the underrun handling of
+	CAPlayThroughEngine against synthetic callback traces (CAPlayThroughTraceSynthesis)
+	replayed through CAPlayThroughReplay. See README for building.
+	
+	  sizing    for a matrix of buffer sizes, sample rates and callback jitter, a ring
+	            sized by CAPlayThroughEngine::ComputeRingCapacity with the jitter known
+	            never underruns once playing has started.
+	  stall     an input device that stalls underruns for about the length of the stall
+	            and no longer: the same stall in a trace twice as long gives the same
+	            count.
+	  resets    a host that carries ExcessJitter into the sizing at every reset, as
+	            CAPlayThroughHost::ResetPlayThrough does, ends up with a ring that stops
+	            growing, and never one bigger than mMaxJitterFrames allows, even when
+	            every run has a stall in it.
+	  commands  changes made while the IO procs are stopped are applied by
+	            CAPlayThroughEngine::ApplyCommands, so they don't pile up in the queues,
+	            and the last one is what the output plays with.
+	
+	Traces are written to $TMPDIR (or /tmp) and removed again. Prints one line per case
+	and exits with 1 if any of them failed.
+*/
+
+#include "CAPlayThroughTrace.h"
+#include "CAPlayThroughTraceSynthesis.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char		sTracePath[1024];
+static UInt32	sFailures = 0;
+
+static void	Check(bool inPassed, const char *inName, const char *inDetail)
+{
+	printf("%-4s  %-44s %s\n", inPassed ? "ok" : "FAIL", inName, inDetail);
+	if (!inPassed) ++sFailures;
+}
+
+static bool	Run(const CAPlayThroughTraceModel &inModel, CAPlayThroughReplayResult &outResult)
+{
+	memset(&outResult, 0, sizeof(outResult));
+	if (CAPlayThroughSynthesizeTrace(inModel, sTracePath) != noErr) return false;
+	return CAPlayThroughReplay(sTracePath, outResult) == noErr;
+}
+
+static void	Describe(const CAPlayThroughTraceModel &inModel, char *outName, size_t inSize)
+{
+	snprintf(outName, inSize, "%lu:%lu frames %.0f:%.0f Hz jitter %lu",
+			(unsigned long)inModel.mInputBufferFrames, (unsigned long)inModel.mOutputBufferFrames,
+			inModel.mInputSampleRate, inModel.mOutputSampleRate, (unsigned long)inModel.mJitterFrames);
+}
+
+#pragma mark ____Sizing
+
+static void	TestSizing()
+{
+	static const UInt32 kBuffers[][2] = { { 64, 64 }, { 512, 512 }, { 4096, 64 }, { 64, 4096 }, { 1024, 256 }, { 256, 1024 } };
+	static const Float64 kRates[][2] = { { 48000., 48000. }, { 44100., 48000. }, { 96000., 44100. } };
+	static const UInt32 kJitter[] = { 0, 200, 1000, 3000 };
+	
+	for (size_t b = 0; b < sizeof(kBuffers) / sizeof(kBuffers[0]); ++b)
+		for (size_t r = 0; r < sizeof(kRates) / sizeof(kRates[0]); ++r)
+			for (size_t j = 0; j < sizeof(kJitter) / sizeof(kJitter[0]); ++j) {
+				CAPlayThroughTraceModel model;
+				model.mInputBufferFrames = kBuffers[b][0];
+				model.mOutputBufferFrames = kBuffers[b][1];
+				model.mInputSafetyOffset = model.mOutputSafetyOffset = 16;
+				model.mInputSampleRate = kRates[r][0];
+				model.mOutputSampleRate = kRates[r][1];
+				model.mJitterFrames = model.mSizing.mJitterFrames = kJitter[j];
+				model.mSeconds = 5.;
+				
+				char name[128], detail[128];
+				Describe(model, name, sizeof(name));
+				CAPlayThroughReplayResult result;
+				bool ran = Run(model, result);
+				snprintf(detail, sizeof(detail), "ring %lu, %lu underruns",
+						(unsigned long)CAPlayThroughTraceModelRingCapacity(model), (unsigned long)result.mUnderruns);
+				Check(ran && result.mUnderruns == 0, name, detail);
+			}
+}
+
+#pragma mark ____Stall
+
+static void	TestStall()
+{
+	static const UInt32 kBuffers[][2] = { { 64, 64 }, { 512, 512 }, { 4096, 64 }, { 1024, 256 } };
+	static const Float64 kStalls[] = { 0.05, 0.2, 1. };
+	
+	for (size_t b = 0; b < sizeof(kBuffers) / sizeof(kBuffers[0]); ++b)
+		for (size_t s = 0; s < sizeof(kStalls) / sizeof(kStalls[0]); ++s) {
+			CAPlayThroughTraceModel model;
+			model.mInputBufferFrames = kBuffers[b][0];
+			model.mOutputBufferFrames = kBuffers[b][1];
+			model.mInputSampleRate = 44100.;
+			model.mJitterFrames = model.mSizing.mJitterFrames = 200;
+			model.mStallStart = 2.;
+			model.mStallSeconds = kStalls[s];
+			
+			// the output can at worst go silent for the whole stall, plus the buffer it noticed in
+			const UInt32 bound = UInt32(kStalls[s] * model.mOutputSampleRate / model.mOutputBufferFrames) + 2;
+			CAPlayThroughReplayResult shorter, longer;
+			model.mSeconds = 5.;
+			bool ran = Run(model, shorter);
+			model.mSeconds = 10.;
+			ran = Run(model, longer) && ran;
+			
+			char name[128], detail[128];
+			Describe(model, name, sizeof(name));
+			snprintf(name + strlen(name), sizeof(name) - strlen(name), " stall %.2f s", kStalls[s]);
+			snprintf(detail, sizeof(detail), "%lu underruns in 5 s, %lu in 10 s, at most %lu",
+					(unsigned long)shorter.mUnderruns, (unsigned long)longer.mUnderruns, (unsigned long)bound);
+			Check(ran && shorter.mUnderruns == longer.mUnderruns && longer.mUnderruns <= bound, name, detail);
+		}
+}
+
+#pragma mark ____Resets
+
+static void	TestResets(bool inStall)
+{
+	static const UInt32 kBuffers[][2] = { { 64, 64 }, { 512, 512 }, { 4096, 64 }, { 256, 1024 } };
+	const UInt32 kResets = 6;
+	
+	for (size_t b = 0; b < sizeof(kBuffers) / sizeof(kBuffers[0]); ++b) {
+		CAPlayThroughTraceModel model;
+		model.mInputBufferFrames = kBuffers[b][0];
+		model.mOutputBufferFrames = kBuffers[b][1];
+		model.mInputSampleRate = 44100.;
+		model.mJitterFrames = 1000;
+		model.mSeconds = 5.;
+		if (inStall) {
+			model.mStallStart = 2.;
+			model.mStallSeconds = 0.5;
+		}
+		const Float64 ratio = model.mInputSampleRate / model.mOutputSampleRate;
+		
+		CAPlayThroughRingSizing worst = model.mSizing;
+		worst.mJitterFrames = worst.mMaxJitterFrames;
+		const UInt32 ceiling = CAPlayThroughEngine::ComputeRingCapacity(worst,
+						model.mInputBufferFrames, model.mInputSafetyOffset,
+						model.mOutputBufferFrames, model.mOutputSafetyOffset, ratio);
+		
+		// every reset starts a new ring with the jitter measured so far, as
+		// CAPlayThroughHost::ResetPlayThrough does
+		UInt32 capacity[kResets];
+		bool ran = true;
+		for (UInt32 i = 0; i < kResets; ++i) {
+			capacity[i] = CAPlayThroughTraceModelRingCapacity(model);
+			model.mSeed = i + 1;
+			CAPlayThroughReplayResult result;
+			ran = Run(model, result) && ran;
+			UInt32 jitter = CAPlayThroughEngine::ExcessJitter(result.mFillSpread,
+						model.mInputBufferFrames, model.mOutputBufferFrames, ratio);
+			if (jitter > model.mSizing.mMaxJitterFrames)
+				jitter = model.mSizing.mMaxJitterFrames;
+			if (jitter > model.mSizing.mJitterFrames)
+				model.mSizing.mJitterFrames = jitter;
+		}
+		
+		bool settled = capacity[kResets - 1] == capacity[kResets - 2] && capacity[kResets - 1] <= ceiling;
+		char name[128], detail[128];
+		snprintf(name, sizeof(name), "%lu:%lu frames %s", (unsigned long)model.mInputBufferFrames,
+				(unsigned long)model.mOutputBufferFrames, inStall ? "resets with stalls" : "resets");
+		snprintf(detail, sizeof(detail), "ring %lu -> %lu, at most %lu",
+				(unsigned long)capacity[0], (unsigned long)capacity[kResets - 1], (unsigned long)ceiling);
+		Check(ran && settled, name, detail);
+	}
+}
+
+#pragma mark ____Commands
+
+static void	TestCommands()
+{
+	const UInt32 kChanges = 1000, kFrames = 256;
+	CAPlayThroughEngine engine;
+	engine.Allocate(1, 1, 1024);
+	
+	// a gain change on the existing route is applied in place, a new matrix is swapped in;
+	// each queue holds 64, so without ApplyCommands both would fail long before the end
+	UInt32 accepted = 0;
+	for (UInt32 i = 0; i < kChanges; ++i) {
+		AudioChannelMatrix matrix(1, 1);
+		matrix.SetGain(0, 0, 0.5f);
+		if ((i & 1) ? engine.RequestGain(0, 0, 0.25f) : engine.RequestChannelMatrix(matrix))
+			++accepted;
+		engine.ApplyCommands();
+	}
+	
+	Float32 input[kFrames], output[kFrames];
+	for (UInt32 i = 0; i < kFrames; ++i) input[i] = 1.f;
+	AudioBufferList inList = { 1, { { 1, UInt32(sizeof(input)), input } } };
+	AudioBufferList outList = { 1, { { 1, UInt32(sizeof(output)), output } } };
+	
+	// the first fetch lines the timelines up, the second plays the input through the matrix
+	engine.StoreInput(&inList, kFrames, 0.);
+	engine.FetchOutput(&outList, kFrames / 4, 0.);
+	bool played = engine.FetchOutput(&outList, kFrames / 4, Float64(kFrames / 4));
+	
+	char detail[128];
+	snprintf(detail, sizeof(detail), "%lu of %lu accepted, output gain %.2f",
+			(unsigned long)accepted, (unsigned long)kChanges, played ? output[0] : 0.f);
+	Check(accepted == kChanges && played && output[0] == 0.25f, "changes while stopped", detail);
+}
+
+int main(int argc, char *const [])
+{
+	if (argc != 1) {
+		fprintf(stderr, "usage: playthroughtests\n");
+		return 2;
+	}
+	
+	const char *dir = getenv("TMPDIR");
+	snprintf(sTracePath, sizeof(sTracePath), "%s/playthroughtests.%ld.trace",
+			(dir && *dir) ? dir : "/tmp", (long)getpid());
+	
+	TestSizing();
+	TestStall();
+	TestResets(false);
+	TestResets(true);
+	TestCommands();
+	
+	unlink(sTracePath);
+	printf("%lu failed\n", (unsigned long)sFailures);
+	return sFailures ? 1 : 0;
+}
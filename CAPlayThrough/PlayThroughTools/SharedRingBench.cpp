@@ -0,0 +1,376 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SharedRingBench.cpp
+	
+=============================================================================*/
+
+/*
+	sharedringbench: measures SharedAudioRingBuffer between two processes. The parent
+	creates the segment and writes, a forked child attaches and reads. See README for
+	building and the options.
+	
+	1. Latency: the writer stores one block per period with the time it stored it in the
+	   first samples; the reader, blocked in WaitForData (or polling, as a real-time reader
+	   would), fetches each block and notes how long after the store it got it.
+	2. Throughput: the writer stores as fast as it can for a while and then detaches; the
+	   reader follows with WaitForData and counts the frames it fetched and the ones that
+	   were overwritten before it got to them.
+	3. Takeover: the writer re-creates the segment with twice the capacity, the way a
+	   restarted capture process would. The reader, still attached to the old incarnation,
+	   must see kSharedAudioRingBufferError_Reinitialized, attach again and read the new
+	   format.
+	
+	Both sides use CLOCK_MONOTONIC, which is the same clock in every process.
+*/
+
+#include "SharedAudioRingBuffer.h"
+#include "CABitOperations.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <sys/wait.h>
+#include <vector>
+#include <algorithm>
+
+struct BenchSettings {
+	UInt32		mChannels;
+	UInt32		mBlockFrames;
+	UInt32		mCapacityFrames;
+	UInt32		mLatencyBlocks;
+	UInt32		mPeriodMicros;
+	Float64		mThroughputSeconds;
+	bool		mPoll;
+};
+
+static UInt64	Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return UInt64(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+}
+
+#pragma mark ____Buffers
+
+static AudioBufferList *	NewBufferList(UInt32 inChannels, UInt32 inFrames)
+{
+	AudioBufferList *abl = (AudioBufferList *)calloc(1, offsetof(AudioBufferList, mBuffers[0]) + sizeof(AudioBuffer) * inChannels);
+	abl->mNumberBuffers = inChannels;
+	for (UInt32 c = 0; c < inChannels; ++c) {
+		abl->mBuffers[c].mNumberChannels = 1;
+		abl->mBuffers[c].mDataByteSize = inFrames * sizeof(Float32);
+		abl->mBuffers[c].mData = calloc(inFrames, sizeof(Float32));
+	}
+	return abl;
+}
+
+static void	DisposeBufferList(AudioBufferList *abl)
+{
+	for (UInt32 c = 0; c < abl->mNumberBuffers; ++c)
+		free(abl->mBuffers[c].mData);
+	free(abl);
+}
+
+static void	SetByteSize(AudioBufferList *abl, UInt32 inFrames)
+{
+	for (UInt32 c = 0; c < abl->mNumberBuffers; ++c)
+		abl->mBuffers[c].mDataByteSize = inFrames * sizeof(Float32);
+}
+
+// the first 8 bytes of channel 0 carry a time or a sequence number
+static void		Stamp(AudioBufferList *abl, UInt64 inValue)		{ memcpy(abl->mBuffers[0].mData, &inValue, sizeof(inValue)); }
+static UInt64	GetStamp(const AudioBufferList *abl)			{ UInt64 v; memcpy(&v, abl->mBuffers[0].mData, sizeof(v)); return v; }
+
+// one byte each way between the processes, to start each phase when the other side is ready
+static void	Signal(int fd)		{ char c = 0; if (write(fd, &c, 1) != 1) exit(1); }
+static void	WaitSignal(int fd)	{ char c; if (read(fd, &c, 1) != 1) exit(1); }
+
+#pragma mark ____Writer
+
+static int	RunWriter(const char *inName, const BenchSettings &inSettings, int inToReader, int inFromReader)
+{
+	SharedAudioRingBuffer ring;
+	OSStatus err = ring.Create(inName, inSettings.mChannels, sizeof(Float32), inSettings.mCapacityFrames, 48000.);
+	if (err) {
+		fprintf(stderr, "Create %s failed (%ld)\n", inName, (long)err);
+		return 1;
+	}
+	AudioBufferList *abl = NewBufferList(inSettings.mChannels, inSettings.mBlockFrames);
+	const UInt32 block = inSettings.mBlockFrames;
+	
+	// 1. latency
+	Signal(inToReader);
+	WaitSignal(inFromReader);
+	for (UInt32 i = 0; i < inSettings.mLatencyBlocks; ++i) {
+		UInt64 due = Now() + inSettings.mPeriodMicros * 1000ULL;
+		Stamp(abl, Now());
+		ring.Store(abl, block, SInt64(i) * block);
+		while (Now() < due)
+			usleep(50);
+	}
+	
+	// 2. throughput, then go away the way a writer that is done does; the blocks are numbered on from phase 1
+	WaitSignal(inFromReader);
+	UInt64 end = Now() + UInt64(inSettings.mThroughputSeconds * 1e9);
+	UInt64 first = inSettings.mLatencyBlocks, blocks = first;
+	while (Now() < end) {
+		for (UInt32 k = 0; k < 64; ++k, ++blocks) {
+			Stamp(abl, blocks);
+			ring.Store(abl, block, SInt64(blocks) * block);
+		}
+	}
+	ring.Detach();
+	blocks -= first;
+	
+	// 3. takeover, with a different geometry
+	WaitSignal(inFromReader);
+	err = ring.Create(inName, inSettings.mChannels, sizeof(Float32), inSettings.mCapacityFrames * 2, 48000.);
+	if (err) {
+		fprintf(stderr, "takeover: Create failed (%ld)\n", (long)err);
+		return 1;
+	}
+	for (UInt32 i = 0; i < 4; ++i) {
+		Stamp(abl, 1000 + i);
+		ring.Store(abl, block, SInt64(i) * block);
+	}
+	WaitSignal(inFromReader);
+	ring.Detach(true);
+	
+	DisposeBufferList(abl);
+	printf("writer: %.1f MB/s stored (%llu blocks of %lu frames x %lu channels)\n",
+			blocks * block * inSettings.mChannels * sizeof(Float32) / inSettings.mThroughputSeconds / 1e6,
+			(unsigned long long)blocks, (unsigned long)block, (unsigned long)inSettings.mChannels);
+	return 0;
+}
+
+#pragma mark ____Reader
+
+static void	PrintLatencies(std::vector<UInt64> &ioNanos, UInt32 inLost, bool inPoll)
+{
+	if (ioNanos.empty()) {
+		printf("latency: nothing received\n");
+		return;
+	}
+	std::sort(ioNanos.begin(), ioNanos.end());
+	size_t n = ioNanos.size();
+	printf("latency (%s reader, %lu blocks, %lu lost): min %.1f  median %.1f  99%% %.1f  max %.1f us\n",
+			inPoll ? "polling" : "blocking", (unsigned long)n, (unsigned long)inLost,
+			ioNanos[0] / 1e3, ioNanos[n / 2] / 1e3, ioNanos[n * 99 / 100] / 1e3, ioNanos[n - 1] / 1e3);
+}
+
+static int	RunReader(const char *inName, const BenchSettings &inSettings, int inFromWriter, int inToWriter)
+{
+	SharedAudioRingBuffer ring;
+	AudioBufferList *abl = NewBufferList(inSettings.mChannels, inSettings.mBlockFrames);
+	const UInt32 block = inSettings.mBlockFrames;
+	
+	// 1. latency
+	WaitSignal(inFromWriter);
+	if (ring.Attach(inName)) {
+		fprintf(stderr, "Attach %s failed\n", inName);
+		return 1;
+	}
+	Signal(inToWriter);
+	std::vector<UInt64> latencies;
+	UInt32 lost = 0;
+	for (UInt32 i = 0; i < inSettings.mLatencyBlocks; ++i) {
+		SInt64 start = SInt64(i) * block;
+		if (inSettings.mPoll) {
+			AudioRingBuffer::SampleTime s, e;
+			while (ring.GetTimeBounds(s, e) != kAudioRingBufferError_OK || e < start + block)
+				;
+		} else if (ring.WaitForData(start + block, 1000))
+			break;
+		
+		UInt64 received = Now();
+		SetByteSize(abl, block);
+		if (ring.Fetch(abl, block, start) == kAudioRingBufferError_OK)
+			latencies.push_back(received - GetStamp(abl));
+		else
+			++lost;
+	}
+	PrintLatencies(latencies, lost, inSettings.mPoll);
+	
+	// 2. throughput: fetch everything still in the ring, skip what was overwritten
+	Signal(inToWriter);
+	UInt64 begin = Now(), fetched = 0, skipped = 0, mismatched = 0;
+	SInt64 next = SInt64(inSettings.mLatencyBlocks) * block;
+	for (;;) {
+		OSStatus wait = ring.WaitForData(next + block, 1000);
+		AudioRingBuffer::SampleTime s, e;
+		if (ring.GetTimeBounds(s, e) != kAudioRingBufferError_OK)
+			break;
+		while (next + block <= e) {
+			if (next < s) {
+				SInt64 resume = (s + block - 1) / block * block;
+				skipped += resume - next;
+				next = resume;
+				continue;
+			}
+			SetByteSize(abl, block);
+			if (ring.Fetch(abl, block, next) != kAudioRingBufferError_OK) {
+				next = -1;	// overwritten while copying; pick up from the new start
+				break;
+			}
+			if (GetStamp(abl) != UInt64(next / block))
+				++mismatched;
+			fetched += block;
+			next += block;
+		}
+		if (next < 0) {
+			ring.GetTimeBounds(s, e);
+			next = (s + block - 1) / block * block;
+			continue;
+		}
+		if (wait != kSharedAudioRingBufferError_OK && next + block > e)
+			break;		// writer gone and everything read
+	}
+	Float64 seconds = (Now() - begin) * 1e-9;
+	printf("reader: %.1f MB/s fetched, %.2f%% of the frames overwritten before the reader got to them%s\n",
+			fetched * inSettings.mChannels * sizeof(Float32) / seconds / 1e6,
+			(fetched + skipped) ? 100. * skipped / (fetched + skipped) : 0.,
+			mismatched ? ", DATA MISMATCH" : "");
+	
+	// 3. takeover: the old incarnation must be refused, the new one readable
+	Signal(inToWriter);
+	AudioRingBuffer::SampleTime s, e;
+	OSStatus err;
+	UInt64 deadline = Now() + 2000000000ULL;
+	while ((err = ring.GetTimeBounds(s, e)) != kSharedAudioRingBufferError_Reinitialized && Now() < deadline)
+		usleep(100);
+	bool ok = (err == kSharedAudioRingBufferError_Reinitialized);
+	SetByteSize(abl, block);
+	ok = ok && ring.Fetch(abl, block, 0) == kSharedAudioRingBufferError_Reinitialized;
+	// the new writer may still be filling in the header
+	while (ok && (err = ring.Attach(inName)) == kSharedAudioRingBufferError_BadFormat && Now() < deadline)
+		usleep(100);
+	ok = ok && err == kSharedAudioRingBufferError_OK;
+	ok = ok && ring.CapacityFrames() == NextPowerOfTwo(inSettings.mCapacityFrames) * 2;
+	ok = ok && ring.WaitForData(4 * block, 1000) == kSharedAudioRingBufferError_OK;
+	SetByteSize(abl, block);
+	ok = ok && ring.Fetch(abl, block, 3 * block) == kAudioRingBufferError_OK && GetStamp(abl) == 1003;
+	printf("takeover: %s\n", ok ? "reader re-attached to the new segment" : "FAILED");
+	Signal(inToWriter);
+	
+	ring.Detach();
+	DisposeBufferList(abl);
+	return ok ? 0 : 1;
+}
+
+#pragma mark ____Options
+
+static void	Usage()
+{
+	fprintf(stderr,
+		"usage: sharedringbench [options]\n"
+		"  -c, --channels N       channels in the ring (2)\n"
+		"  -b, --block N          frames per store and fetch (256)\n"
+		"  -k, --capacity N       ring capacity in frames, rounded up to a power of 2 (16384)\n"
+		"  -n, --blocks N         blocks in the latency run (2000)\n"
+		"  -p, --period US        microseconds between stores in the latency run (1000)\n"
+		"  -t, --seconds S        length of the throughput run (2)\n"
+		"  -P, --poll             the reader polls the time bounds instead of blocking\n");
+}
+
+int main(int argc, char *const argv[])
+{
+	BenchSettings settings = { 2, 256, 16384, 2000, 1000, 2., false };
+	
+	static const struct option options[] = {
+		{ "channels",	required_argument,	NULL, 'c' },
+		{ "block",		required_argument,	NULL, 'b' },
+		{ "capacity",	required_argument,	NULL, 'k' },
+		{ "blocks",		required_argument,	NULL, 'n' },
+		{ "period",		required_argument,	NULL, 'p' },
+		{ "seconds",	required_argument,	NULL, 't' },
+		{ "poll",		no_argument,		NULL, 'P' },
+		{ NULL,			0,					NULL, 0 }
+	};
+	
+	int ch;
+	bool ok = true;
+	while (ok && (ch = getopt_long(argc, argv, "c:b:k:n:p:t:P", options, NULL)) != -1) {
+		switch (ch) {
+			case 'c':	settings.mChannels = strtoul(optarg, NULL, 0);			break;
+			case 'b':	settings.mBlockFrames = strtoul(optarg, NULL, 0);		break;
+			case 'k':	settings.mCapacityFrames = strtoul(optarg, NULL, 0);	break;
+			case 'n':	settings.mLatencyBlocks = strtoul(optarg, NULL, 0);		break;
+			case 'p':	settings.mPeriodMicros = strtoul(optarg, NULL, 0);		break;
+			case 't':	settings.mThroughputSeconds = strtod(optarg, NULL);		break;
+			case 'P':	settings.mPoll = true;									break;
+			default:	ok = false;												break;
+		}
+	}
+	// a block carries an 8 byte stamp, and the ring has to hold a few of them
+	if (!ok || optind != argc || settings.mChannels == 0 || settings.mBlockFrames < 2 ||
+		settings.mCapacityFrames < 4 * settings.mBlockFrames || settings.mLatencyBlocks == 0 ||
+		settings.mThroughputSeconds <= 0.) {
+		Usage();
+		return 2;
+	}
+	
+	char name[64];
+	snprintf(name, sizeof(name), "/sharedringbench.%ld", (long)getpid());
+	setvbuf(stdout, NULL, _IOLBF, 0);
+	
+	int toReader[2], toWriter[2];
+	if (pipe(toReader) || pipe(toWriter)) {
+		perror("pipe");
+		return 1;
+	}
+	pid_t child = fork();
+	if (child < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (child == 0)
+		_exit(RunReader(name, settings, toReader[0], toWriter[1]));
+	
+	int result = RunWriter(name, settings, toReader[1], toWriter[0]);
+	int status = 0;
+	waitpid(child, &status, 0);
+	if (result == 0 && !(WIFEXITED(status) && WEXITSTATUS(status) == 0))
+		result = 1;
+	return result;
+}
@@ -0,0 +1,373 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SharedAudioRingBuffer.cpp
+
+=============================================================================*/
+
+#include "SharedAudioRingBuffer.h"
+#include "CABitOperations.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__)
+	#include <linux/futex.h>
+	#include <sys/syscall.h>
+	#include <limits.h>
+#elif defined(__APPLE__)
+	#include <mach/mach_time.h>
+#endif
+
+enum {
+	kSharedAudioRingBufferMagic		= 'SARB',
+	kSharedAudioRingBufferVersion	= 1
+};
+
+// Everything another process needs; the channel data follows at mDataOffset.
+// Only fixed size types, so 32 and 64 bit processes of the same byte order agree.
+struct SharedAudioRingBuffer::SharedHeader {
+	volatile UInt32		mMagic;					// written last by Create
+	UInt32				mVersion;
+	UInt32				mDataOffset;
+	UInt32				mNumberChannels;
+	UInt32				mBytesPerFrame;
+	UInt32				mCapacityFrames;
+	Float64				mSampleRate;
+
+	volatile SInt32		mWriterPID;				// 0 once the writer detaches
+	volatile UInt32		mWriterGeneration;		// bumped by every Create
+	volatile UInt64		mHeartbeat;				// NowNanos() of the last Store
+
+	volatile UInt32		mWakeSequence;			// futex word, bumped after every Store
+	volatile UInt32		mWaiters;				// readers blocked in WaitForData
+
+	volatile UInt32		mTimeBoundsQueuePtr;
+	AudioRingBuffer::TimeBounds	mTimeBoundsQueue[kTimeBoundsQueueSize];
+};
+
+static inline UInt32 AlignUp(UInt32 n, UInt32 alignment) { return (n + alignment - 1) & ~(alignment - 1); }
+
+SharedAudioRingBuffer::SharedAudioRingBuffer() :
+	mShared(NULL), mMappedSize(0), mIsWriter(false), mGeneration(0)
+{
+	mName[0] = 0;
+}
+
+SharedAudioRingBuffer::~SharedAudioRingBuffer()
+{
+	Detach();
+}
+
+UInt64	SharedAudioRingBuffer::NowNanos()
+{
+#if defined(__APPLE__)
+	static mach_timebase_info_data_t timebase;
+	if (timebase.denom == 0)
+		mach_timebase_info(&timebase);
+	return mach_absolute_time() * timebase.numer / timebase.denom;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return UInt64(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+Float64	SharedAudioRingBuffer::SampleRate() const
+{
+	return mShared ? mShared->mSampleRate : 0.;
+}
+
+OSStatus	SharedAudioRingBuffer::Map(const char *name, int fd, size_t size)
+{
+	strncpy(mName, name, sizeof(mName) - 1);
+	mName[sizeof(mName) - 1] = 0;
+
+	void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return kSharedAudioRingBufferError_SystemError;
+
+	mShared = (SharedHeader *)p;
+	mMappedSize = size;
+	return kSharedAudioRingBufferError_OK;
+}
+
+OSStatus	SharedAudioRingBuffer::Create(const char *name, int nChannels, UInt32 bytesPerFrame, UInt32 capacityFrames, Float64 sampleRate)
+{
+	Detach();
+
+	capacityFrames = NextPowerOfTwo(capacityFrames);
+	UInt32 dataOffset = AlignUp(sizeof(SharedHeader), 64);
+	size_t size = dataOffset + size_t(nChannels) * bytesPerFrame * capacityFrames;
+
+	int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+	if (fd < 0)
+		return kSharedAudioRingBufferError_SystemError;
+
+	// refuse to take over from a writer that is still running
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+		st.st_size = 0;
+	if (size_t(st.st_size) >= sizeof(SharedHeader)) {
+		SharedHeader existing;
+		if (pread(fd, &existing, sizeof(existing), 0) == sizeof(existing) &&
+			existing.mMagic == kSharedAudioRingBufferMagic && existing.mWriterPID != 0 &&
+			existing.mWriterPID != getpid() && (kill(existing.mWriterPID, 0) == 0 || errno == EPERM)) {
+			close(fd);
+			return kSharedAudioRingBufferError_WriterPresent;
+		}
+	}
+
+	// never shrink the segment: readers still mapping the old incarnation would fault on the
+	// pages cut off before they notice the new generation
+	if (size_t(st.st_size) > size)
+		size = st.st_size;
+	else if (ftruncate(fd, size) != 0) {
+		close(fd);
+		return kSharedAudioRingBufferError_SystemError;
+	}
+
+	OSStatus err = Map(name, fd, size);
+	if (err) return err;
+	mIsWriter = true;
+
+	// readers attached to a previous incarnation see the magic go away while the header is rewritten
+	UInt32 generation = (mShared->mMagic == kSharedAudioRingBufferMagic) ? mShared->mWriterGeneration + 1 : 1;
+	mShared->mMagic = 0;
+	__sync_synchronize();
+
+	mShared->mVersion = kSharedAudioRingBufferVersion;
+	mShared->mDataOffset = dataOffset;
+	mShared->mNumberChannels = nChannels;
+	mShared->mBytesPerFrame = bytesPerFrame;
+	mShared->mCapacityFrames = capacityFrames;
+	mShared->mSampleRate = sampleRate;
+	mShared->mWriterPID = getpid();
+	mShared->mWriterGeneration = generation;
+	mGeneration = generation;
+	mShared->mHeartbeat = NowNanos();
+	mShared->mWaiters = 0;
+
+	UseExternalStorage(nChannels, bytesPerFrame, capacityFrames, (Byte *)mShared + dataOffset,
+						mShared->mTimeBoundsQueue, &mShared->mTimeBoundsQueuePtr);
+	Clear();
+
+	__sync_synchronize();
+	mShared->mMagic = kSharedAudioRingBufferMagic;
+	return kSharedAudioRingBufferError_OK;
+}
+
+OSStatus	SharedAudioRingBuffer::Attach(const char *name)
+{
+	Detach();
+
+	int fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0)
+		return kSharedAudioRingBufferError_SystemError;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(SharedHeader)) {
+		close(fd);
+		return kSharedAudioRingBufferError_BadFormat;
+	}
+
+	OSStatus err = Map(name, fd, st.st_size);
+	if (err) return err;
+
+	SharedHeader *h = mShared;
+	if (h->mMagic != kSharedAudioRingBufferMagic || h->mVersion != kSharedAudioRingBufferVersion ||
+		h->mDataOffset + size_t(h->mNumberChannels) * h->mBytesPerFrame * h->mCapacityFrames > mMappedSize) {
+		Detach();
+		return kSharedAudioRingBufferError_BadFormat;
+	}
+
+	mIsWriter = false;
+	mGeneration = h->mWriterGeneration;
+	UseExternalStorage(h->mNumberChannels, h->mBytesPerFrame, h->mCapacityFrames, (Byte *)h + h->mDataOffset,
+						h->mTimeBoundsQueue, &h->mTimeBoundsQueuePtr);
+	return kSharedAudioRingBufferError_OK;
+}
+
+void	SharedAudioRingBuffer::Detach(bool unlink)
+{
+	if (!mShared) return;
+
+	if (mIsWriter) {
+		mShared->mWriterPID = 0;
+		WakeReaders();
+	}
+
+	// drop our pointers into the segment before unmapping it
+	Deallocate();
+	munmap(mShared, mMappedSize);
+	mShared = NULL;
+	mMappedSize = 0;
+	mIsWriter = false;
+
+	if (unlink)
+		shm_unlink(mName);
+}
+
+AudioRingBufferError	SharedAudioRingBuffer::Store(const AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber)
+{
+	if (!mIsWriter)
+		return kAudioRingBufferError_TooMuch;
+
+	AudioRingBufferError err = AudioRingBuffer::Store(abl, nFrames, frameNumber);
+	mShared->mHeartbeat = NowNanos();
+	WakeReaders();
+	return err;
+}
+
+// The header stays mapped whatever the writer does, so this is safe to check before touching the
+// channel data. A writer that re-creates the segment clears mMagic first and bumps the generation.
+bool	SharedAudioRingBuffer::Reinitialized() const
+{
+	return mShared->mMagic != kSharedAudioRingBufferMagic || mShared->mWriterGeneration != mGeneration;
+}
+
+AudioRingBufferError	SharedAudioRingBuffer::Fetch(AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber)
+{
+	if (!mShared)
+		return kSharedAudioRingBufferError_BadFormat;
+	if (Reinitialized())
+		return kSharedAudioRingBufferError_Reinitialized;
+	return AudioRingBuffer::Fetch(abl, nFrames, frameNumber);
+}
+
+AudioRingBufferError	SharedAudioRingBuffer::Fetch(AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber, const AudioChannelMatrix &matrix)
+{
+	if (!mShared)
+		return kSharedAudioRingBufferError_BadFormat;
+	if (Reinitialized())
+		return kSharedAudioRingBufferError_Reinitialized;
+	return AudioRingBuffer::Fetch(abl, nFrames, frameNumber, matrix);
+}
+
+AudioRingBufferError	SharedAudioRingBuffer::GetTimeBounds(SampleTime &startTime, SampleTime &endTime)
+{
+	if (!mShared)
+		return kSharedAudioRingBufferError_BadFormat;
+	if (Reinitialized())
+		return kSharedAudioRingBufferError_Reinitialized;
+	return AudioRingBuffer::GetTimeBounds(startTime, endTime);
+}
+
+void	SharedAudioRingBuffer::WakeReaders()
+{
+	__sync_fetch_and_add(&mShared->mWakeSequence, 1);
+	// the common case has nobody blocked, and then the writer makes no system call
+	if (mShared->mWaiters == 0)
+		return;
+#if defined(__linux__)
+	syscall(SYS_futex, &mShared->mWakeSequence, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+OSStatus	SharedAudioRingBuffer::WaitForData(SampleTime endFrame, UInt32 timeoutMS)
+{
+	if (!mShared)
+		return kSharedAudioRingBufferError_BadFormat;
+
+	UInt64 deadline = NowNanos() + UInt64(timeoutMS) * 1000000ULL;
+	OSStatus result = kSharedAudioRingBufferError_OK;
+
+	__sync_fetch_and_add(&mShared->mWaiters, 1);
+	for (;;) {
+		// sample the sequence before the bounds, so a Store in between makes the wait return at once
+		UInt32 sequence = mShared->mWakeSequence;
+		__sync_synchronize();
+
+		SampleTime startTime, endTime;
+		AudioRingBufferError err = GetTimeBounds(startTime, endTime);
+		if (err == kAudioRingBufferError_OK && endTime >= endFrame)
+			break;
+		if (err == kSharedAudioRingBufferError_Reinitialized) {
+			result = err;
+			break;
+		}
+
+		UInt32 writer = GetWriterState();
+		if (writer == kSharedAudioRingBufferWriter_Detached || writer == kSharedAudioRingBufferWriter_Gone) {
+			result = kSharedAudioRingBufferError_WriterGone;
+			break;
+		}
+
+		UInt64 now = NowNanos();
+		if (now >= deadline) {
+			result = kSharedAudioRingBufferError_Timeout;
+			break;
+		}
+
+#if defined(__linux__)
+		UInt64 remaining = deadline - now;
+		struct timespec ts = { time_t(remaining / 1000000000ULL), long(remaining % 1000000000ULL) };
+		syscall(SYS_futex, &mShared->mWakeSequence, FUTEX_WAIT, sequence, &ts, NULL, 0);
+#else
+		// no cross-process futex here; a millisecond is well under any device buffer
+		(void)sequence;
+		usleep(1000);
+#endif
+	}
+	__sync_fetch_and_sub(&mShared->mWaiters, 1);
+	return result;
+}
+
+UInt32	SharedAudioRingBuffer::GetWriterState(UInt32 stallMS) const
+{
+	if (!mShared)
+		return kSharedAudioRingBufferWriter_Detached;
+
+	pid_t pid = mShared->mWriterPID;
+	if (pid == 0)
+		return kSharedAudioRingBufferWriter_Detached;
+	if (kill(pid, 0) != 0 && errno == ESRCH)
+		return kSharedAudioRingBufferWriter_Gone;
+	if (NowNanos() - mShared->mHeartbeat > UInt64(stallMS) * 1000000ULL)
+		return kSharedAudioRingBufferWriter_Stalled;
+	return kSharedAudioRingBufferWriter_Alive;
+}
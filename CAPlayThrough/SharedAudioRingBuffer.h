@@ -0,0 +1,140 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SharedAudioRingBuffer.h
+
+=============================================================================*/
+
+#ifndef __SharedAudioRingBuffer_h__
+#define __SharedAudioRingBuffer_h__
+
+#include "AudioRingBuffer2.h"
+
+/*
+	An AudioRingBuffer that lives in a POSIX shared memory segment, so that capture and
+	playback can run in separate processes. The segment holds a format header, the time
+	bounds queue and the deinterleaved channel data; one process creates it and writes,
+	any number of processes attach to it and read. Store and Fetch work exactly as they
+	do in-process.
+
+	Readers on a real-time thread should poll: call Fetch (or GetTimeBounds) from the IO
+	callback and treat kAudioRingBufferError_SlightlyAhead/WayAhead as "not yet". Readers
+	on ordinary threads can block in WaitForData instead. On Linux the wait is a futex on
+	a word in the segment and the writer only makes the wake syscall when someone is
+	waiting; elsewhere the wait sleeps in short steps.
+
+	The writer stamps its pid and a heartbeat into the header on every Store, so readers
+	can tell a writer that went away without detaching (crashed) from one that is merely
+	slow. A new writer can take over a segment whose writer is gone. Readers still attached
+	to the old incarnation get kSharedAudioRingBufferError_Reinitialized from Fetch,
+	GetTimeBounds and WaitForData from then on, and have to Detach and Attach again to pick
+	up the new format.
+*/
+
+enum {
+	kSharedAudioRingBufferError_OK				= 0,
+	kSharedAudioRingBufferError_SystemError		= 10,	// shm_open/ftruncate/mmap failed, see errno
+	kSharedAudioRingBufferError_BadFormat		= 11,	// not a ring buffer segment, or a different version
+	kSharedAudioRingBufferError_WriterPresent	= 12,	// Create on a segment that has a live writer
+	kSharedAudioRingBufferError_Timeout			= 13,
+	kSharedAudioRingBufferError_WriterGone		= 14,
+	kSharedAudioRingBufferError_Reinitialized	= 15	// a new writer re-created the segment since Attach
+};
+
+enum {
+	kSharedAudioRingBufferWriter_Alive			= 0,
+	kSharedAudioRingBufferWriter_Stalled		= 1,	// process exists but has not stored for a while
+	kSharedAudioRingBufferWriter_Detached		= 2,	// writer closed the segment
+	kSharedAudioRingBufferWriter_Gone			= 3		// writer process died without detaching
+};
+
+class SharedAudioRingBuffer : public AudioRingBuffer {
+public:
+	SharedAudioRingBuffer();
+	virtual ~SharedAudioRingBuffer();
+
+	// Writer side. name is a POSIX shm name ("/capture"); capacityFrames is rounded up to a power of 2.
+	OSStatus		Create(const char *name, int nChannels, UInt32 bytesPerFrame, UInt32 capacityFrames, Float64 sampleRate);
+
+	// Reader side. The format comes from the segment.
+	OSStatus		Attach(const char *name);
+
+	// Unmap the segment. The writer marks itself detached first; unlink also removes the name.
+	void			Detach(bool unlink = false);
+
+	bool			IsAttached() const		{ return mShared != NULL; }
+	bool			IsWriter() const		{ return mIsWriter; }
+
+	int				NumberChannels() const	{ return mNumberChannels; }
+	UInt32			BytesPerFrame() const	{ return mBytesPerFrame; }
+	Float64			SampleRate() const;
+
+	// Writer only. Stores, bumps the heartbeat and wakes blocked readers.
+	AudioRingBufferError	Store(const AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber);
+
+	// As in AudioRingBuffer, but checked against the incarnation of the segment that was attached.
+	AudioRingBufferError	Fetch(AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber);
+	AudioRingBufferError	Fetch(AudioBufferList *abl, UInt32 nFrames, SampleTime frameNumber, const AudioChannelMatrix &matrix);
+	AudioRingBufferError	GetTimeBounds(SampleTime &startTime, SampleTime &endTime);
+
+	// Non real-time readers: block until the buffer's end time reaches endFrame, the
+	// writer goes away, or timeoutMS passes.
+	OSStatus		WaitForData(SampleTime endFrame, UInt32 timeoutMS);
+
+	// Stalled means no Store for stallMS milliseconds.
+	UInt32			GetWriterState(UInt32 stallMS = 500) const;
+
+private:
+	struct SharedHeader;
+
+	static UInt64	NowNanos();
+	void			WakeReaders();
+	OSStatus		Map(const char *name, int fd, size_t size);
+	bool			Reinitialized() const;
+
+	SharedHeader *	mShared;
+	size_t			mMappedSize;
+	bool			mIsWriter;
+	UInt32			mGeneration;		// mWriterGeneration when we created or attached
+	char			mName[256];
+};
+
+#endif // __SharedAudioRingBuffer_h__
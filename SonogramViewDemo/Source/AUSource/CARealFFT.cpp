@@ -0,0 +1,301 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CARealFFT.cpp
+	
+=============================================================================*/
+
+#include "CARealFFT.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+	#define CA_FFT_X86 1
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define CA_FFT_NEON 1
+#endif
+
+#pragma mark -- Kernels --
+
+#define FFT_KERNEL(name)	name##Scalar
+#define FFT_TARGET
+#define FFT_WIDTH			1
+#define FFT_V				Float32
+#define FFT_LOAD(p)			(*(p))
+#define FFT_STORE(p, v)		(*(p) = (v))
+#define FFT_SET1(x)			(x)
+#define FFT_ADD(a, b)		((a) + (b))
+#define FFT_SUB(a, b)		((a) - (b))
+#define FFT_MUL(a, b)		((a) * (b))
+#include "CARealFFTKernel.h"
+
+#if CA_FFT_X86
+	#define FFT_KERNEL(name)	name##SSE
+	#define FFT_TARGET			__attribute__((target("sse2")))
+	#define FFT_WIDTH			4
+	#define FFT_V				__m128
+	#define FFT_LOAD(p)			_mm_loadu_ps(p)
+	#define FFT_STORE(p, v)		_mm_storeu_ps(p, v)
+	#define FFT_SET1(x)			_mm_set1_ps(x)
+	#define FFT_ADD(a, b)		_mm_add_ps(a, b)
+	#define FFT_SUB(a, b)		_mm_sub_ps(a, b)
+	#define FFT_MUL(a, b)		_mm_mul_ps(a, b)
+	#include "CARealFFTKernel.h"
+	
+	#define FFT_KERNEL(name)	name##AVX2
+	#define FFT_TARGET			__attribute__((target("avx2")))
+	#define FFT_WIDTH			8
+	#define FFT_V				__m256
+	#define FFT_LOAD(p)			_mm256_loadu_ps(p)
+	#define FFT_STORE(p, v)		_mm256_storeu_ps(p, v)
+	#define FFT_SET1(x)			_mm256_set1_ps(x)
+	#define FFT_ADD(a, b)		_mm256_add_ps(a, b)
+	#define FFT_SUB(a, b)		_mm256_sub_ps(a, b)
+	#define FFT_MUL(a, b)		_mm256_mul_ps(a, b)
+	#include "CARealFFTKernel.h"
+#elif CA_FFT_NEON
+	#define FFT_KERNEL(name)	name##NEON
+	#define FFT_TARGET
+	#define FFT_WIDTH			4
+	#define FFT_V				float32x4_t
+	#define FFT_LOAD(p)			vld1q_f32(p)
+	#define FFT_STORE(p, v)		vst1q_f32(p, v)
+	#define FFT_SET1(x)			vdupq_n_f32(x)
+	#define FFT_ADD(a, b)		vaddq_f32(a, b)
+	#define FFT_SUB(a, b)		vsubq_f32(a, b)
+	#define FFT_MUL(a, b)		vmulq_f32(a, b)
+	#include "CARealFFTKernel.h"
+#endif
+
+enum { kScalar = 0, kSSE, kAVX2, kNEON };
+
+static int	BestInstructionSet()
+{
+#if CA_FFT_X86
+	#if defined(__GNUC__)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return kAVX2;
+	#endif
+	return kSSE;
+#elif CA_FFT_NEON
+	return kNEON;
+#else
+	return kScalar;
+#endif
+}
+
+typedef void (*KernelProc)(UInt32 n, UInt32 s, const Float32 *xr, const Float32 *xi,
+							Float32 *yr, Float32 *yi, const Float32 *tw);
+
+// the widest kernel whose vector width divides the stride
+static KernelProc	ChooseKernel(int isa, UInt32 radix, UInt32 stride)
+{
+#if CA_FFT_X86
+	if (isa == kAVX2 && stride % 8 == 0)
+		return (radix == 4) ? Radix4AVX2 : Radix2AVX2;
+	if (stride % 4 == 0)
+		return (radix == 4) ? Radix4SSE : Radix2SSE;
+#elif CA_FFT_NEON
+	if (stride % 4 == 0)
+		return (radix == 4) ? Radix4NEON : Radix2NEON;
+#endif
+	return (radix == 4) ? Radix4Scalar : Radix2Scalar;
+}
+
+const char *	CARealFFT::InstructionSet()
+{
+	switch (BestInstructionSet()) {
+		case kAVX2:	return "AVX2";
+		case kSSE:	return "SSE";
+		case kNEON:	return "NEON";
+	}
+	return "scalar";
+}
+
+#pragma mark -- CARealFFT --
+
+CARealFFT::CARealFFT(UInt32 size) :
+	mSize(size), mHalfSize(size / 2)
+{
+	static const int isa = BestInstructionSet();
+	
+	// plan the complex transform of length N/2: radix-4 stages, then radix-2 if needed
+	UInt32 n = mHalfSize, s = 1;
+	while (n > 1) {
+		UInt32 radix = (n % 4 == 0) ? 4 : 2;
+		Stage stage;
+		stage.mLength = n;
+		stage.mStride = s;
+		stage.mTwiddles = mTwiddles.size();
+		stage.mProc = ChooseKernel(isa, radix, s);
+		
+		// w^p, w^2p, w^3p (radix 4) or w^p (radix 2) with w = exp(-2 pi i / n)
+		for (UInt32 p = 0; p < n / radix; ++p) {
+			for (UInt32 k = 1; k < radix; ++k) {
+				double theta = -2. * M_PI * double(p * k) / double(n);
+				mTwiddles.push_back(Float32(cos(theta)));
+				mTwiddles.push_back(Float32(sin(theta)));
+			}
+		}
+		mStages.push_back(stage);
+		n /= radix;
+		s *= radix;
+	}
+	
+	mTwist.resize(2 * mHalfSize);
+	for (UInt32 k = 0; k < mHalfSize; ++k) {
+		double theta = -2. * M_PI * double(k) / double(mSize);
+		mTwist[2 * k] = Float32(cos(theta));
+		mTwist[2 * k + 1] = Float32(sin(theta));
+	}
+	
+	mBuffer.resize(4 * mHalfSize);
+}
+
+CARealFFT::~CARealFFT()
+{
+}
+
+void	CARealFFT::Forward(const Float32 *input, Float32 *outReal, Float32 *outImag)
+{
+	const UInt32 m = mHalfSize;
+	Float32 *xr = &mBuffer[0], *xi = xr + m;
+	Float32 *yr = xi + m, *yi = yr + m;
+	
+	// z[n] = x[2n] + i x[2n+1]
+	for (UInt32 i = 0; i < m; ++i) {
+		xr[i] = input[2 * i];
+		xi[i] = input[2 * i + 1];
+	}
+	
+	for (std::vector<Stage>::const_iterator stage = mStages.begin(); stage != mStages.end(); ++stage) {
+		(stage->mProc)(stage->mLength, stage->mStride, xr, xi, yr, yi, &mTwiddles[stage->mTwiddles]);
+		Float32 *t;
+		t = xr; xr = yr; yr = t;
+		t = xi; xi = yi; yi = t;
+	}
+	
+	// Z = FFT(z) is in xr, xi. Split it into the transforms of the even and odd samples,
+	// E[k] = (Z[k] + conj Z[m-k]) / 2 and O[k] = (Z[k] - conj Z[m-k]) / 2i,
+	// and combine them: X[k] = E[k] + exp(-2 pi i k / N) O[k].
+	outReal[0] = xr[0] + xi[0];
+	outImag[0] = 0.f;
+	outReal[m] = xr[0] - xi[0];
+	outImag[m] = 0.f;
+	
+	const Float32 *twist = &mTwist[0];
+	for (UInt32 k = 1; k < m; ++k) {
+		Float32 zr = xr[k], zi = xi[k];
+		Float32 cr = xr[m - k], ci = -xi[m - k];
+		
+		Float32 er = 0.5f * (zr + cr), ei = 0.5f * (zi + ci);
+		Float32 dr = 0.5f * (zr - cr), di = 0.5f * (zi - ci);
+		Float32 or_ = di, oi = -dr;
+		
+		Float32 wr = twist[2 * k], wi = twist[2 * k + 1];
+		outReal[k] = er + wr * or_ - wi * oi;
+		outImag[k] = ei + wr * oi + wi * or_;
+	}
+}
+
+void	CARealFFT::Inverse(const Float32 *inReal, const Float32 *inImag, Float32 *output)
+{
+	const UInt32 m = mHalfSize;
+	Float32 *xr = &mBuffer[0], *xi = xr + m;
+	Float32 *yr = xi + m, *yi = yr + m;
+	
+	// Undo the twist: with Y[k] = conj X[m-k], E[k] = (X[k] + Y[k]) / 2 and
+	// O[k] = (X[k] - Y[k]) / 2 conj(exp(-2 pi i k / N)); then Z[k] = E[k] + i O[k].
+	// The inverse of a forward transform is the forward transform with real and imaginary
+	// swapped on the way in and out, so Z goes in swapped, scaled by 1/m for the inverse.
+	const Float32 scale = 0.5f / m;
+	const Float32 *twist = &mTwist[0];
+	for (UInt32 k = 0; k < m; ++k) {
+		Float32 ar = inReal[k], ai = (k == 0) ? 0.f : inImag[k];
+		Float32 br = inReal[m - k], bi = (k == 0) ? 0.f : -inImag[m - k];
+		
+		Float32 er = ar + br, ei = ai + bi;
+		Float32 dr = ar - br, di = ai - bi;
+		
+		Float32 wr = twist[2 * k], wi = twist[2 * k + 1];
+		Float32 or_ = dr * wr + di * wi, oi = di * wr - dr * wi;
+		
+		xr[k] = scale * (ei + or_);
+		xi[k] = scale * (er - oi);
+	}
+	
+	for (std::vector<Stage>::const_iterator stage = mStages.begin(); stage != mStages.end(); ++stage) {
+		(stage->mProc)(stage->mLength, stage->mStride, xr, xi, yr, yi, &mTwiddles[stage->mTwiddles]);
+		Float32 *t;
+		t = xr; xr = yr; yr = t;
+		t = xi; xi = yi; yi = t;
+	}
+	
+	// z[n] = x[2n] + i x[2n+1], swapped back
+	for (UInt32 i = 0; i < m; ++i) {
+		output[2 * i] = xi[i];
+		output[2 * i + 1] = xr[i];
+	}
+}
+
+void	CARealFFT::Magnitude(const Float32 *inReal, const Float32 *inImag, Float32 *outMagnitude, UInt32 nBins)
+{
+	for (UInt32 i = 0; i < nBins; ++i)
+		outMagnitude[i] = sqrtf(inReal[i] * inReal[i] + inImag[i] * inImag[i]);
+}
+
+void	CARealFFT::Magnitude(const Float32 *inReal, const Float32 *inImag, Float32 *outMagnitude, UInt32 nBins,
+								Float32 &outMin, Float32 &outMax)
+{
+	Float32 lo = sqrtf(inReal[0] * inReal[0] + inImag[0] * inImag[0]), hi = lo;
+	outMagnitude[0] = lo;
+	for (UInt32 i = 1; i < nBins; ++i) {
+		Float32 m = sqrtf(inReal[i] * inReal[i] + inImag[i] * inImag[i]);
+		outMagnitude[i] = m;
+		if (m < lo) lo = m;
+		if (m > hi) hi = m;
+	}
+	outMin = lo;
+	outMax = hi;
+}
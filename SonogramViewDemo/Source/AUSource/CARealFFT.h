@@ -0,0 +1,126 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CARealFFT.h
+	
+=============================================================================*/
+
+#ifndef __CARealFFT_h__
+#define __CARealFFT_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+#include <vector>
+
+/*
+	A forward FFT of real input, and its inverse, for power of two sizes from 64 to
+	65536, that does not depend on vDSP.
+	
+	A real transform of size N is done as a complex transform of size N/2 on the
+	even/odd samples, followed by a twist into the N/2 + 1 bins; the inverse untwists
+	and runs the same complex transform with real and imaginary parts swapped. The
+	complex transform is a Stockham autosort FFT (no bit reversal pass) made of radix-4
+	stages, plus one radix-2 stage when log2(N/2) is odd, on split real/imaginary arrays.
+	All twiddle factors are computed once, in double precision, by the constructor.
+	
+	Each stage is vectorized across its independent sub-transforms; the instruction set
+	is chosen at run time: AVX2 where the CPU has it, otherwise SSE on x86 and NEON on
+	ARM, with a scalar kernel for the first stages, which are too narrow to vectorize.
+	
+	An instance keeps scratch buffers, so it must only be used by one thread at a time.
+*/
+
+class CARealFFT {
+public:
+	enum {
+		kMinSize = 64,
+		kMaxSize = 65536
+	};
+	
+	CARealFFT(UInt32 size);		// a power of 2 between kMinSize and kMaxSize
+	~CARealFFT();
+	
+	UInt32		Size() const			{ return mSize; }
+	UInt32		NumberBins() const		{ return mSize / 2 + 1; }
+	
+	// input has Size() samples; outReal and outImag receive NumberBins() values, DC to
+	// Nyquist. The result is not normalized: a sine of amplitude A in bin k gives
+	// |X[k]| = A * Size() / 2.
+	void		Forward(const Float32 *input, Float32 *outReal, Float32 *outImag);
+	
+	// NumberBins() values of inReal and inImag back to Size() samples, normalized so that
+	// Inverse of Forward gives the input back. The imaginary parts of DC and Nyquist are
+	// ignored. output may not be inReal or inImag.
+	void		Inverse(const Float32 *inReal, const Float32 *inImag, Float32 *output);
+	
+	// Fills outMagnitude with sqrt(re^2 + im^2) for nBins bins.
+	static void	Magnitude(const Float32 *inReal, const Float32 *inImag, Float32 *outMagnitude, UInt32 nBins);
+	// ... and the smallest and largest of them, from the same pass. nBins must be at least 1.
+	static void	Magnitude(const Float32 *inReal, const Float32 *inImag, Float32 *outMagnitude, UInt32 nBins,
+							Float32 &outMin, Float32 &outMax);
+	
+	// The widest instruction set this machine uses: "AVX2", "SSE", "NEON" or "scalar".
+	static const char *	InstructionSet();
+
+private:
+	typedef void (*StageProc)(UInt32 n, UInt32 s, const Float32 *xr, const Float32 *xi,
+								Float32 *yr, Float32 *yi, const Float32 *tw);
+	
+	struct Stage {
+		StageProc	mProc;
+		UInt32		mLength;		// n: length of each sub-transform
+		UInt32		mStride;		// s: number of sub-transforms
+		UInt32		mTwiddles;		// offset into mTwiddles
+	};
+	
+	UInt32					mSize;
+	UInt32					mHalfSize;
+	std::vector<Stage>		mStages;
+	std::vector<Float32>	mTwiddles;
+	std::vector<Float32>	mTwist;			// cos, sin of 2 pi k / N for the real post-processing
+	std::vector<Float32>	mBuffer;		// 4 * mHalfSize: two split complex work arrays
+};
+
+#endif // __CARealFFT_h__
@@ -0,0 +1,131 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CARealFFTKernel.h
+	
+	Included by CARealFFT.cpp once per instruction set, with these defined:
+	
+		FFT_KERNEL(name)	the function name for this instruction set
+		FFT_TARGET			function attributes enabling the instruction set
+		FFT_WIDTH			floats per vector
+		FFT_V				the vector type
+		FFT_LOAD(p), FFT_STORE(p, v), FFT_SET1(x)
+		FFT_ADD(a, b), FFT_SUB(a, b), FFT_MUL(a, b)
+	
+	The stages only vectorize across q, so they require s to be a multiple of FFT_WIDTH.
+=============================================================================*/
+
+// One radix-4 Stockham stage: n is the length of the sub-transforms at this stage and s
+// their number (the stride). tw holds w^p, w^2p, w^3p for p < n/4 as re,im pairs.
+FFT_TARGET static void	FFT_KERNEL(Radix4)(UInt32 n, UInt32 s, const Float32 *xr, const Float32 *xi,
+											Float32 *yr, Float32 *yi, const Float32 *tw)
+{
+	const UInt32 m = n / 4;
+	for (UInt32 p = 0; p < m; ++p, tw += 6) {
+		const FFT_V w1r = FFT_SET1(tw[0]), w1i = FFT_SET1(tw[1]);
+		const FFT_V w2r = FFT_SET1(tw[2]), w2i = FFT_SET1(tw[3]);
+		const FFT_V w3r = FFT_SET1(tw[4]), w3i = FFT_SET1(tw[5]);
+		const UInt32 ia = s * p, ib = s * (p + m), ic = s * (p + 2 * m), id = s * (p + 3 * m);
+		const UInt32 o = s * 4 * p;
+		
+		for (UInt32 q = 0; q < s; q += FFT_WIDTH) {
+			FFT_V ar = FFT_LOAD(xr + ia + q), ai = FFT_LOAD(xi + ia + q);
+			FFT_V br = FFT_LOAD(xr + ib + q), bi = FFT_LOAD(xi + ib + q);
+			FFT_V cr = FFT_LOAD(xr + ic + q), ci = FFT_LOAD(xi + ic + q);
+			FFT_V dr = FFT_LOAD(xr + id + q), di = FFT_LOAD(xi + id + q);
+			
+			FFT_V apcr = FFT_ADD(ar, cr), apci = FFT_ADD(ai, ci);
+			FFT_V amcr = FFT_SUB(ar, cr), amci = FFT_SUB(ai, ci);
+			FFT_V bpdr = FFT_ADD(br, dr), bpdi = FFT_ADD(bi, di);
+			// j * (b - d)
+			FFT_V jbmdr = FFT_SUB(di, bi), jbmdi = FFT_SUB(br, dr);
+			
+			FFT_STORE(yr + o + q, FFT_ADD(apcr, bpdr));
+			FFT_STORE(yi + o + q, FFT_ADD(apci, bpdi));
+			
+			FFT_V tr = FFT_SUB(amcr, jbmdr), ti = FFT_SUB(amci, jbmdi);
+			FFT_STORE(yr + o + s + q, FFT_SUB(FFT_MUL(w1r, tr), FFT_MUL(w1i, ti)));
+			FFT_STORE(yi + o + s + q, FFT_ADD(FFT_MUL(w1r, ti), FFT_MUL(w1i, tr)));
+			
+			tr = FFT_SUB(apcr, bpdr); ti = FFT_SUB(apci, bpdi);
+			FFT_STORE(yr + o + 2 * s + q, FFT_SUB(FFT_MUL(w2r, tr), FFT_MUL(w2i, ti)));
+			FFT_STORE(yi + o + 2 * s + q, FFT_ADD(FFT_MUL(w2r, ti), FFT_MUL(w2i, tr)));
+			
+			tr = FFT_ADD(amcr, jbmdr); ti = FFT_ADD(amci, jbmdi);
+			FFT_STORE(yr + o + 3 * s + q, FFT_SUB(FFT_MUL(w3r, tr), FFT_MUL(w3i, ti)));
+			FFT_STORE(yi + o + 3 * s + q, FFT_ADD(FFT_MUL(w3r, ti), FFT_MUL(w3i, tr)));
+		}
+	}
+}
+
+// One radix-2 Stockham stage; tw holds w^p for p < n/2.
+FFT_TARGET static void	FFT_KERNEL(Radix2)(UInt32 n, UInt32 s, const Float32 *xr, const Float32 *xi,
+											Float32 *yr, Float32 *yi, const Float32 *tw)
+{
+	const UInt32 m = n / 2;
+	for (UInt32 p = 0; p < m; ++p, tw += 2) {
+		const FFT_V wr = FFT_SET1(tw[0]), wi = FFT_SET1(tw[1]);
+		const UInt32 ia = s * p, ib = s * (p + m), o = s * 2 * p;
+		
+		for (UInt32 q = 0; q < s; q += FFT_WIDTH) {
+			FFT_V ar = FFT_LOAD(xr + ia + q), ai = FFT_LOAD(xi + ia + q);
+			FFT_V br = FFT_LOAD(xr + ib + q), bi = FFT_LOAD(xi + ib + q);
+			
+			FFT_STORE(yr + o + q, FFT_ADD(ar, br));
+			FFT_STORE(yi + o + q, FFT_ADD(ai, bi));
+			
+			FFT_V tr = FFT_SUB(ar, br), ti = FFT_SUB(ai, bi);
+			FFT_STORE(yr + o + s + q, FFT_SUB(FFT_MUL(wr, tr), FFT_MUL(wi, ti)));
+			FFT_STORE(yi + o + s + q, FFT_ADD(FFT_MUL(wr, ti), FFT_MUL(wi, tr)));
+		}
+	}
+}
+
+#undef FFT_KERNEL
+#undef FFT_TARGET
+#undef FFT_WIDTH
+#undef FFT_V
+#undef FFT_LOAD
+#undef FFT_STORE
+#undef FFT_SET1
+#undef FFT_ADD
+#undef FFT_SUB
+#undef FFT_MUL
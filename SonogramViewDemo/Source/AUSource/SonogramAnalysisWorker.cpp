@@ -0,0 +1,152 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramAnalysisWorker.cpp
+	
+=============================================================================*/
+
+#include "SonogramAnalysisWorker.h"
+#include <errno.h>
+#include <time.h>
+
+#if defined(__APPLE__)
+	#include <libkern/OSAtomic.h>
+	#define WorkerCompareAndSwap(oldValue, newValue, address)	OSAtomicCompareAndSwap32Barrier(oldValue, newValue, address)
+	#define WorkerMemoryBarrier()								OSMemoryBarrier()
+#else
+	#define WorkerCompareAndSwap(oldValue, newValue, address)	__sync_bool_compare_and_swap(address, oldValue, newValue)
+	#define WorkerMemoryBarrier()								__sync_synchronize()
+#endif
+
+SonogramAnalysisWorker::SonogramAnalysisWorker() :
+	mProc(NULL), mRefCon(NULL), mRunning(false), mStopping(false), mWakePending(0)
+{
+#if defined(__APPLE__)
+	semaphore_create(mach_task_self(), &mSemaphore, SYNC_POLICY_FIFO, 0);
+#else
+	sem_init(&mSemaphore, 0, 0);
+#endif
+}
+
+SonogramAnalysisWorker::~SonogramAnalysisWorker()
+{
+	Stop();
+#if defined(__APPLE__)
+	semaphore_destroy(mach_task_self(), mSemaphore);
+#else
+	sem_destroy(&mSemaphore);
+#endif
+}
+
+bool	SonogramAnalysisWorker::Start(WorkProc inProc, void *inRefCon)
+{
+	Stop();
+	
+	mProc = inProc;
+	mRefCon = inRefCon;
+	mStopping = false;
+	mWakePending = 0;
+	mRunning = (pthread_create(&mThread, NULL, Entry, this) == 0);
+	return mRunning;
+}
+
+void	SonogramAnalysisWorker::Stop()
+{
+	if (!mRunning) return;
+	
+	mStopping = true;
+	Wake();
+	pthread_join(mThread, NULL);
+	mRunning = false;
+}
+
+void	SonogramAnalysisWorker::Wake()
+{
+	// one outstanding signal is enough; the worker drains everything when it runs
+	if (WorkerCompareAndSwap(0, 1, &mWakePending)) {
+#if defined(__APPLE__)
+		semaphore_signal(mSemaphore);
+#else
+		sem_post(&mSemaphore);
+#endif
+	}
+}
+
+bool	SonogramAnalysisWorker::WaitForWake(UInt32 inTimeoutMS)
+{
+#if defined(__APPLE__)
+	mach_timespec_t timeout = { inTimeoutMS / 1000, (inTimeoutMS % 1000) * 1000000 };
+	return semaphore_timedwait(mSemaphore, timeout) == KERN_SUCCESS;
+#else
+	struct timespec deadline;
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	deadline.tv_sec += inTimeoutMS / 1000;
+	deadline.tv_nsec += (inTimeoutMS % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000) {
+		deadline.tv_sec += 1;
+		deadline.tv_nsec -= 1000000000;
+	}
+	while (sem_timedwait(&mSemaphore, &deadline) != 0) {
+		if (errno != EINTR)
+			return false;
+	}
+	return true;
+#endif
+}
+
+void *	SonogramAnalysisWorker::Entry(void *inWorker)
+{
+	SonogramAnalysisWorker *This = (SonogramAnalysisWorker *)inWorker;
+	
+	while (!This->mStopping) {
+		if (!This->WaitForWake(100))
+			continue;
+		
+		// clear before working, so a wake during the proc runs it again
+		This->mWakePending = 0;
+		WorkerMemoryBarrier();
+		if (This->mStopping)
+			break;
+		
+		(This->mProc)(This->mRefCon);
+	}
+	return NULL;
+}
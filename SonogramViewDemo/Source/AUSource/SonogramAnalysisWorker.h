@@ -0,0 +1,100 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramAnalysisWorker.h
+	
+=============================================================================*/
+
+#ifndef __SonogramAnalysisWorker_h__
+#define __SonogramAnalysisWorker_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+#include <pthread.h>
+
+#if defined(__APPLE__)
+	#include <mach/mach.h>
+#else
+	#include <semaphore.h>
+#endif
+
+/*
+	A thread that runs a work proc each time it is woken. Wake never blocks or allocates,
+	so the render thread can call it after queueing input; wakes that arrive while the
+	proc is running are not lost, but several may be folded into one call, so the proc
+	should drain everything that is ready.
+*/
+
+class SonogramAnalysisWorker {
+public:
+	typedef void (*WorkProc)(void *inRefCon);
+	
+	SonogramAnalysisWorker();
+	~SonogramAnalysisWorker();
+	
+	bool		Start(WorkProc inProc, void *inRefCon);		// false if the thread can't be created
+	void		Stop();										// waits for the current call to finish
+	bool		IsRunning() const	{ return mRunning; }
+	
+	void		Wake();
+
+private:
+	static void *	Entry(void *inWorker);
+	bool			WaitForWake(UInt32 inTimeoutMS);
+	
+	pthread_t			mThread;
+	WorkProc			mProc;
+	void *				mRefCon;
+	bool				mRunning;
+	volatile bool		mStopping;
+	volatile SInt32		mWakePending;	// saves the signal when the worker is already awake
+#if defined(__APPLE__)
+	semaphore_t			mSemaphore;
+#else
+	sem_t				mSemaphore;
+#endif
+};
+
+#endif // __SonogramAnalysisWorker_h__
@@ -0,0 +1,235 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramAnalyzer.cpp
+	
+=============================================================================*/
+
+#include "SonogramAnalyzer.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+// zeroth order modified Bessel function of the first kind, for the Kaiser window
+static double	BesselI0(double x)
+{
+	double sum = 1., term = 1., q = x * x / 4.;
+	for (int k = 1; k < 64 && term > sum * 1e-12; ++k) {
+		term *= q / (double(k) * k);
+		sum += term;
+	}
+	return sum;
+}
+
+static void	MakeWindow(UInt32 inWindow, Float32 *outWindow, UInt32 n)
+{
+	// periodic windows, so that overlapped frames sum evenly
+	for (UInt32 i = 0; i < n; ++i) {
+		double x = 2. * M_PI * i / n;
+		double w;
+		switch (inWindow) {
+			case kSonogramWindow_BlackmanHarris:
+				w = 0.35875 - 0.48829 * cos(x) + 0.14128 * cos(2. * x) - 0.01168 * cos(3. * x);
+				break;
+			case kSonogramWindow_Kaiser:
+			{
+				const double beta = 9.;
+				double r = (2. * i) / n - 1.;
+				w = BesselI0(beta * sqrt(1. - r * r)) / BesselI0(beta);
+				break;
+			}
+			default:
+				w = 0.5 - 0.5 * cos(x);
+				break;
+		}
+		outWindow[i] = Float32(w);
+	}
+}
+
+SonogramAnalyzer::SonogramAnalyzer(UInt32 inFFTSize, UInt32 inHopSize, UInt32 inWindow,
+									const SonogramBinReducer *inReducer, SonogramFeatureExtractor *inFeatures,
+									SonogramSpectralEffect *inEffect) :
+	mFFTSize(inFFTSize), mHopSize(inHopSize), mWindowType(inWindow), mReducer(inReducer), mFeatures(inFeatures),
+	mEffect(inEffect),
+	mFFT(inFFTSize),
+	mWindow(inFFTSize),
+	mHistory(inFFTSize, 0.f),
+	mWritePos(0),
+	mWindowed(inFFTSize),
+	mReal(inFFTSize / 2 + 1), mImag(inFFTSize / 2 + 1),
+	mMagnitudes((inReducer || inFeatures) ? inFFTSize / 2 : 0),
+	mSynthesisWindow(inEffect ? inFFTSize : 0),
+	mFrame(inEffect ? inFFTSize : 0),
+	mOverlap(inEffect ? 2 * inFFTSize : 0, 0.f),
+	mOutputPos(0)
+{
+	MakeWindow(inWindow, &mWindow[0], mFFTSize);
+	
+	if (mEffect) {
+		// Weighted overlap-add: dividing by the sum of the squared windows over the frames
+		// that overlap each point makes analysis times synthesis sum to one. With no overlap
+		// that sum goes to zero at the frame edges, so it is kept off zero there.
+		std::vector<double> sum(mFFTSize, 0.);
+		double most = 0.;
+		for (UInt32 i = 0; i < mFFTSize; ++i) {
+			for (UInt32 j = i % mHopSize; j < mFFTSize; j += mHopSize)
+				sum[i] += double(mWindow[j]) * mWindow[j];
+			most = std::max(most, sum[i]);
+		}
+		for (UInt32 i = 0; i < mFFTSize; ++i)
+			mSynthesisWindow[i] = Float32(mWindow[i] / std::max(sum[i], 0.01 * most));
+	}
+}
+
+SonogramAnalyzer::~SonogramAnalyzer()
+{
+}
+
+void	SonogramAnalyzer::Clear()
+{
+	std::fill(mHistory.begin(), mHistory.end(), 0.f);
+	mWritePos = 0;
+	if (mFeatures)
+		mFeatures->Clear();
+	mRange.Reset();
+	if (mEffect) {
+		mEffect->Clear();
+		std::fill(mOverlap.begin(), mOverlap.end(), 0.f);
+		mOutputPos = 0;
+	}
+}
+
+UInt32	SonogramAnalyzer::Process(const Float32 *inFrames, UInt32 inNumFrames, UInt32 inHopFill,
+									Float32 *outSlices, Float32 &outMin, Float32 &outMax,
+									SonogramFeatures *outFeatures, Float32 *outFrames)
+{
+	const UInt32 mask = mFFTSize - 1;
+	const UInt32 nBins = NumberBins();
+	UInt32 nSlices = 0;
+	
+	UInt32 offset = 0;
+	while (offset < inNumFrames) {
+		// copy up to the next hop boundary
+		UInt32 n = std::min(inNumFrames - offset, mHopSize - inHopFill);
+		UInt32 first = std::min(n, mFFTSize - mWritePos);
+		memcpy(&mHistory[mWritePos], inFrames + offset, first * sizeof(Float32));
+		memcpy(&mHistory[0], inFrames + offset + first, (n - first) * sizeof(Float32));
+		mWritePos = (mWritePos + n) & mask;
+		inHopFill += n;
+		offset += n;
+		
+		if (inHopFill == mHopSize) {
+			inHopFill = 0;
+			Analyze(outSlices + nSlices * nBins, outMin, outMax, outFeatures ? outFeatures + nSlices : NULL);
+			++nSlices;
+			// the frame starts Latency() frames before the end of the hop, which is the
+			// last frame handed back below
+			if (mEffect)
+				OverlapAdd(mOutputPos + n - 1);
+		}
+		// the input of these n frames is in mHistory already, so outFrames may overwrite it
+		if (mEffect)
+			Emit(outFrames ? outFrames + offset - n : NULL, n);
+	}
+	return nSlices;
+}
+
+void	SonogramAnalyzer::OverlapAdd(UInt32 inStart)
+{
+	const UInt32 mask = 2 * mFFTSize - 1;
+	const Float32 *frame = &mFrame[0], *window = &mSynthesisWindow[0];
+	Float32 *sum = &mOverlap[0];
+	
+	UInt32 start = inStart & mask;
+	UInt32 first = std::min(mFFTSize, mask + 1 - start);
+	for (UInt32 i = 0; i < first; ++i)
+		sum[start + i] += frame[i] * window[i];
+	for (UInt32 i = first; i < mFFTSize; ++i)
+		sum[i - first] += frame[i] * window[i];
+}
+
+void	SonogramAnalyzer::Emit(Float32 *outFrames, UInt32 inNumFrames)
+{
+	const UInt32 mask = 2 * mFFTSize - 1;
+	Float32 *sum = &mOverlap[0];
+	
+	// each point is complete once handed back, and starts over at zero for a later frame
+	for (UInt32 i = 0; i < inNumFrames; ++i) {
+		UInt32 pos = (mOutputPos + i) & mask;
+		if (outFrames)
+			outFrames[i] = sum[pos];
+		sum[pos] = 0.f;
+	}
+	mOutputPos = (mOutputPos + inNumFrames) & mask;
+}
+
+void	SonogramAnalyzer::Analyze(Float32 *outMagnitudes, Float32 &outMin, Float32 &outMax, SonogramFeatures *outFeatures)
+{
+	const UInt32 mask = mFFTSize - 1;
+	const UInt32 nBins = NumberBins();
+	
+	// oldest frame first
+	for (UInt32 i = 0; i < mFFTSize; ++i)
+		mWindowed[i] = mHistory[(mWritePos + i) & mask] * mWindow[i];
+	
+	mFFT.Forward(&mWindowed[0], &mReal[0], &mImag[0]);
+	if (mFeatures) {
+		// the features come out of the magnitude pass; a slice nobody wants them for is scratch
+		SonogramFeatures scratch;
+		Float32 *magnitudes = mReducer ? &mMagnitudes[0] : outMagnitudes;
+		mFeatures->Process(&mReal[0], &mImag[0], magnitudes, outMin, outMax, outFeatures ? *outFeatures : scratch);
+		if (mReducer)
+			mReducer->Apply(magnitudes, outMagnitudes, outMin, outMax);
+	} else if (mReducer) {
+		CARealFFT::Magnitude(&mReal[0], &mImag[0], &mMagnitudes[0], mFFTSize / 2);
+		mReducer->Apply(&mMagnitudes[0], outMagnitudes, outMin, outMax);
+	} else
+		CARealFFT::Magnitude(&mReal[0], &mImag[0], outMagnitudes, nBins, outMin, outMax);
+	
+	// the range comes out of whichever pass wrote the slice
+	mRange.AddSlice(outMin, outMax);
+	
+	// the slice is done with the spectrum; now the effect may change it
+	if (mEffect) {
+		mEffect->Process(&mReal[0], &mImag[0], mReducer ? &mMagnitudes[0] : outMagnitudes);
+		mFFT.Inverse(&mReal[0], &mImag[0], &mFrame[0]);
+	}
+}
@@ -0,0 +1,156 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramAnalyzer.h
+	
+=============================================================================*/
+
+#ifndef __SonogramAnalyzer_h__
+#define __SonogramAnalyzer_h__
+
+#include "CARealFFT.h"
+#include "SonogramBinReducer.h"
+#include "SonogramFeatures.h"
+#include "SonogramRangeTracker.h"
+#include "SonogramSpectralEffect.h"
+
+/*
+	Short-time spectral analysis of one channel for the sonogram, built on CARealFFT.
+	
+	Every hopSize input frames the last fftSize frames are windowed and transformed into
+	one slice of fftSize / 2 magnitudes (DC up to, but not including, Nyquist). The
+	magnitudes are not normalized. Given a SonogramBinReducer, each slice holds its bands
+	instead; the reducer must outlive the analyzer. Given a SonogramFeatureExtractor, it
+	computes the magnitudes and each slice's SonogramFeatures at once; the extractor is
+	the analyzer's to use, and must outlive it too. Every slice's range also goes into a
+	SonogramRangeTracker, for a display range that doesn't jump from slice to slice.
+	
+	Given a SonogramSpectralEffect, the analyzer resynthesizes the input as well: each
+	frame's spectrum, once the slice has been taken from it, goes through the effect and
+	an inverse FFT, and is overlap-added with a synthesis window that makes the windows
+	sum to one (exactly, unless there is no overlap). Process then hands back as many
+	frames as it was given, Latency() frames late. The effect is the analyzer's to use,
+	and must outlive it.
+	
+	The caller keeps the hop phase (the number of frames since the last hop) and passes
+	it in, so that channels analyzed separately, on different threads or with some of
+	them switched off for a while, stay in step and produce the same slices.
+	
+	Nothing is allocated after construction, so Process can be called from the render
+	thread. An instance must only be used by one thread at a time.
+*/
+
+enum {
+	kSonogramWindow_Hann			= 0,
+	kSonogramWindow_BlackmanHarris	= 1,	// 4 term, -92 dB side lobes
+	kSonogramWindow_Kaiser			= 2		// beta = 9, about the same side lobes with a narrower main lobe
+};
+
+class SonogramAnalyzer {
+public:
+	SonogramAnalyzer(UInt32 inFFTSize, UInt32 inHopSize, UInt32 inWindow = kSonogramWindow_Hann,
+						const SonogramBinReducer *inReducer = NULL, SonogramFeatureExtractor *inFeatures = NULL,
+						SonogramSpectralEffect *inEffect = NULL);
+	~SonogramAnalyzer();
+	
+	UInt32		FFTSize() const			{ return mFFTSize; }
+	UInt32		HopSize() const			{ return mHopSize; }
+	UInt32		NumberBins() const		{ return mReducer ? mReducer->NumberBands() : mFFTSize / 2; }
+	UInt32		Window() const			{ return mWindowType; }
+	
+	// how late the resynthesized output is, in frames: the last frame of a hop can't be
+	// played until the frame that ends with it has been analyzed
+	UInt32		Latency() const			{ return mEffect ? mFFTSize - 1 : 0; }
+	
+	// the smoothed range of the slices so far; its times may be set from any thread
+	SonogramRangeTracker &			Range()			{ return mRange; }
+	const SonogramRangeTracker &	Range() const	{ return mRange; }
+	
+	// the number of slices Process produces, and the hop phase it leaves, for inNumFrames
+	UInt32		NumberSlices(UInt32 inHopFill, UInt32 inNumFrames) const	{ return (inHopFill + inNumFrames) / mHopSize; }
+	UInt32		NextHopFill(UInt32 inHopFill, UInt32 inNumFrames) const		{ return (inHopFill + inNumFrames) % mHopSize; }
+	
+	// Forget the input so far, the range and the effect's output, e.g. when a channel is
+	// switched back on.
+	void		Clear();
+	
+	// Adds inNumFrames frames; inHopFill is the number of frames added since the last hop.
+	// Each completed hop appends NumberBins() magnitudes to outSlices, which must have room
+	// for NumberSlices(inHopFill, inNumFrames) of them. Returns the number of slices, and
+	// the smallest and largest magnitude of the last one in outMin and outMax. With an
+	// extractor, outFeatures (if not NULL) gets one SonogramFeatures per slice. With an
+	// effect, outFrames (if not NULL) gets inNumFrames frames of its output; it may be
+	// inFrames.
+	UInt32		Process(const Float32 *inFrames, UInt32 inNumFrames, UInt32 inHopFill,
+						Float32 *outSlices, Float32 &outMin, Float32 &outMax,
+						SonogramFeatures *outFeatures = NULL, Float32 *outFrames = NULL);
+
+private:
+	void		Analyze(Float32 *outMagnitudes, Float32 &outMin, Float32 &outMax, SonogramFeatures *outFeatures);
+	void		OverlapAdd(UInt32 inStart);
+	void		Emit(Float32 *outFrames, UInt32 inNumFrames);
+	
+	UInt32					mFFTSize;
+	UInt32					mHopSize;
+	UInt32					mWindowType;
+	const SonogramBinReducer *	mReducer;
+	SonogramFeatureExtractor *	mFeatures;
+	SonogramRangeTracker	mRange;
+	SonogramSpectralEffect *	mEffect;
+	
+	CARealFFT				mFFT;
+	std::vector<Float32>	mWindow;
+	std::vector<Float32>	mHistory;		// circular, mFFTSize frames
+	UInt32					mWritePos;		// next frame to write
+	
+	std::vector<Float32>	mWindowed;
+	std::vector<Float32>	mReal;
+	std::vector<Float32>	mImag;
+	std::vector<Float32>	mMagnitudes;	// before reduction
+	
+	// resynthesis, with an effect
+	std::vector<Float32>	mSynthesisWindow;
+	std::vector<Float32>	mFrame;			// the last frame, resynthesized
+	std::vector<Float32>	mOverlap;		// circular, 2 * mFFTSize frames of output being summed
+	UInt32					mOutputPos;		// in mOverlap, of the next frame to hand back
+};
+
+#endif // __SonogramAnalyzer_h__
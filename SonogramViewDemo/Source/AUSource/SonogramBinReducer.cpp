@@ -0,0 +1,181 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramBinReducer.cpp
+	
+=============================================================================*/
+
+#include "SonogramBinReducer.h"
+#include <math.h>
+#include <algorithm>
+
+static inline Float64	HzToMel(Float64 f)	{ return 2595. * log10(1. + f / 700.); }
+static inline Float64	MelToHz(Float64 m)	{ return 700. * (pow(10., m / 2595.) - 1.); }
+
+SonogramBinReducer::SonogramBinReducer(UInt32 inNumBins, Float64 inSampleRate, UInt32 inScale, UInt32 inNumBands,
+										Float64 inMinFrequency) :
+	mNumberBins(inNumBins), mScale(inScale),
+	mBinWidth(inSampleRate / (2. * inNumBins))
+{
+	const Float64 maxFrequency = inNumBins * mBinWidth;
+	const Float64 minFrequency = std::min(std::max(inMinFrequency, mBinWidth), maxFrequency / 2.);
+	
+	// inNumBands + 2 corner frequencies: band i rises from p[i], peaks at p[i+1] and falls to p[i+2]
+	std::vector<Float64> p(inNumBands + 2);
+	for (UInt32 i = 0; i < p.size(); ++i) {
+		Float64 x = Float64(i) / (inNumBands + 1);
+		switch (inScale) {
+			case kSonogramScale_Mel:
+				p[i] = MelToHz(x * HzToMel(maxFrequency));
+				break;
+			case kSonogramScale_Log:
+			case kSonogramScale_ConstantQ:
+				p[i] = minFrequency * pow(maxFrequency / minFrequency, x);
+				break;
+			default:
+				p[i] = x * maxFrequency;
+				break;
+		}
+	}
+	
+	mBands.reserve(inNumBands);
+	for (UInt32 i = 0; i < inNumBands; ++i) {
+		if (inScale == kSonogramScale_ConstantQ) {
+			// Q = 1 / (r - 1) for a ratio r between neighbouring centres; the kernel spans
+			// one bandwidth (centre / Q) either side, as far as the neighbouring centres
+			Float64 bandwidth = p[i + 1] * (p[i + 2] / p[i + 1] - 1.);
+			AddBand(p[i + 1] - bandwidth, p[i + 1], p[i + 1] + bandwidth);
+		} else
+			AddBand(p[i], p[i + 1], p[i + 2]);
+	}
+}
+
+void	SonogramBinReducer::AddBand(Float64 inLow, Float64 inCenter, Float64 inHigh)
+{
+	Band band;
+	band.mFirstWeight = mWeights.size();
+	band.mCenter = inCenter;
+	
+	const bool hann = (mScale == kSonogramScale_ConstantQ);
+	SInt32 first = SInt32(ceil(inLow / mBinWidth));
+	SInt32 last = SInt32(floor(inHigh / mBinWidth));
+	first = std::max(first, SInt32(0));
+	last = std::min(last, SInt32(mNumberBins) - 1);
+	
+	// weights of the bins strictly inside the band, trimmed of zeros at either end
+	Float64 sum = 0.;
+	band.mFirstBin = 0;
+	band.mNumberBins = 0;
+	for (SInt32 k = first; k <= last; ++k) {
+		Float64 f = k * mBinWidth;
+		Float64 w;
+		if (hann)
+			w = 0.5 + 0.5 * cos(M_PI * (f - inCenter) / (inCenter - inLow));
+		else if (f <= inCenter)
+			w = (f - inLow) / (inCenter - inLow);
+		else
+			w = (inHigh - f) / (inHigh - inCenter);
+		if (w <= 0.) {
+			if (band.mNumberBins == 0) continue;
+			break;
+		}
+		if (band.mNumberBins == 0)
+			band.mFirstBin = k;
+		mWeights.push_back(Float32(w));
+		++band.mNumberBins;
+		sum += w;
+	}
+	
+	if (band.mNumberBins == 0) {
+		// narrower than a bin: interpolate at the centre
+		Float64 position = std::min(inCenter / mBinWidth, Float64(mNumberBins - 1));
+		UInt32 k = UInt32(position);
+		Float64 frac = position - k;
+		band.mFirstBin = k;
+		mWeights.push_back(Float32(1. - frac));
+		band.mNumberBins = 1;
+		if (k + 1 < mNumberBins) {
+			mWeights.push_back(Float32(frac));
+			band.mNumberBins = 2;
+		}
+	} else {
+		// an average, so that bands and bins read on the same amplitude scale
+		for (UInt32 i = 0; i < band.mNumberBins; ++i)
+			mWeights[band.mFirstWeight + i] = Float32(mWeights[band.mFirstWeight + i] / sum);
+	}
+	
+	mBands.push_back(band);
+}
+
+void	SonogramBinReducer::Apply(const Float32 *inBins, Float32 *outBands) const
+{
+	const Float32 *weights = &mWeights[0];
+	const UInt32 nBands = mBands.size();
+	for (UInt32 b = 0; b < nBands; ++b) {
+		const Band &band = mBands[b];
+		const Float32 *bins = inBins + band.mFirstBin;
+		const Float32 *w = weights + band.mFirstWeight;
+		Float32 sum = 0.f;
+		for (UInt32 i = 0; i < band.mNumberBins; ++i)
+			sum += w[i] * bins[i];
+		outBands[b] = sum;
+	}
+}
+
+void	SonogramBinReducer::Apply(const Float32 *inBins, Float32 *outBands, Float32 &outMin, Float32 &outMax) const
+{
+	const Float32 *weights = &mWeights[0];
+	const UInt32 nBands = mBands.size();
+	Float32 lo = 0.f, hi = 0.f;
+	for (UInt32 b = 0; b < nBands; ++b) {
+		const Band &band = mBands[b];
+		const Float32 *bins = inBins + band.mFirstBin;
+		const Float32 *w = weights + band.mFirstWeight;
+		Float32 sum = 0.f;
+		for (UInt32 i = 0; i < band.mNumberBins; ++i)
+			sum += w[i] * bins[i];
+		outBands[b] = sum;
+		if (b == 0 || sum < lo) lo = sum;
+		if (b == 0 || sum > hi) hi = sum;
+	}
+	outMin = lo;
+	outMax = hi;
+}
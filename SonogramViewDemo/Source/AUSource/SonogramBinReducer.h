@@ -0,0 +1,118 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramBinReducer.h
+	
+=============================================================================*/
+
+#ifndef __SonogramBinReducer_h__
+#define __SonogramBinReducer_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+#include <vector>
+
+/*
+	Maps the linear magnitude bins of one slice onto fewer bands on a display scale, so
+	that the sonogram stores and hands out only as many values as the view can show.
+	
+	Each band is a weighted average of a short run of bins; the weights are worked out
+	once, up front, and only the non-zero ones are kept:
+	
+		linear, log, mel	overlapping triangles whose corners are the neighbouring
+							band centres, spaced evenly on that scale
+		constant-Q			log-spaced centres with a Hann-shaped kernel whose width
+							is a fixed fraction of the centre frequency
+	
+	The constant-Q kernel is applied to the magnitudes rather than the complex spectrum,
+	which gives the constant relative resolution without a second transform.
+	
+	Where a band is narrower than a bin (low frequencies at small FFT sizes) it is
+	interpolated between the two nearest bins instead. Apply doesn't allocate and the
+	reducer isn't changed after construction, so one instance can serve every channel.
+*/
+
+enum {
+	kSonogramScale_Linear		= 0,
+	kSonogramScale_Log			= 1,
+	kSonogramScale_Mel			= 2,
+	kSonogramScale_ConstantQ	= 3
+};
+
+class SonogramBinReducer {
+public:
+	// inNumBins bins from DC, spaced inSampleRate / (2 * inNumBins) apart. The log and
+	// constant-Q scales start at inMinFrequency, or at the first bin if that is higher.
+	SonogramBinReducer(UInt32 inNumBins, Float64 inSampleRate, UInt32 inScale, UInt32 inNumBands,
+						Float64 inMinFrequency = 20.);
+	
+	UInt32		NumberBins() const			{ return mNumberBins; }
+	UInt32		NumberBands() const			{ return mBands.size(); }
+	UInt32		Scale() const				{ return mScale; }
+	Float64		CenterFrequency(UInt32 inBand) const	{ return mBands[inBand].mCenter; }
+	
+	// NumberBins() magnitudes in, NumberBands() out
+	void		Apply(const Float32 *inBins, Float32 *outBands) const;
+	// ... and the smallest and largest band, from the same pass
+	void		Apply(const Float32 *inBins, Float32 *outBands, Float32 &outMin, Float32 &outMax) const;
+
+private:
+	struct Band {
+		UInt32		mFirstBin;
+		UInt32		mNumberBins;
+		UInt32		mFirstWeight;		// into mWeights
+		Float64		mCenter;
+	};
+	
+	void		AddBand(Float64 inLow, Float64 inCenter, Float64 inHigh);
+	
+	UInt32					mNumberBins;
+	UInt32					mScale;
+	Float64					mBinWidth;		// Hz
+	std::vector<Band>		mBands;
+	std::vector<Float32>	mWeights;
+};
+
+#endif // __SonogramBinReducer_h__
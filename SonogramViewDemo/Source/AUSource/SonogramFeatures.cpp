@@ -0,0 +1,263 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramFeatures.cpp
+	
+=============================================================================*/
+
+#include "SonogramFeatures.h"
+#include "CASonogramFastDB.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#if defined(__SSE2__)
+	#define SONOGRAM_FEATURES_SSE2 1
+#elif (defined(__ARM_NEON__) || defined(__ARM_NEON)) && defined(__aarch64__)
+	#define SONOGRAM_FEATURES_NEON 1		// 32 bit NEON has no square root
+#endif
+
+static const Float32 kRolloffFraction = 0.85f;
+static const Float32 kFloorMagnitude = 1e-10f;		// -200 dB, so silent bins have a finite log
+
+SonogramFeatureExtractor::SonogramFeatureExtractor(UInt32 inFFTSize, Float64 inSampleRate)
+	: mNumberBins(inFFTSize / 2),
+	  mBinWidth(Float32(inSampleRate / inFFTSize)),
+	  mGroupBand(inFFTSize / 2 / 4),
+	  mPrevious(inFFTSize / 2, 0.f),
+	  mBlockPower(inFFTSize / 2 / kBlockBins)
+{
+	// band b > 0 starts at the first bin at or above 62.5 * 2^b Hz
+	mBandStart[0] = 0;
+	for (UInt32 band = 1; band < kSonogramFeatureBands; ++band)
+		mBandStart[band] = std::min(mNumberBins, UInt32(ceil(62.5 * (1 << band) * inFFTSize / inSampleRate)));
+	mBandStart[kSonogramFeatureBands] = mNumberBins;
+	
+	for (UInt32 group = 0; group < mGroupBand.size(); ++group) {
+		UInt32 band = BandOfBin(4 * group);
+		mGroupBand[group] = (BandOfBin(4 * group + 3) == band) ? band : UInt32(kSplitGroup);
+	}
+}
+
+UInt32	SonogramFeatureExtractor::BandOfBin(UInt32 inBin) const
+{
+	UInt32 band = 0;
+	while (inBin >= mBandStart[band + 1])
+		++band;
+	return band;
+}
+
+void	SonogramFeatureExtractor::Clear()
+{
+	std::fill(mPrevious.begin(), mPrevious.end(), 0.f);
+}
+
+void	SonogramFeatureExtractor::Process(const Float32 *inReal, const Float32 *inImag, Float32 *outMagnitudes,
+											Float32 &outMin, Float32 &outMax, SonogramFeatures &outFeatures)
+{
+	Float32 *previous = &mPrevious[0];
+	Float32 sumMagnitude = 0.f, sumWeighted = 0.f, sumRise = 0.f, sumDB = 0.f;
+	Float32 lo = HUGE_VALF, hi = 0.f;
+	Float32 *bandEnergy = outFeatures.mBandEnergy;
+	memset(bandEnergy, 0, sizeof(outFeatures.mBandEnergy));
+	
+#if SONOGRAM_FEATURES_SSE2
+	__m128 vMagnitude = _mm_setzero_ps(), vWeighted = _mm_setzero_ps(), vRise = _mm_setzero_ps(), vDB = _mm_setzero_ps();
+	__m128 vMin = _mm_set1_ps(lo), vMax = _mm_setzero_ps();
+	const __m128 floor = _mm_set1_ps(kFloorMagnitude), four = _mm_set1_ps(4.f);
+	__m128 bin = _mm_set_ps(3.f, 2.f, 1.f, 0.f);
+	__m128 vBand[kSonogramFeatureBands];
+	for (UInt32 band = 0; band < kSonogramFeatureBands; ++band)
+		vBand[band] = _mm_setzero_ps();
+#elif SONOGRAM_FEATURES_NEON
+	float32x4_t vMagnitude = vdupq_n_f32(0.f), vWeighted = vMagnitude, vRise = vMagnitude, vDB = vMagnitude;
+	float32x4_t vMin = vdupq_n_f32(lo), vMax = vMagnitude;
+	const float32x4_t floor = vdupq_n_f32(kFloorMagnitude), four = vdupq_n_f32(4.f);
+	const Float32 firstBins[4] = { 0.f, 1.f, 2.f, 3.f };
+	float32x4_t bin = vld1q_f32(firstBins);
+	float32x4_t vBand[kSonogramFeatureBands];
+	for (UInt32 band = 0; band < kSonogramFeatureBands; ++band)
+		vBand[band] = vdupq_n_f32(0.f);
+#endif
+	
+	for (UInt32 block = 0; block < mBlockPower.size(); ++block) {
+		const UInt32 first = block * kBlockBins;
+#if SONOGRAM_FEATURES_SSE2
+		__m128 vPower = _mm_setzero_ps();
+		for (UInt32 i = first; i < first + kBlockBins; i += 4) {
+			__m128 re = _mm_loadu_ps(inReal + i), im = _mm_loadu_ps(inImag + i);
+			__m128 power = _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im));
+			__m128 m = _mm_sqrt_ps(power);
+			__m128 last = _mm_loadu_ps(previous + i);
+			_mm_storeu_ps(outMagnitudes + i, m);
+			_mm_storeu_ps(previous + i, m);
+			
+			vPower = _mm_add_ps(vPower, power);
+			UInt32 band = mGroupBand[i / 4];
+			if (band != kSplitGroup)
+				vBand[band] = _mm_add_ps(vBand[band], power);
+			else {
+				Float32 lanes[4];
+				_mm_storeu_ps(lanes, power);
+				for (UInt32 k = 0; k < 4; ++k)
+					bandEnergy[BandOfBin(i + k)] += lanes[k];
+			}
+			vMagnitude = _mm_add_ps(vMagnitude, m);
+			vMin = _mm_min_ps(vMin, m);
+			vMax = _mm_max_ps(vMax, m);
+			vWeighted = _mm_add_ps(vWeighted, _mm_mul_ps(bin, m));
+			vRise = _mm_add_ps(vRise, _mm_max_ps(_mm_sub_ps(m, last), _mm_setzero_ps()));
+			vDB = _mm_add_ps(vDB, CASonogramFastDB(_mm_max_ps(m, floor)));
+			bin = _mm_add_ps(bin, four);
+		}
+		Float32 lanes[4];
+		_mm_storeu_ps(lanes, vPower);
+		mBlockPower[block] = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif SONOGRAM_FEATURES_NEON
+		float32x4_t vPower = vdupq_n_f32(0.f);
+		for (UInt32 i = first; i < first + kBlockBins; i += 4) {
+			float32x4_t re = vld1q_f32(inReal + i), im = vld1q_f32(inImag + i);
+			float32x4_t power = vmlaq_f32(vmulq_f32(re, re), im, im);
+			float32x4_t m = vsqrtq_f32(power);
+			float32x4_t last = vld1q_f32(previous + i);
+			vst1q_f32(outMagnitudes + i, m);
+			vst1q_f32(previous + i, m);
+			
+			vPower = vaddq_f32(vPower, power);
+			UInt32 band = mGroupBand[i / 4];
+			if (band != kSplitGroup)
+				vBand[band] = vaddq_f32(vBand[band], power);
+			else {
+				Float32 lanes[4];
+				vst1q_f32(lanes, power);
+				for (UInt32 k = 0; k < 4; ++k)
+					bandEnergy[BandOfBin(i + k)] += lanes[k];
+			}
+			vMagnitude = vaddq_f32(vMagnitude, m);
+			vMin = vminq_f32(vMin, m);
+			vMax = vmaxq_f32(vMax, m);
+			vWeighted = vmlaq_f32(vWeighted, bin, m);
+			vRise = vaddq_f32(vRise, vmaxq_f32(vsubq_f32(m, last), vdupq_n_f32(0.f)));
+			vDB = vaddq_f32(vDB, CASonogramFastDB(vmaxq_f32(m, floor)));
+			bin = vaddq_f32(bin, four);
+		}
+		mBlockPower[block] = vaddvq_f32(vPower);
+#else
+		Float32 blockPower = 0.f;
+		for (UInt32 i = first; i < first + kBlockBins; ++i) {
+			Float32 power = inReal[i] * inReal[i] + inImag[i] * inImag[i];
+			Float32 m = sqrtf(power);
+			Float32 last = previous[i];
+			outMagnitudes[i] = m;
+			previous[i] = m;
+			
+			blockPower += power;
+			bandEnergy[BandOfBin(i)] += power;
+			sumMagnitude += m;
+			lo = std::min(lo, m);
+			hi = std::max(hi, m);
+			sumWeighted += i * m;
+			sumRise += std::max(m - last, 0.f);
+			sumDB += CASonogramFastDB(std::max(m, kFloorMagnitude));
+		}
+		mBlockPower[block] = blockPower;
+#endif
+	}
+	
+#if SONOGRAM_FEATURES_SSE2
+	Float32 lanes[4][4];
+	_mm_storeu_ps(lanes[0], vMagnitude);
+	_mm_storeu_ps(lanes[1], vWeighted);
+	_mm_storeu_ps(lanes[2], vRise);
+	_mm_storeu_ps(lanes[3], vDB);
+	sumMagnitude = (lanes[0][0] + lanes[0][1]) + (lanes[0][2] + lanes[0][3]);
+	sumWeighted = (lanes[1][0] + lanes[1][1]) + (lanes[1][2] + lanes[1][3]);
+	sumRise = (lanes[2][0] + lanes[2][1]) + (lanes[2][2] + lanes[2][3]);
+	sumDB = (lanes[3][0] + lanes[3][1]) + (lanes[3][2] + lanes[3][3]);
+	for (UInt32 band = 0; band < kSonogramFeatureBands; ++band) {
+		_mm_storeu_ps(lanes[0], vBand[band]);
+		bandEnergy[band] += (lanes[0][0] + lanes[0][1]) + (lanes[0][2] + lanes[0][3]);
+	}
+	_mm_storeu_ps(lanes[0], vMin);
+	_mm_storeu_ps(lanes[1], vMax);
+	lo = std::min(std::min(lanes[0][0], lanes[0][1]), std::min(lanes[0][2], lanes[0][3]));
+	hi = std::max(std::max(lanes[1][0], lanes[1][1]), std::max(lanes[1][2], lanes[1][3]));
+#elif SONOGRAM_FEATURES_NEON
+	sumMagnitude = vaddvq_f32(vMagnitude);
+	sumWeighted = vaddvq_f32(vWeighted);
+	sumRise = vaddvq_f32(vRise);
+	sumDB = vaddvq_f32(vDB);
+	for (UInt32 band = 0; band < kSonogramFeatureBands; ++band)
+		bandEnergy[band] += vaddvq_f32(vBand[band]);
+	lo = vminvq_f32(vMin);
+	hi = vmaxvq_f32(vMax);
+#endif
+	outMin = lo;
+	outMax = hi;
+	
+	// the rest only reads the block sums, and the bins of one block
+	Float32 totalPower = 0.f;
+	for (UInt32 block = 0; block < mBlockPower.size(); ++block)
+		totalPower += mBlockPower[block];
+	
+	Float32 rolloff = 0.f;
+	if (totalPower > 0.f) {
+		const Float32 target = kRolloffFraction * totalPower;
+		Float32 below = 0.f;
+		UInt32 block = 0;
+		while (block + 1 < mBlockPower.size() && below + mBlockPower[block] < target)
+			below += mBlockPower[block++];
+		UInt32 i = block * kBlockBins;
+		for (; i + 1 < (block + 1) * kBlockBins; ++i) {
+			below += outMagnitudes[i] * outMagnitudes[i];
+			if (below >= target) break;
+		}
+		rolloff = i * mBinWidth;
+	}
+	
+	const Float32 n = Float32(mNumberBins);
+	outFeatures.mCentroid = (sumMagnitude > 0.f) ? mBinWidth * sumWeighted / sumMagnitude : 0.f;
+	outFeatures.mRolloff = rolloff;
+	outFeatures.mFlux = (sumMagnitude > 0.f) ? sumRise / sumMagnitude : 0.f;
+	// geometric over arithmetic mean power; the dB sums are of magnitudes, so 10 log10 of power
+	outFeatures.mFlatness = (totalPower > 0.f) ? powf(10.f, (sumDB / n - 10.f * log10f(totalPower / n)) / 10.f) : 0.f;
+	if (outFeatures.mFlatness > 1.f) outFeatures.mFlatness = 1.f;
+}
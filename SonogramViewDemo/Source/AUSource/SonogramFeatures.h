@@ -0,0 +1,92 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramFeatures.h
+	
+=============================================================================*/
+
+#ifndef __SonogramFeatures_h__
+#define __SonogramFeatures_h__
+
+#include "CASonogramViewSharedData.h"
+#include <vector>
+
+/*
+	Computes the SonogramFeatures of a slice in the same pass that turns its FFT output
+	into magnitudes, so that the features don't cost a second pass over the spectrum.
+	The bins are taken four at a time with SSE2 (or NEON on 64 bit ARM). Each group of
+	four adds its power to its band, lane by lane only where a band edge splits it, and
+	the power is also summed in blocks of 16 bins, so the rolloff search reads the block
+	sums and then just the bins of one block.
+	
+	Works on the full linear spectrum, before any SonogramBinReducer, so the features
+	don't depend on the display scale. It keeps the previous slice's magnitudes for the
+	flux, so each channel needs its own. Nothing is allocated after construction.
+*/
+
+class SonogramFeatureExtractor {
+public:
+	// fftSize / 2 bins, at least 32, from DC
+	SonogramFeatureExtractor(UInt32 inFFTSize, Float64 inSampleRate);
+	
+	// forget the previous slice, so the next flux is measured from silence
+	void		Clear();
+	
+	// sqrt(re^2 + im^2) of every bin into outMagnitudes, as CARealFFT::Magnitude does,
+	// the smallest and largest of them into outMin and outMax, and the features of
+	// those magnitudes into outFeatures
+	void		Process(const Float32 *inReal, const Float32 *inImag, Float32 *outMagnitudes,
+						Float32 &outMin, Float32 &outMax, SonogramFeatures &outFeatures);
+
+private:
+	enum { kBlockBins = 16, kSplitGroup = 0xFF };
+	
+	UInt32		BandOfBin(UInt32 inBin) const;
+	
+	UInt32					mNumberBins;
+	Float32					mBinWidth;			// Hz
+	UInt32					mBandStart[kSonogramFeatureBands + 1];	// first bin of each band, then mNumberBins
+	std::vector<UInt8>		mGroupBand;			// the band of each group of four bins, or kSplitGroup
+	std::vector<Float32>	mPrevious;			// magnitudes of the last slice
+	std::vector<Float32>	mBlockPower;		// of the current slice
+};
+
+#endif // __SonogramFeatures_h__
@@ -0,0 +1,136 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramPyramid.cpp
+	
+=============================================================================*/
+
+#include "SonogramPyramid.h"
+#include "SonogramQuantizer.h"
+#include <algorithm>
+
+SonogramPyramid::SonogramPyramid(UInt32 inNumLevels, UInt32 inPooling, UInt32 inNumBins, UInt32 inFormat, UInt32 inCapacitySlices) :
+	mPooling(inPooling), mNumberBins(inNumBins), mFormat(inFormat),
+	mBytesPerSlice(SonogramBytesPerSlice(inFormat, inNumBins)),
+	mQuantized(mBytesPerSlice)
+{
+	for (UInt32 i = 0; i < inNumLevels; ++i) {
+		PoolLevel *level = new PoolLevel;
+		level->mRing.Allocate(1, mBytesPerSlice, inCapacitySlices);
+		level->mPool.resize(inNumBins);
+		level->mCount = 0;
+		level->mIndex = 0;
+		mLevels.push_back(level);
+	}
+}
+
+SonogramPyramid::~SonogramPyramid()
+{
+	for (UInt32 i = 0; i < mLevels.size(); ++i)
+		delete mLevels[i];
+}
+
+void	SonogramPyramid::Clear()
+{
+	for (UInt32 i = 0; i < mLevels.size(); ++i)
+		mLevels[i]->mCount = 0;
+}
+
+void	SonogramPyramid::AddSlices(const Float32 *inSlices, UInt32 inNumSlices, SampleTime inFirstSlice)
+{
+	if (mLevels.empty())
+		return;
+	for (UInt32 s = 0; s < inNumSlices; ++s)
+		Add(1, inSlices + s * mNumberBins, inFirstSlice + s);
+}
+
+void	SonogramPyramid::Add(UInt32 inLevel, const Float32 *inSlice, SampleTime inIndex)
+{
+	PoolLevel &level = *mLevels[inLevel - 1];
+	SampleTime index = inIndex >> 1;
+	
+	// the first half of this pair went missing, or the second half of the last one did
+	if (level.mCount && level.mIndex != index)
+		Emit(inLevel);
+	
+	Float32 *pool = &level.mPool[0];
+	if (level.mCount == 0)
+		std::copy(inSlice, inSlice + mNumberBins, pool);
+	else if (mPooling == kSonogramPooling_Max) {
+		for (UInt32 i = 0; i < mNumberBins; ++i)
+			pool[i] = std::max(pool[i], inSlice[i]);
+	} else {
+		for (UInt32 i = 0; i < mNumberBins; ++i)
+			pool[i] += inSlice[i];
+	}
+	++level.mCount;
+	level.mIndex = index;
+	
+	if (inIndex & 1)
+		Emit(inLevel);
+}
+
+void	SonogramPyramid::Emit(UInt32 inLevel)
+{
+	PoolLevel &level = *mLevels[inLevel - 1];
+	Float32 *pool = &level.mPool[0];
+	if (mPooling == kSonogramPooling_Mean && level.mCount > 1) {
+		Float32 scale = 1.f / level.mCount;
+		for (UInt32 i = 0; i < mNumberBins; ++i)
+			pool[i] *= scale;
+	}
+	level.mCount = 0;
+	
+	AudioBufferList abl;
+	abl.mNumberBuffers = 1;
+	abl.mBuffers[0].mNumberChannels = 1;
+	abl.mBuffers[0].mDataByteSize = mBytesPerSlice;
+	abl.mBuffers[0].mData = pool;
+	if (mFormat != kSonogramStorage_Float32) {
+		SonogramQuantizer::Quantize(mFormat, pool, mNumberBins, 1, &mQuantized[0]);
+		abl.mBuffers[0].mData = &mQuantized[0];
+	}
+	level.mRing.Store(&abl, 1, level.mIndex);
+	
+	// the pooled slice is the next level's input; it is only changed again by the next Add here
+	if (inLevel < mLevels.size())
+		Add(inLevel + 1, pool, level.mIndex);
+}
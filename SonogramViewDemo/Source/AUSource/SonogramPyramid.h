@@ -0,0 +1,110 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramPyramid.h
+	
+=============================================================================*/
+
+#ifndef __SonogramPyramid_h__
+#define __SonogramPyramid_h__
+
+#include "CARingBuffer.h"
+#include "CASonogramViewSharedData.h"
+#include <vector>
+
+/*
+	Coarser copies of one channel's spectrum history, for views zoomed out further than a
+	slice per pixel. Level k slice i pools the raw (level 0) slices i << k up to, but not
+	including, (i + 1) << k, by taking either the largest or the mean value of each bin.
+	Level 0 itself is the channel's own ring; the pyramid keeps levels 1 and up.
+	
+	The levels are built as the raw slices arrive: each level pools pairs from the level
+	below, so keeping every level up to date costs no more than the raw slices themselves.
+	A pair with one slice missing (the analysis started on the second, or the channel was
+	switched off in between) is pooled from the one there is.
+	
+	Every level's ring holds as many slices as level 0, so each covers twice the time of
+	the one below, in the same storage format. Nothing is allocated after construction.
+*/
+
+enum {
+	kSonogramPooling_Max	= 0,	// keeps short peaks visible when zoomed out
+	kSonogramPooling_Mean	= 1
+};
+
+class SonogramPyramid {
+public:
+	// inNumLevels levels above level 0
+	SonogramPyramid(UInt32 inNumLevels, UInt32 inPooling, UInt32 inNumBins, UInt32 inFormat, UInt32 inCapacitySlices);
+	~SonogramPyramid();
+	
+	UInt32			NumberLevels() const		{ return mLevels.size(); }
+	
+	// inNumSlices Float32 magnitude slices, numbered in level 0 from inFirstSlice on
+	void			AddSlices(const Float32 *inSlices, UInt32 inNumSlices, SampleTime inFirstSlice);
+	
+	// Drop any half-pooled slices, e.g. when the channel is switched back on.
+	void			Clear();
+	
+	// 1 to NumberLevels()
+	CARingBuffer &	Level(UInt32 inLevel)		{ return mLevels[inLevel - 1]->mRing; }
+
+private:
+	struct PoolLevel {
+		CARingBuffer			mRing;
+		std::vector<Float32>	mPool;
+		UInt32					mCount;			// slices pooled so far
+		SampleTime				mIndex;			// of the slice being pooled, in this level
+	};
+	
+	// adds slice inIndex of level inLevel - 1 to level inLevel
+	void			Add(UInt32 inLevel, const Float32 *inSlice, SampleTime inIndex);
+	void			Emit(UInt32 inLevel);
+	
+	UInt32					mPooling;
+	UInt32					mNumberBins;
+	UInt32					mFormat;
+	UInt32					mBytesPerSlice;
+	std::vector<PoolLevel *>	mLevels;
+	std::vector<Byte>		mQuantized;			// one slice
+};
+
+#endif // __SonogramPyramid_h__
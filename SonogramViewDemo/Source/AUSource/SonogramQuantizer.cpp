@@ -0,0 +1,151 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramQuantizer.cpp
+	
+=============================================================================*/
+
+#include "SonogramQuantizer.h"
+#include "CASonogramFastDB.h"
+#include <string.h>
+
+Float32	SonogramQuantizer::DisplayDB(Float32 inMagnitude)
+{
+	return CASonogramFastDB(1.f + inMagnitude);
+}
+
+#if defined(__SSE2__)
+// steps above the slice minimum, rounded and clamped to [0, inMax]; NaN goes to 0
+static inline __m128i	Steps(const Float32 *inMagnitudes, __m128 inOffset, __m128 inInvScale, __m128 inMax)
+{
+	__m128 db = CASonogramFastDB(_mm_add_ps(_mm_set1_ps(1.f), _mm_loadu_ps(inMagnitudes)));
+	__m128 q = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(db, inOffset), inInvScale), _mm_set1_ps(0.5f));
+	q = _mm_min_ps(_mm_max_ps(q, _mm_setzero_ps()), inMax);
+	return _mm_cvttps_epi32(q);
+}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+static inline uint32x4_t	Steps(const Float32 *inMagnitudes, float32x4_t inOffset, float32x4_t inInvScale, float32x4_t inMax)
+{
+	float32x4_t db = CASonogramFastDB(vaddq_f32(vdupq_n_f32(1.f), vld1q_f32(inMagnitudes)));
+	float32x4_t q = vmlaq_f32(vdupq_n_f32(0.5f), vsubq_f32(db, inOffset), inInvScale);
+	// vmaxq returns NaN for NaN; the conversion turns that into 0
+	q = vminq_f32(vmaxq_f32(q, vdupq_n_f32(0.f)), inMax);
+	return vcvtq_u32_f32(q);
+}
+#endif
+
+static inline UInt32	ScalarSteps(Float32 inMagnitude, Float32 inOffset, Float32 inInvScale, Float32 inMax)
+{
+	Float32 q = (CASonogramFastDB(1.f + inMagnitude) - inOffset) * inInvScale + 0.5f;
+	if (!(q > 0.f)) q = 0.f;
+	if (q > inMax) q = inMax;
+	return UInt32(q);
+}
+
+void	SonogramQuantizer::Quantize(UInt32 inFormat, const Float32 *inMagnitudes, UInt32 inNumBins, UInt32 inNumSlices,
+									void *outSlices)
+{
+	const UInt32 bytesPerSlice = SonogramBytesPerSlice(inFormat, inNumBins);
+	if (inFormat != kSonogramStorage_UInt8 && inFormat != kSonogramStorage_UInt16) {
+		memcpy(outSlices, inMagnitudes, inNumSlices * bytesPerSlice);
+		return;
+	}
+	
+	const Float32 maxSteps = (inFormat == kSonogramStorage_UInt8) ? 255.f : 65535.f;
+	for (UInt32 s = 0; s < inNumSlices; ++s) {
+		const Float32 *mag = inMagnitudes + s * inNumBins;
+		Byte *slice = (Byte *)outSlices + s * bytesPerSlice;
+		
+		// dB rises with magnitude, so the range comes from the extreme magnitudes
+		Float32 minMag = mag[0], maxMag = mag[0];
+		for (UInt32 i = 1; i < inNumBins; ++i) {
+			if (mag[i] < minMag) minMag = mag[i];
+			if (mag[i] > maxMag) maxMag = mag[i];
+		}
+		Float32 minDB = CASonogramFastDB(1.f + minMag);
+		Float32 maxDB = CASonogramFastDB(1.f + maxMag);
+		
+		SonogramSliceHeader header;
+		header.mOffset = minDB;
+		header.mScale = (maxDB - minDB) / maxSteps;
+		const Float32 invScale = (header.mScale > 0.f) ? 1.f / header.mScale : 0.f;
+		memcpy(slice, &header, sizeof(header));
+		
+		UInt32 i = 0;
+		if (inFormat == kSonogramStorage_UInt8) {
+			UInt8 *q = (UInt8 *)(slice + sizeof(header));
+#if defined(__SSE2__)
+			__m128 offset = _mm_set1_ps(minDB), inv = _mm_set1_ps(invScale), top = _mm_set1_ps(maxSteps);
+			for (; i + 16 <= inNumBins; i += 16) {
+				__m128i a = _mm_packs_epi32(Steps(mag + i, offset, inv, top), Steps(mag + i + 4, offset, inv, top));
+				__m128i b = _mm_packs_epi32(Steps(mag + i + 8, offset, inv, top), Steps(mag + i + 12, offset, inv, top));
+				_mm_storeu_si128((__m128i *)(q + i), _mm_packus_epi16(a, b));
+			}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+			float32x4_t offset = vdupq_n_f32(minDB), inv = vdupq_n_f32(invScale), top = vdupq_n_f32(maxSteps);
+			for (; i + 8 <= inNumBins; i += 8) {
+				uint16x8_t w = vcombine_u16(vmovn_u32(Steps(mag + i, offset, inv, top)), vmovn_u32(Steps(mag + i + 4, offset, inv, top)));
+				vst1_u8(q + i, vmovn_u16(w));
+			}
+#endif
+			for (; i < inNumBins; ++i)
+				q[i] = UInt8(ScalarSteps(mag[i], minDB, invScale, maxSteps));
+		} else {
+			UInt16 *q = (UInt16 *)(slice + sizeof(header));
+#if defined(__SSE2__)
+			// packs saturates signed, so go through the signed range and flip the top bit back
+			__m128 offset = _mm_set1_ps(minDB), inv = _mm_set1_ps(invScale), top = _mm_set1_ps(maxSteps);
+			const __m128i bias = _mm_set1_epi32(32768);
+			for (; i + 8 <= inNumBins; i += 8) {
+				__m128i a = _mm_sub_epi32(Steps(mag + i, offset, inv, top), bias);
+				__m128i b = _mm_sub_epi32(Steps(mag + i + 4, offset, inv, top), bias);
+				_mm_storeu_si128((__m128i *)(q + i), _mm_xor_si128(_mm_packs_epi32(a, b), _mm_set1_epi16(SInt16(0x8000))));
+			}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+			float32x4_t offset = vdupq_n_f32(minDB), inv = vdupq_n_f32(invScale), top = vdupq_n_f32(maxSteps);
+			for (; i + 8 <= inNumBins; i += 8)
+				vst1q_u16(q + i, vcombine_u16(vmovn_u32(Steps(mag + i, offset, inv, top)), vmovn_u32(Steps(mag + i + 4, offset, inv, top))));
+#endif
+			for (; i < inNumBins; ++i)
+				q[i] = UInt16(ScalarSteps(mag[i], minDB, invScale, maxSteps));
+		}
+	}
+}
@@ -0,0 +1,80 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramRangeTracker.cpp
+	
+=============================================================================*/
+
+#include "SonogramRangeTracker.h"
+#include <math.h>
+
+SonogramRangeTracker::SonogramRangeTracker()
+	: mAttack(1.f), mDecay(1.f), mPeak(0.f), mFloor(0.f), mEmpty(true)
+{
+}
+
+Float32	SonogramRangeTracker::Coefficient(Float32 inTime, Float64 inSlicesPerSecond)
+{
+	if (!(inTime * inSlicesPerSecond > 0.))
+		return 1.f;
+	return Float32(1. - exp(-1. / (inTime * inSlicesPerSecond)));
+}
+
+void	SonogramRangeTracker::SetTimes(Float32 inAttackTime, Float32 inDecayTime, Float64 inSlicesPerSecond)
+{
+	mAttack = Coefficient(inAttackTime, inSlicesPerSecond);
+	mDecay = Coefficient(inDecayTime, inSlicesPerSecond);
+}
+
+void	SonogramRangeTracker::AddSlice(Float32 inMin, Float32 inMax)
+{
+	if (mEmpty) {
+		mPeak = inMax;
+		mFloor = inMin;
+		mEmpty = false;
+		return;
+	}
+	Float32 peak = mPeak, floor = mFloor;
+	peak += ((inMax > peak) ? mAttack : mDecay) * (inMax - peak);
+	floor += ((inMin < floor) ? mAttack : mDecay) * (inMin - floor);
+	mPeak = peak;
+	mFloor = floor;
+}
@@ -0,0 +1,91 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramRangeTracker.h
+	
+=============================================================================*/
+
+#ifndef __SonogramRangeTracker_h__
+#define __SonogramRangeTracker_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+/*
+	Running estimates of the loudest and quietest magnitude of a channel's slices, for
+	a display range that moves smoothly instead of jumping with every slice. The peak
+	follows a louder slice at the attack rate and falls back at the decay rate; the
+	floor does the same the other way up. Both are one-pole filters on the magnitudes,
+	updated once per slice.
+	
+	The times may be changed from another thread while slices are being added; the new
+	rates take effect from the next slice.
+*/
+
+class SonogramRangeTracker {
+public:
+	SonogramRangeTracker();
+	
+	// times in seconds to get about two thirds of the way to a new level; 0 is at once
+	void		SetTimes(Float32 inAttackTime, Float32 inDecayTime, Float64 inSlicesPerSecond);
+	
+	// the next slice sets the range outright
+	void		Reset()						{ mEmpty = true; }
+	
+	void		AddSlice(Float32 inMin, Float32 inMax);
+	
+	Float32		Peak() const				{ return mPeak; }
+	Float32		Floor() const				{ return mFloor; }
+
+private:
+	static Float32	Coefficient(Float32 inTime, Float64 inSlicesPerSecond);
+	
+	volatile Float32	mAttack;		// per slice
+	volatile Float32	mDecay;
+	volatile Float32	mPeak;
+	volatile Float32	mFloor;
+	bool				mEmpty;
+};
+
+#endif // __SonogramRangeTracker_h__
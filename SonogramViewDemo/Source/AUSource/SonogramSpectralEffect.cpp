@@ -0,0 +1,124 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramSpectralEffect.cpp
+	
+=============================================================================*/
+
+#include "SonogramSpectralEffect.h"
+#include <math.h>
+#include <algorithm>
+
+static const Float64 kFloorRiseTime = 4.;		// seconds
+static const Float64 kFloorFallTime = 0.05;
+static const Float64 kGateReleaseTime = 0.08;
+
+static Float32	Coefficient(Float64 inTime, Float64 inFramesPerSecond)
+{
+	return Float32(1. - exp(-1. / std::max(inTime * inFramesPerSecond, 1.)));
+}
+
+SonogramSpectralEffect::SonogramSpectralEffect(UInt32 inFFTSize, Float64 inFramesPerSecond, const SonogramEffectSettings *inSettings)
+	: mNumberBins(inFFTSize / 2), mSettings(inSettings),
+	  mFloorRise(Coefficient(kFloorRiseTime, inFramesPerSecond)),
+	  mFloorFall(Coefficient(kFloorFallTime, inFramesPerSecond)),
+	  mGateRelease(Coefficient(kGateReleaseTime, inFramesPerSecond)),
+	  mEmpty(true),
+	  mGateOpen(true),
+	  mFloor(inFFTSize / 2),
+	  mGain(inFFTSize / 2 + 1, 1.f)
+{
+}
+
+void	SonogramSpectralEffect::Clear()
+{
+	mEmpty = true;
+	mGateOpen = true;
+	std::fill(mGain.begin(), mGain.end(), 1.f);
+}
+
+void	SonogramSpectralEffect::Process(Float32 *ioReal, Float32 *ioImag, const Float32 *inMagnitudes)
+{
+	const SonogramEffectSettings &settings = *mSettings;
+	const UInt32 n = mNumberBins;
+	
+	if (mEmpty) {
+		std::copy(inMagnitudes, inMagnitudes + n, mFloor.begin());
+		mEmpty = false;
+	}
+	
+	// the floors are tracked with the gate off too, so turning it on needn't wait for them
+	const Float32 rise = mFloorRise, fall = mFloorFall;
+	Float32 *floor = &mFloor[0];
+	for (UInt32 i = 0; i < n; ++i) {
+		Float32 m = inMagnitudes[i];
+		floor[i] += ((m < floor[i]) ? fall : rise) * (m - floor[i]);
+	}
+	
+	Float32 *gain = &mGain[0];
+	if (settings.mGateFloor < 1.f) {
+		const Float32 threshold = settings.mGateThreshold, closed = settings.mGateFloor, release = mGateRelease;
+		for (UInt32 i = 0; i < n; ++i) {
+			Float32 target = (inMagnitudes[i] > threshold * floor[i]) ? 1.f : closed;
+			gain[i] = (target > gain[i]) ? target : gain[i] + release * (target - gain[i]);
+		}
+		gain[n] = gain[n - 1];		// Nyquist has no magnitude of its own
+		mGateOpen = false;
+	} else if (!mGateOpen) {
+		// the gate was just turned off
+		std::fill(mGain.begin(), mGain.end(), 1.f);
+		mGateOpen = true;
+	}
+	
+	if (settings.mEQGains) {
+		const Float32 *eq = settings.mEQGains;
+		for (UInt32 i = 0; i <= n; ++i) {
+			Float32 g = gain[i] * eq[i];
+			ioReal[i] *= g;
+			ioImag[i] *= g;
+		}
+	} else if (settings.mGateFloor < 1.f) {
+		for (UInt32 i = 0; i <= n; ++i) {
+			ioReal[i] *= gain[i];
+			ioImag[i] *= gain[i];
+		}
+	}
+}
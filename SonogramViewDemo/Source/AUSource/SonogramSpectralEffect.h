@@ -0,0 +1,103 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramSpectralEffect.h
+	
+=============================================================================*/
+
+#ifndef __SonogramSpectralEffect_h__
+#define __SonogramSpectralEffect_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+#include <vector>
+
+/*
+	The bin-domain half of the sonogram's spectral effect: given one frame's FFT, as
+	SonogramAnalyzer has it for the display, it scales every bin by an EQ gain and a
+	noise gate gain. The analyzer then resynthesizes the frame.
+	
+	The gate keeps a running estimate of each bin's noise floor, which follows a quieter
+	frame within about kFloorFallTime and a louder one only over kFloorRiseTime, so steady
+	noise sets it and music doesn't. A bin more than the threshold above its floor passes;
+	the others are turned down to the floor gain. A bin's gain opens at once and closes
+	over about kGateReleaseTime, which keeps isolated bins from twittering.
+	
+	The settings are read at every frame and may be shared by every channel's effect;
+	the owner changes them between frames. Each channel needs its own effect, for its
+	floors and gains. Nothing is allocated after construction.
+*/
+
+struct SonogramEffectSettings
+{
+	Float32				mGateThreshold;		// linear magnitude ratio over the floor
+	Float32				mGateFloor;			// linear gain of gated bins; 1 turns the gate off
+	const Float32 *		mEQGains;			// linear, fftSize / 2 + 1 of them, or NULL for none
+};
+
+class SonogramSpectralEffect {
+public:
+	SonogramSpectralEffect(UInt32 inFFTSize, Float64 inFramesPerSecond, const SonogramEffectSettings *inSettings);
+	
+	// forget the floors, so the gate learns them over again
+	void		Clear();
+	
+	// fftSize / 2 + 1 bins of ioReal and ioImag, DC to Nyquist, and the magnitudes of the
+	// first fftSize / 2 of them
+	void		Process(Float32 *ioReal, Float32 *ioImag, const Float32 *inMagnitudes);
+
+private:
+	UInt32							mNumberBins;		// fftSize / 2
+	const SonogramEffectSettings *	mSettings;
+	Float32							mFloorRise;			// per frame
+	Float32							mFloorFall;
+	Float32							mGateRelease;
+	bool							mEmpty;				// no floors yet
+	bool							mGateOpen;			// every mGain is 1
+	std::vector<Float32>			mFloor;
+	std::vector<Float32>			mGain;				// of the gate
+};
+
+#endif // __SonogramSpectralEffect_h__
@@ -0,0 +1,158 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramThreadPool.cpp
+	
+=============================================================================*/
+
+#include "SonogramThreadPool.h"
+#include <unistd.h>
+
+#if defined(__APPLE__)
+	#include <libkern/OSAtomic.h>
+	#define PoolIncrement(address)		OSAtomicIncrement32Barrier(address)
+	#define PoolMemoryBarrier()			OSMemoryBarrier()
+#else
+	#define PoolIncrement(address)		__sync_add_and_fetch(address, 1)
+	#define PoolMemoryBarrier()			__sync_synchronize()
+#endif
+
+SonogramThreadPool::SonogramThreadPool() :
+	mNumberThreads(0), mProc(NULL), mRefCon(NULL), mCheckedIn(0)
+{
+	for (UInt32 i = 0; i <= kMaxThreads; ++i)
+		mRanges[i].mNext = mRanges[i].mEnd = 0;
+	pthread_mutex_init(&mMutex, NULL);
+	pthread_cond_init(&mDone, NULL);
+}
+
+SonogramThreadPool::~SonogramThreadPool()
+{
+	Stop();
+	pthread_cond_destroy(&mDone);
+	pthread_mutex_destroy(&mMutex);
+}
+
+UInt32	SonogramThreadPool::NumberProcessors()
+{
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return (n > 0) ? UInt32(n) : 1;
+}
+
+void	SonogramThreadPool::Start(UInt32 inNumThreads)
+{
+	Stop();
+	
+	if (inNumThreads > kMaxThreads)
+		inNumThreads = kMaxThreads;
+	for (UInt32 i = 0; i < inNumThreads; ++i) {
+		Thread *thread = new Thread;
+		thread->mPool = this;
+		thread->mIndex = i + 1;
+		if (!thread->mWorker.Start(ThreadProc, thread)) {
+			delete thread;
+			break;
+		}
+		mThreads[mNumberThreads++] = thread;
+	}
+}
+
+void	SonogramThreadPool::Stop()
+{
+	for (UInt32 i = 0; i < mNumberThreads; ++i)
+		delete mThreads[i];		// stops the thread
+	mNumberThreads = 0;
+}
+
+void	SonogramThreadPool::Run(TaskProc inProc, void *inRefCon, UInt32 inNumTasks)
+{
+	UInt32 nParticipants = mNumberThreads + 1;
+	
+	mProc = inProc;
+	mRefCon = inRefCon;
+	for (UInt32 i = 0; i < nParticipants; ++i) {
+		mRanges[i].mNext = SInt32(UInt64(inNumTasks) * i / nParticipants);
+		mRanges[i].mEnd = SInt32(UInt64(inNumTasks) * (i + 1) / nParticipants);
+	}
+	mCheckedIn = 0;
+	PoolMemoryBarrier();
+	
+	for (UInt32 i = 0; i < mNumberThreads; ++i)
+		mThreads[i]->mWorker.Wake();
+	
+	Participate(0);
+	
+	// Every thread checks in once per batch, which also means no wake is left over to
+	// start one of them on the next batch before its ranges are set up.
+	pthread_mutex_lock(&mMutex);
+	while (mCheckedIn < mNumberThreads)
+		pthread_cond_wait(&mDone, &mMutex);
+	pthread_mutex_unlock(&mMutex);
+}
+
+void	SonogramThreadPool::ThreadProc(void *inThread)
+{
+	Thread *thread = static_cast<Thread *>(inThread);
+	SonogramThreadPool *pool = thread->mPool;
+	
+	pool->Participate(thread->mIndex);
+	
+	pthread_mutex_lock(&pool->mMutex);
+	if (++pool->mCheckedIn == pool->mNumberThreads)
+		pthread_cond_signal(&pool->mDone);
+	pthread_mutex_unlock(&pool->mMutex);
+}
+
+void	SonogramThreadPool::Participate(UInt32 inIndex)
+{
+	UInt32 nParticipants = mNumberThreads + 1;
+	
+	// our own range first, then steal from the others
+	for (UInt32 k = 0; k < nParticipants; ++k) {
+		Range &range = mRanges[(inIndex + k) % nParticipants];
+		for (;;) {
+			SInt32 task = PoolIncrement(&range.mNext) - 1;
+			if (task >= range.mEnd)
+				break;
+			(mProc)(mRefCon, UInt32(task));
+		}
+	}
+}
@@ -0,0 +1,111 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramThreadPool.h
+	
+=============================================================================*/
+
+#ifndef __SonogramThreadPool_h__
+#define __SonogramThreadPool_h__
+
+#include "SonogramAnalysisWorker.h"
+#include <vector>
+
+/*
+	A fork/join pool for running the same proc over a set of independent tasks, e.g. one
+	per channel. Run splits the task indices into one range per thread (the calling thread
+	counts as one) and wakes the pool; each thread works through its own range and then
+	steals from the others, so a thread that gets the expensive channels, or is scheduled
+	late, doesn't hold up the batch. Run returns when every task is done.
+	
+	Run must only be called from one thread at a time, and not from the render thread:
+	it waits for the pool.
+*/
+
+class SonogramThreadPool {
+public:
+	typedef void (*TaskProc)(void *inRefCon, UInt32 inTask);
+	
+	enum { kMaxThreads = 16 };
+	
+	SonogramThreadPool();
+	~SonogramThreadPool();
+	
+	// Starts inNumThreads threads besides the caller of Run, at most kMaxThreads.
+	void		Start(UInt32 inNumThreads);
+	void		Stop();
+	UInt32		NumberThreads() const		{ return mNumberThreads; }
+	
+	void		Run(TaskProc inProc, void *inRefCon, UInt32 inNumTasks);
+	
+	// processors available to the process, for sizing the pool
+	static UInt32	NumberProcessors();
+
+private:
+	struct Thread {
+		SonogramThreadPool *	mPool;
+		UInt32					mIndex;
+		SonogramAnalysisWorker	mWorker;
+	};
+	
+	// one per participant, on its own cache line
+	struct Range {
+		volatile SInt32		mNext;
+		SInt32				mEnd;
+		char				mPad[64 - 2 * sizeof(SInt32)];
+	};
+	
+	static void		ThreadProc(void *inThread);
+	void			Participate(UInt32 inIndex);
+	
+	UInt32					mNumberThreads;
+	Thread *				mThreads[kMaxThreads];
+	Range					mRanges[kMaxThreads + 1];	// [0] belongs to the caller of Run
+	
+	TaskProc				mProc;
+	void *					mRefCon;
+	
+	pthread_mutex_t			mMutex;
+	pthread_cond_t			mDone;
+	UInt32					mCheckedIn;				// threads finished with the current batch
+};
+
+#endif // __SonogramThreadPool_h__
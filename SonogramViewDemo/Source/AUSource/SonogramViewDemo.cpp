@@ -39,6 +39,8 @@
 			POSSIBILITY OF SUCH DAMAGE.
 */
 #include "SonogramViewDemo.h"
+#include <libkern/OSAtomic.h>
+#include <algorithm>
 
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -48,28 +50,59 @@ COMPONENT_ENTRY(SonogramViewDemo)
 
 void SonogramViewDemo::Cleanup()
 {
+	// the worker, and the pool under it, may be using the analysis
+	mWorker.Stop();
+	mPool.Stop();
 	
-	mSpectralProcessor.free();
-	if (mSpectrumBuffer) delete(mSpectrumBuffer);
-	if (mFetchingBufferList) delete(mFetchingBufferList);
-	if (mSpectralDataBufferList) delete(mSpectralDataBufferList);
+	CAMutex::Locker lock(mAnalysisLock);
+	
+	CollectRetiredAnalyses();
+	delete mPendingAnalysis;
+	delete mAnalysis;
+	for (UInt32 i = 0; i < mInputBuffers.size(); ++i)
+		delete mInputBuffers[i];
 
 	
-	mSpectrumBuffer = NULL;
-	mFetchingBufferList = NULL;
-	mSpectralDataBufferList = NULL;
+	mAnalysis = NULL;
+	mPendingAnalysis = NULL;
+	mInputBuffers.clear();
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	SonogramViewDemo::SonogramViewDemo
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 SonogramViewDemo::SonogramViewDemo(AudioUnit component)
-	: AUEffectBase(component, true)
+	: AUEffectBase(component, true), mAnalysisLock("SonogramViewDemo analysis")
 {	
+	CreateElements();
+	Globals()->UseIndexedParameters(kNumberOfParameters);
+	Globals()->SetParameter(kSonogramParam_FFTSize, kDefaultValue_FFTSize);
+	Globals()->SetParameter(kSonogramParam_Overlap, kDefaultValue_Overlap);
+	Globals()->SetParameter(kSonogramParam_Window, kDefaultValue_Window);
+	Globals()->SetParameter(kSonogramParam_Scale, kDefaultValue_Scale);
+	Globals()->SetParameter(kSonogramParam_Bands, kDefaultValue_Bands);
+	Globals()->SetParameter(kSonogramParam_Effect, kDefaultValue_Effect);
+	Globals()->SetParameter(kSonogramParam_GateThreshold, kDefaultValue_GateThreshold);
+	Globals()->SetParameter(kSonogramParam_GateDepth, kDefaultValue_GateDepth);
+	
+	mAnalysis = NULL;
+	mPendingAnalysis = NULL;
+	mRetiredAnalysis[0] = mRetiredAnalysis[1] = NULL;
+	memset(&mParameters, 0, sizeof(mParameters));
 	
-	mSpectrumBuffer = NULL;
-	mFetchingBufferList = NULL;
-	mSpectralDataBufferList = NULL;
+	for (UInt32 i = 0; i < kMaxChannelMaskWords; ++i)
+		mChannelMask[i] = 0xFFFFFFFF;
+	
+	mStorageFormat = kSonogramStorage_Float32;
+	mPyramidSettings.mNumberLevels = 0;
+	mPyramidSettings.mPooling = kSonogramPooling_Max;
+	mRangeSmoothing.mAttackTime = kDefaultRangeAttackTime;
+	mRangeSmoothing.mDecayTime = kDefaultRangeDecayTime;
+	memset(&mEQCurve, 0, sizeof(mEQCurve));
+	mEQGeneration = 0;
+	mAsyncAnalysis = false;
+	mInputFrames = mAnalyzedFrames = 0;
+	mQueuedFrames = 0;
 }
 
 SonogramViewDemo::~SonogramViewDemo()
@@ -88,6 +121,14 @@ ComponentResult		SonogramViewDemo::Initialize()
 	if(result == noErr )
 	{
 		AllocateBuffers();
+		if (mAsyncAnalysis) {
+			// the worker thread takes a share of the channels too
+			UInt32 participants = std::min(UInt32(GetNumberOfChannels()), SonogramThreadPool::NumberProcessors());
+			if (participants > 1)
+				mPool.Start(participants - 1);
+			if (!mWorker.Start(AnalyzeInputProc, this))
+				result = kAudioUnitErr_FailedInitialization;
+		}
 	}
 	
 	return result;
@@ -100,7 +141,61 @@ ComponentResult		SonogramViewDemo::GetParameterValueStrings(AudioUnitScope		inSc
                                                                 AudioUnitParameterID	inParameterID,
                                                                 CFArrayRef *		outStrings)
 {
-        
+	if (inScope != kAudioUnitScope_Global)
+		return kAudioUnitErr_InvalidProperty;
+	
+	switch (inParameterID) {
+		case kSonogramParam_FFTSize:
+		{
+			if (outStrings == NULL) return noErr;
+			CFStringRef strings[kNumberFFTSizes];
+			for (UInt32 i = 0; i < kNumberFFTSizes; ++i)
+				strings[i] = CFStringCreateWithFormat(NULL, NULL, CFSTR("%u"), (unsigned)(kMinFFTSize << i));
+			*outStrings = CFArrayCreate(NULL, (const void **)strings, kNumberFFTSizes, &kCFTypeArrayCallBacks);
+			for (UInt32 i = 0; i < kNumberFFTSizes; ++i)
+				CFRelease(strings[i]);
+			return noErr;
+		}
+		case kSonogramParam_Overlap:
+		{
+			if (outStrings == NULL) return noErr;
+			CFStringRef strings[kNumberOverlaps] = { CFSTR("None"), CFSTR("50%"), CFSTR("75%"), CFSTR("87.5%") };
+			*outStrings = CFArrayCreate(NULL, (const void **)strings, kNumberOverlaps, NULL);
+			return noErr;
+		}
+		case kSonogramParam_Window:
+		{
+			if (outStrings == NULL) return noErr;
+			CFStringRef strings[kNumberWindows] = { CFSTR("Hann"), CFSTR("Blackman-Harris"), CFSTR("Kaiser") };
+			*outStrings = CFArrayCreate(NULL, (const void **)strings, kNumberWindows, NULL);
+			return noErr;
+		}
+		case kSonogramParam_Scale:
+		{
+			if (outStrings == NULL) return noErr;
+			CFStringRef strings[kNumberScales] = { CFSTR("Linear"), CFSTR("Log"), CFSTR("Mel"), CFSTR("Constant-Q") };
+			*outStrings = CFArrayCreate(NULL, (const void **)strings, kNumberScales, NULL);
+			return noErr;
+		}
+		case kSonogramParam_Bands:
+		{
+			if (outStrings == NULL) return noErr;
+			CFStringRef strings[kNumberBandCounts];
+			for (UInt32 i = 0; i < kNumberBandCounts; ++i)
+				strings[i] = CFStringCreateWithFormat(NULL, NULL, CFSTR("%u"), (unsigned)(kMinBands << i));
+			*outStrings = CFArrayCreate(NULL, (const void **)strings, kNumberBandCounts, &kCFTypeArrayCallBacks);
+			for (UInt32 i = 0; i < kNumberBandCounts; ++i)
+				CFRelease(strings[i]);
+			return noErr;
+		}
+		case kSonogramParam_Effect:
+		{
+			if (outStrings == NULL) return noErr;
+			CFStringRef strings[2] = { CFSTR("Off"), CFSTR("On") };
+			*outStrings = CFArrayCreate(NULL, (const void **)strings, 2, NULL);
+			return noErr;
+		}
+	}
     return kAudioUnitErr_InvalidProperty;
 }
 
@@ -121,6 +216,75 @@ ComponentResult		SonogramViewDemo::GetParameterInfo(AudioUnitScope		inScope,
     if (inScope == kAudioUnitScope_Global) {
         switch(inParameterID)
         {
+			case kSonogramParam_FFTSize:
+				AUBase::FillInParameterName (outParameterInfo, kParameterFFTSizeName, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Indexed;
+				outParameterInfo.minValue = 0;
+				outParameterInfo.maxValue = kNumberFFTSizes - 1;
+				outParameterInfo.defaultValue = kDefaultValue_FFTSize;
+				outParameterInfo.flags |= kAudioUnitParameterFlag_NonRealTime;
+				break;
+			
+			case kSonogramParam_Overlap:
+				AUBase::FillInParameterName (outParameterInfo, kParameterOverlapName, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Indexed;
+				outParameterInfo.minValue = 0;
+				outParameterInfo.maxValue = kNumberOverlaps - 1;
+				outParameterInfo.defaultValue = kDefaultValue_Overlap;
+				outParameterInfo.flags |= kAudioUnitParameterFlag_NonRealTime;
+				break;
+			
+			case kSonogramParam_Window:
+				AUBase::FillInParameterName (outParameterInfo, kParameterWindowName, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Indexed;
+				outParameterInfo.minValue = 0;
+				outParameterInfo.maxValue = kNumberWindows - 1;
+				outParameterInfo.defaultValue = kDefaultValue_Window;
+				outParameterInfo.flags |= kAudioUnitParameterFlag_NonRealTime;
+				break;
+			
+			case kSonogramParam_Scale:
+				AUBase::FillInParameterName (outParameterInfo, kParameterScaleName, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Indexed;
+				outParameterInfo.minValue = 0;
+				outParameterInfo.maxValue = kNumberScales - 1;
+				outParameterInfo.defaultValue = kDefaultValue_Scale;
+				outParameterInfo.flags |= kAudioUnitParameterFlag_NonRealTime;
+				break;
+			
+			case kSonogramParam_Bands:
+				AUBase::FillInParameterName (outParameterInfo, kParameterBandsName, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Indexed;
+				outParameterInfo.minValue = 0;
+				outParameterInfo.maxValue = kNumberBandCounts - 1;
+				outParameterInfo.defaultValue = kDefaultValue_Bands;
+				outParameterInfo.flags |= kAudioUnitParameterFlag_NonRealTime;
+				break;
+			
+			case kSonogramParam_Effect:
+				AUBase::FillInParameterName (outParameterInfo, kParameterEffectName, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Indexed;
+				outParameterInfo.minValue = 0;
+				outParameterInfo.maxValue = 1;
+				outParameterInfo.defaultValue = kDefaultValue_Effect;
+				outParameterInfo.flags |= kAudioUnitParameterFlag_NonRealTime;
+				break;
+			
+			case kSonogramParam_GateThreshold:
+				AUBase::FillInParameterName (outParameterInfo, kParameterGateThresholdName, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Decibels;
+				outParameterInfo.minValue = 0;
+				outParameterInfo.maxValue = kMaxGateThreshold;
+				outParameterInfo.defaultValue = kDefaultValue_GateThreshold;
+				break;
+			
+			case kSonogramParam_GateDepth:
+				AUBase::FillInParameterName (outParameterInfo, kParameterGateDepthName, false);
+				outParameterInfo.unit = kAudioUnitParameterUnit_Decibels;
+				outParameterInfo.minValue = 0;
+				outParameterInfo.maxValue = kMaxGateDepth;
+				outParameterInfo.defaultValue = kDefaultValue_GateDepth;
+				break;
 			
             default:
                 result = kAudioUnitErr_InvalidParameter;
@@ -132,6 +296,32 @@ ComponentResult		SonogramViewDemo::GetParameterInfo(AudioUnitScope		inScope,
 	return result;
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	SonogramViewDemo::SetParameter
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ComponentResult		SonogramViewDemo::SetParameter(	AudioUnitParameterID	inID,
+													AudioUnitScope			inScope,
+													AudioUnitElement		inElement,
+													Float32					inValue,
+													UInt32					inBufferOffsetInFrames)
+{
+	ComponentResult result = AUEffectBase::SetParameter(inID, inScope, inElement, inValue, inBufferOffsetInFrames);
+	
+	// the gate's are read at every block; the others shape the analysis, and before
+	// Initialize, AllocateBuffers picks them up
+	if (result == noErr && inScope == kAudioUnitScope_Global && IsInitialized()
+			&& inID != kSonogramParam_GateThreshold && inID != kSonogramParam_GateDepth) {
+		Float64 latency = EffectLatency();
+		QueueAnalysis();
+		if (EffectLatency() != latency) {
+			PropertyChanged(kAudioUnitProperty_Latency, kAudioUnitScope_Global, 0);
+			PropertyChanged(kAudioUnitProperty_TailTime, kAudioUnitScope_Global, 0);
+		}
+	}
+	
+	return result;
+}
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //	SonogramViewDemo::GetPropertyInfo
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -157,6 +347,47 @@ ComponentResult		SonogramViewDemo::GetPropertyInfo (AudioUnitPropertyID	inID,
 				outWritable = true;
 				outDataSize = sizeof(SonogramOverview);
 				return noErr;
+			
+			case kAudioUnitProperty_SonogramAsyncAnalysis:
+				outWritable = true;
+				outDataSize = sizeof(UInt32);
+				return noErr;
+			
+			case kAudioUnitProperty_SonogramChannelMask:
+				outWritable = true;
+				outDataSize = sizeof(mChannelMask);
+				return noErr;
+			
+			case kAudioUnitProperty_SonogramStorageFormat:
+				outWritable = true;
+				outDataSize = sizeof(UInt32);
+				return noErr;
+			
+			case kAudioUnitProperty_SonogramPyramid:
+				outWritable = true;
+				outDataSize = sizeof(SonogramPyramidSettings);
+				return noErr;
+			
+			case kAudioUnitProperty_SonogramFeatures:
+				outWritable = true;
+				outDataSize = sizeof(SonogramFeatureHistory);
+				return noErr;
+			
+			case kAudioUnitProperty_SonogramRangeSmoothing:
+				outWritable = true;
+				outDataSize = sizeof(SonogramRangeSmoothing);
+				return noErr;
+			
+			case kAudioUnitProperty_SonogramSubscribe:
+			case kAudioUnitProperty_SonogramUnsubscribe:
+				outWritable = true;
+				outDataSize = sizeof(CAAnalysisMailbox *);
+				return noErr;
+			
+			case kAudioUnitProperty_SonogramEQCurve:
+				outWritable = true;
+				outDataSize = sizeof(SonogramEQCurve);
+				return noErr;
 					
 		}
 	}
@@ -201,60 +432,565 @@ if (inScope == kAudioUnitScope_Global) {
 			return GetSonogramOverview(overview);
 		}
 		
+		case kAudioUnitProperty_SonogramFeatures:
+		{
+			SonogramFeatureHistory *history = (SonogramFeatureHistory*)outData;
+			return GetSonogramFeatures(history);
+		}
+		
 		case kAudioUnitProperty_SampleTimeStamp:
 		{
 			*(static_cast<Float64*>(outData)) = mRenderStamp.mSampleTime;		
 			return noErr;
 		}
+		
+		case kAudioUnitProperty_SonogramAsyncAnalysis:
+		{
+			*(static_cast<UInt32*>(outData)) = mAsyncAnalysis;
+			return noErr;
+		}
+		
+		case kAudioUnitProperty_SonogramChannelMask:
+		{
+			UInt32 *mask = static_cast<UInt32*>(outData);
+			for (UInt32 i = 0; i < kMaxChannelMaskWords; ++i)
+				mask[i] = mChannelMask[i];
+			return noErr;
+		}
+		
+		case kAudioUnitProperty_SonogramStorageFormat:
+		{
+			*(static_cast<UInt32*>(outData)) = mStorageFormat;
+			return noErr;
+		}
+		
+		case kAudioUnitProperty_SonogramPyramid:
+		{
+			*(static_cast<SonogramPyramidSettings*>(outData)) = mPyramidSettings;
+			return noErr;
+		}
+		
+		case kAudioUnitProperty_SonogramRangeSmoothing:
+		{
+			CAMutex::Locker lock(mAnalysisLock);
+			*(static_cast<SonogramRangeSmoothing*>(outData)) = mRangeSmoothing;
+			return noErr;
+		}
+		
+		case kAudioUnitProperty_SonogramEQCurve:
+		{
+			CAMutex::Locker lock(mAnalysisLock);
+			*(static_cast<SonogramEQCurve*>(outData)) = mEQCurve;
+			return noErr;
+		}
 	  }
 	}
 
 	return AUEffectBase::GetProperty (inID, inScope, inElement, outData);
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//	SonogramViewDemo::SetProperty
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ComponentResult		SonogramViewDemo::SetProperty(		AudioUnitPropertyID inID,
+                                                        AudioUnitScope 		inScope,
+                                                        AudioUnitElement 	inElement,
+                                                        const void *		inData,
+                                                        UInt32				inDataSize )
+{
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitProperty_SonogramAsyncAnalysis) {
+		if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+		// switching threads under a running analysis isn't supported
+		if (IsInitialized()) return kAudioUnitErr_Initialized;
+		mAsyncAnalysis = *(static_cast<const UInt32*>(inData)) != 0;
+		return noErr;
+	}
+	
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitProperty_SonogramChannelMask) {
+		// may change while rendering; the analysis picks it up at its next batch. A short
+		// mask replaces only its first words.
+		if (inDataSize == 0 || inDataSize % sizeof(UInt32) || inDataSize > sizeof(mChannelMask))
+			return kAudioUnitErr_InvalidPropertyValue;
+		const UInt32 *mask = static_cast<const UInt32*>(inData);
+		for (UInt32 i = 0; i < inDataSize / sizeof(UInt32); ++i)
+			mChannelMask[i] = mask[i];
+		return noErr;
+	}
+	
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitProperty_SonogramStorageFormat) {
+		if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+		UInt32 format = *(static_cast<const UInt32*>(inData));
+		if (format > kSonogramStorage_UInt16) return kAudioUnitErr_InvalidPropertyValue;
+		// like a parameter change: the history starts over in the new format
+		mStorageFormat = format;
+		if (IsInitialized())
+			QueueAnalysis();
+		return noErr;
+	}
+	
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitProperty_SonogramPyramid) {
+		if (inDataSize < sizeof(SonogramPyramidSettings)) return kAudioUnitErr_InvalidPropertyValue;
+		const SonogramPyramidSettings *settings = static_cast<const SonogramPyramidSettings*>(inData);
+		if (settings->mNumberLevels > kMaxPyramidLevels || settings->mPooling > kSonogramPooling_Mean)
+			return kAudioUnitErr_InvalidPropertyValue;
+		mPyramidSettings = *settings;
+		if (IsInitialized())
+			QueueAnalysis();
+		return noErr;
+	}
+	
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitProperty_SonogramRangeSmoothing) {
+		if (inDataSize < sizeof(SonogramRangeSmoothing)) return kAudioUnitErr_InvalidPropertyValue;
+		const SonogramRangeSmoothing *smoothing = static_cast<const SonogramRangeSmoothing*>(inData);
+		if (!(smoothing->mAttackTime >= 0.f && smoothing->mAttackTime <= kMaxRangeSmoothingTime)
+			|| !(smoothing->mDecayTime >= 0.f && smoothing->mDecayTime <= kMaxRangeSmoothingTime))
+			return kAudioUnitErr_InvalidPropertyValue;
+		// unlike the other settings this needs no new analysis; the current and pending
+		// ones take the new times as they are, and those built later get them too
+		CAMutex::Locker lock(mAnalysisLock);
+		mRangeSmoothing = *smoothing;
+		if (mAnalysis)
+			mAnalysis->SetRangeSmoothing(mRangeSmoothing);
+		if (mPendingAnalysis)
+			mPendingAnalysis->SetRangeSmoothing(mRangeSmoothing);
+		return noErr;
+	}
+	
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitProperty_SonogramSubscribe) {
+		if (inDataSize < sizeof(CAAnalysisMailbox *)) return kAudioUnitErr_InvalidPropertyValue;
+		CAAnalysisMailbox *mailbox = *(static_cast<CAAnalysisMailbox * const *>(inData));
+		if (mailbox == NULL) return kAudioUnitErr_InvalidPropertyValue;
+		if (!mPublisher.Subscribe(mailbox)) return kAudioUnitErr_InvalidPropertyValue;	// no room for more
+		// what is there already, so the view needn't wait for the next batch; a racing post
+		// from EndBatch may leave an older stamp, which the next batch puts right
+		CAAnalysisMailboxPost(mailbox, SInt64(mRenderStamp.mSampleTime));
+		return noErr;
+	}
+	
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitProperty_SonogramUnsubscribe) {
+		if (inDataSize < sizeof(CAAnalysisMailbox *)) return kAudioUnitErr_InvalidPropertyValue;
+		mPublisher.Unsubscribe(*(static_cast<CAAnalysisMailbox * const *>(inData)));
+		return noErr;
+	}
+	
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitProperty_SonogramEQCurve) {
+		// the points past mNumberPoints may be left out
+		const SonogramEQCurve *curve = static_cast<const SonogramEQCurve*>(inData);
+		if (inDataSize < sizeof(UInt32) || curve->mNumberPoints > kMaxEQPoints
+			|| inDataSize < sizeof(UInt32) + curve->mNumberPoints * sizeof(SonogramEQPoint))
+			return kAudioUnitErr_InvalidPropertyValue;
+		for (UInt32 i = 0; i < curve->mNumberPoints; ++i) {
+			const SonogramEQPoint &point = curve->mPoints[i];
+			if (!(point.mFrequency > 0.f) || !(fabsf(point.mGainDB) <= kMaxEQGainDB)
+				|| (i > 0 && !(point.mFrequency > curve->mPoints[i - 1].mFrequency)))
+				return kAudioUnitErr_InvalidPropertyValue;
+		}
+		// no new analysis: the analysis thread makes new gains at its next batch
+		CAMutex::Locker lock(mAnalysisLock);
+		++mEQGeneration;
+		OSMemoryBarrier();
+		memset(&mEQCurve, 0, sizeof(mEQCurve));
+		memcpy(&mEQCurve, curve, sizeof(UInt32) + curve->mNumberPoints * sizeof(SonogramEQPoint));
+		OSMemoryBarrier();
+		++mEQGeneration;
+		return noErr;
+	}
+
+	return AUEffectBase::SetProperty (inID, inScope, inElement, inData, inDataSize);
+}
+
 #pragma mark CommuniationWithView
 
 
 void	SonogramViewDemo::AllocateBuffers()
 {
-	mBlockSize = 1024;
-	mNumBins = mBlockSize>>1;
-
-	if (mSpectrumBuffer) {
-		// delete calls deallocate
-		delete (mSpectrumBuffer);
+	memset (&mRenderStamp, 0, sizeof(AudioTimeStamp));
+	mRenderStamp.mFlags = kAudioTimeStampSampleTimeValid;	
+	
+	UInt32 numChannels = GetNumberOfChannels();
+	mBatch.mChannels.resize(numChannels);
+	
+	// one queue per channel, so disabled channels cost neither copies nor analysis
+	for (UInt32 i = 0; i < mInputBuffers.size(); ++i)
+		delete mInputBuffers[i];
+	mInputBuffers.clear();
+	if (mAsyncAnalysis) {
+		for (UInt32 i = 0; i < numChannels; ++i) {
+			CARingBuffer *queue = new CARingBuffer();
+			queue->Allocate(1, sizeof(Float32), InputQueueFrames());
+			mInputBuffers.push_back(queue);
+		}
 	}
-	mSpectrumBuffer = new CARingBuffer();
-	mSpectrumBuffer->Allocate(GetNumberOfChannels(), mNumBins*sizeof(Float32), kMaxSonogramLatency);
+	mInputFrames = 0;
+	mQueuedFrames = 0;
+	mAnalyzedFrames = 0;
+	
+	// not rendering yet, so the analysis can be installed directly
+	CAMutex::Locker lock(mAnalysisLock);
+	CollectRetiredAnalyses();
+	delete mPendingAnalysis;
+	delete mAnalysis;
+	mPendingAnalysis = NULL;
+	mAnalysis = NewAnalysis();
+}
 
-	CAStreamBasicDescription	bufClientDesc;		
-	bufClientDesc.SetCanonical(GetNumberOfChannels(), false);
-	bufClientDesc.mSampleRate = GetSampleRate();
+#pragma mark ____Analysis
 
-	UInt32 frameLength = kDefaultValue_BufferSize*sizeof(Float32);
+SonogramChannelAnalysis::SonogramChannelAnalysis(const SonogramAnalysisParameters &inParams, const SonogramBinReducer *inReducer, UInt32 inCapacitySlices,
+													const SonogramEffectSettings *inEffectSettings)
+	: mFeatureExtractor(inParams.mFFTSize, inParams.mSampleRate),
+	  mEffect(inEffectSettings ? new SonogramSpectralEffect(inParams.mFFTSize, inParams.mSampleRate / inParams.mHopSize, inEffectSettings) : NULL),
+	  mAnalyzer(inParams.mFFTSize, inParams.mHopSize, inParams.mWindow, inReducer, &mFeatureExtractor, mEffect),
+	  mPyramid(inParams.mPyramid.mNumberLevels, inParams.mPyramid.mPooling, mAnalyzer.NumberBins(),
+			   inParams.mStorageFormat, inCapacitySlices),
+	  mSlices((kAnalysisChunkFrames / inParams.mHopSize + 1) * mAnalyzer.NumberBins()),
+	  mFeatures(kAnalysisChunkFrames / inParams.mHopSize + 1),
+	  mInput(kAnalysisChunkFrames),
+	  mFormat(inParams.mStorageFormat),
+	  mBytesPerSlice(SonogramBytesPerSlice(inParams.mStorageFormat, mAnalyzer.NumberBins())),
+	  mEnabled(false)
+{
+	if (mFormat != kSonogramStorage_Float32)
+		mQuantized.resize((kAnalysisChunkFrames / inParams.mHopSize + 1) * mBytesPerSlice);
+	mSpectrumBuffer.Allocate(1, mBytesPerSlice, inCapacitySlices);
+	mFeatureBuffer.Allocate(1, sizeof(SonogramFeatures), std::max(inCapacitySlices, kFeatureHistorySlices));
+}
+
+SonogramChannelAnalysis::~SonogramChannelAnalysis()
+{
+	delete mEffect;
+}
+
+void	SonogramChannelAnalysis::Process(const Float32 *inFrames, UInt32 inNumFrames, UInt32 inHopFill, SampleTime inFirstSlice,
+										 Float32 *outFrames)
+{
+	// the analyzer keeps the smoothed range itself; the effect works from the same FFTs
+	Float32 minAmp, maxAmp;
+	UInt32 numSlices = mAnalyzer.Process(inFrames, inNumFrames, inHopFill, &mSlices[0], minAmp, maxAmp, &mFeatures[0], outFrames);
+	if (numSlices == 0)
+		return;
+	
+	AudioBufferList features;
+	features.mNumberBuffers = 1;
+	features.mBuffers[0].mNumberChannels = 1;
+	features.mBuffers[0].mDataByteSize = numSlices * sizeof(SonogramFeatures);
+	features.mBuffers[0].mData = &mFeatures[0];
+	mFeatureBuffer.Store(&features, numSlices, inFirstSlice);
+	
+	mPyramid.AddSlices(&mSlices[0], numSlices, inFirstSlice);
 	
-	if (mFetchingBufferList) {		
-		mFetchingBufferList->DeallocateBuffers();
-		delete(mFetchingBufferList);
+	AudioBufferList abl;
+	abl.mNumberBuffers = 1;
+	abl.mBuffers[0].mNumberChannels = 1;
+	abl.mBuffers[0].mDataByteSize = numSlices * mBytesPerSlice;
+	abl.mBuffers[0].mData = &mSlices[0];
+	if (mFormat != kSonogramStorage_Float32) {
+		SonogramQuantizer::Quantize(mFormat, &mSlices[0], mAnalyzer.NumberBins(), numSlices, &mQuantized[0]);
+		abl.mBuffers[0].mData = &mQuantized[0];
 	}
-	mFetchingBufferList = CABufferList::New("fetch buffer", bufClientDesc );
-	mFetchingBufferList->AllocateBuffers(frameLength);
+	mSpectrumBuffer.Store(&abl, numSlices, inFirstSlice);
+}
+
+SonogramAnalysis::SonogramAnalysis(const SonogramAnalysisParameters &inParams, UInt32 inNumChannels)
+	: mReducer(NULL), mHopFill(0), mSlicesPerSecond(inParams.mSampleRate / inParams.mHopSize), mEQGeneration(0)
+{
+	// the gate and EQ start out doing nothing; the first batch sets them
+	mEffectSettings.mGateThreshold = 1.f;
+	mEffectSettings.mGateFloor = 1.f;
+	mEffectSettings.mEQGains = NULL;
+	if (inParams.mEffect)
+		mEQGains.resize(inParams.mFFTSize / 2 + 1, 1.f);
 	
-	if (mSpectralDataBufferList) {
-		mSpectralDataBufferList->DeallocateBuffers();
-		delete(mSpectralDataBufferList);
+	UInt32 numBins = inParams.mFFTSize / 2;
+	if (inParams.Reduces()) {
+		mReducer = new SonogramBinReducer(numBins, inParams.mSampleRate, inParams.mScale, inParams.mNumberBands);
+		numBins = mReducer->NumberBands();
 	}
-	mSpectralDataBufferList = CABufferList::New("temp buffer", bufClientDesc );
-	mSpectralDataBufferList->AllocateBuffers(frameLength);
+	
+	// Quantized slices buy more history in the memory kMaxSonogramLatency Float32 slices take.
+	// Keep each ring under 8 MB at the largest sizes; slices come slowly there anyway. A chunk
+	// of input at the smallest hop makes kAnalysisChunkFrames/8 + 1 slices, well under the minimum.
+	mFormat = inParams.mStorageFormat;
+	mBytesPerSlice = SonogramBytesPerSlice(mFormat, numBins);
+	UInt32 historySlices = kMaxSonogramLatency * numBins * sizeof(Float32) / mBytesPerSlice;
+	mCapacitySlices = std::max(16U, std::min(historySlices, (8U << 20) / mBytesPerSlice));
+	for (UInt32 i = 0; i < inNumChannels; ++i)
+		mChannels.push_back(new SonogramChannelAnalysis(inParams, mReducer, mCapacitySlices,
+														inParams.mEffect ? &mEffectSettings : NULL));
+}
 
-	memset (&mRenderStamp, 0, sizeof(AudioTimeStamp));
-	mRenderStamp.mFlags = kAudioTimeStampSampleTimeValid;	
+SonogramAnalysis::~SonogramAnalysis()
+{
+	for (UInt32 i = 0; i < mChannels.size(); ++i)
+		delete mChannels[i];
+	delete mReducer;
+}
+
+void	SonogramAnalysis::SetRangeSmoothing(const SonogramRangeSmoothing &inSmoothing)
+{
+	for (UInt32 i = 0; i < mChannels.size(); ++i)
+		mChannels[i]->mAnalyzer.Range().SetTimes(inSmoothing.mAttackTime, inSmoothing.mDecayTime, mSlicesPerSecond);
+}
+
+// atomically replaces *ioSlot with inNew and returns what was there
+static SonogramAnalysis *	SwapAnalysis(SonogramAnalysis * volatile *ioSlot, SonogramAnalysis *inNew)
+{
+	SonogramAnalysis *old;
+	do {
+		old = *ioSlot;
+	} while (!OSAtomicCompareAndSwapPtrBarrier(old, inNew, (void * volatile *)ioSlot));
+	return old;
+}
+
+// control threads, with mAnalysisLock held
+void	SonogramViewDemo::GetAnalysisParameters(SonogramAnalysisParameters &outParams)
+{
+	UInt32 sizeIndex = std::min(UInt32(GetParameter(kSonogramParam_FFTSize)), kNumberFFTSizes - 1);
+	UInt32 overlapIndex = std::min(UInt32(GetParameter(kSonogramParam_Overlap)), kNumberOverlaps - 1);
+	UInt32 bandsIndex = std::min(UInt32(GetParameter(kSonogramParam_Bands)), kNumberBandCounts - 1);
+	
+	outParams.mFFTSize = kMinFFTSize << sizeIndex;
+	outParams.mHopSize = outParams.mFFTSize >> overlapIndex;
+	outParams.mWindow = std::min(UInt32(GetParameter(kSonogramParam_Window)), kNumberWindows - 1);
+	outParams.mScale = std::min(UInt32(GetParameter(kSonogramParam_Scale)), kNumberScales - 1);
+	outParams.mNumberBands = std::min(kMinBands << bandsIndex, outParams.mFFTSize / 2);
+	outParams.mSampleRate = GetSampleRate();
+	outParams.mStorageFormat = mStorageFormat;
+	outParams.mPyramid = mPyramidSettings;
+	// the worker can't get its output back to Render in time
+	outParams.mEffect = GetParameter(kSonogramParam_Effect) != 0 && !mAsyncAnalysis && outParams.mFFTSize <= kMaxEffectFFTSize;
+}
+
+// control threads: of the analysis built last, which Render is using or about to
+Float64	SonogramViewDemo::EffectLatency()
+{
+	CAMutex::Locker lock(mAnalysisLock);
+	if (!(mParameters.mSampleRate > 0.))
+		return 0.;
+	return mParameters.Latency() / mParameters.mSampleRate;
+}
+
+SonogramAnalysis *	SonogramViewDemo::NewAnalysis()
+{
+	GetAnalysisParameters(mParameters);
+	SonogramAnalysis *analysis = new SonogramAnalysis(mParameters, GetNumberOfChannels());
+	analysis->SetRangeSmoothing(mRangeSmoothing);
+	return analysis;
+}
+
+void	SonogramViewDemo::CollectRetiredAnalyses()
+{
+	for (int i = 0; i < 2; ++i)
+		delete SwapAnalysis(&mRetiredAnalysis[i], NULL);
+}
+
+void	SonogramViewDemo::QueueAnalysis()
+{
+	CAMutex::Locker lock(mAnalysisLock);
+	
+	SonogramAnalysisParameters params;
+	GetAnalysisParameters(params);
+	if (params == mParameters)
+		return;
+	
+	// Collecting first leaves at most one retired slot in use (Render may retire once more
+	// before the new analysis is published), so Render always has a free slot to adopt it.
+	CollectRetiredAnalyses();
+	
+	// an analysis still pending was never seen by Render
+	delete SwapAnalysis(&mPendingAnalysis, NewAnalysis());
+}
+
+// analysis thread (Render, or the worker in async mode), at the top of a batch
+void	SonogramViewDemo::AdoptPendingAnalysis()
+{
+	if (mPendingAnalysis == NULL)
+		return;
+	
+	int slot = (mRetiredAnalysis[0] == NULL) ? 0 : (mRetiredAnalysis[1] == NULL) ? 1 : -1;
+	if (slot < 0)
+		return;		// try again next block
+	
+	SonogramAnalysis *analysis = SwapAnalysis(&mPendingAnalysis, NULL);
+	if (analysis == NULL)
+		return;
 	
+	SonogramAnalysis *old = mAnalysis;
+	mAnalysis = analysis;
+	SwapAnalysis(&mRetiredAnalysis[slot], old);
+}
+
+// Gains for the inFFTSize / 2 + 1 bins from DC to Nyquist, interpolated in dB on a log2
+// frequency scale. DC takes the first point's gain.
+void	SonogramViewDemo::MakeEQGains(const SonogramEQCurve &inCurve, Float64 inSampleRate, UInt32 inFFTSize, Float32 *outGains)
+{
+	UInt32 numGains = inFFTSize / 2 + 1;
+	UInt32 numPoints = inCurve.mNumberPoints;
+	if (numPoints == 0) {
+		for (UInt32 i = 0; i < numGains; ++i)
+			outGains[i] = 1.f;
+		return;
+	}
+	const SonogramEQPoint *points = inCurve.mPoints;
+	Float32 binWidth = Float32(inSampleRate / inFFTSize);
+	UInt32 segment = 0;			// the points on either side of the bin are segment and segment + 1
+	for (UInt32 i = 0; i < numGains; ++i) {
+		Float32 frequency = i * binWidth, gainDB;
+		while (segment + 1 < numPoints && frequency >= points[segment + 1].mFrequency)
+			++segment;
+		if (frequency <= points[0].mFrequency)
+			gainDB = points[0].mGainDB;
+		else if (segment + 1 == numPoints)
+			gainDB = points[segment].mGainDB;
+		else {
+			const SonogramEQPoint &a = points[segment], &b = points[segment + 1];
+			Float32 t = log2f(frequency / a.mFrequency) / log2f(b.mFrequency / a.mFrequency);
+			gainDB = a.mGainDB + t * (b.mGainDB - a.mGainDB);
+		}
+		outGains[i] = powf(10.f, gainDB / 20.f);
+	}
+}
+
+// analysis thread, with an effect: the gate's parameters, and new EQ gains if the curve has changed
+void	SonogramViewDemo::UpdateEffectSettings(SonogramAnalysis *inAnalysis)
+{
+	SonogramEffectSettings &settings = inAnalysis->mEffectSettings;
+	settings.mGateThreshold = powf(10.f, GetParameter(kSonogramParam_GateThreshold) / 20.f);
+	settings.mGateFloor = powf(10.f, -GetParameter(kSonogramParam_GateDepth) / 20.f);
+	
+	UInt32 generation = mEQGeneration;
+	if (generation == inAnalysis->mEQGeneration || (generation & 1))
+		return;		// up to date, or being written; try again next batch
+	OSMemoryBarrier();
+	SonogramEQCurve curve = mEQCurve;
+	OSMemoryBarrier();
+	if (mEQGeneration != generation)
+		return;
 	
-	mSpectralProcessor.free();
-	mSpectralProcessor = new CASpectralProcessor(mBlockSize, mNumBins, GetNumberOfChannels(), GetMaxFramesPerSlice());
+	// once per change, on the render thread: a log and a power per bin
+	UInt32 fftSize = (UInt32(inAnalysis->mEQGains.size()) - 1) * 2;
+	MakeEQGains(curve, GetSampleRate(), fftSize, &inAnalysis->mEQGains[0]);
+	settings.mEQGains = curve.mNumberPoints ? &inAnalysis->mEQGains[0] : NULL;
+	inAnalysis->mEQGeneration = generation;
+}
 
+// analysis thread: sets up mBatch for inNumFrames frames of every enabled channel, from
+// inInput or, when it is NULL, from the input queues at inStartFrame. With an effect,
+// inOutput gets every channel's output, or NULL when it isn't wanted.
+void	SonogramViewDemo::BeginBatch(SonogramAnalysis *inAnalysis, const AudioBufferList *inInput, SampleTime inStartFrame, UInt32 inNumFrames,
+									 AudioBufferList *inOutput)
+{
+	if (inAnalysis->HasEffect())
+		UpdateEffectSettings(inAnalysis);
+	
+	mBatch.mAnalysis = inAnalysis;
+	mBatch.mInput = inInput;
+	mBatch.mOutput = inOutput;
+	mBatch.mStartFrame = inStartFrame;
+	mBatch.mNumberFrames = inNumFrames;
+	mBatch.mHopFill = inAnalysis->mHopFill;
+	mBatch.mFirstSlice = (SampleTime) mRenderStamp.mSampleTime;
+	
+	// one snapshot of the mask for the whole batch; AllocateBuffers reserved room for every channel
+	mBatch.mChannels.resize(inAnalysis->mChannels.size());
+	UInt32 numEnabled = 0;
+	for (UInt32 i = 0; i < inAnalysis->mChannels.size(); ++i) {
+		SonogramChannelAnalysis *channel = inAnalysis->mChannels[i];
+		// every channel's output goes through the effect, shown or not
+		if (ChannelEnabled(i) || channel->mEffect) {
+			// a channel coming back starts from silence, not from where it left off
+			if (!channel->mEnabled) {
+				channel->mAnalyzer.Clear();
+				channel->mPyramid.Clear();
+			}
+			channel->mEnabled = true;
+			mBatch.mChannels[numEnabled++] = i;
+		} else
+			channel->mEnabled = false;
+	}
+	mBatch.mChannels.resize(numEnabled);
+}
+
+// any thread of the batch: channels don't share anything but the input, so they run in any order
+void	SonogramViewDemo::AnalyzeChannelTask(void *inRefCon, UInt32 inTask)
+{
+	SonogramViewDemo *This = static_cast<SonogramViewDemo *>(inRefCon);
+	const Batch &batch = This->mBatch;
+	UInt32 channelIndex = batch.mChannels[inTask];
+	SonogramChannelAnalysis *channel = batch.mAnalysis->mChannels[channelIndex];
+	const SonogramAnalyzer &analyzer = channel->mAnalyzer;
+	
+	UInt32 hopFill = batch.mHopFill;
+	SampleTime slice = batch.mFirstSlice;
+	for (UInt32 offset = 0; offset < batch.mNumberFrames; ) {
+		UInt32 n = std::min(batch.mNumberFrames - offset, kAnalysisChunkFrames);
+		const Float32 *frames;
+		if (batch.mInput)
+			frames = (const Float32 *)batch.mInput->mBuffers[channelIndex].mData + offset;
+		else {
+			AudioBufferList abl;
+			abl.mNumberBuffers = 1;
+			abl.mBuffers[0].mNumberChannels = 1;
+			abl.mBuffers[0].mDataByteSize = n * sizeof(Float32);
+			abl.mBuffers[0].mData = &channel->mInput[0];
+			// a channel enabled since these frames were queued has nothing there
+			if (This->mInputBuffers[channelIndex]->Fetch(&abl, n, batch.mStartFrame + offset, false) != kCARingBufferError_OK)
+				memset(&channel->mInput[0], 0, n * sizeof(Float32));
+			frames = &channel->mInput[0];
+		}
+		Float32 *output = batch.mOutput ? (Float32 *)batch.mOutput->mBuffers[channelIndex].mData + offset : NULL;
+		channel->Process(frames, n, hopFill, slice, output);
 		
+		slice += analyzer.NumberSlices(hopFill, n);
+		hopFill = analyzer.NextHopFill(hopFill, n);
+		offset += n;
+	}
+}
+
+// analysis thread, after every task of mBatch has run: publishes the new slices
+void	SonogramViewDemo::EndBatch()
+{
+	SonogramAnalysis *analysis = mBatch.mAnalysis;
+	const SonogramAnalyzer &analyzer = analysis->mChannels[0]->mAnalyzer;
+	UInt32 numSlices = analyzer.NumberSlices(mBatch.mHopFill, mBatch.mNumberFrames);
+	analysis->mHopFill = analyzer.NextHopFill(mBatch.mHopFill, mBatch.mNumberFrames);
+	if (numSlices == 0 || mBatch.mChannels.empty())
+		return;
+	
+	// the slices must be in the rings before the view can see the new time
+	OSMemoryBarrier();
+	mRenderStamp.mSampleTime += numSlices;
+	mPublisher.Post(SInt64(mRenderStamp.mSampleTime));
+}
+
+void	SonogramViewDemo::AnalyzeInputProc(void *inRefCon)
+{
+	static_cast<SonogramViewDemo *>(inRefCon)->AnalyzeInput();
+}
+
+// worker thread, async mode: analyze everything Render has queued, the channels split across mPool
+void	SonogramViewDemo::AnalyzeInput()
+{
+	AdoptPendingAnalysis();
+	SonogramAnalysis *analysis = mAnalysis;
+	
+	// mQueuedFrames wraps; the difference doesn't
+	UInt32 numFrames = mQueuedFrames - UInt32(mAnalyzedFrames);
+	OSMemoryBarrier();
+	if (numFrames == 0)
+		return;
+	
+	// if we fell more than the queues behind, skip what Render has overwritten
+	UInt32 queueFrames = InputQueueFrames() - GetMaxFramesPerSlice();
+	if (numFrames > queueFrames) {
+		mAnalyzedFrames += numFrames - queueFrames;
+		numFrames = queueFrames;
+	}
+	
+	BeginBatch(analysis, NULL, mAnalyzedFrames, numFrames);
+	mPool.Run(AnalyzeChannelTask, this, mBatch.mChannels.size());
+	EndBatch();
+	mAnalyzedFrames += numFrames;
 }
 
 ComponentResult		SonogramViewDemo::ChangeStreamFormat(	AudioUnitScope						inScope,
@@ -262,35 +998,105 @@ ComponentResult		SonogramViewDemo::ChangeStreamFormat(	AudioUnitScope						inSco
 															const CAStreamBasicDescription & 	inPrevFormat,
 															const CAStreamBasicDescription &	inNewFormat )
 {	
-	// we could change the default buffer size here because the sample rate may have changed or the
-	// number of samples we are pulling may have changed
+	// the analysis size comes from the FFT size and overlap parameters, not the format
 	return  AUBase::ChangeStreamFormat(inScope, inElement, inPrevFormat, inNewFormat);		
 }
 
 ComponentResult	SonogramViewDemo::GetSonogramOverview(SonogramOverview* data)
 {	
-	#pragma warning we are pulling all the data but only need a certain channel
+	// holding the lock keeps the analysis we read from alive even if Render replaces it
+	CAMutex::Locker lock(mAnalysisLock);
+	CollectRetiredAnalyses();
+	
+	SonogramAnalysis *analysis = mAnalysis;
+	if (analysis == NULL) return kAudioUnitErr_Uninitialized;
+	if (data->mChannel >= analysis->mChannels.size()) return kAudioUnitErr_InvalidPropertyValue;
+	UInt32 numBins = analysis->NumberBins();
 	
-	data->mNumBins = mNumBins;	
-	data->mMinAmp = mMinAmp;
-	data->mMaxAmp = mMaxAmp;	
+	data->mNumBins = numBins;	
+	// this channel's own range, smoothed by its analyzer
+	const SonogramRangeTracker &range = analysis->mChannels[data->mChannel]->mAnalyzer.Range();
+	data->mMinAmp = range.Floor();
+	data->mMaxAmp = range.Peak();	
+	data->mFormat = analysis->mFormat;
+	data->mBytesPerSlice = analysis->mBytesPerSlice;
 		
 	UInt32 num = data->mNumSlices; 
 	
 	if (num > kMaxSonogramLatency) return kAudioUnitErr_TooManyFramesToProcess; 
+	
+	// at large FFT sizes fewer slices fit in the ring and in the caller's buffer
+	num = std::min(num, std::min(analysis->mCapacitySlices, UInt32(kDefaultValue_BufferSize * sizeof(Float32) / analysis->mBytesPerSlice)));
+	data->mNumSlices = num;
 
-	AudioBufferList *bufferList = &mFetchingBufferList->GetModifiableBufferList();
+	// Zoomed out, serve the pyramid level with about mSlicesPerPixel raw slices to a slice,
+	// counting in slices of that level; only the complete ones are there to fetch.
+	SonogramChannelAnalysis *channel = analysis->mChannels[data->mChannel];
+	UInt32 level = 0;
+	for (UInt32 perPixel = data->mSlicesPerPixel; perPixel > 1 && level < channel->mPyramid.NumberLevels(); perPixel >>= 1)
+		++level;
+	data->mLevel = level;
+	
 	SampleTime t = (SampleTime) data->mFetchStamp.mSampleTime;
-	mSpectrumBuffer->Fetch(bufferList, num, t, false);	 // you fetch mNumBins * mNumSlices of data
-
-	Float32* b = (Float32*) bufferList->mBuffers[data->mChannel].mData;
-	memcpy(data->mOverview, b, num*mNumBins*sizeof(Float32));		
-	data->mFetchStamp.mSampleTime += num;
+	if (level > 0) {
+		SampleTime complete = (SampleTime(mRenderStamp.mSampleTime) >> level) - (t >> level);
+		num = UInt32(std::max(SampleTime(0), std::min(SampleTime(num), complete)));
+		data->mNumSlices = num;
+		t >>= level;
+	}
+	
+	// each channel has a ring of its own, so fetch just that one, straight into the view's buffer
+	AudioBufferList bufferList;
+	bufferList.mNumberBuffers = 1;
+	bufferList.mBuffers[0].mNumberChannels = 1;
+	bufferList.mBuffers[0].mDataByteSize = num*analysis->mBytesPerSlice;
+	bufferList.mBuffers[0].mData = data->mOverview;
+	
+	// you fetch mNumSlices slices of data; slices from before a change of analysis are gone,
+	// and so are those from while the channel was disabled. Zeros read as silence in every format.
+	CARingBuffer &spectrumBuffer = level ? channel->mPyramid.Level(level) : channel->mSpectrumBuffer;
+	if (num && spectrumBuffer.Fetch(&bufferList, num, t, false) != kCARingBufferError_OK)
+		memset(data->mOverview, 0, num*analysis->mBytesPerSlice);
+	
+	data->mFetchStamp.mSampleTime += SampleTime(num) << level;
 	return noErr;
 	
 }
 
 
+ComponentResult	SonogramViewDemo::GetSonogramFeatures(SonogramFeatureHistory* data)
+{
+	CAMutex::Locker lock(mAnalysisLock);
+	CollectRetiredAnalyses();
+	
+	SonogramAnalysis *analysis = mAnalysis;
+	if (analysis == NULL) return kAudioUnitErr_Uninitialized;
+	if (data->mChannel >= analysis->mChannels.size()) return kAudioUnitErr_InvalidPropertyValue;
+	CARingBuffer &featureBuffer = analysis->mChannels[data->mChannel]->mFeatureBuffer;
+	
+	// only what EndBatch has published, and no further back than the ring goes
+	SampleTime first = data->mFetchSlice, startTime, endTime;
+	UInt32 num = 0;
+	if (featureBuffer.GetTimeBounds(startTime, endTime) == kCARingBufferError_OK) {
+		endTime = std::min(endTime, SampleTime(mRenderStamp.mSampleTime));
+		first = std::max(first, startTime);
+		num = UInt32(std::max(SampleTime(0), std::min(SampleTime(data->mNumSlices), endTime - first)));
+	}
+	
+	AudioBufferList bufferList;
+	bufferList.mNumberBuffers = 1;
+	bufferList.mBuffers[0].mNumberChannels = 1;
+	bufferList.mBuffers[0].mDataByteSize = num * sizeof(SonogramFeatures);
+	bufferList.mBuffers[0].mData = data->mFeatures;
+	if (num && featureBuffer.Fetch(&bufferList, num, first, false) != kCARingBufferError_OK)
+		memset(data->mFeatures, 0, num * sizeof(SonogramFeatures));
+	
+	data->mFirstSlice = first;
+	data->mNumSlices = num;
+	data->mFetchSlice = first + num;
+	return noErr;
+}
+
 ComponentResult 	SonogramViewDemo::Render(	AudioUnitRenderActionFlags		&ioActionFlags,
 												const AudioTimeStamp &			inTimeStamp,
 												UInt32							inFramesToProcess )
@@ -304,19 +1110,38 @@ ComponentResult 	SonogramViewDemo::Render(	AudioUnitRenderActionFlags		&ioAction
 	outputBus->PrepareBuffer(inFramesToProcess); // prepare the output buffer list	
 	AudioBufferList& inputBufList = inputBus->GetBufferList();
 	
-	if (
-		mSpectralProcessor->ProcessForwards(inFramesToProcess, &inputBufList)
-	){
+	if (mAsyncAnalysis) {
+		// queue the enabled channels for the worker; this is all the analysis costs the render thread
+		for (UInt32 i = 0; i < mInputBuffers.size(); ++i) {
+			if (!ChannelEnabled(i))
+				continue;
+			AudioBufferList abl;
+			abl.mNumberBuffers = 1;
+			abl.mBuffers[0] = inputBufList.mBuffers[i];
+			mInputBuffers[i]->Store(&abl, inFramesToProcess, mInputFrames);
+		}
+		mInputFrames += inFramesToProcess;
+		OSMemoryBarrier();
+		mQueuedFrames = UInt32(mInputFrames);
+		mWorker.Wake();
+	} else {
+		// the render thread mustn't wait on other threads, so here the channels run in turn
+		AdoptPendingAnalysis();
+		SonogramAnalysis *analysis = mAnalysis;
 		
-		mMinAmp = 0.0;	mMaxAmp = 0.0;
-		AudioBufferList* sdBufferList = &mSpectralDataBufferList->GetModifiableBufferList(); 
-		mSpectralProcessor->GetMagnitude(sdBufferList, mMinAmp, mMaxAmp);
-		// copy mNumBins of numbers out
-			
-		SampleTime s = (SampleTime) (mRenderStamp.mSampleTime);
-		mSpectrumBuffer->Store(sdBufferList, 1, s);
+		// The spectral effect's output comes out of the analysis, straight into the output
+		// buffers, so the kernels have nothing left to do. Bypassed, the analysis goes on
+		// for the display and AUEffectBase passes the input through.
+		bool effect = analysis->HasEffect() && !ShouldBypassEffect();
+		BeginBatch(analysis, &inputBufList, 0, inFramesToProcess, effect ? &outputBus->GetBufferList() : NULL);
+		for (UInt32 i = 0; i < mBatch.mChannels.size(); ++i)
+			AnalyzeChannelTask(this, i);
+		EndBatch();
 		
-		mRenderStamp.mSampleTime += 1; 
+		if (effect) {
+			ioActionFlags &= ~kAudioUnitRenderAction_OutputIsSilence;
+			return noErr;
+		}
 	}			
 	return AUEffectBase::Render(ioActionFlags, inTimeStamp, inFramesToProcess);
 
@@ -342,8 +1167,8 @@ void SonogramViewDemoKernel::Process(	const Float32		*inSourceP,
                                               bool			&ioSilence )
 {
 
-	//This code will pass-thru the audio data.
-	//This is where you want to process data to produce an effect.
+	//This code will pass-thru the audio data. With the spectral effect on, Render makes
+	//the output in the analysis pass and never gets here.
 
  }
 
@@ -42,10 +42,19 @@
 #include "SonogramViewDemoVersion.h"
 
 #include "CARingBuffer.h"
-#include "CABufferList.h"
-#include "CASpectralProcessor.h"
+#include "CAMutex.h"
+#include "SonogramAnalyzer.h"
+#include "SonogramBinReducer.h"
+#include "SonogramFeatures.h"
+#include "SonogramQuantizer.h"
+#include "SonogramPyramid.h"
+#include "SonogramAnalysisWorker.h"
+#include "SonogramThreadPool.h"
+#include <vector>
+#include <algorithm>
 
 #include "CASonogramViewSharedData.h"
+#include "CAAnalysisMailbox.h"
 
 
 #if AU_DEBUG_DISPATCHER
@@ -66,13 +75,203 @@ enum
 {
 	kAudioUnitProperty_SonogramOverview = 65536,
 	kAudioUnitProperty_SampleTimeStamp = 65537,
+	kAudioUnitProperty_SonogramAsyncAnalysis = 65538,	// UInt32, settable only while uninitialized
+	kAudioUnitProperty_SonogramChannelMask = 65539,		// UInt32[kMaxChannelMaskWords], bit c of word c/32 enables channel c
+	kAudioUnitProperty_SonogramStorageFormat = 65540,	// UInt32 kSonogramStorage_*, of the history and the overview
+	kAudioUnitProperty_SonogramPyramid = 65541,			// SonogramPyramidSettings
+	kAudioUnitProperty_SonogramFeatures = 65542,		// SonogramFeatureHistory, read only
+	kAudioUnitProperty_SonogramRangeSmoothing = 65543,	// SonogramRangeSmoothing
+	kAudioUnitProperty_SonogramSubscribe = 65544,		// CAAnalysisMailbox *, set only: posted the sample
+														// time stamp whenever new slices are in
+	kAudioUnitProperty_SonogramUnsubscribe = 65545,		// CAAnalysisMailbox *, set only
+	kAudioUnitProperty_SonogramEQCurve = 65546,			// SonogramEQCurve, of the spectral effect
 };
 
+// How fast the overview's mMaxAmp and mMinAmp follow the music: each channel's peak rises
+// to a louder slice in about the attack time and falls back in about the decay time, and
+// the floor the same the other way up. In seconds; 0 follows every slice as it comes.
+// Changing them keeps the history.
+struct SonogramRangeSmoothing
+{
+	Float32				mAttackTime;
+	Float32				mDecayTime;
+};
+static const Float32 kDefaultRangeAttackTime = 0.f;
+static const Float32 kDefaultRangeDecayTime = 2.f;
+static const Float32 kMaxRangeSmoothingTime = 60.f;
+
+// Pooled copies of the history for zoomed out views; see SonogramPyramid. Changing them
+// starts the history over, as a parameter change does.
+struct SonogramPyramidSettings
+{
+	UInt32				mNumberLevels;		// above the raw slices, up to kMaxPyramidLevels; 0 for none
+	UInt32				mPooling;			// kSonogramPooling_*
+};
+static const UInt32 kMaxPyramidLevels = 16;
+
+// The spectral effect's EQ: gains in dB at ascending frequencies, joined by straight lines
+// on a log frequency scale and held flat past the first and last point. No points is flat
+// at 0 dB. It may be changed while rendering; the effect picks it up at its next block.
+struct SonogramEQPoint
+{
+	Float32				mFrequency;			// Hz
+	Float32				mGainDB;
+};
+static const UInt32 kMaxEQPoints = 32;
+struct SonogramEQCurve
+{
+	UInt32				mNumberPoints;
+	SonogramEQPoint		mPoints[kMaxEQPoints];
+};
+static const Float32 kMaxEQGainDB = 24.f;
+
+// Channels past the end of the mask are always analyzed.
+static const UInt32 kMaxChannelMaskWords = 8;
+
 
 #pragma mark ____SonogramViewDemo Parameters
 
+// The indexed ones are non real-time: a change builds a new analysis on the calling
+// thread, which the analysis thread picks up at the start of its next block. The gate's
+// settings are real-time, read at every block.
+//
+// With the spectral effect on, the output is the input run through the gate and the EQ
+// curve in the analysis's own FFT frames, FFT size - 1 frames late. Only synchronous
+// analysis can make it in time for the output; in async analysis mode it stays off, and
+// so it does above kMaxEffectFFTSize, where a block that completes a hop on every channel
+// at once can take longer than the block lasts.
+enum {
+	kSonogramParam_FFTSize = 0,		// 64 << value
+	kSonogramParam_Overlap = 1,		// hop size is the FFT size >> value
+	kSonogramParam_Window = 2,		// kSonogramWindow_*
+	kSonogramParam_Scale = 3,		// kSonogramScale_*
+	kSonogramParam_Bands = 4,		// at most 32 << value bins, fewer if the FFT has fewer
+	kSonogramParam_Effect = 5,		// 0 off, 1 on
+	kSonogramParam_GateThreshold = 6,	// dB over a bin's noise floor that opens its gate
+	kSonogramParam_GateDepth = 7,	// dB a closed gate takes off; 0 turns the gate off
+	kNumberOfParameters = 8
+};
+
+static CFStringRef kParameterFFTSizeName = CFSTR("FFT Size");
+static CFStringRef kParameterOverlapName = CFSTR("Overlap");
+static CFStringRef kParameterWindowName = CFSTR("Window");
+static CFStringRef kParameterScaleName = CFSTR("Frequency Scale");
+static CFStringRef kParameterBandsName = CFSTR("Bands");
+static CFStringRef kParameterEffectName = CFSTR("Spectral Effect");
+static CFStringRef kParameterGateThresholdName = CFSTR("Gate Threshold");
+static CFStringRef kParameterGateDepthName = CFSTR("Gate Depth");
+
+static const UInt32 kMinFFTSize = 64;
+static const UInt32 kNumberFFTSizes = 11;			// 64 to 65536
+static const UInt32 kNumberOverlaps = 4;			// none, 50%, 75%, 87.5%
+static const UInt32 kNumberWindows = 3;
+static const UInt32 kNumberScales = 4;				// linear, log, mel, constant-Q
+static const UInt32 kMinBands = 32;
+static const UInt32 kNumberBandCounts = 5;			// 32 to 512
+static const UInt32 kMaxEffectFFTSize = 4096;
+static const Float32 kMaxGateThreshold = 30.f;		// dB
+static const Float32 kMaxGateDepth = 60.f;
+
+static const Float32 kDefaultValue_FFTSize = 4;		// 1024
+static const Float32 kDefaultValue_Overlap = 1;		// 50%
+static const Float32 kDefaultValue_Window = kSonogramWindow_Hann;
+static const Float32 kDefaultValue_Scale = kSonogramScale_Linear;
+static const Float32 kDefaultValue_Bands = 4;		// 512, every bin at the default FFT size
+static const Float32 kDefaultValue_Effect = 0;
+static const Float32 kDefaultValue_GateThreshold = 6.f;
+static const Float32 kDefaultValue_GateDepth = 12.f;
+
 static const UInt64 kDefaultValue_BufferSize = kMaxNumAnalysisFrames*kMaxNumBins;
 
+// In async analysis mode Render only queues its input; this much may be waiting for the worker.
+static const UInt32 kAsyncInputFrames = 32768;
+static const UInt32 kAnalysisChunkFrames = 2048;		// the analyzers are fed at most this much at once
+
+// slices of features kept per channel, at least; they are small, so this is more than the spectra
+static const UInt32 kFeatureHistorySlices = 4096;
+
+// what the parameters ask of the analysis
+struct SonogramAnalysisParameters
+{
+	UInt32				mFFTSize;
+	UInt32				mHopSize;
+	UInt32				mWindow;
+	UInt32				mScale;
+	UInt32				mNumberBands;		// no more than mFFTSize / 2
+	Float64				mSampleRate;
+	UInt32				mStorageFormat;		// kSonogramStorage_*
+	SonogramPyramidSettings	mPyramid;
+	bool				mEffect;			// the spectral effect makes the output
+	
+	bool				operator==(const SonogramAnalysisParameters &inOther) const
+	{
+		return mFFTSize == inOther.mFFTSize && mHopSize == inOther.mHopSize && mWindow == inOther.mWindow
+			&& mScale == inOther.mScale && mNumberBands == inOther.mNumberBands && mSampleRate == inOther.mSampleRate
+			&& mStorageFormat == inOther.mStorageFormat && mPyramid.mNumberLevels == inOther.mPyramid.mNumberLevels
+			&& mPyramid.mPooling == inOther.mPyramid.mPooling && mEffect == inOther.mEffect;
+	}
+	// in frames
+	UInt32				Latency() const		{ return mEffect ? mFFTSize - 1 : 0; }
+	// the full linear spectrum needs no reducer
+	bool				Reduces() const		{ return mScale != kSonogramScale_Linear || mNumberBands < mFFTSize / 2; }
+};
+
+// One channel's analyzer and the rings of spectra and features it feeds.
+struct SonogramChannelAnalysis
+{
+	SonogramChannelAnalysis(const SonogramAnalysisParameters &inParams, const SonogramBinReducer *inReducer, UInt32 inCapacitySlices,
+							const SonogramEffectSettings *inEffectSettings);
+	~SonogramChannelAnalysis();
+	
+	// analyzes inNumFrames frames and stores the slices it completes, numbered from inFirstSlice
+	// on; with an effect, outFrames (if not NULL) gets its output
+	void				Process(const Float32 *inFrames, UInt32 inNumFrames, UInt32 inHopFill, SampleTime inFirstSlice,
+								Float32 *outFrames);
+	
+	SonogramFeatureExtractor	mFeatureExtractor;	// the analyzer's
+	SonogramSpectralEffect *	mEffect;			// the analyzer's, or NULL
+	SonogramAnalyzer		mAnalyzer;
+	CARingBuffer			mSpectrumBuffer;
+	CARingBuffer			mFeatureBuffer;		// one SonogramFeatures per slice, numbered as the spectra are
+	SonogramPyramid			mPyramid;			// coarser copies of mSpectrumBuffer
+	std::vector<Float32>	mSlices;			// the slices of one Process call
+	std::vector<SonogramFeatures>	mFeatures;	// and their features
+	std::vector<Float32>	mInput;				// async mode: input fetched from the queue
+	std::vector<Byte>		mQuantized;			// mSlices in mFormat, unless that is Float32
+	UInt32					mFormat;
+	UInt32					mBytesPerSlice;
+	bool					mEnabled;			// analyzed in the last batch
+};
+
+// Every channel's analysis, sized for one set of parameter values. All channels share the
+// hop phase, so slice s of every enabled channel covers the same input. The rings hold
+// reduced slices when the scale or band count asks for them.
+struct SonogramAnalysis
+{
+	SonogramAnalysis(const SonogramAnalysisParameters &inParams, UInt32 inNumChannels);
+	~SonogramAnalysis();
+	
+	UInt32				NumberBins() const		{ return mChannels[0]->mAnalyzer.NumberBins(); }
+	
+	// any thread; the channels' ranges carry on at the new rates
+	void				SetRangeSmoothing(const SonogramRangeSmoothing &inSmoothing);
+	
+	bool				HasEffect() const		{ return mChannels[0]->mEffect != NULL; }
+	
+	SonogramBinReducer *					mReducer;		// shared by the channels, or NULL
+	std::vector<SonogramChannelAnalysis *>	mChannels;
+	UInt32				mFormat;				// of the rings
+	UInt32				mBytesPerSlice;
+	UInt32				mCapacitySlices;
+	UInt32				mHopFill;				// frames since the last hop
+	Float64				mSlicesPerSecond;
+	
+	// the channels' effects share these; the analysis thread sets them between batches
+	SonogramEffectSettings	mEffectSettings;
+	std::vector<Float32>	mEQGains;				// fftSize / 2 + 1 of them, with an effect
+	UInt32				mEQGeneration;			// of the curve mEQGains were made from
+};
+
 
 
 #pragma mark ____SonogramViewDemo
@@ -116,6 +315,12 @@ public:
 	virtual	ComponentResult		GetParameterInfo(	AudioUnitScope			inScope,
 													AudioUnitParameterID	inParameterID,
 													AudioUnitParameterInfo	&outParameterInfo);
+	
+	virtual ComponentResult		SetParameter(	AudioUnitParameterID	inID,
+												AudioUnitScope			inScope,
+												AudioUnitElement		inElement,
+												Float32					inValue,
+												UInt32					inBufferOffsetInFrames);
     
 	virtual ComponentResult		GetPropertyInfo(	AudioUnitPropertyID		inID,
 													AudioUnitScope			inScope,
@@ -128,7 +333,15 @@ public:
 												AudioUnitElement 		inElement,
 												void *					outData);
 	
-	virtual Float64				GetTailTime(){return(0.0);}
+	virtual ComponentResult		SetProperty(	AudioUnitPropertyID		inID,
+												AudioUnitScope			inScope,
+												AudioUnitElement 		inElement,
+												const void *			inData,
+												UInt32					inDataSize);
+	
+	// the spectral effect's delay; what is left in its frames when the input stops is as long
+	virtual Float64				GetLatency()	{ return EffectLatency(); }
+	virtual Float64				GetTailTime()	{ return EffectLatency(); }
 	virtual	bool				SupportsTail () { return true; }
 	
 	/*! @method Version */
@@ -146,22 +359,80 @@ public:
 												UInt32							inFramesToProcess );
 												
 		ComponentResult			GetSonogramOverview(	SonogramOverview*		data);
+		ComponentResult			GetSonogramFeatures(	SonogramFeatureHistory*	data);
 
 	private:
-		CARingBuffer*					mSpectrumBuffer;			// for storing the spectral data
-		CABufferList*					mFetchingBufferList;		// for fetching from the ring buffer
+		void							GetAnalysisParameters(SonogramAnalysisParameters &outParams);
+		SonogramAnalysis *				NewAnalysis();
+		void							QueueAnalysis();
+		void							CollectRetiredAnalyses();
+		void							AdoptPendingAnalysis();
+		Float64							EffectLatency();
+		
+		bool							ChannelEnabled(UInt32 inChannel) const
+		{
+			return inChannel >= kMaxChannelMaskWords * 32 || ((mChannelMask[inChannel >> 5] >> (inChannel & 31)) & 1);
+		}
+		void							BeginBatch(SonogramAnalysis *inAnalysis, const AudioBufferList *inInput, SampleTime inStartFrame, UInt32 inNumFrames,
+												   AudioBufferList *inOutput = NULL);
+		void							UpdateEffectSettings(SonogramAnalysis *inAnalysis);
+		static void						MakeEQGains(const SonogramEQCurve &inCurve, Float64 inSampleRate, UInt32 inFFTSize, Float32 *outGains);
+		static void						AnalyzeChannelTask(void *inRefCon, UInt32 inTask);
+		void							EndBatch();
 		
-		CABufferList*					mSpectralDataBufferList;	// for computing fft from the input
+		UInt32							InputQueueFrames()			{ return std::max(kAsyncInputFrames, 8 * GetMaxFramesPerSlice()); }
+		static void						AnalyzeInputProc(void *inRefCon);
+		void							AnalyzeInput();
 		
 		AudioTimeStamp					mRenderStamp;				
+		CAAnalysisPublisher				mPublisher;					// posted mRenderStamp by EndBatch
+		
+		// The analysis thread owns mAnalysis: Render, or the worker in async mode. SetParameter
+		// builds a replacement into mPendingAnalysis; the analysis thread adopts it at the top
+		// of a block and hands the old one back through mRetiredAnalysis, to be deleted by the
+		// next control call. Render never allocates, frees or blocks; the control calls
+		// serialize on mAnalysisLock.
+		SonogramAnalysis * volatile		mAnalysis;
+		SonogramAnalysis * volatile		mPendingAnalysis;
+		SonogramAnalysis * volatile		mRetiredAnalysis[2];
+		CAMutex							mAnalysisLock;
+		
+		SonogramAnalysisParameters		mParameters;				// of the last analysis built
+		
+		volatile UInt32					mChannelMask[kMaxChannelMaskWords];
+		UInt32							mStorageFormat;
+		SonogramPyramidSettings			mPyramidSettings;
+		SonogramRangeSmoothing			mRangeSmoothing;			// mAnalysisLock
 		
-		CAAutoDelete<CASpectralProcessor>	mSpectralProcessor;				
-		UInt32								mBlockSize;					// nom. 1024
-		UInt32								mNumBins;
+		// The analysis thread reads the curve without the lock: SetProperty makes the
+		// generation odd while it writes, and the reader keeps a copy only if the generation
+		// was even and the same before and after.
+		SonogramEQCurve					mEQCurve;
+		volatile UInt32					mEQGeneration;
 		
-		Float32								mMinAmp;
-		Float32								mMaxAmp;
+		// A batch is a run of input frames that every enabled channel analyzes, each on its
+		// own from the same hop phase; then EndBatch publishes the new slices together.
+		struct Batch {
+			SonogramAnalysis *			mAnalysis;
+			const AudioBufferList *		mInput;					// NULL: read from mInputBuffers
+			AudioBufferList *			mOutput;				// the effect's, or NULL
+			SampleTime					mStartFrame;
+			UInt32						mNumberFrames;
+			UInt32						mHopFill;
+			SampleTime					mFirstSlice;
+			std::vector<UInt32>			mChannels;				// the enabled ones
+		};
+		Batch							mBatch;						// analysis thread
 		
+		// async analysis: Render stores each enabled channel into its queue and wakes mWorker,
+		// which splits the channels across mPool
+		bool							mAsyncAnalysis;
+		std::vector<CARingBuffer *>		mInputBuffers;
+		SampleTime						mInputFrames;				// render thread
+		volatile UInt32					mQueuedFrames;				// mInputFrames, published to the worker
+		SampleTime						mAnalyzedFrames;			// worker thread
+		SonogramAnalysisWorker			mWorker;
+		SonogramThreadPool				mPool;
 };
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -0,0 +1,184 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CASonogramColormap.cpp
+	
+=============================================================================*/
+
+#include "CASonogramColormap.h"
+#include "CASonogramFastDB.h"
+#include <string.h>
+#include <math.h>
+
+static const Float32 kMaxIndex = CASonogramColormap::kNumberColors - 1;
+
+CASonogramColormap::CASonogramColormap()
+{
+	const Float32 black[3] = { 0.f, 0.f, 0.f }, white[3] = { 1.f, 1.f, 1.f };
+	SetColors(black, white);
+}
+
+void	CASonogramColormap::SetColors(const Float32 inBackground[3], const Float32 inForeground[3])
+{
+	for (UInt32 i = 0; i < kNumberColors; ++i) {
+		Byte pixel[4];
+		pixel[0] = 255;
+		for (UInt32 c = 0; c < 3; ++c)
+			pixel[c + 1] = (Byte)(255 * (inBackground[c] + (inForeground[c] - inBackground[c]) * i / kNumberColors));
+		memcpy(&mColors[i], pixel, sizeof(pixel));
+	}
+}
+
+// color index of display dB inDB: inScale colors per dB, from inOffset at 0 dB
+static inline UInt32	ColorIndex(Float32 inDB, Float32 inScale, Float32 inOffset)
+{
+	Float32 x = inDB * inScale + inOffset;
+	if (!(x > 0.f)) return 0;
+	return (x < kMaxIndex) ? UInt32(x) : UInt32(kMaxIndex);
+}
+
+void	CASonogramColormap::ColorSlice(UInt32 inFormat, const void *inSlice, UInt32 inNumBins, Float32 inMinDB, Float32 inMaxDB,
+										Byte *outPixels) const
+{
+	UInt32 *out = (UInt32 *)outPixels;
+	
+	// nothing much in view: all background, as the view has always drawn it
+	if (!(inMaxDB - inMinDB >= 20.f * log10f(1.001f))) {
+		for (UInt32 i = 0; i < inNumBins; ++i)
+			out[i] = mColors[0];
+		return;
+	}
+	const Float32 scale = kMaxIndex / (inMaxDB - inMinDB), offset = -inMinDB * scale;
+	UInt32 i = 0;
+	
+	switch (inFormat) {
+		case kSonogramStorage_UInt8:
+		{
+			// dB is linear in q, so a table for this slice's 256 steps does it all
+			const SonogramSliceHeader *header = (const SonogramSliceHeader *)inSlice;
+			const UInt8 *q = (const UInt8 *)(header + 1);
+			UInt32 table[256];
+			for (UInt32 k = 0; k < 256; ++k)
+				table[k] = mColors[ColorIndex(header->mOffset + k * header->mScale, scale, offset)];
+			for (; i < inNumBins; ++i)
+				out[i] = table[q[i]];
+			break;
+		}
+		case kSonogramStorage_UInt16:
+		{
+			const SonogramSliceHeader *header = (const SonogramSliceHeader *)inSlice;
+			const UInt16 *q = (const UInt16 *)(header + 1);
+			const Float32 a = header->mScale * scale, b = header->mOffset * scale + offset;
+#if defined(__SSE2__)
+			const __m128 va = _mm_set1_ps(a), vb = _mm_set1_ps(b), top = _mm_set1_ps(kMaxIndex);
+			for (; i + 8 <= inNumBins; i += 8) {
+				__m128i words = _mm_loadu_si128((const __m128i *)(q + i));
+				__m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, _mm_setzero_si128()));
+				__m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(words, _mm_setzero_si128()));
+				lo = _mm_min_ps(_mm_max_ps(_mm_add_ps(vb, _mm_mul_ps(va, lo)), _mm_setzero_ps()), top);
+				hi = _mm_min_ps(_mm_max_ps(_mm_add_ps(vb, _mm_mul_ps(va, hi)), _mm_setzero_ps()), top);
+				UInt32 index[8];
+				_mm_storeu_si128((__m128i *)index, _mm_cvttps_epi32(lo));
+				_mm_storeu_si128((__m128i *)(index + 4), _mm_cvttps_epi32(hi));
+				for (UInt32 k = 0; k < 8; ++k)
+					out[i + k] = mColors[index[k]];
+			}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+			const float32x4_t vb = vdupq_n_f32(b), top = vdupq_n_f32(kMaxIndex);
+			for (; i + 8 <= inNumBins; i += 8) {
+				uint16x8_t words = vld1q_u16(q + i);
+				float32x4_t lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(words)));
+				float32x4_t hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(words)));
+				lo = vminq_f32(vmaxq_f32(vmlaq_n_f32(vb, lo, a), vdupq_n_f32(0.f)), top);
+				hi = vminq_f32(vmaxq_f32(vmlaq_n_f32(vb, hi, a), vdupq_n_f32(0.f)), top);
+				UInt32 index[8];
+				vst1q_u32(index, vcvtq_u32_f32(lo));
+				vst1q_u32(index + 4, vcvtq_u32_f32(hi));
+				for (UInt32 k = 0; k < 8; ++k)
+					out[i + k] = mColors[index[k]];
+			}
+#endif
+			for (; i < inNumBins; ++i)
+				out[i] = mColors[ColorIndex(header->mOffset + q[i] * header->mScale, scale, offset)];
+			break;
+		}
+		default:
+		{
+			const Float32 *mag = (const Float32 *)inSlice;
+#if defined(__SSE2__)
+			const __m128 vscale = _mm_set1_ps(scale), voffset = _mm_set1_ps(offset);
+			const __m128 one = _mm_set1_ps(1.f), top = _mm_set1_ps(kMaxIndex);
+			for (; i + 4 <= inNumBins; i += 4) {
+				__m128 m = _mm_loadu_ps(mag + i);
+				m = _mm_and_ps(m, _mm_cmpord_ps(m, m));		// NaN to 0
+				__m128 x = _mm_add_ps(_mm_mul_ps(CASonogramFastDB(_mm_add_ps(one, m)), vscale), voffset);
+				x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), top);
+				UInt32 index[4];
+				_mm_storeu_si128((__m128i *)index, _mm_cvttps_epi32(x));
+				out[i] = mColors[index[0]];
+				out[i + 1] = mColors[index[1]];
+				out[i + 2] = mColors[index[2]];
+				out[i + 3] = mColors[index[3]];
+			}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+			const float32x4_t one = vdupq_n_f32(1.f), top = vdupq_n_f32(kMaxIndex), voffset = vdupq_n_f32(offset);
+			for (; i + 4 <= inNumBins; i += 4) {
+				float32x4_t m = vld1q_f32(mag + i);
+				m = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(m), vceqq_f32(m, m)));	// NaN to 0
+				float32x4_t x = vmlaq_n_f32(voffset, CASonogramFastDB(vaddq_f32(one, m)), scale);
+				x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(0.f)), top);
+				UInt32 index[4];
+				vst1q_u32(index, vcvtq_u32_f32(x));
+				out[i] = mColors[index[0]];
+				out[i + 1] = mColors[index[1]];
+				out[i + 2] = mColors[index[2]];
+				out[i + 3] = mColors[index[3]];
+			}
+#endif
+			for (; i < inNumBins; ++i) {
+				Float32 m = mag[i];
+				if (m != m) m = 0.f;
+				out[i] = mColors[ColorIndex(CASonogramFastDB(1.f + m), scale, offset)];
+			}
+			break;
+		}
+	}
+}
@@ -0,0 +1,81 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CASonogramColormap.h
+	
+=============================================================================*/
+
+#ifndef __CASonogramColormap_h__
+#define __CASonogramColormap_h__
+
+#include "CASonogramViewSharedData.h"
+
+/*
+	Turns slices from the AU into rows of pixels for the sonogram view. Where a bin's
+	display dB, 20 * log10(1 + magnitude), lies between the floor and the peak dB in view
+	picks one of kNumberColors colors on a ramp from the background to the foreground
+	color; louder bins get the foreground color, and quieter ones and NaNs the background.
+	
+	The dB values come from CASonogramFastDB four at a time where SSE2 or NEON is
+	available. UInt8 slices go through a 256 entry table made for the slice, so each of
+	their pixels is a single lookup. Nothing is allocated per slice.
+*/
+
+class CASonogramColormap {
+public:
+	enum { kNumberColors = 1024 };
+	
+	CASonogramColormap();
+	
+	// red, green and blue from 0 to 1
+	void		SetColors(const Float32 inBackground[3], const Float32 inForeground[3]);
+	
+	// inNumBins bins of a kSonogramStorage_* slice to inNumBins pixels of 8 bit alpha, red,
+	// green and blue, in that order in memory; inMinDB gets the background color and
+	// inMaxDB the foreground
+	void		ColorSlice(UInt32 inFormat, const void *inSlice, UInt32 inNumBins, Float32 inMinDB, Float32 inMaxDB,
+							Byte *outPixels) const;
+
+private:
+	UInt32		mColors[kNumberColors];		// one pixel each, in memory order
+};
+
+#endif // __CASonogramColormap_h__
@@ -0,0 +1,114 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CASonogramFastDB.h
+	
+=============================================================================*/
+
+#ifndef __CASonogramFastDB_h__
+#define __CASonogramFastDB_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+	#include <arm_neon.h>
+#endif
+
+/*
+	20 * log10(x) for positive, normal x, by splitting off the exponent and fitting log2 of
+	the mantissa with a polynomial; good to about 0.0002 dB. The AU uses it to quantize
+	slices and the view to color them, four values at a time where SSE2 or NEON is there.
+*/
+
+// log2(1 + t) on [0, 1), fitted so that log2(1) is exactly 0
+#define kCASonogramLog2C0		1.4418258f
+#define kCASonogramLog2C1		-0.708682102f
+#define kCASonogramLog2C2		0.415421951f
+#define kCASonogramLog2C3		-0.194422676f
+#define kCASonogramLog2C4		0.0458855279f
+#define kCASonogramDBPerOctave	6.02059991f		// 20 * log10(2)
+
+static inline Float32	CASonogramFastDB(Float32 x)
+{
+	union { Float32 f; UInt32 i; } u;
+	u.f = x;
+	Float32 e = Float32(SInt32(u.i >> 23) - 127);
+	u.i = (u.i & 0x007FFFFF) | 0x3F800000;
+	Float32 t = u.f - 1.f;
+	return kCASonogramDBPerOctave * (e + t * (kCASonogramLog2C0 + t * (kCASonogramLog2C1 + t * (kCASonogramLog2C2
+				+ t * (kCASonogramLog2C3 + t * kCASonogramLog2C4)))));
+}
+
+#if defined(__SSE2__)
+static inline __m128	CASonogramFastDB(__m128 x)
+{
+	__m128i bits = _mm_castps_si128(x);
+	__m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+	__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)));
+	__m128 t = _mm_sub_ps(m, _mm_set1_ps(1.f));
+	__m128 p = _mm_add_ps(_mm_set1_ps(kCASonogramLog2C3), _mm_mul_ps(t, _mm_set1_ps(kCASonogramLog2C4)));
+	p = _mm_add_ps(_mm_set1_ps(kCASonogramLog2C2), _mm_mul_ps(t, p));
+	p = _mm_add_ps(_mm_set1_ps(kCASonogramLog2C1), _mm_mul_ps(t, p));
+	p = _mm_add_ps(_mm_set1_ps(kCASonogramLog2C0), _mm_mul_ps(t, p));
+	return _mm_mul_ps(_mm_set1_ps(kCASonogramDBPerOctave), _mm_add_ps(e, _mm_mul_ps(t, p)));
+}
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+static inline float32x4_t	CASonogramFastDB(float32x4_t x)
+{
+	uint32x4_t bits = vreinterpretq_u32_f32(x);
+	float32x4_t e = vcvtq_f32_s32(vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(127)));
+	float32x4_t m = vreinterpretq_f32_u32(vorrq_u32(vandq_u32(bits, vdupq_n_u32(0x007FFFFF)), vdupq_n_u32(0x3F800000)));
+	float32x4_t t = vsubq_f32(m, vdupq_n_f32(1.f));
+	float32x4_t p = vmlaq_n_f32(vdupq_n_f32(kCASonogramLog2C3), t, kCASonogramLog2C4);
+	p = vmlaq_f32(vdupq_n_f32(kCASonogramLog2C2), t, p);
+	p = vmlaq_f32(vdupq_n_f32(kCASonogramLog2C1), t, p);
+	p = vmlaq_f32(vdupq_n_f32(kCASonogramLog2C0), t, p);
+	return vmulq_n_f32(vmlaq_f32(e, t, p), kCASonogramDBPerOctave);
+}
+#endif
+
+#endif // __CASonogramFastDB_h__
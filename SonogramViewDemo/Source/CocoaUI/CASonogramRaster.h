@@ -0,0 +1,101 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CASonogramRaster.h
+	
+=============================================================================*/
+
+#ifndef __CASonogramRaster_h__
+#define __CASonogramRaster_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+/*
+	The sonogram image the view draws: its newest NumberColumns slices, one column of
+	NumberBins 32 bit pixels per slice, oldest first. Columns are written where they
+	will be drawn and never moved.
+	
+	The columns are kept in a circular buffer, and each one is stored a second time
+	NumberColumns further on. So the columns from the oldest to the newest are always
+	contiguous, starting at Image(), and the view can hand that pointer to the drawing
+	code as is. Adding a slice costs two column writes, however wide the view.
+*/
+
+class CASonogramRaster {
+public:
+	CASonogramRaster();
+	~CASonogramRaster();
+	
+	void			Allocate(UInt32 inNumColumns, UInt32 inNumBins);
+	void			Deallocate();
+	
+	// every column to zero (transparent), and the next column back to the left edge
+	void			Clear();
+	
+	// start writing over the image from the left edge again, for a view that does not scroll
+	void			Restart()				{ mNextColumn = 0; }
+	
+	// BeginColumn returns the memory for the newest column; fill in BytesPerColumn bytes
+	// and call EndColumn, which scrolls the image by one column.
+	Byte *			BeginColumn()			{ return mPixels + mNextColumn * mBytesPerColumn; }
+	void			EndColumn();
+	
+	// NumberColumns columns of BytesPerColumn bytes, oldest first
+	const Byte *	Image() const			{ return mPixels + mNextColumn * mBytesPerColumn; }
+	
+	UInt32			NumberColumns() const	{ return mNumberColumns; }
+	UInt32			NumberBins() const		{ return mNumberBins; }
+	UInt32			BytesPerColumn() const	{ return mBytesPerColumn; }
+	UInt32			ImageBytes() const		{ return mNumberColumns * mBytesPerColumn; }
+
+private:
+	Byte *			mPixels;				// 2 * mNumberColumns columns
+	UInt32			mNumberColumns;
+	UInt32			mNumberBins;
+	UInt32			mBytesPerColumn;
+	UInt32			mNextColumn;			// also the oldest column
+};
+
+#endif // __CASonogramRaster_h__
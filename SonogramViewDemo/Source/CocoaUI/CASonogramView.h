@@ -44,10 +44,9 @@
 #import <QuartzCore/QuartzCore.h>
 
 
-#include "CABufferList.h"
-#include "CARingBuffer.h"
-
 #include "CASonogramViewSharedData.h"
+#include "CASonogramColormap.h"
+#include "CASonogramRaster.h"
 
 
 @interface CASonogramView : NSView
@@ -62,11 +61,9 @@
 	NSColor								*backgroundColor;
 	NSColor								*lineColor;
 					
-	Float32								*colormap; 
-	UInt32								colormapSize;
+	CASonogramColormap					*mColormap;
 			
-	CARingBuffer						*mRingBuffer;	
-	SInt64								mRingBufferCounter;
+	CASonogramRaster					*mRaster;			// the newest mNumSlicesTotal slices, colored
 		
 	UInt32								mNumBins;			// how many bins were just written
 	UInt32								mNumSlices;			// how many slices were just written
@@ -74,11 +71,6 @@
 	UInt32								mNumSlicesTotal;	// how many overall
 	UInt32								mNumBinsTotal;		// how many overall
 	
-	SInt64								mRenderCounter;
-	
-	CABufferList*						mFetchingBufferList;
-	CABufferList*						mStoringBufferList;
-	
 	bool								storing;	
 	bool								isStaticView;
 }
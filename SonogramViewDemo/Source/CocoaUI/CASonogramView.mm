@@ -43,84 +43,16 @@
 
 #define NSRectToCGRect(r) CGRectMake(r.origin.x, r.origin.y, r.size.width, r.size.height)
 
-typedef struct{
-	float red;
-	float green;
-	float blue;
-} ColorTriplet;
-
 @implementation CASonogramView
 
 #pragma mark ___Coloing___
-- (void) createColormap: (UInt32) mapsize
+- (void) createColormap
 {
-	colormapSize = mapsize;
-	if (colormap) free(colormap);
-	colormap = (Float32*)calloc(3*mapsize, sizeof(Float32));	
+	if (!mColormap) mColormap = new CASonogramColormap();
 	
-	Float32 bRed = [backgroundColor redComponent];
-	Float32 bGreen = [backgroundColor greenComponent];
-	Float32 bBlue = [backgroundColor blueComponent];
-
-	Float32 fRed = [lineColor redComponent];
-	Float32 fGreen = [lineColor greenComponent];
-	Float32 fBlue = [lineColor blueComponent];
-		
-	Float32 incrRed = (fRed - bRed)/mapsize;
-	Float32 incrGreen = (fGreen - bGreen)/mapsize;
-	Float32 incrBlue = (fBlue - bBlue)/mapsize;
-		
-	UInt32 index;
-	for (UInt32 i = 0; i < mapsize; i++) {
-		index = i*3;
-		colormap[index] = bRed;
-		colormap[index+1] = bGreen;
-		colormap[index+2] = bBlue;
-	  
-		bRed += incrRed;
-		bGreen += incrGreen;
-		bBlue += incrBlue;		
-			  	  
-    }	
-}
-
-- (UInt32) skewColor: (Float32) x
-{
-	UInt32 pos = (UInt32)(x * (colormapSize-1));
-	return(pos);
-}
-
-- (UInt32)	getIndex: (Float32) value 
-			withMin: (Float32) minD 
-			andMax: (Float32) maxD 
-			andScale: (Float32) scale
-{	
-	if (maxD < .001) return 0;
-	
-	value /= scale;
-	
-	Float32 maxDB = 20.0 * log10(1.0 + maxD); 	
-	Float32 minDB = 20.0 * log10(1.0 + minD); 	
-	Float32 inDB = 20.0 * log10(1.0 + value);
-	
-	Float32 db;
-	db = (inDB <= minDB) ? minDB : inDB;
-	db = (inDB >= maxDB) ? maxDB : inDB;
-
-	Float32 ratio = (db/maxDB);	
-	UInt32 j = [self skewColor: ratio];
-	
-	return j;
-}
-
-- (ColorTriplet) getColorWithIndex: (UInt32) j 
-{	
-	ColorTriplet c;
-	UInt32 index = j*3;
-	c.red =  colormap[index];
-	c.green = colormap[index+1];
-	c.blue = colormap[index+2];
-	return c;
+	Float32 background[3] = { [backgroundColor redComponent], [backgroundColor greenComponent], [backgroundColor blueComponent] };
+	Float32 line[3] = { [lineColor redComponent], [lineColor greenComponent], [lineColor blueComponent] };
+	mColormap->SetColors(background, line);
 }
 
 
@@ -135,35 +67,10 @@ typedef struct{
 
 - (void) InitializeBuffers
 {	
-	[self createColormap: mNumBins];	
-	
-	UInt32 numBytesPerFrame = mNumBins*4*sizeof(unsigned char);	// rgba
-																	
-	if (mRingBuffer) delete(mRingBuffer);
-	mRingBuffer = new CARingBuffer();
-	mRingBuffer->Allocate(1, numBytesPerFrame, mNumSlicesTotal);
-			
-	mRingBufferCounter = 0;	
-	mRenderCounter = 0;
-	
-	UInt32 numTotalBytes = numBytesPerFrame*mNumSlicesTotal;
+	[self createColormap];	
 	
-	CAStreamBasicDescription	bufClientDesc;		
-	bufClientDesc.SetCanonical(1, false);
-	if(mFetchingBufferList) {
-		mFetchingBufferList->DeallocateBuffers();
-		delete(mFetchingBufferList);
-	}
-	mFetchingBufferList = CABufferList::New("fetch buffer", bufClientDesc );
-	mFetchingBufferList->AllocateBuffers(numTotalBytes);
-	
-	if(mStoringBufferList) {
-		mStoringBufferList->DeallocateBuffers();
-		delete(mStoringBufferList);
-	}
-	mStoringBufferList = CABufferList::New("store buffer", bufClientDesc );
-	mStoringBufferList->AllocateBuffers(numTotalBytes);
-
+	if (!mRaster) mRaster = new CASonogramRaster();
+	mRaster->Allocate(mNumSlicesTotal, mNumBins);
 	
 	storing = false;	
 }
@@ -181,9 +88,6 @@ typedef struct{
 	mNumSlicesTotal = (UInt32) ([self frame].size.width);		
 	mNumBinsTotal = (UInt32) ([self frame].size.height);		
 	
-	mRingBufferCounter = 0;	
-	mRenderCounter = 0;
-	
 	[self InitializeBuffers];
 
 	isStaticView = false;
@@ -205,11 +109,9 @@ typedef struct{
 	if (backgroundColor) [backgroundColor release];
 	if (lineColor) [lineColor release];	
 	
-	if (colormap) free(colormap);;
+	if (mColormap) delete(mColormap);
 	
-	if (mRingBuffer) delete(mRingBuffer);
-	if (mFetchingBufferList) delete(mFetchingBufferList);
-	if (mStoringBufferList) delete(mStoringBufferList);
+	if (mRaster) delete(mRaster);
 
 	[super dealloc];
 }
@@ -238,14 +140,14 @@ typedef struct{
 - (IBAction) changeBackgroundColor: (id) sender
 {
 	[self setBackgroundColor : [sender color]];
-	[self createColormap: mNumBins];	
+	[self createColormap];	
 	[self setNeedsDisplay: YES];
 }
 
 - (IBAction) changeLineColor: (id) sender
 {
 	[self  setLineColor: [sender color]];
-	[self createColormap: mNumBins];	
+	[self createColormap];	
 	[self setNeedsDisplay: YES];
 }
 
@@ -271,46 +173,22 @@ typedef struct{
 	
 	mNumSlices = data->mNumSlices;
 	
-	Float32 linmin = data->mMinAmp;
-	Float32 linmax = data->mMaxAmp;
+	// the AU smooths the range, so it doesn't jump from one fetch to the next
+	Float32 minDB = 20.0 * log10(1.0 + data->mMinAmp);
+	Float32 maxDB = 20.0 * log10(1.0 + data->mMaxAmp);
+	// the AU may keep its history quantized; the colormap reads every format
+	const Byte *slices = (const Byte *) data->mOverview;
 													
-	UInt32 numBytesPerRow = mNumBins*4*sizeof(unsigned char);	//rgba
-									
-	AudioBufferList* mStoringList = &mStoringBufferList->GetModifiableBufferList(); 
-	unsigned char* bitmapImageSliceBits = (unsigned char*) mStoringList->mBuffers[data->mChannel].mData;
-
+	// a static view paints over the same columns every time instead of scrolling
+	if (isStaticView)
+		mRaster->Restart();
 	
-	Float32 linmag;	
-	UInt32  index, index1, index2;
-	ColorTriplet c;
-
+	// only the new slices are colored, straight into the image
 	for (UInt32 j = 0; j < mNumSlices; j++) {	// for each frame	
-		for (UInt32 i = 0; i < mNumBins; i++) {		// for each frequency
-		
-			index1 = i + j*mNumBins;
-			linmag	= data->mOverview[index1];	
-			
-			if  (isnan(linmag)) linmag = 0.0;
-			
-			index = [self getIndex: linmag withMin: linmin andMax: linmax andScale: 1.0];
-			c = [self getColorWithIndex: index];
-			
-				
-			index2 = i*4 + j*numBytesPerRow;
-			
-			
-			bitmapImageSliceBits[index2  ] = 255;
-			bitmapImageSliceBits[index2+1] = (unsigned char) (255*c.red);
-			bitmapImageSliceBits[index2+2] = (unsigned char) (255*c.green);
-			bitmapImageSliceBits[index2+3] = (unsigned char) (255*c.blue); 		
-
-		}
-	}	 
-	
-	//store
-	mRingBuffer->Store(mStoringList, mNumSlices, mRingBufferCounter);
-	if (!isStaticView)
-		mRingBufferCounter += mNumSlices;
+		mColormap->ColorSlice(data->mFormat, slices + j*data->mBytesPerSlice, mNumBins, minDB, maxDB,
+								mRaster->BeginColumn());
+		mRaster->EndColumn();
+	}
 	
 	[self setNeedsDisplay: YES];
 	
@@ -323,19 +201,13 @@ typedef struct{
 {	
 	[super drawRect: rect];
 	
-	if (!mRingBuffer) return;
-	AudioBufferList* fetchBufferList = &mFetchingBufferList->GetModifiableBufferList(); 
-	
-	// fetch	
-	SInt64 newNum = mRingBufferCounter-mRenderCounter;
-	mRingBuffer->Fetch(fetchBufferList, mNumSlicesTotal, mRingBufferCounter, true);
-	if (!isStaticView)
-		mRenderCounter += newNum;
+	if (!mRaster) return;
 	
-	unsigned char* bitmapImageBits = (unsigned char*) fetchBufferList->mBuffers[0].mData;
+	// the raster keeps its columns contiguous, oldest first, so nothing is copied here
+	unsigned char* bitmapImageBits = (unsigned char*) mRaster->Image();
 	
-	UInt32 numBytesPerRow = mNumBins*4*sizeof(unsigned char); 
-	UInt32 numTotalBytes = mNumSlicesTotal*numBytesPerRow;
+	UInt32 numBytesPerRow = mRaster->BytesPerColumn(); 
+	UInt32 numTotalBytes = mRaster->ImageBytes();
 
 	NSData* bitmapData = [[NSData alloc] initWithBytesNoCopy:bitmapImageBits length:numTotalBytes freeWhenDone:NO];															
 	CIImage* mSpectrumImage = [[CIImage alloc] initWithBitmapData : bitmapData
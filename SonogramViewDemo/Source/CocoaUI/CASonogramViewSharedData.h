@@ -53,6 +53,63 @@
 
 typedef SInt64 SampleTime;
 
+#include <math.h>
+
+// How the AU keeps, and hands out, each slice. The quantized formats hold display dB,
+// 20 * log10(1 + magnitude), after a SonogramSliceHeader: bin i is
+// mOffset + q[i] * mScale dB, where q[i] is a UInt8 or UInt16.
+enum {
+	kSonogramStorage_Float32	= 0,	// magnitudes, no header
+	kSonogramStorage_UInt8		= 1,
+	kSonogramStorage_UInt16		= 2
+};
+
+struct SonogramSliceHeader
+{
+	Float32			mOffset;		// dB of q = 0, the quietest bin of the slice
+	Float32			mScale;			// dB per step
+};
+typedef struct SonogramSliceHeader  SonogramSliceHeader;
+
+static inline UInt32	SonogramBytesPerSlice(UInt32 inFormat, UInt32 inNumBins)
+{
+	switch (inFormat) {
+		case kSonogramStorage_UInt8:	return sizeof(SonogramSliceHeader) + ((inNumBins + 3) & ~3);
+		case kSonogramStorage_UInt16:	return sizeof(SonogramSliceHeader) + ((2 * inNumBins + 3) & ~3);
+		default:						return inNumBins * sizeof(Float32);
+	}
+}
+
+// display dB of every bin of one slice, whatever the format
+static inline void	SonogramSliceToDB(UInt32 inFormat, const void *inSlice, UInt32 inNumBins, Float32 *outDB)
+{
+	const SonogramSliceHeader *header = (const SonogramSliceHeader *)inSlice;
+	UInt32 i;
+	switch (inFormat) {
+		case kSonogramStorage_UInt8:
+		{
+			const UInt8 *q = (const UInt8 *)(header + 1);
+			for (i = 0; i < inNumBins; ++i)
+				outDB[i] = header->mOffset + q[i] * header->mScale;
+			break;
+		}
+		case kSonogramStorage_UInt16:
+		{
+			const UInt16 *q = (const UInt16 *)(header + 1);
+			for (i = 0; i < inNumBins; ++i)
+				outDB[i] = header->mOffset + q[i] * header->mScale;
+			break;
+		}
+		default:
+		{
+			const Float32 *mag = (const Float32 *)inSlice;
+			for (i = 0; i < inNumBins; ++i)
+				outDB[i] = 20.f * log10f(1.f + mag[i]);
+			break;
+		}
+	}
+}
+
 #pragma mark ___CASonogramView DataStructs
 /*!
     @struct         SonogramOverview
@@ -60,7 +117,11 @@ typedef SInt64 SampleTime;
     @field          mChannel
                         Which channel you want to draw.
     @field          mFetchStamp
-                        The time last fetched.
+                        The time last fetched, in raw slices.
+	@field			mSlicesPerPixel
+						How many raw slices one column of the view stands for. The AU
+						serves slices pooled to about that many from its pyramid, if it
+						keeps one; 0 or 1 asks for raw slices.
     @field          mOverview
                        The data.
 	@field			mNumBins
@@ -68,9 +129,18 @@ typedef SInt64 SampleTime;
 	@field			mNumSlices
 						The number of slices.
 	@field			mMaxAmp
-						The maximum amp.
+						The channel's running peak magnitude, smoothed with the attack and
+						decay times of kAudioUnitProperty_SonogramRangeSmoothing.
 	@field			mMinAmp
-						The minimum amp.						
+						The channel's running floor, the quietest magnitude, smoothed the
+						same way.						
+	@field			mFormat
+						The kSonogramStorage_* format of mOverview.
+	@field			mBytesPerSlice
+						The size of one slice in mOverview.
+	@field			mLevel
+						The pyramid level served: each slice pools 1 << mLevel raw slices,
+						and mFetchStamp advanced by mNumSlices << mLevel.
 */
 
 
@@ -79,15 +149,76 @@ struct SonogramOverview
     UInt32			mChannel;		// the view writes	
 	UInt32			mNumSlices;		// the view writes
 	AudioTimeStamp	mFetchStamp;	// the view writes
+	UInt32			mSlicesPerPixel;// the view writes
 	
 	UInt32			mNumBins;		// the au writes
 	
 	Float32			mMaxAmp;		// the au writes
 	Float32			mMinAmp;		// the au writes
+	
+	UInt32			mFormat;		// the au writes
+	UInt32			mBytesPerSlice;	// the au writes
+	UInt32			mLevel;			// the au writes
 
-    Float32			mOverview[1];	// the au writes  
+    Float32			mOverview[1];	// the au writes; mNumSlices slices of mBytesPerSlice bytes
 	
 };
 typedef struct SonogramOverview  SonogramOverview;
 
+enum { kSonogramFeatureBands = 8 };
+
+/*!
+    @struct         SonogramFeatures
+    @abstract       Numbers that describe one slice, of the full linear spectrum.
+    @field          mCentroid
+                        The magnitude weighted mean frequency, in Hz.
+    @field          mRolloff
+                        The frequency below which 85% of the power lies, in Hz.
+    @field          mFlux
+                        How much the magnitudes rose since the previous slice: the sum of
+                        the rises over the sum of the magnitudes.
+    @field          mFlatness
+                        The geometric over the arithmetic mean power, from 0 for a pure
+                        tone to 1 for white noise.
+    @field          mBandEnergy
+                        The power below 125 Hz, in the octaves from 125 Hz to 8 kHz, and
+                        above 8 kHz.
+*/
+struct SonogramFeatures
+{
+	Float32			mCentroid;
+	Float32			mRolloff;
+	Float32			mFlux;
+	Float32			mFlatness;
+	Float32			mBandEnergy[kSonogramFeatureBands];
+};
+typedef struct SonogramFeatures  SonogramFeatures;
+
+/*!
+    @struct         SonogramFeatureHistory
+    @abstract       A structure to fetch the features of a run of slices.
+    @field          mChannel
+                        Which channel.
+    @field          mNumSlices
+                        The room in mFeatures; the au writes how many it filled.
+    @field          mFetchSlice
+                        The first slice wanted, in the slices of mFetchStamp in
+                        SonogramOverview. The au moves it past the slices it wrote; if
+                        the slice asked for is no longer kept, it starts at the oldest.
+    @field          mFirstSlice
+                        The slice of mFeatures[0].
+    @field          mFeatures
+                        The features, oldest first.
+*/
+struct SonogramFeatureHistory
+{
+	UInt32			mChannel;		// the caller writes
+	UInt32			mNumSlices;		// the caller and the au write
+	SInt64			mFetchSlice;	// the caller and the au write
+	SInt64			mFirstSlice;	// the au writes
+	
+	SonogramFeatures	mFeatures[1];	// the au writes; mNumSlices of them
+};
+typedef struct SonogramFeatureHistory  SonogramFeatureHistory;
+
 #endif
@@ -59,14 +59,17 @@
 	
 	SonogramOverview			*mData;	
 	
-	NSTimer*					mFetchTimer;
-	
+	// the AU posts here when it has new slices; see CAAnalysisMailbox.h
+	CAAnalysisMailbox			mMailbox;
+	CFFileDescriptorRef			mMailboxFD;
+	CFRunLoopSourceRef			mMailboxSource;
+	CFAbsoluteTime				mLastUpdate;
 
 }
 
 #pragma mark ___REDRAW___
 
-- (void) updateSpectrum: (NSTimer*) t;
+- (void) updateSpectrum;
 
 #pragma mark ____ PUBLIC FUNCTIONS ____
 - (void)setAU:(AudioUnit)inAU;
@@ -76,6 +79,10 @@
 - (void)priv_synchronizeUIWithParameterValues;
 - (void)priv_addListeners;
 - (void)priv_removeListeners;
+- (void)priv_addMailbox;
+- (void)priv_removeMailbox;
+- (void)priv_mailboxReady;
+- (void)priv_takeMail;
 
 #pragma mark ____ LISTENER CALLBACK DISPATCHEE ____
 - (void)priv_eventListener:(void *) inObject event:(const AudioUnitEvent *)inEvent value:(Float32)inValue;
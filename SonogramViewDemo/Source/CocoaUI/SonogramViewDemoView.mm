@@ -40,6 +40,8 @@
 */
 #import "SonogramViewDemoView.h"
 
+// the AU may post far more often than the screen can show it
+static const CFAbsoluteTime kMinUpdateInterval = 1.0 / 60.0;
 
 #pragma mark ____ LISTENER CALLBACK DISPATCHER ____
 // This listener responds to parameter changes, gestures, and property notifications
@@ -49,6 +51,13 @@ void EventListenerDispatcher (void *inRefCon, void *inObject, const AudioUnitEve
 	[SELF priv_eventListener:inObject event: inEvent value: inValue];
 }
 
+// The mailbox's pipe has something in it: the AU has new slices
+static void MailboxDispatcher (CFFileDescriptorRef inFD, CFOptionFlags inCallBackTypes, void *inInfo)
+{
+	SonogramViewDemoView *SELF = (SonogramViewDemoView *)inInfo;
+	[SELF priv_mailboxReady];
+}
+
 @implementation SonogramViewDemoView
 #pragma mark ____ (INIT /) DEALLOC ____
 - (void)dealloc {
@@ -65,25 +74,13 @@ void EventListenerDispatcher (void *inRefCon, void *inObject, const AudioUnitEve
 
 - (void) removeFromSuperview
 {
-	[mFetchTimer invalidate];
+	[self priv_removeMailbox];
 
 	//[[NSNotificationCenter defaultCenter] removeObserver:self];
 
 	[super removeFromSuperview];
 }
 
-#pragma mark ___OnTimer___
-- (NSTimer *) timer {
-	return [[mFetchTimer retain] autorelease];
-}
-
-- (void) setTimer: (NSTimer *) value {
-	if ( mFetchTimer != value ) {
-		[mFetchTimer release];
-		mFetchTimer = [value retain];
-	}
-}
-
 #pragma mark ____ PUBLIC FUNCTIONS ____
 
 - (void)setAU:(AudioUnit)inAU {
@@ -103,30 +100,19 @@ void EventListenerDispatcher (void *inRefCon, void *inObject, const AudioUnitEve
 	// register for resize notification and data changes
 	//[[NSNotificationCenter defaultCenter]
 	// addObserver: self selector: @selector(handleSpectrumSizeChanged:) name: NSViewFrameDidChangeNotification  object: uiSonogramView];
-
-	[self setTimer: [NSTimer scheduledTimerWithTimeInterval: (1.0/60.0)
-											 target: self
-											 selector: @selector(updateSpectrum:)
-											 userInfo: nil
-											repeats: YES]];	
-
 }
 
 #pragma mark ___Drawing___
 
-- (void) updateSpectrum: (NSTimer*) t
+- (void) updateSpectrum
 {	
+	// the AU's latest time stamp comes with the mail; taking it before anything else
+	// means whatever the AU posts from here on wakes us again
+	Float64 tStamp = CAAnalysisMailboxTake(&mMailbox);
+	
 	if ([uiSonogramView storing]) return;
 	
 	mData->mChannel = 0;
-	Float64 tStamp;
-	UInt32 size = sizeof(Float64);
-	ComponentResult result = AudioUnitGetProperty(	mAU,
-													kAudioUnitProperty_SampleTimeStamp,
-													kAudioUnitScope_Global,
-													0,
-													&tStamp,
-													&size);
 
 	SInt64 numToGet = (SInt64) (tStamp - mData->mFetchStamp.mSampleTime);
 	
@@ -138,8 +124,8 @@ void EventListenerDispatcher (void *inRefCon, void *inObject, const AudioUnitEve
 	
 	mData->mNumSlices = numToGet; 
 	
-	size = sizeof(SonogramOverview);
-	result = AudioUnitGetProperty(					mAU,
+	UInt32 size = sizeof(SonogramOverview);
+	ComponentResult result = AudioUnitGetProperty(					mAU,
 													kAudioUnitProperty_SonogramOverview,
 													kAudioUnitScope_Global,
 													0,
@@ -155,7 +141,61 @@ void EventListenerDispatcher (void *inRefCon, void *inObject, const AudioUnitEve
 
 #pragma mark ____ INTERFACE ACTIONS ____
 - (void) handleSpectrumSizeChanged:(NSNotification *) aNotification {
-	[self updateSpectrum: nil];
+	[self updateSpectrum];
+}
+
+#pragma mark ____ MAILBOX ____
+
+- (void) priv_mailboxReady
+{
+	// Until we take the mail the AU won't write to the pipe again, so holding off to keep to
+	// kMinUpdateInterval costs nothing; the callback stays off until then.
+	CFAbsoluteTime wait = mLastUpdate + kMinUpdateInterval - CFAbsoluteTimeGetCurrent();
+	if (wait > 0)
+		[self performSelector: @selector(priv_takeMail) withObject: nil afterDelay: wait];
+	else
+		[self priv_takeMail];
+}
+
+- (void) priv_takeMail
+{
+	mLastUpdate = CFAbsoluteTimeGetCurrent();
+	[self updateSpectrum];
+	if (mMailboxFD) CFFileDescriptorEnableCallBacks(mMailboxFD, kCFFileDescriptorReadCallBack);
+}
+
+- (void) priv_addMailbox
+{
+	if (!CAAnalysisMailboxOpen(&mMailbox)) return;
+	
+	CFFileDescriptorContext context = { 0, self, NULL, NULL, NULL };
+	mMailboxFD = CFFileDescriptorCreate(NULL, mMailbox.mWaitFD, false, MailboxDispatcher, &context);
+	mMailboxSource = CFFileDescriptorCreateRunLoopSource(NULL, mMailboxFD, 0);
+	CFRunLoopAddSource(CFRunLoopGetCurrent(), mMailboxSource, kCFRunLoopDefaultMode);
+	CFFileDescriptorEnableCallBacks(mMailboxFD, kCFFileDescriptorReadCallBack);
+	
+	CAAnalysisMailbox *mailbox = &mMailbox;
+	verify_noerr(AudioUnitSetProperty(mAU, kAudioUnitProperty_SonogramSubscribe, kAudioUnitScope_Global, 0,
+										&mailbox, sizeof(mailbox)));
+}
+
+- (void) priv_removeMailbox
+{
+	if (mMailboxFD == NULL) return;
+	
+	// once the AU has let go, nothing writes to the pipe
+	CAAnalysisMailbox *mailbox = &mMailbox;
+	if (mAU) AudioUnitSetProperty(mAU, kAudioUnitProperty_SonogramUnsubscribe, kAudioUnitScope_Global, 0,
+									&mailbox, sizeof(mailbox));
+	[NSObject cancelPreviousPerformRequestsWithTarget: self selector: @selector(priv_takeMail) object: nil];
+	
+	CFRunLoopSourceInvalidate(mMailboxSource);
+	CFRelease(mMailboxSource);
+	CFFileDescriptorInvalidate(mMailboxFD);
+	CFRelease(mMailboxFD);
+	mMailboxSource = NULL;
+	mMailboxFD = NULL;
+	CAAnalysisMailboxClose(&mMailbox);
 }
 
 
@@ -168,6 +208,7 @@ void EventListenerDispatcher (void *inRefCon, void *inObject, const AudioUnitEve
 
 	memset (&mData->mFetchStamp, 0, sizeof(AudioTimeStamp));
 	mData->mFetchStamp.mFlags = kAudioTimeStampSampleTimeValid;
+	mData->mSlicesPerPixel = 1;		// a column per slice
 	
 }
 
@@ -177,11 +218,13 @@ void EventListenerDispatcher (void *inRefCon, void *inObject, const AudioUnitEve
 		verify_noerr( AUEventListenerCreate(EventListenerDispatcher, self,
 											CFRunLoopGetCurrent(), kCFRunLoopDefaultMode, 0.05, 0.05, 
 											&mAUEventListener));
+		[self priv_addMailbox];
 	}
 }
 
 - (void)priv_removeListeners 
 {
+	[self priv_removeMailbox];
 	if (mAUEventListener) verify_noerr (AUListenerDispose(mAUEventListener));
 	mAUEventListener = NULL;
 	mAU = NULL;
@@ -208,12 +251,12 @@ void EventListenerDispatcher (void *inRefCon, void *inObject, const AudioUnitEve
 							
 			}
 			// get the data from the audio unit
-			[self updateSpectrum: nil];
+			[self updateSpectrum];
 			break;
 			
 		case kAudioUnitEvent_PropertyChange:						// custom property changed
 			if (inEvent->mArgument.mProperty.mPropertyID == kAudioUnitProperty_SonogramOverview)
-				[self updateSpectrum: nil];
+				[self updateSpectrum];
 			break;
 	}
 }
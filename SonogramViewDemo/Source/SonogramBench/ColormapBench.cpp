@@ -0,0 +1,230 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	ColormapBench.cpp
+	
+=============================================================================*/
+
+/*
+	colormapbench: checks CASonogramColormap::ColorSlice against a plain per pixel
+	coloring and times both, for each kSonogramStorage_* format. See README for building.
+	
+	The reference converts each bin with SonogramSliceToDB (log10f for magnitudes), picks
+	the color index the straightforward way and computes the color with the ramp
+	SetColors uses. ColorSlice uses CASonogramFastDB and, for the quantized formats, a
+	table per slice, so it may land one color step away where a bin sits on a step
+	boundary; anything further is a failure. The slices are quantized from the same
+	magnitudes with SonogramQuantizer, as the AU stores them.
+	
+	The exit status is 1 if any pixel is off by more than a step.
+*/
+
+#include "CASonogramColormap.h"
+#include "SonogramQuantizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#include <vector>
+
+static double	Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static const Float32 kBackground[3] = { 0.05f, 0.1f, 0.3f }, kForeground[3] = { 1.f, 0.85f, 0.2f };
+
+#pragma mark ____Reference
+
+// the pixel of color index inIndex, as SetColors makes it
+static UInt32	ReferenceColor(SInt32 inIndex)
+{
+	Byte pixel[4];
+	pixel[0] = 255;
+	for (UInt32 c = 0; c < 3; ++c)
+		pixel[c + 1] = (Byte)(255 * (kBackground[c] + (kForeground[c] - kBackground[c]) * inIndex / CASonogramColormap::kNumberColors));
+	UInt32 color;
+	memcpy(&color, pixel, sizeof(color));
+	return color;
+}
+
+static SInt32	ReferenceIndex(Float32 inDB, Float32 inMinDB, Float32 inMaxDB)
+{
+	const Float32 top = CASonogramColormap::kNumberColors - 1;
+	if (inDB != inDB) return 0;
+	Float32 x = (inDB - inMinDB) * top / (inMaxDB - inMinDB);
+	if (!(x > 0.f)) return 0;
+	return (x < top) ? SInt32(x) : SInt32(top);
+}
+
+// how many of the pixels are further than a color step from the reference
+static UInt32	CountMismatches(UInt32 inFormat, const void *inSlice, UInt32 inNumBins, Float32 inMinDB, Float32 inMaxDB,
+								const UInt32 *inPixels, std::vector<Float32> &ioDB)
+{
+	SonogramSliceToDB(inFormat, inSlice, inNumBins, &ioDB[0]);
+	UInt32 mismatches = 0;
+	for (UInt32 i = 0; i < inNumBins; ++i) {
+		SInt32 index = ReferenceIndex(ioDB[i], inMinDB, inMaxDB);
+		if (inPixels[i] != ReferenceColor(index) && inPixels[i] != ReferenceColor(index > 0 ? index - 1 : 0) &&
+			inPixels[i] != ReferenceColor(index + 1 < CASonogramColormap::kNumberColors ? index + 1 : index))
+			++mismatches;
+	}
+	return mismatches;
+}
+
+static void	ReferenceColorSlice(UInt32 inFormat, const void *inSlice, UInt32 inNumBins, Float32 inMinDB, Float32 inMaxDB,
+								UInt32 *outPixels, std::vector<Float32> &ioDB)
+{
+	SonogramSliceToDB(inFormat, inSlice, inNumBins, &ioDB[0]);
+	for (UInt32 i = 0; i < inNumBins; ++i)
+		outPixels[i] = ReferenceColor(ReferenceIndex(ioDB[i], inMinDB, inMaxDB));
+}
+
+#pragma mark ____Slices
+
+// Magnitudes with the spread of a real sonogram: most bins near the floor, a few loud
+// partials, the odd NaN the view has to draw as background.
+static void	MakeMagnitudes(UInt32 inNumBins, UInt32 inNumSlices, std::vector<Float32> &outMagnitudes)
+{
+	outMagnitudes.resize(size_t(inNumBins) * inNumSlices);
+	UInt32 state = 2024;
+	for (size_t i = 0; i < outMagnitudes.size(); ++i) {
+		state = state * 1664525 + 1013904223;
+		const Float32 u = (state >> 8) / Float32(1 << 24);
+		const UInt32 bin = UInt32(i % inNumBins);
+		Float32 db = 90.f * u * u * u;
+		if (bin % 97 == 13) db += 40.f;
+		outMagnitudes[i] = (state % 4099 == 0) ? nanf("") : powf(10.f, db / 20.f) - 1.f;
+	}
+}
+
+#pragma mark ____Options
+
+static void	Usage()
+{
+	fprintf(stderr,
+		"usage: colormapbench [options]\n"
+		"  -b, --bins N           bins per slice (1024)\n"
+		"  -n, --slices N         slices per format (2000)\n"
+		"  -r, --range MIN:MAX    dB from background to foreground (0:120)\n");
+}
+
+int main(int argc, char *const argv[])
+{
+	UInt32 numBins = 1024, numSlices = 2000;
+	Float32 minDB = 0.f, maxDB = 120.f;
+	
+	static const struct option options[] = {
+		{ "bins",		required_argument,	NULL, 'b' },
+		{ "slices",		required_argument,	NULL, 'n' },
+		{ "range",		required_argument,	NULL, 'r' },
+		{ NULL,			0,					NULL, 0 }
+	};
+	
+	int ch;
+	bool ok = true;
+	while (ok && (ch = getopt_long(argc, argv, "b:n:r:", options, NULL)) != -1) {
+		switch (ch) {
+			case 'b':	numBins = strtoul(optarg, NULL, 0);		break;
+			case 'n':	numSlices = strtoul(optarg, NULL, 0);	break;
+			case 'r':	ok = sscanf(optarg, "%f:%f", &minDB, &maxDB) == 2;	break;
+			default:	ok = false;								break;
+		}
+	}
+	if (!ok || optind != argc || numBins == 0 || numSlices == 0 || !(maxDB - minDB >= 1.f)) {
+		Usage();
+		return 2;
+	}
+	
+	CASonogramColormap colormap;
+	colormap.SetColors(kBackground, kForeground);
+	
+	std::vector<Float32> magnitudes, db(numBins);
+	MakeMagnitudes(numBins, numSlices, magnitudes);
+	std::vector<UInt32> pixels(size_t(numBins) * numSlices);
+	
+	static const struct { UInt32 mFormat; const char *mName; } kFormats[] = {
+		{ kSonogramStorage_Float32, "Float32" },
+		{ kSonogramStorage_UInt16, "UInt16" },
+		{ kSonogramStorage_UInt8, "UInt8" }
+	};
+	
+	printf("%lu bins x %lu slices, %.0f to %.0f dB\n", (unsigned long)numBins, (unsigned long)numSlices, minDB, maxDB);
+	printf("%-8s  %12s  %14s  %8s  %10s\n", "format", "Mpixels/s", "reference M/s", "speedup", "mismatches");
+	
+	bool passed = true;
+	for (size_t f = 0; f < sizeof(kFormats) / sizeof(kFormats[0]); ++f) {
+		const UInt32 format = kFormats[f].mFormat, bytesPerSlice = SonogramBytesPerSlice(format, numBins);
+		std::vector<Byte> slices(size_t(bytesPerSlice) * numSlices);
+		if (format == kSonogramStorage_Float32)
+			memcpy(&slices[0], &magnitudes[0], slices.size());
+		else
+			SonogramQuantizer::Quantize(format, &magnitudes[0], numBins, numSlices, &slices[0]);
+		
+		double start = Now();
+		for (UInt32 s = 0; s < numSlices; ++s)
+			colormap.ColorSlice(format, &slices[size_t(s) * bytesPerSlice], numBins, minDB, maxDB,
+								(Byte *)&pixels[size_t(s) * numBins]);
+		const double elapsed = Now() - start;
+		
+		UInt32 mismatches = 0;
+		for (UInt32 s = 0; s < numSlices; ++s)
+			mismatches += CountMismatches(format, &slices[size_t(s) * bytesPerSlice], numBins, minDB, maxDB,
+											&pixels[size_t(s) * numBins], db);
+		
+		start = Now();
+		for (UInt32 s = 0; s < numSlices; ++s)
+			ReferenceColorSlice(format, &slices[size_t(s) * bytesPerSlice], numBins, minDB, maxDB,
+								&pixels[size_t(s) * numBins], db);
+		const double referenceElapsed = Now() - start;
+		
+		const double count = double(numBins) * numSlices * 1e-6;
+		printf("%-8s  %12.1f  %14.1f  %7.1fx  %10lu\n", kFormats[f].mName, count / elapsed, count / referenceElapsed,
+				referenceElapsed / elapsed, (unsigned long)mismatches);
+		if (mismatches) passed = false;
+	}
+	
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,299 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	FFTBench.cpp
+	
+=============================================================================*/
+
+/*
+	fftbench: checks CARealFFT against a reference transform and times it, for every
+	size it supports. See README for building.
+	
+	The reference is a textbook radix-2 FFT in double precision, with its twiddle factors
+	tabulated once per size, itself checked against a direct DFT at the small sizes. For each size fftbench reports the largest error of
+	Forward against the reference, relative to the largest reference magnitude, the
+	largest error of Inverse(Forward(x)) against x, and how long a Forward and an
+	Inverse take next to the reference's forward transform. The input is white noise plus a few sines, the
+	same every run.
+	
+	The exit status is 1 if any error exceeds the tolerance (-e), which is loose enough
+	for single precision at 65536 points and tight enough to catch a wrong twiddle or a
+	misplaced bin.
+*/
+
+#include "CARealFFT.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#include <vector>
+
+static double	Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#pragma mark ____Reference
+
+// exp(-2 pi i k / n) for k < n / 2, kept for the last size asked for
+static void	ReferenceTwiddles(size_t n, const double *&outCos, const double *&outSin)
+{
+	static std::vector<double> sCos, sSin;
+	if (sCos.size() != n / 2) {
+		sCos.resize(n / 2);
+		sSin.resize(n / 2);
+		for (size_t k = 0; k < n / 2; ++k) {
+			sCos[k] = cos(2. * M_PI * k / n);
+			sSin[k] = -sin(2. * M_PI * k / n);
+		}
+	}
+	outCos = &sCos[0];
+	outSin = &sSin[0];
+}
+
+// In place iterative radix-2 FFT of n complex values, forward (e^-i).
+static void	ReferenceFFT(std::vector<double> &re, std::vector<double> &im)
+{
+	const size_t n = re.size();
+	const double *twCos, *twSin;
+	ReferenceTwiddles(n, twCos, twSin);
+	for (size_t i = 1, j = 0; i < n; ++i) {
+		size_t bit = n >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j ^= bit;
+		if (i < j) {
+			double t = re[i]; re[i] = re[j]; re[j] = t;
+			t = im[i]; im[i] = im[j]; im[j] = t;
+		}
+	}
+	for (size_t len = 2; len <= n; len <<= 1) {
+		for (size_t k = 0; k < len / 2; ++k) {
+			const double wr = twCos[k * (n / len)], wi = twSin[k * (n / len)];
+			for (size_t i = k; i < n; i += len) {
+				const size_t j = i + len / 2;
+				const double tr = re[j] * wr - im[j] * wi, ti = re[j] * wi + im[j] * wr;
+				re[j] = re[i] - tr;
+				im[j] = im[i] - ti;
+				re[i] += tr;
+				im[i] += ti;
+			}
+		}
+	}
+}
+
+// The first n/2 + 1 bins of the real input, as CARealFFT::Forward gives them.
+static void	ReferenceForward(const Float32 *input, UInt32 n, std::vector<double> &outReal, std::vector<double> &outImag)
+{
+	outReal.assign(input, input + n);
+	outImag.assign(n, 0.);
+	ReferenceFFT(outReal, outImag);
+	outReal.resize(n / 2 + 1);
+	outImag.resize(n / 2 + 1);
+}
+
+static void	DirectDFT(const Float32 *input, UInt32 n, std::vector<double> &outReal, std::vector<double> &outImag)
+{
+	outReal.assign(n / 2 + 1, 0.);
+	outImag.assign(n / 2 + 1, 0.);
+	for (UInt32 k = 0; k <= n / 2; ++k)
+		for (UInt32 t = 0; t < n; ++t) {
+			const double angle = -2. * M_PI * double((UInt64(k) * t) % n) / n;
+			outReal[k] += input[t] * cos(angle);
+			outImag[k] += input[t] * sin(angle);
+		}
+}
+
+#pragma mark ____Measuring
+
+static void	MakeInput(UInt32 n, std::vector<Float32> &outInput)
+{
+	outInput.resize(n);
+	UInt32 state = 12345;
+	for (UInt32 i = 0; i < n; ++i) {
+		state = state * 1664525 + 1013904223;
+		const double noise = (state >> 8) / double(1 << 24) - 0.5;
+		outInput[i] = Float32(0.25 * noise + 0.5 * sin(2. * M_PI * 3. * i / n) +
+								0.25 * cos(2. * M_PI * (n / 5 + 0.37) * i / n));
+	}
+}
+
+// max |a - b| / max |b| over the bins
+static double	RelativeError(const Float32 *re, const Float32 *im, const std::vector<double> &refRe,
+								const std::vector<double> &refIm)
+{
+	double error = 0., scale = 0.;
+	for (size_t k = 0; k < refRe.size(); ++k) {
+		const double dr = re[k] - refRe[k], di = im[k] - refIm[k];
+		const double e = sqrt(dr * dr + di * di), m = sqrt(refRe[k] * refRe[k] + refIm[k] * refIm[k]);
+		if (e > error) error = e;
+		if (m > scale) scale = m;
+	}
+	return (scale > 0.) ? error / scale : error;
+}
+
+// Seconds per call of inProc, repeated for about inSeconds.
+template <class Proc>
+static double	Time(Proc inProc, double inSeconds)
+{
+	UInt32 calls = 1;
+	for (;;) {
+		const double start = Now();
+		for (UInt32 i = 0; i < calls; ++i)
+			inProc();
+		const double elapsed = Now() - start;
+		if (elapsed >= inSeconds)
+			return elapsed / calls;
+		calls = (elapsed > 0.) ? UInt32(calls * 1.5 * inSeconds / elapsed) + 1 : calls * 2;
+	}
+}
+
+struct ForwardCall {
+	CARealFFT *fft; const Float32 *in; Float32 *re, *im;
+	void operator()() const { fft->Forward(in, re, im); }
+};
+struct InverseCall {
+	CARealFFT *fft; const Float32 *re, *im; Float32 *out;
+	void operator()() const { fft->Inverse(re, im, out); }
+};
+struct ReferenceCall {
+	const Float32 *in; UInt32 n; std::vector<double> *re, *im;
+	void operator()() const { ReferenceForward(in, n, *re, *im); }
+};
+
+#pragma mark ____Options
+
+static void	Usage()
+{
+	fprintf(stderr,
+		"usage: fftbench [options]\n"
+		"  -n, --size N           only this size (every power of 2 from 64 to 65536)\n"
+		"  -t, --time S           seconds to time each transform for (0.2)\n"
+		"  -e, --tolerance E      largest relative error that passes (1e-5)\n");
+}
+
+int main(int argc, char *const argv[])
+{
+	UInt32 onlySize = 0;
+	double seconds = 0.2, tolerance = 1e-5;
+	
+	static const struct option options[] = {
+		{ "size",		required_argument,	NULL, 'n' },
+		{ "time",		required_argument,	NULL, 't' },
+		{ "tolerance",	required_argument,	NULL, 'e' },
+		{ NULL,			0,					NULL, 0 }
+	};
+	
+	int ch;
+	bool ok = true;
+	while (ok && (ch = getopt_long(argc, argv, "n:t:e:", options, NULL)) != -1) {
+		switch (ch) {
+			case 'n':	onlySize = strtoul(optarg, NULL, 0);	break;
+			case 't':	seconds = strtod(optarg, NULL);			break;
+			case 'e':	tolerance = strtod(optarg, NULL);		break;
+			default:	ok = false;								break;
+		}
+	}
+	if (!ok || optind != argc || seconds <= 0. || tolerance <= 0. ||
+		(onlySize && (onlySize < CARealFFT::kMinSize || onlySize > CARealFFT::kMaxSize || (onlySize & (onlySize - 1))))) {
+		Usage();
+		return 2;
+	}
+	
+	// the reference has to be right before anything is compared with it
+	bool passed = true;
+	for (UInt32 n = CARealFFT::kMinSize; n <= 1024; n *= 2) {
+		std::vector<Float32> input;
+		std::vector<double> fftRe, fftIm, dftRe, dftIm;
+		MakeInput(n, input);
+		ReferenceForward(&input[0], n, fftRe, fftIm);
+		DirectDFT(&input[0], n, dftRe, dftIm);
+		std::vector<Float32> re(fftRe.begin(), fftRe.end()), im(fftIm.begin(), fftIm.end());
+		if (RelativeError(&re[0], &im[0], dftRe, dftIm) > 1e-6) {
+			fprintf(stderr, "fftbench: the reference FFT disagrees with the DFT at %lu points\n", (unsigned long)n);
+			return 1;
+		}
+	}
+	
+	printf("CARealFFT, %s kernels\n", CARealFFT::InstructionSet());
+	printf("%7s  %11s  %11s  %12s  %12s  %12s  %8s\n", "size", "fwd error", "round trip",
+			"forward us", "inverse us", "reference us", "speedup");
+	
+	for (UInt32 n = CARealFFT::kMinSize; n <= CARealFFT::kMaxSize; n *= 2) {
+		if (onlySize && n != onlySize) continue;
+		
+		CARealFFT fft(n);
+		std::vector<Float32> input, re(fft.NumberBins()), im(fft.NumberBins()), output(n);
+		std::vector<double> refRe, refIm;
+		MakeInput(n, input);
+		
+		ReferenceForward(&input[0], n, refRe, refIm);
+		fft.Forward(&input[0], &re[0], &im[0]);
+		const double forwardError = RelativeError(&re[0], &im[0], refRe, refIm);
+		
+		fft.Inverse(&re[0], &im[0], &output[0]);
+		double roundTrip = 0., peak = 0.;
+		for (UInt32 i = 0; i < n; ++i) {
+			roundTrip = fmax(roundTrip, fabs(output[i] - input[i]));
+			peak = fmax(peak, fabs(input[i]));
+		}
+		roundTrip /= peak;
+		
+		ForwardCall forward = { &fft, &input[0], &re[0], &im[0] };
+		InverseCall inverse = { &fft, &re[0], &im[0], &output[0] };
+		ReferenceCall reference = { &input[0], n, &refRe, &refIm };
+		const double forwardTime = Time(forward, seconds);
+		const double inverseTime = Time(inverse, seconds);
+		const double referenceTime = Time(reference, seconds);
+		
+		const bool sizePassed = forwardError <= tolerance && roundTrip <= tolerance;
+		passed = passed && sizePassed;
+		printf("%7lu  %11.2e  %11.2e  %12.2f  %12.2f  %12.2f  %7.1fx%s\n", (unsigned long)n, forwardError, roundTrip,
+				forwardTime * 1e6, inverseTime * 1e6, referenceTime * 1e6, referenceTime / forwardTime,
+				sizePassed ? "" : "  FAIL");
+	}
+	
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramImageFile.cpp
+	
+=============================================================================*/
+
+#include "SonogramImageFile.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <zlib.h>
+
+static void	PutBE32(std::vector<Byte> &ioBytes, UInt32 inValue)
+{
+	ioBytes.push_back(Byte(inValue >> 24));
+	ioBytes.push_back(Byte(inValue >> 16));
+	ioBytes.push_back(Byte(inValue >> 8));
+	ioBytes.push_back(Byte(inValue));
+}
+
+static bool	WriteChunk(FILE *inFile, const char *inType, const Byte *inData, UInt32 inSize)
+{
+	std::vector<Byte> header;
+	PutBE32(header, inSize);
+	header.insert(header.end(), inType, inType + 4);
+	
+	uLong crc = crc32(0L, (const Bytef *)inType, 4);
+	if (inSize)
+		crc = crc32(crc, inData, inSize);
+	std::vector<Byte> trailer;
+	PutBE32(trailer, UInt32(crc));
+	
+	return fwrite(&header[0], 1, 8, inFile) == 8 &&
+			(inSize == 0 || fwrite(inData, 1, inSize, inFile) == inSize) &&
+			fwrite(&trailer[0], 1, 4, inFile) == 4;
+}
+
+bool	SonogramWritePNG(const char *inPath, const Byte *inARGB, UInt32 inWidth, UInt32 inHeight)
+{
+	// filter type 2 (up) on every row: neighbouring frequencies are similar, so the
+	// differences deflate far better than the pixels
+	const UInt32 rowBytes = 1 + 3 * inWidth;
+	std::vector<Byte> filtered(size_t(rowBytes) * inHeight);
+	for (UInt32 y = 0; y < inHeight; ++y) {
+		Byte *row = &filtered[size_t(y) * rowBytes];
+		const Byte *pixel = inARGB + size_t(y) * inWidth * 4, *above = pixel - inWidth * 4;
+		row[0] = 2;
+		for (UInt32 x = 0; x < inWidth; ++x)
+			for (UInt32 c = 0; c < 3; ++c)
+				row[1 + 3 * x + c] = Byte(pixel[4 * x + 1 + c] - (y ? above[4 * x + 1 + c] : 0));
+	}
+	
+	uLongf deflatedSize = compressBound(filtered.size());
+	std::vector<Byte> deflated(deflatedSize);
+	if (compress2(&deflated[0], &deflatedSize, &filtered[0], filtered.size(), 6) != Z_OK)
+		return false;
+	
+	std::vector<Byte> ihdr;
+	PutBE32(ihdr, inWidth);
+	PutBE32(ihdr, inHeight);
+	const Byte format[5] = { 8, 2, 0, 0, 0 };		// 8 bits, RGB, deflate, adaptive filtering, not interlaced
+	ihdr.insert(ihdr.end(), format, format + 5);
+	
+	FILE *file = fopen(inPath, "wb");
+	if (!file) return false;
+	static const Byte signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	bool ok = fwrite(signature, 1, 8, file) == 8 &&
+				WriteChunk(file, "IHDR", &ihdr[0], ihdr.size()) &&
+				WriteChunk(file, "IDAT", &deflated[0], deflatedSize) &&
+				WriteChunk(file, "IEND", NULL, 0);
+	return (fclose(file) == 0) && ok;
+}
+
+bool	SonogramWriteRGBA(const char *inPath, const Byte *inARGB, UInt32 inWidth, UInt32 inHeight)
+{
+	FILE *file = fopen(inPath, "wb");
+	if (!file) return false;
+	
+	std::vector<Byte> row(size_t(inWidth) * 4);
+	bool ok = true;
+	for (UInt32 y = 0; y < inHeight && ok; ++y) {
+		const Byte *pixel = inARGB + size_t(y) * inWidth * 4;
+		for (UInt32 x = 0; x < 4 * inWidth; x += 4) {
+			row[x] = pixel[x + 1];
+			row[x + 1] = pixel[x + 2];
+			row[x + 2] = pixel[x + 3];
+			row[x + 3] = pixel[x];
+		}
+		ok = fwrite(&row[0], 1, row.size(), file) == row.size();
+	}
+	return (fclose(file) == 0) && ok;
+}
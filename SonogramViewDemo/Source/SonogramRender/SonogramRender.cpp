@@ -0,0 +1,361 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramRender.cpp
+	
+=============================================================================*/
+
+/*
+	sonogramrender: renders WAVE files to sonogram images offline, with the same
+	analysis (SonogramAnalyzer, SonogramBinReducer) and coloring (CASonogramColormap)
+	as the AU and its view. See README for building and the options.
+	
+	The image is split into runs of columns that are analyzed in parallel on a
+	SonogramThreadPool. Each run starts its analyzer a whole number of hops early, at
+	least one FFT's worth, so that its first slice sees the same input as it would
+	have in one pass over the file; the rendering doesn't depend on the thread count.
+	Each column is the maximum of the slices that fall in it, so short events survive
+	however many slices a column covers.
+*/
+
+#include "SonogramWAVFile.h"
+#include "SonogramImageFile.h"
+#include "SonogramAnalyzer.h"
+#include "SonogramThreadPool.h"
+#include "CASonogramColormap.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <errno.h>
+#include <getopt.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+struct RenderSettings {
+	UInt32		mWidth;
+	UInt32		mHeight;
+	UInt32		mFFTSize;
+	UInt32		mHopSize;			// 0: a quarter of the FFT
+	UInt32		mWindow;
+	UInt32		mScale;
+	UInt32		mChannel;
+	Float32		mMaxDB;				// 0: the loudest bin in the file
+	Float32		mBackground[3];
+	Float32		mForeground[3];
+	bool		mRaw;
+	UInt32		mThreads;			// 0: one per processor
+};
+
+struct RenderJob {
+	const SonogramWAVFile *		mFile;
+	const RenderSettings *		mSettings;
+	const SonogramBinReducer *	mReducer;
+	UInt32						mHopSize;
+	SInt64						mNumberSlices;
+	UInt32						mNumberTasks;
+	std::vector<Float32>		mColumns;		// mHeight magnitudes per column
+	
+	// the first slice of column inColumn; column c covers [FirstSlice(c), EndSlice(c))
+	SInt64	FirstSlice(UInt32 inColumn) const	{ return inColumn * mNumberSlices / mSettings->mWidth; }
+	SInt64	EndSlice(UInt32 inColumn) const		{ return std::max(FirstSlice(inColumn + 1), FirstSlice(inColumn) + 1); }
+};
+
+static double	Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#pragma mark ____Analysis
+
+static void	RenderColumns(void *inJob, UInt32 inTask)
+{
+	RenderJob &job = *(RenderJob *)inJob;
+	const RenderSettings &settings = *job.mSettings;
+	const UInt32 width = settings.mWidth, bands = settings.mHeight, hop = job.mHopSize;
+	
+	const UInt32 firstColumn = UInt32(SInt64(inTask) * width / job.mNumberTasks);
+	const UInt32 endColumn = UInt32(SInt64(inTask + 1) * width / job.mNumberTasks);
+	if (firstColumn == endColumn) return;
+	const SInt64 firstSlice = job.FirstSlice(firstColumn), endSlice = job.EndSlice(endColumn - 1);
+	
+	// start early enough that the analyzer's history is all file (or the silence before it)
+	const SInt64 preroll = (settings.mFFTSize + hop - 1) / hop;
+	SInt64 slice = firstSlice - preroll;
+	
+	SonogramAnalyzer analyzer(settings.mFFTSize, hop, settings.mWindow, job.mReducer);
+	enum { kSlicesPerBlock = 16 };
+	std::vector<Float32> frames(kSlicesPerBlock * hop), slices(kSlicesPerBlock * bands);
+	
+	Float32 *columns = &job.mColumns[0];
+	UInt32 column = firstColumn;
+	while (slice < endSlice) {
+		// whole hops only, so every call starts on a hop and yields exactly this many slices
+		UInt32 numSlices = UInt32(std::min(SInt64(kSlicesPerBlock), endSlice - slice));
+		job.mFile->ReadFrames(slice * hop, numSlices * hop, settings.mChannel, &frames[0]);
+		Float32 minAmp, maxAmp;
+		analyzer.Process(&frames[0], numSlices * hop, 0, &slices[0], minAmp, maxAmp);
+		
+		for (UInt32 k = 0; k < numSlices; ++k, ++slice) {
+			if (slice < firstSlice) continue;
+			while (column < endColumn && job.EndSlice(column) <= slice)
+				++column;
+			// a slice can fall in several columns when there are fewer slices than columns
+			for (UInt32 c = column; c < endColumn && job.FirstSlice(c) <= slice; ++c) {
+				const Float32 *in = &slices[k * bands];
+				Float32 *out = columns + size_t(c) * bands;
+				bool first = (job.FirstSlice(c) == slice);
+				for (UInt32 i = 0; i < bands; ++i)
+					out[i] = (first || in[i] > out[i]) ? in[i] : out[i];
+			}
+		}
+	}
+}
+
+#pragma mark ____Rendering
+
+static bool	RenderFile(const char *inPath, const std::string &inOutPath, const RenderSettings &inSettings,
+						SonogramThreadPool &inPool, double &ioAudioSeconds)
+{
+	SonogramWAVFile file;
+	if (!file.Open(inPath)) {
+		fprintf(stderr, "%s: %s\n", inPath, file.Error());
+		return false;
+	}
+	if (inSettings.mChannel != kSonogramWAVChannel_Mix && inSettings.mChannel >= file.NumberChannels()) {
+		fprintf(stderr, "%s: no channel %u\n", inPath, (unsigned)inSettings.mChannel);
+		return false;
+	}
+	
+	const double start = Now();
+	const UInt32 width = inSettings.mWidth, height = inSettings.mHeight;
+	
+	SonogramBinReducer reducer(inSettings.mFFTSize / 2, file.SampleRate(), inSettings.mScale, height);
+	RenderJob job;
+	job.mFile = &file;
+	job.mSettings = &inSettings;
+	job.mReducer = &reducer;
+	job.mHopSize = inSettings.mHopSize ? inSettings.mHopSize : inSettings.mFFTSize / 4;
+	job.mNumberSlices = std::max(SInt64(1), (file.NumberFrames() + job.mHopSize - 1) / job.mHopSize);
+	// several runs per thread, so that the stealing can even out the load
+	job.mNumberTasks = std::min(width, 8 * (inPool.NumberThreads() + 1));
+	job.mColumns.resize(size_t(width) * height);
+	
+	inPool.Run(RenderColumns, &job, job.mNumberTasks);
+	
+	Float32 maxDB = inSettings.mMaxDB;
+	if (maxDB <= 0.f) {
+		Float32 maxAmp = 0.f;
+		for (size_t i = 0; i < job.mColumns.size(); ++i)
+			maxAmp = std::max(maxAmp, job.mColumns[i]);
+		maxDB = 20.f * log10f(1.f + maxAmp);
+	}
+	
+	// color a column at a time, then lay the columns out with the highest band on top
+	CASonogramColormap colormap;
+	colormap.SetColors(inSettings.mBackground, inSettings.mForeground);
+	std::vector<UInt32> column(height), image(size_t(width) * height);
+	for (UInt32 x = 0; x < width; ++x) {
+		colormap.ColorSlice(kSonogramStorage_Float32, &job.mColumns[size_t(x) * height], height, 0.f, maxDB, (Byte *)&column[0]);
+		for (UInt32 y = 0; y < height; ++y)
+			image[size_t(height - 1 - y) * width + x] = column[y];
+	}
+	
+	bool written = inSettings.mRaw ? SonogramWriteRGBA(inOutPath.c_str(), (const Byte *)&image[0], width, height)
+									: SonogramWritePNG(inOutPath.c_str(), (const Byte *)&image[0], width, height);
+	if (!written) {
+		fprintf(stderr, "%s: %s\n", inOutPath.c_str(), strerror(errno));
+		return false;
+	}
+	
+	const double seconds = Now() - start, audio = file.NumberFrames() / file.SampleRate();
+	ioAudioSeconds += audio;
+	printf("%s -> %s (%ux%u%s): %.1f min of audio in %.2f s\n", inPath, inOutPath.c_str(),
+			(unsigned)width, (unsigned)height, inSettings.mRaw ? " RGBA" : "", audio / 60., seconds);
+	return true;
+}
+
+#pragma mark ____Options
+
+static void	Usage()
+{
+	fprintf(stderr,
+		"usage: sonogramrender [options] file.wav ...\n"
+		"  -o, --output PATH      image for a single input (default: input name, .png or .rgba)\n"
+		"  -d, --directory DIR    put the images here instead of next to the inputs\n"
+		"  -W, --width N          columns, from the start of the file to the end (1024)\n"
+		"  -H, --height N         bands, lowest at the bottom (256)\n"
+		"  -f, --fft N            FFT size, a power of 2 from 64 to 65536 (2048)\n"
+		"  -h, --hop N            frames between slices (a quarter of the FFT)\n"
+		"  -w, --window NAME      hann, blackman or kaiser (hann)\n"
+		"  -s, --scale NAME       linear, log, mel or cq (log)\n"
+		"  -c, --channel N|mix    channel from 0, or the average of all (mix)\n"
+		"  -r, --range DB         dB that gets the foreground color (the loudest bin)\n"
+		"      --colors BG:FG     background and foreground as RRGGBB (000000:ffffff)\n"
+		"      --raw              write raw RGBA pixels instead of PNG\n"
+		"  -j, --threads N        analysis threads (one per processor)\n");
+}
+
+static bool	ParseColor(const char *inText, Float32 outColor[3])
+{
+	char *end;
+	unsigned long rgb = strtoul(inText, &end, 16);
+	if (end != inText + 6) return false;
+	for (UInt32 c = 0; c < 3; ++c)
+		outColor[c] = ((rgb >> (16 - 8 * c)) & 0xFF) / 255.f;
+	return true;
+}
+
+static bool	ParseName(const char *inText, const char *const inNames[], UInt32 inCount, UInt32 &outValue)
+{
+	for (UInt32 i = 0; i < inCount; ++i)
+		if (!strcmp(inText, inNames[i])) {
+			outValue = i;
+			return true;
+		}
+	return false;
+}
+
+static std::string	OutputPath(const char *inInput, const char *inDirectory, bool inRaw)
+{
+	std::string path = inInput;
+	std::string::size_type slash = path.rfind('/');
+	std::string name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+	std::string::size_type dot = name.rfind('.');
+	if (dot != std::string::npos && dot > 0)
+		name.erase(dot);
+	name += inRaw ? ".rgba" : ".png";
+	
+	if (inDirectory)
+		return std::string(inDirectory) + "/" + name;
+	return (slash == std::string::npos) ? name : path.substr(0, slash + 1) + name;
+}
+
+int main(int argc, char *const argv[])
+{
+	RenderSettings settings = { 1024, 256, 2048, 0, kSonogramWindow_Hann, kSonogramScale_Log,
+								kSonogramWAVChannel_Mix, 0.f, { 0.f, 0.f, 0.f }, { 1.f, 1.f, 1.f }, false, 0 };
+	const char *output = NULL, *directory = NULL;
+	
+	enum { kOptionColors = 256, kOptionRaw };
+	static const struct option options[] = {
+		{ "output",		required_argument,	NULL, 'o' },
+		{ "directory",	required_argument,	NULL, 'd' },
+		{ "width",		required_argument,	NULL, 'W' },
+		{ "height",		required_argument,	NULL, 'H' },
+		{ "fft",		required_argument,	NULL, 'f' },
+		{ "hop",		required_argument,	NULL, 'h' },
+		{ "window",		required_argument,	NULL, 'w' },
+		{ "scale",		required_argument,	NULL, 's' },
+		{ "channel",	required_argument,	NULL, 'c' },
+		{ "range",		required_argument,	NULL, 'r' },
+		{ "colors",		required_argument,	NULL, kOptionColors },
+		{ "raw",		no_argument,		NULL, kOptionRaw },
+		{ "threads",	required_argument,	NULL, 'j' },
+		{ NULL,			0,					NULL, 0 }
+	};
+	static const char *const windows[] = { "hann", "blackman", "kaiser" };
+	static const char *const scales[] = { "linear", "log", "mel", "cq" };
+	
+	int ch;
+	bool ok = true;
+	while (ok && (ch = getopt_long(argc, argv, "o:d:W:H:f:h:w:s:c:r:j:", options, NULL)) != -1) {
+		switch (ch) {
+			case 'o':	output = optarg;										break;
+			case 'd':	directory = optarg;										break;
+			case 'W':	settings.mWidth = strtoul(optarg, NULL, 0);				break;
+			case 'H':	settings.mHeight = strtoul(optarg, NULL, 0);			break;
+			case 'f':	settings.mFFTSize = strtoul(optarg, NULL, 0);			break;
+			case 'h':	settings.mHopSize = strtoul(optarg, NULL, 0);			break;
+			case 'w':	ok = ParseName(optarg, windows, 3, settings.mWindow);	break;
+			case 's':	ok = ParseName(optarg, scales, 4, settings.mScale);		break;
+			case 'c':
+				if (!strcmp(optarg, "mix"))
+					settings.mChannel = kSonogramWAVChannel_Mix;
+				else
+					settings.mChannel = strtoul(optarg, NULL, 0);
+				break;
+			case 'r':	settings.mMaxDB = strtod(optarg, NULL);					break;
+			case kOptionColors:
+				ok = strlen(optarg) == 13 && optarg[6] == ':' &&
+						ParseColor(optarg, settings.mBackground) && ParseColor(optarg + 7, settings.mForeground);
+				break;
+			case kOptionRaw:	settings.mRaw = true;							break;
+			case 'j':	settings.mThreads = strtoul(optarg, NULL, 0);			break;
+			default:	ok = false;												break;
+		}
+	}
+	const int numInputs = argc - optind;
+	UInt32 fft = settings.mFFTSize;
+	if (!ok || numInputs < 1 || (output && numInputs > 1) || settings.mWidth == 0 || settings.mHeight == 0 ||
+		fft < 64 || fft > 65536 || (fft & (fft - 1))) {
+		Usage();
+		return 2;
+	}
+	
+	// the caller of Run is one of the threads
+	UInt32 threads = settings.mThreads ? settings.mThreads : SonogramThreadPool::NumberProcessors();
+	SonogramThreadPool pool;
+	pool.Start(threads - 1);
+	
+	const double start = Now();
+	double audioSeconds = 0.;
+	int failures = 0;
+	for (int i = optind; i < argc; ++i) {
+		std::string path = output ? std::string(output) : OutputPath(argv[i], directory, settings.mRaw);
+		if (!RenderFile(argv[i], path, settings, pool, audioSeconds))
+			++failures;
+	}
+	threads = pool.NumberThreads() + 1;
+	pool.Stop();
+	
+	const double minutes = (Now() - start) / 60.;
+	printf("%d file%s, %.2f h of audio in %.2f min on %u thread%s: %.1f audio hours per minute\n",
+			numInputs - failures, (numInputs - failures == 1) ? "" : "s", audioSeconds / 3600., minutes,
+			(unsigned)threads, (threads == 1) ? "" : "s",
+			minutes > 0. ? audioSeconds / 3600. / minutes : 0.);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,207 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramWAVFile.cpp
+	
+=============================================================================*/
+
+#include "SonogramWAVFile.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+
+// WAVE is little endian whatever the host is
+static inline UInt32	LE16(const Byte *p)	{ return p[0] | (p[1] << 8); }
+static inline UInt32	LE32(const Byte *p)	{ return p[0] | (p[1] << 8) | (p[2] << 16) | (UInt32(p[3]) << 24); }
+
+SonogramWAVFile::SonogramWAVFile() :
+	mFile(-1), mSampleRate(0.), mNumberChannels(0), mBitsPerSample(0), mBytesPerFrame(0),
+	mFloat(false), mDataOffset(0), mNumberFrames(0)
+{
+	mError[0] = 0;
+}
+
+SonogramWAVFile::~SonogramWAVFile()
+{
+	Close();
+}
+
+void	SonogramWAVFile::Close()
+{
+	if (mFile >= 0) {
+		close(mFile);
+		mFile = -1;
+	}
+	mNumberFrames = 0;
+}
+
+bool	SonogramWAVFile::Open(const char *inPath)
+{
+	Close();
+	
+	mFile = open(inPath, O_RDONLY);
+	if (mFile < 0) {
+		snprintf(mError, sizeof(mError), "can't open the file");
+		return false;
+	}
+	struct stat st;
+	fstat(mFile, &st);
+	const SInt64 fileSize = st.st_size;
+	
+	Byte riff[12];
+	if (pread(mFile, riff, 12, 0) != 12 || memcmp(riff, "RIFF", 4) || memcmp(riff + 8, "WAVE", 4)) {
+		snprintf(mError, sizeof(mError), "not a WAVE file");
+		Close();
+		return false;
+	}
+	
+	// walk the chunks; fmt comes before data
+	bool haveFormat = false;
+	SInt64 offset = 12;
+	for (;;) {
+		Byte chunk[8];
+		if (pread(mFile, chunk, 8, offset) != 8) {
+			snprintf(mError, sizeof(mError), haveFormat ? "no data chunk" : "no fmt chunk");
+			Close();
+			return false;
+		}
+		SInt64 size = LE32(chunk + 4);
+		if (!memcmp(chunk, "fmt ", 4)) {
+			Byte fmt[40];
+			memset(fmt, 0, sizeof(fmt));
+			if (size < 16 || pread(mFile, fmt, std::min(size, SInt64(sizeof(fmt))), offset + 8) < 16) {
+				snprintf(mError, sizeof(mError), "bad fmt chunk");
+				Close();
+				return false;
+			}
+			UInt32 tag = LE16(fmt);
+			if (tag == 0xFFFE && size >= 26)		// WAVE_FORMAT_EXTENSIBLE: the sub format starts with the tag
+				tag = LE16(fmt + 24);
+			mNumberChannels = LE16(fmt + 2);
+			mSampleRate = LE32(fmt + 4);
+			mBytesPerFrame = LE16(fmt + 12);
+			mBitsPerSample = LE16(fmt + 14);
+			mFloat = (tag == 3);
+			bool supported = (tag == 1 && mBitsPerSample >= 8 && mBitsPerSample <= 32) ||
+							 (tag == 3 && (mBitsPerSample == 32 || mBitsPerSample == 64));
+			if (!supported || mNumberChannels == 0 || mBytesPerFrame < mNumberChannels * ((mBitsPerSample + 7) / 8)) {
+				snprintf(mError, sizeof(mError), "unsupported format (tag %u, %u bits)", (unsigned)tag, (unsigned)mBitsPerSample);
+				Close();
+				return false;
+			}
+			haveFormat = true;
+		} else if (!memcmp(chunk, "data", 4) && haveFormat) {
+			mDataOffset = offset + 8;
+			// files that were still being written say 0 or 0xFFFFFFFF; take the rest of the file
+			if (size == 0 || size == 0xFFFFFFFFLL || mDataOffset + size > fileSize)
+				size = fileSize - mDataOffset;
+			mNumberFrames = size / mBytesPerFrame;
+			return true;
+		}
+		offset += 8 + size + (size & 1);
+	}
+}
+
+Float32	SonogramWAVFile::Sample(const Byte *inFrame, UInt32 inChannel) const
+{
+	const UInt32 bytes = (mBitsPerSample + 7) / 8;
+	const Byte *p = inFrame + inChannel * bytes;
+	if (mFloat) {
+		if (bytes == 4) {
+			UInt32 bits = LE32(p);
+			Float32 f;
+			memcpy(&f, &bits, 4);
+			return f;
+		}
+		UInt64 bits = LE32(p) | (UInt64(LE32(p + 4)) << 32);
+		Float64 d;
+		memcpy(&d, &bits, 8);
+		return Float32(d);
+	}
+	if (bytes == 1)
+		return (p[0] - 128) * (1.f / 128.f);
+	// left justify in 32 bits, so that every width has the same full scale
+	UInt32 word = 0;
+	for (UInt32 i = 0; i < bytes; ++i)
+		word |= UInt32(p[i]) << (32 - 8 * bytes + 8 * i);
+	return SInt32(word) * (1.f / 2147483648.f);
+}
+
+void	SonogramWAVFile::ReadFrames(SInt64 inStartFrame, UInt32 inNumFrames, UInt32 inChannel, Float32 *outFrames) const
+{
+	// silence before and after the file
+	while (inNumFrames && inStartFrame < 0) {
+		*outFrames++ = 0.f;
+		++inStartFrame;
+		--inNumFrames;
+	}
+	UInt32 inFile = UInt32(std::max(SInt64(0), std::min(SInt64(inNumFrames), mNumberFrames - inStartFrame)));
+	memset(outFrames + inFile, 0, (inNumFrames - inFile) * sizeof(Float32));
+	
+	Byte buffer[kReadBytes];
+	const UInt32 framesPerRead = std::max(UInt32(1), UInt32(sizeof(buffer) / mBytesPerFrame));
+	const Float32 mixGain = 1.f / mNumberChannels;
+	while (inFile) {
+		UInt32 n = std::min(inFile, framesPerRead);
+		ssize_t got = pread(mFile, buffer, size_t(n) * mBytesPerFrame, mDataOffset + inStartFrame * mBytesPerFrame);
+		UInt32 frames = (got > 0) ? UInt32(got / mBytesPerFrame) : 0;
+		for (UInt32 i = 0; i < frames; ++i) {
+			const Byte *frame = buffer + i * mBytesPerFrame;
+			if (inChannel == kSonogramWAVChannel_Mix) {
+				Float32 sum = 0.f;
+				for (UInt32 c = 0; c < mNumberChannels; ++c)
+					sum += Sample(frame, c);
+				outFrames[i] = sum * mixGain;
+			} else
+				outFrames[i] = Sample(frame, inChannel < mNumberChannels ? inChannel : 0);
+		}
+		if (frames < n) {		// the file is shorter than it said
+			memset(outFrames + frames, 0, (inFile - frames) * sizeof(Float32));
+			return;
+		}
+		outFrames += n;
+		inStartFrame += n;
+		inFile -= n;
+	}
+}
@@ -0,0 +1,102 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	SonogramWAVFile.h
+	
+=============================================================================*/
+
+#ifndef __SonogramWAVFile_h__
+#define __SonogramWAVFile_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+/*
+	Reads the sample frames of a RIFF WAVE file: integer PCM of 8 to 32 bits and 32 or
+	64 bit floats, plain or WAVE_FORMAT_EXTENSIBLE. It uses no audio toolbox, so the
+	renderer runs wherever there is a C++ compiler.
+	
+	ReadFrames only uses pread, so any number of threads can read different parts of
+	one open file at the same time.
+*/
+
+enum {
+	kSonogramWAVChannel_Mix		= 0xFFFFFFFF	// average of all channels
+};
+
+class SonogramWAVFile {
+public:
+	SonogramWAVFile();
+	~SonogramWAVFile();
+	
+	// false, with a reason in Error(), if the file can't be read
+	bool			Open(const char *inPath);
+	void			Close();
+	const char *	Error() const				{ return mError; }
+	
+	Float64			SampleRate() const			{ return mSampleRate; }
+	UInt32			NumberChannels() const		{ return mNumberChannels; }
+	SInt64			NumberFrames() const		{ return mNumberFrames; }
+	
+	// inNumFrames frames of one channel (or kSonogramWAVChannel_Mix) from inStartFrame,
+	// as floats from -1 to 1; frames outside the file read as silence
+	void			ReadFrames(SInt64 inStartFrame, UInt32 inNumFrames, UInt32 inChannel, Float32 *outFrames) const;
+
+private:
+	enum { kReadBytes = 32768 };		// per pread, on the stack
+	
+	Float32			Sample(const Byte *inFrame, UInt32 inChannel) const;
+	
+	int				mFile;
+	char			mError[128];
+	Float64			mSampleRate;
+	UInt32			mNumberChannels;
+	UInt32			mBitsPerSample;
+	UInt32			mBytesPerFrame;
+	bool			mFloat;
+	SInt64			mDataOffset;
+	SInt64			mNumberFrames;
+};
+
+#endif // __SonogramWAVFile_h__
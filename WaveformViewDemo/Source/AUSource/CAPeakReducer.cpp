@@ -0,0 +1,260 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAPeakReducer.cpp
+	
+=============================================================================*/
+
+#include "CAPeakReducer.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+	#define CA_PEAK_X86 1
+#elif (defined(__ARM_NEON__) || defined(__ARM_NEON)) && defined(__aarch64__)
+	#include <arm_neon.h>
+	#define CA_PEAK_NEON 1
+#endif
+
+#pragma mark -- Kernels --
+
+// Each kernel starts from the first frame's min and max, runs its vectors over as many
+// frames as fill them, and leaves the frames after that to ReduceFrames.
+
+static inline void	ReduceFrames(const Float32 *inFrames, UInt32 inBegin, UInt32 inEnd, CAPeakStatistics &ioStats)
+{
+	Float32 mn = ioStats.mMin, mx = ioStats.mMax, ss = ioStats.mSumSquares;
+	UInt32 crossings = ioStats.mZeroCrossings;
+	bool negative = inFrames[inBegin > 0 ? inBegin - 1 : 0] < 0.f;
+	for (UInt32 i = inBegin; i < inEnd; ++i) {
+		Float32 x = inFrames[i];
+		if (x < mn) mn = x;
+		if (x > mx) mx = x;
+		ss += x * x;
+		bool n = x < 0.f;
+		crossings += (n != negative);
+		negative = n;
+	}
+	ioStats.mMin = mn;
+	ioStats.mMax = mx;
+	ioStats.mSumSquares = ss;
+	ioStats.mZeroCrossings = crossings;
+}
+
+static inline void	StartFrames(const Float32 *inFrames, CAPeakStatistics &outStats)
+{
+	outStats.mMin = outStats.mMax = inFrames[0];
+	outStats.mSumSquares = 0.f;
+	outStats.mZeroCrossings = 0;
+}
+
+static void	ReduceScalarKernel(const Float32 *inFrames, UInt32 inNumFrames, CAPeakStatistics &ioStats)
+{
+	ReduceFrames(inFrames, 0, inNumFrames, ioStats);
+}
+
+#if CA_PEAK_X86
+// The sign bits of each vector come out as an integer mask; a crossing is a bit that
+// differs from the one below it, the lowest bit being compared with the last vector's top
+// (the first frame's sign, to begin with). The bits are counted by table, since neither
+// kernel may assume the POPCNT instruction.
+
+static const UInt8 kBitCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+// folds the lanes of the vector min, max and sum into ioStats
+__attribute__((target("sse2")))
+static inline void	FoldSSE(__m128 inMin, __m128 inMax, __m128 inSum, CAPeakStatistics &ioStats)
+{
+	inMin = _mm_min_ps(inMin, _mm_movehl_ps(inMin, inMin));
+	inMax = _mm_max_ps(inMax, _mm_movehl_ps(inMax, inMax));
+	inSum = _mm_add_ps(inSum, _mm_movehl_ps(inSum, inSum));
+	inMin = _mm_min_ss(inMin, _mm_shuffle_ps(inMin, inMin, 1));
+	inMax = _mm_max_ss(inMax, _mm_shuffle_ps(inMax, inMax, 1));
+	inSum = _mm_add_ss(inSum, _mm_shuffle_ps(inSum, inSum, 1));
+	ioStats.mMin = _mm_cvtss_f32(inMin);
+	ioStats.mMax = _mm_cvtss_f32(inMax);
+	ioStats.mSumSquares += _mm_cvtss_f32(inSum);
+}
+
+__attribute__((target("sse2")))
+static void	ReduceSSE(const Float32 *inFrames, UInt32 inNumFrames, CAPeakStatistics &ioStats)
+{
+	UInt32 i = 0;
+	if (inNumFrames >= 4) {
+		const __m128 zero = _mm_setzero_ps();
+		__m128 mn = _mm_set1_ps(ioStats.mMin), mx = mn, ss = _mm_setzero_ps();
+		UInt32 carry = inFrames[0] < 0.f, crossings = 0;
+		for ( ; i + 4 <= inNumFrames; i += 4) {
+			__m128 x = _mm_loadu_ps(inFrames + i);
+			mn = _mm_min_ps(mn, x);
+			mx = _mm_max_ps(mx, x);
+			ss = _mm_add_ps(ss, _mm_mul_ps(x, x));
+			UInt32 signs = _mm_movemask_ps(_mm_cmplt_ps(x, zero));
+			crossings += kBitCount[(signs ^ ((signs << 1) | carry)) & 0xF];
+			carry = signs >> 3;
+		}
+		FoldSSE(mn, mx, ss, ioStats);
+		ioStats.mZeroCrossings += crossings;
+	}
+	ReduceFrames(inFrames, i, inNumFrames, ioStats);
+}
+
+__attribute__((target("avx2")))
+static void	ReduceAVX2(const Float32 *inFrames, UInt32 inNumFrames, CAPeakStatistics &ioStats)
+{
+	UInt32 i = 0;
+	if (inNumFrames >= 8) {
+		const __m256 zero = _mm256_setzero_ps();
+		__m256 mn = _mm256_set1_ps(ioStats.mMin), mx = mn, ss = _mm256_setzero_ps();
+		UInt32 carry = inFrames[0] < 0.f, crossings = 0;
+		for ( ; i + 8 <= inNumFrames; i += 8) {
+			__m256 x = _mm256_loadu_ps(inFrames + i);
+			mn = _mm256_min_ps(mn, x);
+			mx = _mm256_max_ps(mx, x);
+			ss = _mm256_add_ps(ss, _mm256_mul_ps(x, x));
+			UInt32 signs = _mm256_movemask_ps(_mm256_cmp_ps(x, zero, _CMP_LT_OQ));
+			UInt32 differ = signs ^ ((signs << 1) | carry);
+			crossings += kBitCount[differ & 0xF] + kBitCount[(differ >> 4) & 0xF];
+			carry = signs >> 7;
+		}
+		FoldSSE(_mm_min_ps(_mm256_castps256_ps128(mn), _mm256_extractf128_ps(mn, 1)),
+				_mm_max_ps(_mm256_castps256_ps128(mx), _mm256_extractf128_ps(mx, 1)),
+				_mm_add_ps(_mm256_castps256_ps128(ss), _mm256_extractf128_ps(ss, 1)), ioStats);
+		ioStats.mZeroCrossings += crossings;
+	}
+	ReduceFrames(inFrames, i, inNumFrames, ioStats);
+}
+#elif CA_PEAK_NEON
+// Each vector's signs are compared with those of the same frames moved up one, the lowest
+// lane taking the last vector's top (the first frame, to begin with); the differing lanes
+// are all ones, so subtracting them counts them.
+
+static void	ReduceNEON(const Float32 *inFrames, UInt32 inNumFrames, CAPeakStatistics &ioStats)
+{
+	UInt32 i = 0;
+	if (inNumFrames >= 4) {
+		float32x4_t mn = vdupq_n_f32(ioStats.mMin), mx = mn, ss = vdupq_n_f32(0.f), last = mn;
+		uint32x4_t crossings = vdupq_n_u32(0);
+		for ( ; i + 4 <= inNumFrames; i += 4) {
+			float32x4_t x = vld1q_f32(inFrames + i);
+			mn = vminq_f32(mn, x);
+			mx = vmaxq_f32(mx, x);
+			ss = vmlaq_f32(ss, x, x);
+			uint32x4_t differ = veorq_u32(vcltzq_f32(x), vcltzq_f32(vextq_f32(last, x, 3)));
+			crossings = vsubq_u32(crossings, differ);
+			last = x;
+		}
+		ioStats.mMin = vminvq_f32(mn);
+		ioStats.mMax = vmaxvq_f32(mx);
+		ioStats.mSumSquares += vaddvq_f32(ss);
+		ioStats.mZeroCrossings += vaddvq_u32(crossings);
+	}
+	ReduceFrames(inFrames, i, inNumFrames, ioStats);
+}
+#endif
+
+enum { kScalar = 0, kSSE, kAVX2, kNEON };
+
+static int	BestInstructionSet()
+{
+#if CA_PEAK_X86
+	#if defined(__GNUC__)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return kAVX2;
+	#endif
+	return kSSE;
+#elif CA_PEAK_NEON
+	return kNEON;
+#else
+	return kScalar;
+#endif
+}
+
+typedef void (*KernelProc)(const Float32 *inFrames, UInt32 inNumFrames, CAPeakStatistics &ioStats);
+
+static KernelProc	ChooseKernel(int isa)
+{
+	switch (isa) {
+#if CA_PEAK_X86
+		case kAVX2:	return ReduceAVX2;
+		case kSSE:	return ReduceSSE;
+#elif CA_PEAK_NEON
+		case kNEON:	return ReduceNEON;
+#endif
+	}
+	return ReduceScalarKernel;
+}
+
+#pragma mark -- CAPeakReducer --
+
+static void	Run(KernelProc inKernel, const Float32 *inFrames, UInt32 inNumFrames, CAPeakStatistics &outStats)
+{
+	if (inNumFrames == 0) {
+		outStats.mMin = outStats.mMax = outStats.mAbsMax = outStats.mSumSquares = 0.f;
+		outStats.mZeroCrossings = 0;
+		return;
+	}
+	StartFrames(inFrames, outStats);
+	(*inKernel)(inFrames, inNumFrames, outStats);
+	// the larger magnitude is at one end or the other, so it needn't be tracked
+	outStats.mAbsMax = (-outStats.mMin > outStats.mMax) ? -outStats.mMin : outStats.mMax;
+}
+
+void	CAPeakReducer::Reduce(const Float32 *inFrames, UInt32 inNumFrames, CAPeakStatistics &outStats)
+{
+	static const KernelProc kernel = ChooseKernel(BestInstructionSet());
+	Run(kernel, inFrames, inNumFrames, outStats);
+}
+
+void	CAPeakReducer::ReduceScalar(const Float32 *inFrames, UInt32 inNumFrames, CAPeakStatistics &outStats)
+{
+	Run(ReduceScalarKernel, inFrames, inNumFrames, outStats);
+}
+
+const char *	CAPeakReducer::InstructionSet()
+{
+	switch (BestInstructionSet()) {
+		case kAVX2:	return "AVX2";
+		case kSSE:	return "SSE";
+		case kNEON:	return "NEON";
+	}
+	return "scalar";
+}
@@ -0,0 +1,88 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAPeakReducer.h
+	
+=============================================================================*/
+
+#ifndef __CAPeakReducer_h__
+#define __CAPeakReducer_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+/*
+	The level statistics of a run of samples, all in one pass over them, with the widest
+	vector instructions the processor has (AVX2 or SSE2 on Intel, NEON on ARM, plain C
+	elsewhere), chosen once at run time. It does not depend on vDSP.
+	
+	mMin and mMax are the signal's, not its magnitude's; mAbsMax is the larger magnitude of
+	the two. mZeroCrossings counts the neighbouring pairs of frames one of which is negative
+	and the other not, so a run of one frame has none. The sums are accumulated in vector
+	lanes, so mSumSquares can differ from a sequential sum in the last bits, and between
+	instruction sets.
+*/
+
+struct CAPeakStatistics
+{
+	Float32				mMin;
+	Float32				mMax;
+	Float32				mAbsMax;
+	Float32				mSumSquares;
+	UInt32				mZeroCrossings;
+};
+
+class CAPeakReducer {
+public:
+	// the statistics of inNumFrames frames; all zero if there are none
+	static void			Reduce(const Float32 *inFrames, UInt32 inNumFrames, CAPeakStatistics &outStats);
+	
+	// the plain C version, whatever the processor
+	static void			ReduceScalar(const Float32 *inFrames, UInt32 inNumFrames, CAPeakStatistics &outStats);
+	
+	// "AVX2", "SSE", "NEON" or "scalar": what Reduce uses on this machine
+	static const char *	InstructionSet();
+};
+
+#endif // __CAPeakReducer_h__
@@ -0,0 +1,321 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	WaveformHistoryCodec.cpp
+	
+=============================================================================*/
+
+#include "WaveformHistoryCodec.h"
+#include <string.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+	#define WAVEFORM_X86 1
+#elif (defined(__ARM_NEON__) || defined(__ARM_NEON)) && defined(__aarch64__)
+	#include <arm_neon.h>
+	#define WAVEFORM_NEON 1
+#endif
+
+static const Float32 kInt16Scale = 32767.f;
+
+#pragma mark -- Scalar --
+
+static inline UInt16	FloatToHalf(Float32 inValue)
+{
+	UInt32 x;
+	memcpy(&x, &inValue, sizeof(x));
+	UInt32 sign = (x >> 16) & 0x8000;
+	x &= 0x7FFFFFFF;
+	
+	if (x >= 0x7F800000)							// infinity or NaN, which stays a NaN
+		return sign | 0x7C00 | ((x > 0x7F800000) ? 0x200 : 0);
+	if (x >= 0x477FF000)							// 65520 and up round to infinity
+		return sign | 0x7C00;
+	if (x < 0x38800000) {
+		// below the smallest normal half: adding 0.5, whose last place is the smallest
+		// subnormal half, leaves the rounded subnormal in the low bits
+		Float32 f;
+		memcpy(&f, &x, sizeof(f));
+		f += 0.5f;
+		memcpy(&x, &f, sizeof(x));
+		return sign | (x - 0x3F000000);
+	}
+	// rebias the exponent and round the 13 bits that go to nearest, even on a tie
+	x += 0xC8000FFF + ((x >> 13) & 1);
+	return sign | (x >> 13);
+}
+
+static inline Float32	HalfToFloat(UInt16 inHalf)
+{
+	UInt32 sign = UInt32(inHalf & 0x8000) << 16, exponent = (inHalf >> 10) & 0x1F, mantissa = inHalf & 0x3FF;
+	UInt32 x;
+	if (exponent == 0x1F)
+		x = sign | 0x7F800000 | (mantissa << 13);
+	else if (exponent == 0) {
+		Float32 f = mantissa * (1.f / 16777216.f);		// subnormal: mantissa * 2^-24
+		memcpy(&x, &f, sizeof(x));
+		x |= sign;
+	} else
+		x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+	Float32 f;
+	memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+static inline SInt16	FloatToInt16(Float32 inValue)
+{
+	Float32 x = inValue * kInt16Scale;
+	if (!(x > -kInt16Scale)) return -32767;			// NaN too
+	if (x >= kInt16Scale) return 32767;
+	return SInt16(lrintf(x));						// to nearest, even on a tie, as the vectors do
+}
+
+static void	EncodeHalfScalar(const Float32 *inFrames, UInt16 *outPacked, UInt32 inBegin, UInt32 inEnd)
+{
+	for (UInt32 i = inBegin; i < inEnd; ++i)
+		outPacked[i] = FloatToHalf(inFrames[i]);
+}
+
+static void	DecodeHalfScalar(const UInt16 *inPacked, Float32 *outFrames, UInt32 inBegin, UInt32 inEnd)
+{
+	for (UInt32 i = inBegin; i < inEnd; ++i)
+		outFrames[i] = HalfToFloat(inPacked[i]);
+}
+
+static void	EncodeInt16Scalar(const Float32 *inFrames, SInt16 *outPacked, UInt32 inBegin, UInt32 inEnd)
+{
+	for (UInt32 i = inBegin; i < inEnd; ++i)
+		outPacked[i] = FloatToInt16(inFrames[i]);
+}
+
+static void	DecodeInt16Scalar(const SInt16 *inPacked, Float32 *outFrames, UInt32 inBegin, UInt32 inEnd)
+{
+	for (UInt32 i = inBegin; i < inEnd; ++i)
+		outFrames[i] = inPacked[i] * (1.f / kInt16Scale);
+}
+
+#pragma mark -- Vector --
+
+// Each kernel converts as many frames as fill its vectors and returns how many; the
+// scalar versions do the rest.
+
+#if WAVEFORM_X86
+__attribute__((target("sse2")))
+static UInt32	EncodeInt16SSE(const Float32 *inFrames, SInt16 *outPacked, UInt32 inNumFrames)
+{
+	const __m128 lo = _mm_set1_ps(-1.f), hi = _mm_set1_ps(1.f), scale = _mm_set1_ps(kInt16Scale);
+	UInt32 i = 0;
+	for ( ; i + 8 <= inNumFrames; i += 8) {
+		// clamped first: out of range conversions give 0x80000000 whatever the sign
+		__m128 a = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(inFrames + i), lo), hi), scale);
+		__m128 b = _mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(inFrames + i + 4), lo), hi), scale);
+		_mm_storeu_si128((__m128i *)(outPacked + i), _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+	}
+	return i;
+}
+
+__attribute__((target("sse2")))
+static UInt32	DecodeInt16SSE(const SInt16 *inPacked, Float32 *outFrames, UInt32 inNumFrames)
+{
+	const __m128 scale = _mm_set1_ps(1.f / kInt16Scale);
+	UInt32 i = 0;
+	for ( ; i + 8 <= inNumFrames; i += 8) {
+		__m128i x = _mm_loadu_si128((const __m128i *)(inPacked + i));
+		// each 16 bits into the top of 32, then shifted down with their sign
+		__m128i a = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16), b = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+		_mm_storeu_ps(outFrames + i, _mm_mul_ps(_mm_cvtepi32_ps(a), scale));
+		_mm_storeu_ps(outFrames + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(b), scale));
+	}
+	return i;
+}
+
+__attribute__((target("avx,f16c")))
+static UInt32	EncodeHalfF16C(const Float32 *inFrames, UInt16 *outPacked, UInt32 inNumFrames)
+{
+	UInt32 i = 0;
+	for ( ; i + 8 <= inNumFrames; i += 8)
+		_mm_storeu_si128((__m128i *)(outPacked + i), _mm256_cvtps_ph(_mm256_loadu_ps(inFrames + i), _MM_FROUND_TO_NEAREST_INT));
+	return i;
+}
+
+__attribute__((target("avx,f16c")))
+static UInt32	DecodeHalfF16C(const UInt16 *inPacked, Float32 *outFrames, UInt32 inNumFrames)
+{
+	UInt32 i = 0;
+	for ( ; i + 8 <= inNumFrames; i += 8)
+		_mm256_storeu_ps(outFrames + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(inPacked + i))));
+	return i;
+}
+#elif WAVEFORM_NEON
+static UInt32	EncodeInt16NEON(const Float32 *inFrames, SInt16 *outPacked, UInt32 inNumFrames)
+{
+	const float32x4_t lo = vdupq_n_f32(-1.f), hi = vdupq_n_f32(1.f);
+	UInt32 i = 0;
+	for ( ; i + 8 <= inNumFrames; i += 8) {
+		float32x4_t a = vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(inFrames + i), lo), hi), kInt16Scale);
+		float32x4_t b = vmulq_n_f32(vminq_f32(vmaxq_f32(vld1q_f32(inFrames + i + 4), lo), hi), kInt16Scale);
+		vst1q_s16(outPacked + i, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b))));
+	}
+	return i;
+}
+
+static UInt32	DecodeInt16NEON(const SInt16 *inPacked, Float32 *outFrames, UInt32 inNumFrames)
+{
+	UInt32 i = 0;
+	for ( ; i + 8 <= inNumFrames; i += 8) {
+		int16x8_t x = vld1q_s16(inPacked + i);
+		vst1q_f32(outFrames + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), 1.f / kInt16Scale));
+		vst1q_f32(outFrames + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), 1.f / kInt16Scale));
+	}
+	return i;
+}
+
+static UInt32	EncodeHalfNEON(const Float32 *inFrames, UInt16 *outPacked, UInt32 inNumFrames)
+{
+	UInt32 i = 0;
+	for ( ; i + 4 <= inNumFrames; i += 4)
+		vst1_u16(outPacked + i, vreinterpret_u16_f16(vcvt_f16_f32(vld1q_f32(inFrames + i))));
+	return i;
+}
+
+static UInt32	DecodeHalfNEON(const UInt16 *inPacked, Float32 *outFrames, UInt32 inNumFrames)
+{
+	UInt32 i = 0;
+	for ( ; i + 4 <= inNumFrames; i += 4)
+		vst1q_f32(outFrames + i, vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(inPacked + i))));
+	return i;
+}
+#endif
+
+enum { kScalar = 0, kSSE, kAVX2, kNEON };
+
+static int	BestInstructionSet()
+{
+#if WAVEFORM_X86
+	#if defined(__GNUC__)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx2"))
+			return kAVX2;
+	#endif
+	return kSSE;
+#elif WAVEFORM_NEON
+	return kNEON;
+#else
+	return kScalar;
+#endif
+}
+
+#pragma mark -- WaveformHistoryCodec --
+
+void	WaveformHistoryCodec::Encode(UInt32 inFormat, const Float32 *inFrames, void *outPacked, UInt32 inNumFrames)
+{
+	static const int isa = BestInstructionSet();
+	UInt32 done = 0;
+	if (inFormat == kWaveformStorage_Float16) {
+		UInt16 *packed = static_cast<UInt16 *>(outPacked);
+#if WAVEFORM_X86
+		if (isa == kAVX2) done = EncodeHalfF16C(inFrames, packed, inNumFrames);
+#elif WAVEFORM_NEON
+		done = EncodeHalfNEON(inFrames, packed, inNumFrames);
+#endif
+		EncodeHalfScalar(inFrames, packed, done, inNumFrames);
+	} else if (inFormat == kWaveformStorage_Int16) {
+		SInt16 *packed = static_cast<SInt16 *>(outPacked);
+#if WAVEFORM_X86
+		done = EncodeInt16SSE(inFrames, packed, inNumFrames);
+#elif WAVEFORM_NEON
+		done = EncodeInt16NEON(inFrames, packed, inNumFrames);
+#endif
+		EncodeInt16Scalar(inFrames, packed, done, inNumFrames);
+	}
+	(void)isa;
+}
+
+void	WaveformHistoryCodec::Decode(UInt32 inFormat, const void *inPacked, Float32 *outFrames, UInt32 inNumFrames)
+{
+	static const int isa = BestInstructionSet();
+	UInt32 done = 0;
+	if (inFormat == kWaveformStorage_Float16) {
+		const UInt16 *packed = static_cast<const UInt16 *>(inPacked);
+#if WAVEFORM_X86
+		if (isa == kAVX2) done = DecodeHalfF16C(packed, outFrames, inNumFrames);
+#elif WAVEFORM_NEON
+		done = DecodeHalfNEON(packed, outFrames, inNumFrames);
+#endif
+		DecodeHalfScalar(packed, outFrames, done, inNumFrames);
+	} else if (inFormat == kWaveformStorage_Int16) {
+		const SInt16 *packed = static_cast<const SInt16 *>(inPacked);
+#if WAVEFORM_X86
+		done = DecodeInt16SSE(packed, outFrames, inNumFrames);
+#elif WAVEFORM_NEON
+		done = DecodeInt16NEON(packed, outFrames, inNumFrames);
+#endif
+		DecodeInt16Scalar(packed, outFrames, done, inNumFrames);
+	}
+	(void)isa;
+}
+
+void	WaveformHistoryCodec::EncodeScalar(UInt32 inFormat, const Float32 *inFrames, void *outPacked, UInt32 inNumFrames)
+{
+	if (inFormat == kWaveformStorage_Float16)
+		EncodeHalfScalar(inFrames, static_cast<UInt16 *>(outPacked), 0, inNumFrames);
+	else if (inFormat == kWaveformStorage_Int16)
+		EncodeInt16Scalar(inFrames, static_cast<SInt16 *>(outPacked), 0, inNumFrames);
+}
+
+void	WaveformHistoryCodec::DecodeScalar(UInt32 inFormat, const void *inPacked, Float32 *outFrames, UInt32 inNumFrames)
+{
+	if (inFormat == kWaveformStorage_Float16)
+		DecodeHalfScalar(static_cast<const UInt16 *>(inPacked), outFrames, 0, inNumFrames);
+	else if (inFormat == kWaveformStorage_Int16)
+		DecodeInt16Scalar(static_cast<const SInt16 *>(inPacked), outFrames, 0, inNumFrames);
+}
+
+const char *	WaveformHistoryCodec::InstructionSet()
+{
+	switch (BestInstructionSet()) {
+		case kAVX2:	return "AVX2";
+		case kSSE:	return "SSE";
+		case kNEON:	return "NEON";
+	}
+	return "scalar";
+}
@@ -0,0 +1,86 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	WaveformHistoryCodec.h
+	
+=============================================================================*/
+
+#ifndef __WaveformHistoryCodec_h__
+#define __WaveformHistoryCodec_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+// how the waveform history keeps its samples
+enum {
+	kWaveformStorage_Float32	= 0,
+	kWaveformStorage_Float16	= 1,	// IEEE half precision: about 3 digits, overs kept up to 65504
+	kWaveformStorage_Int16		= 2		// 16 bit fixed point of -1 to 1; overs are clipped
+};
+
+/*
+	Packs runs of samples into the 16 bit kWaveformStorage_* formats, and back, with the
+	widest vector instructions the processor has for them (F16C and SSE2 on Intel, NEON on
+	ARM, plain C elsewhere), chosen once at run time. Both round to nearest, even on a tie,
+	as the hardware conversions do; Int16 saturates.
+*/
+
+class WaveformHistoryCodec {
+public:
+	static UInt32		BytesPerFrame(UInt32 inFormat)	{ return (inFormat == kWaveformStorage_Float32) ? sizeof(Float32) : sizeof(UInt16); }
+	
+	// inNumFrames samples into inFormat, which must be one of the 16 bit ones
+	static void			Encode(UInt32 inFormat, const Float32 *inFrames, void *outPacked, UInt32 inNumFrames);
+	
+	static void			Decode(UInt32 inFormat, const void *inPacked, Float32 *outFrames, UInt32 inNumFrames);
+	
+	// the plain C versions, whatever the processor
+	static void			EncodeScalar(UInt32 inFormat, const Float32 *inFrames, void *outPacked, UInt32 inNumFrames);
+	static void			DecodeScalar(UInt32 inFormat, const void *inPacked, Float32 *outFrames, UInt32 inNumFrames);
+	
+	// "AVX2" (whose processors all have F16C), "SSE", "NEON" or "scalar"
+	static const char *	InstructionSet();
+};
+
+#endif // __WaveformHistoryCodec_h__
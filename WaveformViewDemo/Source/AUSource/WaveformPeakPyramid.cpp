@@ -0,0 +1,167 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	WaveformPeakPyramid.cpp
+	
+=============================================================================*/
+
+#include "WaveformPeakPyramid.h"
+#include "CAPeakReducer.h"
+#include <algorithm>
+
+void	WaveformPeakSum::Add(const Float32 *inFrames, UInt32 inNumFrames)
+{
+	if (inNumFrames == 0)
+		return;
+	CAPeakStatistics stats;
+	CAPeakReducer::Reduce(inFrames, inNumFrames, stats);
+	if (stats.mMin < mMin) mMin = stats.mMin;
+	if (stats.mMax > mMax) mMax = stats.mMax;
+	mSumSquares += stats.mSumSquares;
+}
+
+WaveformPeakPyramid::WaveformPeakPyramid(UInt32 inNumChannels, UInt32 inMaxFrames)
+{
+	for (UInt32 i = 0; i < kNumberLevels; ++i) {
+		Level *level = new Level;
+		for (UInt32 c = 0; c < inNumChannels; ++c) {
+			CARingBuffer *ring = new CARingBuffer();
+			ring->Allocate(1, sizeof(WaveformPeakSum), kCapacityBlocks);
+			level->mRings.push_back(ring);
+		}
+		level->mPartial.resize(inNumChannels);
+		mLevels.push_back(level);
+	}
+	// the most level 0 blocks one call can complete; the levels above complete fewer
+	mBlocks[0].resize(inMaxFrames / kBaseBlockFrames + 1);
+	mBlocks[1].resize(inMaxFrames / kBaseBlockFrames + 1);
+	Reset();
+}
+
+WaveformPeakPyramid::~WaveformPeakPyramid()
+{
+	for (UInt32 i = 0; i < mLevels.size(); ++i) {
+		for (UInt32 c = 0; c < mLevels[i]->mRings.size(); ++c)
+			delete mLevels[i]->mRings[c];
+		delete mLevels[i];
+	}
+}
+
+void	WaveformPeakPyramid::Reset()
+{
+	for (UInt32 i = 0; i < mLevels.size(); ++i)
+		for (UInt32 c = 0; c < mLevels[i]->mPartial.size(); ++c)
+			mLevels[i]->mPartial[c].Clear();
+}
+
+void	WaveformPeakPyramid::AddFrames(const AudioBufferList &inBuffer, UInt32 inNumFrames, SampleTime inStartFrame)
+{
+	const UInt32 numChannels = std::min(UInt32(inBuffer.mNumberBuffers), UInt32(mLevels[0]->mPartial.size()));
+	for (UInt32 c = 0; c < numChannels; ++c) {
+		const Float32 *frames = (const Float32 *)inBuffer.mBuffers[c].mData;
+		
+		// level 0: cut the frames at the block boundaries
+		WaveformPeakSum &partial = mLevels[0]->mPartial[c];
+		WaveformPeakSum *blocks = &mBlocks[0][0];
+		UInt32 numBlocks = 0;
+		SampleTime frame = inStartFrame;
+		for (UInt32 i = 0; i < inNumFrames; ) {
+			UInt32 n = std::min(UInt32(kBaseBlockFrames - (frame & (kBaseBlockFrames - 1))), inNumFrames - i);
+			partial.Add(frames + i, n);
+			i += n;
+			frame += n;
+			if ((frame & (kBaseBlockFrames - 1)) == 0) {
+				blocks[numBlocks++] = partial;
+				partial.Clear();
+			}
+		}
+		SampleTime firstBlock = inStartFrame >> kBaseBlockShift;
+		
+		// each level above pools the blocks the one below has just completed
+		for (UInt32 level = 0; numBlocks; ++level) {
+			Store(level, c, &mBlocks[level & 1][0], numBlocks, firstBlock);
+			if (level + 1 == kNumberLevels)
+				break;
+			
+			const WaveformPeakSum *in = &mBlocks[level & 1][0];
+			WaveformPeakSum *out = &mBlocks[(level + 1) & 1][0];
+			WaveformPeakSum &above = mLevels[level + 1]->mPartial[c];
+			UInt32 numOut = 0;
+			for (UInt32 i = 0; i < numBlocks; ++i) {
+				above.Add(in[i]);
+				if (((firstBlock + i + 1) & (kLevelFactor - 1)) == 0) {
+					out[numOut++] = above;
+					above.Clear();
+				}
+			}
+			numBlocks = numOut;
+			firstBlock >>= kLevelShift;
+		}
+	}
+}
+
+void	WaveformPeakPyramid::Store(UInt32 inLevel, UInt32 inChannel, const WaveformPeakSum *inBlocks, UInt32 inNumBlocks,
+								   SampleTime inFirstBlock)
+{
+	AudioBufferList abl;
+	abl.mNumberBuffers = 1;
+	abl.mBuffers[0].mNumberChannels = 1;
+	abl.mBuffers[0].mDataByteSize = inNumBlocks * sizeof(WaveformPeakSum);
+	abl.mBuffers[0].mData = (void *)inBlocks;
+	mLevels[inLevel]->mRings[inChannel]->Store(&abl, inNumBlocks, inFirstBlock);
+}
+
+bool	WaveformPeakPyramid::GetBlockBounds(UInt32 inLevel, SampleTime &outFirstBlock, SampleTime &outEndBlock)
+{
+	// every channel's ring is stored with the same blocks
+	return mLevels[inLevel]->mRings[0]->GetTimeBounds(outFirstBlock, outEndBlock) == kCARingBufferError_OK;
+}
+
+bool	WaveformPeakPyramid::FetchBlocks(UInt32 inLevel, UInt32 inChannel, SampleTime inFirstBlock, UInt32 inNumBlocks,
+										 WaveformPeakSum *outBlocks)
+{
+	AudioBufferList abl;
+	abl.mNumberBuffers = 1;
+	abl.mBuffers[0].mNumberChannels = 1;
+	abl.mBuffers[0].mDataByteSize = inNumBlocks * sizeof(WaveformPeakSum);
+	abl.mBuffers[0].mData = outBlocks;
+	return mLevels[inLevel]->mRings[inChannel]->Fetch(&abl, inNumBlocks, inFirstBlock, false) == kCARingBufferError_OK;
+}
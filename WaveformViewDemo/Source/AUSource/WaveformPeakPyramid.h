@@ -0,0 +1,132 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	WaveformPeakPyramid.h
+	
+=============================================================================*/
+
+#ifndef __WaveformPeakPyramid_h__
+#define __WaveformPeakPyramid_h__
+
+#include "CARingBuffer.h"
+#include <vector>
+
+/*
+	Min, max and sum of squares summaries of every channel's recent samples, at several
+	block sizes, so a view can draw any stretch of them at one column per pixel without
+	touching the samples themselves. Level k block i covers the frames
+	i << BlockShift(k) up to, but not including, (i + 1) << BlockShift(k); level 0 blocks
+	are kBaseBlockFrames long and each level's are kLevelFactor times the last.
+	
+	The levels are built as the frames arrive: level 0 from the frames, and each level
+	above from the blocks of the one below, so keeping all of them costs little more than
+	level 0. A block only goes into its level's ring once it is complete; the one being
+	filled is kept on the side. A block with frames missing, as the first one after Reset
+	may be, summarizes the ones there are.
+	
+	Each level's ring holds kCapacityBlocks blocks per channel, so the coarser levels go
+	back much further than the samples do. One thread adds frames, and any other may fetch
+	blocks at the same time, as CARingBuffer allows. Nothing is allocated after
+	construction.
+*/
+
+struct WaveformPeakSum
+{
+	Float32				mMin;
+	Float32				mMax;
+	Float32				mSumSquares;
+	
+	void				Clear()			{ mMin = 3.4e38f; mMax = -3.4e38f; mSumSquares = 0.f; }
+	void				Add(const WaveformPeakSum &inOther)
+	{
+		if (inOther.mMin < mMin) mMin = inOther.mMin;
+		if (inOther.mMax > mMax) mMax = inOther.mMax;
+		mSumSquares += inOther.mSumSquares;
+	}
+	// folds in inNumFrames frames
+	void				Add(const Float32 *inFrames, UInt32 inNumFrames);
+};
+
+class WaveformPeakPyramid {
+public:
+	enum {
+		kBaseBlockShift = 4,
+		kBaseBlockFrames = 1 << kBaseBlockShift,
+		kLevelShift = 2,
+		kLevelFactor = 1 << kLevelShift,
+		kNumberLevels = 7,					// 16 frames to 64K frames a block
+		kCapacityBlocks = 8192
+	};
+	
+	// inMaxFrames is the most AddFrames is given at once
+	WaveformPeakPyramid(UInt32 inNumChannels, UInt32 inMaxFrames);
+	~WaveformPeakPyramid();
+	
+	static UInt32	BlockShift(UInt32 inLevel)		{ return kBaseBlockShift + inLevel * kLevelShift; }
+	
+	// Forget the blocks being filled; the rings keep what they have.
+	void			Reset();
+	
+	// one buffer per channel, of inNumFrames frames numbered from inStartFrame on
+	void			AddFrames(const AudioBufferList &inBuffer, UInt32 inNumFrames, SampleTime inStartFrame);
+	
+	// the complete blocks of inLevel there are: inFirstBlock to inEndBlock, exclusive
+	bool			GetBlockBounds(UInt32 inLevel, SampleTime &outFirstBlock, SampleTime &outEndBlock);
+	
+	// inNumBlocks blocks of inLevel and inChannel, all of which must be within the bounds
+	bool			FetchBlocks(UInt32 inLevel, UInt32 inChannel, SampleTime inFirstBlock, UInt32 inNumBlocks,
+								WaveformPeakSum *outBlocks);
+
+private:
+	struct Level {
+		std::vector<CARingBuffer *>		mRings;			// one per channel
+		std::vector<WaveformPeakSum>	mPartial;		// the block being filled, per channel
+	};
+	
+	// stores inNumBlocks blocks of inChannel into level inLevel, numbered from inFirstBlock on
+	void			Store(UInt32 inLevel, UInt32 inChannel, const WaveformPeakSum *inBlocks, UInt32 inNumBlocks,
+						  SampleTime inFirstBlock);
+	
+	std::vector<Level *>				mLevels;
+	std::vector<WaveformPeakSum>		mBlocks[2];		// a level's new blocks, and the next level's
+};
+
+#endif // __WaveformPeakPyramid_h__
@@ -40,7 +40,8 @@
 */
 #include "WaveformViewDemo.h"
 
-#include <vecLib/vDSP.h>
+#include <math.h>
+#include <algorithm>
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 
@@ -56,6 +57,10 @@ WaveformViewDemo::WaveformViewDemo(AudioUnit component)
 	
 	mAudioBuffer = NULL;
 	mFetchingBufferList = NULL;
+	mStoringBufferList = NULL;
+	mPeaks = NULL;
+	mStorageFormat = kWaveformStorage_Float32;
+	mHistoryFrames = 0;
 }
 
 WaveformViewDemo::~WaveformViewDemo()
@@ -68,8 +73,12 @@ void WaveformViewDemo::Cleanup()
 {
 	if (mAudioBuffer) delete (mAudioBuffer);
 	if (mFetchingBufferList) delete(mFetchingBufferList);
+	if (mStoringBufferList) delete(mStoringBufferList);
+	if (mPeaks) delete (mPeaks);
 	mAudioBuffer = NULL;
 	mFetchingBufferList = NULL;
+	mStoringBufferList = NULL;
+	mPeaks = NULL;
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -153,6 +162,17 @@ ComponentResult		WaveformViewDemo::GetPropertyInfo (AudioUnitPropertyID	inID,
 				outWritable = true;
 				outDataSize = sizeof(WaveformOverview);
 				return noErr;
+			
+			case kAudioUnitProperty_WaveformSubscribe:
+			case kAudioUnitProperty_WaveformUnsubscribe:
+				outWritable = true;
+				outDataSize = sizeof(CAAnalysisMailbox *);
+				return noErr;
+			
+			case kAudioUnitProperty_WaveformStorageFormat:
+				outWritable = true;
+				outDataSize = sizeof(UInt32);
+				return noErr;
 		
 		}
 	}
@@ -160,21 +180,156 @@ ComponentResult		WaveformViewDemo::GetPropertyInfo (AudioUnitPropertyID	inID,
 	return AUEffectBase::GetPropertyInfo (inID, inScope, inElement, outDataSize, outWritable);
 }
 
-void			WaveformViewDemo::GetWaveformOverview(WaveformOverview* data)
-{	
+const Float32 *	WaveformViewDemo::FetchFrames(UInt32 inChannel, SampleTime inStart, UInt32 inNumFrames)
+{
 	AudioBufferList *bufferList = &mFetchingBufferList->GetModifiableBufferList();
-	UInt32 num = data->mNumDataPoints;
-	SampleTime t = (SampleTime) data->mFetchStamp.mSampleTime;
-	mAudioBuffer->Fetch(bufferList, num, t, false);	
+#pragma warning we are pulling all the data but only need a certain channel
+	if (inNumFrames > mHistoryFrames || mAudioBuffer->Fetch(bufferList, inNumFrames, inStart, false) != kCARingBufferError_OK)
+		return NULL;
+	if (mStorageFormat == kWaveformStorage_Float32)
+		return (const Float32 *) bufferList->mBuffers[inChannel].mData;
+	WaveformHistoryCodec::Decode(mStorageFormat, bufferList->mBuffers[inChannel].mData, &mExpandedFrames[0], inNumFrames);
+	return &mExpandedFrames[0];
+}
 
-	Float32* b = (Float32*) bufferList->mBuffers[data->mChannel].mData;
-	memcpy(data->mOverview, b, num*sizeof(Float32));	
+void			WaveformViewDemo::SumRecentFrames(UInt32 inChannel, UInt32 inLevel, SampleTime inBegin, SampleTime inEnd,
+												  WaveformPeakSum &ioSum, UInt32 &ioNumFrames)
+{
+	// Each level below has fewer than kLevelFactor complete blocks past the end of the one
+	// above, and the samples fewer than a level 0 block, so this is a handful of fetches.
+	WaveformPeakSum blocks[WaveformPeakPyramid::kLevelFactor];
+	for (int level = int(inLevel) - 1; level >= 0 && inBegin < inEnd; --level) {
+		UInt32 shift = WaveformPeakPyramid::BlockShift(level);
+		SampleTime first, end;
+		if (!mPeaks->GetBlockBounds(level, first, end) || (inBegin >> shift) < first)
+			return;
+		end = std::min(end, inEnd >> shift);
+		for (SampleTime b = inBegin >> shift; b < end; ) {
+			UInt32 n = UInt32(std::min(end - b, SampleTime(WaveformPeakPyramid::kLevelFactor)));
+			if (!mPeaks->FetchBlocks(level, inChannel, b, n, blocks))
+				return;
+			for (UInt32 i = 0; i < n; ++i)
+				ioSum.Add(blocks[i]);
+			ioNumFrames += n << shift;
+			b += n;
+			inBegin = b << shift;
+		}
+	}
+	if (inBegin < inEnd) {
+		const Float32 *frames = FetchFrames(inChannel, inBegin, UInt32(inEnd - inBegin));
+		if (frames) {
+			ioSum.Add(frames, UInt32(inEnd - inBegin));
+			ioNumFrames += UInt32(inEnd - inBegin);
+		}
+	}
+}
+
+// One peak per column, from the coarsest level with kLevelFactor blocks or more to a column,
+// so that moving a column's edges to that level's block boundaries moves them by less than
+// a quarter of a column; every sample still counts in exactly one column. Where that level
+// doesn't go back far enough a coarser one serves, down to a block a column. Zoomed in
+// further than the levels allow, the columns come from the samples.
+void			WaveformViewDemo::GetWaveformOverview(WaveformOverview* data)
+{	
+	SampleTime start = (SampleTime) data->mFetchStamp.mSampleTime;
+	// no more than kLevelFactor^2 top level blocks a column, which is more than the top level holds
+	SInt64 num = std::max(data->mNumDataPoints, SInt64(0));
+	num = std::min(num, SInt64(mColumnBlocks.size() - 1) << WaveformPeakPyramid::BlockShift(WaveformPeakPyramid::kNumberLevels - 1));
+	data->mNumDataPoints = num;
+	UInt32 numColumns = std::min(data->mNumColumns, UInt32(kMaxWaveformColumns));
+	if (num < numColumns)
+		numColumns = UInt32(num);
+	data->mNumColumns = numColumns;
+	data->mMin = data->mMax = 0.f;
+	if (numColumns == 0 || data->mChannel >= GetNumberOfChannels())
+		return;
 	
-	vDSP_maxmgv(b, 1, &(data->mMax), num);
-	vDSP_minmgv (b, 1,&(data->mMin), num);
-  
+	Float64 framesPerColumn = Float64(num) / numColumns;
+	int level = -1;
+	if (framesPerColumn >= WaveformPeakPyramid::kBaseBlockFrames
+			&& (num > SInt64(mHistoryFrames) || framesPerColumn >= WaveformPeakPyramid::kLevelFactor * WaveformPeakPyramid::kBaseBlockFrames)) {
+		level = 0;
+		while (level + 1 < WaveformPeakPyramid::kNumberLevels
+				&& Float64(WaveformPeakPyramid::kLevelFactor << WaveformPeakPyramid::BlockShift(level + 1)) <= framesPerColumn)
+			++level;
+		SampleTime first, end;
+		while (level + 1 < WaveformPeakPyramid::kNumberLevels
+				&& Float64(1 << WaveformPeakPyramid::BlockShift(level + 1)) <= framesPerColumn
+				&& mPeaks->GetBlockBounds(level, first, end) && first > (start >> WaveformPeakPyramid::BlockShift(level)))
+			++level;
+	}
 	
-#pragma warning we are pulling all the data but only need a certain channel
+	if (level < 0) {
+		// no more frames than the samples ring holds
+		const Float32 *frames = FetchFrames(data->mChannel, start, UInt32(num));
+		for (UInt32 c = 0; c < numColumns; ++c) {
+			WaveformPeak &column = data->mColumns[c];
+			if (frames == NULL) {
+				column.mMin = column.mMax = column.mRMS = 0.f;
+				continue;
+			}
+			UInt32 f0 = UInt32(num * c / numColumns), f1 = UInt32(num * (c + 1) / numColumns);
+			WaveformPeakSum sum;
+			sum.Clear();
+			sum.Add(frames + f0, f1 - f0);
+			column.mMin = sum.mMin;
+			column.mMax = sum.mMax;
+			column.mRMS = sqrtf(sum.mSumSquares / (f1 - f0));
+		}
+	} else {
+		// every block under the columns: those the level has, then the recent ones it hasn't
+		// completed from finer levels; those too old to have are silence
+		UInt32 shift = WaveformPeakPyramid::BlockShift(level);
+		SampleTime firstBlock = start >> shift, endBlock = ((start + num - 1) >> shift) + 1;
+		UInt32 numBlocks = UInt32(endBlock - firstBlock);		// at most kLevelFactor^2 a column, and one more
+		WaveformPeakSum *blocks = &mColumnBlocks[0];
+		UInt32 *blockFrames = &mColumnBlockFrames[0];
+		std::fill(blockFrames, blockFrames + numBlocks, 0U);
+		
+		SampleTime first, end;
+		if (!mPeaks->GetBlockBounds(level, first, end))
+			first = end = 0;
+		SampleTime have0 = std::max(first, firstBlock), have1 = std::min(end, endBlock);
+		if (have0 < have1 && mPeaks->FetchBlocks(level, data->mChannel, have0, UInt32(have1 - have0), blocks + (have0 - firstBlock)))
+			std::fill(blockFrames + (have0 - firstBlock), blockFrames + (have1 - firstBlock), 1U << shift);
+		for (SampleTime b = std::max(end, firstBlock); b < endBlock; ++b) {
+			WaveformPeakSum &sum = blocks[b - firstBlock];
+			sum.Clear();
+			SumRecentFrames(data->mChannel, level, b << shift, std::min((b + 1) << shift, start + num),
+							sum, blockFrames[b - firstBlock]);
+		}
+		
+		// a column takes the blocks that start in it, and the first column the one it starts in
+		UInt32 b0 = 0;
+		for (UInt32 c = 0; c < numColumns; ++c) {
+			SampleTime f1 = start + num * (c + 1) / numColumns;
+			UInt32 b1 = UInt32(((f1 + (1 << shift) - 1) >> shift) - firstBlock);
+			WaveformPeakSum sum;
+			sum.Clear();
+			UInt32 frames = 0;
+			for (; b0 < b1; ++b0) {
+				if (blockFrames[b0] == 0) continue;
+				sum.Add(blocks[b0]);
+				frames += blockFrames[b0];
+			}
+			WaveformPeak &column = data->mColumns[c];
+			if (frames == 0)
+				column.mMin = column.mMax = column.mRMS = 0.f;
+			else {
+				column.mMin = sum.mMin;
+				column.mMax = sum.mMax;
+				column.mRMS = sqrtf(sum.mSumSquares / frames);
+			}
+		}
+	}
+	
+	Float32 minimum = data->mColumns[0].mMin, maximum = data->mColumns[0].mMax;
+	for (UInt32 c = 1; c < numColumns; ++c) {
+		minimum = std::min(minimum, data->mColumns[c].mMin);
+		maximum = std::max(maximum, data->mColumns[c].mMax);
+	}
+	data->mMin = minimum;
+	data->mMax = maximum;
 	data->mFetchStamp.mSampleTime += (Float64) num;	
 }
 
@@ -220,6 +375,10 @@ ComponentResult		WaveformViewDemo::GetProperty(		AudioUnitPropertyID		inID,
 				*(static_cast<Float64*>(outData)) =mRenderStamp.mSampleTime;		
 				return noErr;
 			}
+			
+			case kAudioUnitProperty_WaveformStorageFormat:
+				*(static_cast<UInt32*>(outData)) = mStorageFormat;
+				return noErr;
 		} //end switch
 	}//end global if
 
@@ -238,15 +397,45 @@ ComponentResult		WaveformViewDemo::	SetProperty(AudioUnitPropertyID 		inID,
 													const void *				inData,
 													UInt32 						inDataSize)
 {											
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitProperty_WaveformSubscribe) {
+		if (inDataSize < sizeof(CAAnalysisMailbox *)) return kAudioUnitErr_InvalidPropertyValue;
+		CAAnalysisMailbox *mailbox = *(static_cast<CAAnalysisMailbox * const *>(inData));
+		if (mailbox == NULL) return kAudioUnitErr_InvalidPropertyValue;
+		if (!mPublisher.Subscribe(mailbox)) return kAudioUnitErr_InvalidPropertyValue;	// no room for more
+		// what is there already, so the view needn't wait for the next render
+		CAAnalysisMailboxPost(mailbox, SInt64(mRenderStamp.mSampleTime));
+		return noErr;
+	}
+	
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitProperty_WaveformUnsubscribe) {
+		if (inDataSize < sizeof(CAAnalysisMailbox *)) return kAudioUnitErr_InvalidPropertyValue;
+		mPublisher.Unsubscribe(*(static_cast<CAAnalysisMailbox * const *>(inData)));
+		return noErr;
+	}
+	
+	if (inScope == kAudioUnitScope_Global && inID == kAudioUnitProperty_WaveformStorageFormat) {
+		if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+		UInt32 format = *(static_cast<const UInt32*>(inData));
+		if (format > kWaveformStorage_Int16) return kAudioUnitErr_InvalidPropertyValue;
+		// the render thread stores into the history, so it is only rebuilt by Initialize
+		if (IsInitialized()) return kAudioUnitErr_Initialized;
+		mStorageFormat = format;
+		return noErr;
+	}
+	
 	return AUEffectBase::SetProperty (inID, inScope, inElement, inData, inDataSize);
 }
 
 
 void			WaveformViewDemo::AllocateBuffers()
 {
+	// the 16 bit formats keep twice the history in the same memory
+	const UInt32 bytesPerFrame = WaveformHistoryCodec::BytesPerFrame(mStorageFormat);
+	mHistoryFrames = kDefaultValue_BufferSize * sizeof(Float32) / bytesPerFrame;
+	
 	if (mAudioBuffer) delete (mAudioBuffer);
 	mAudioBuffer = new CARingBuffer();
-	mAudioBuffer->Allocate(GetNumberOfChannels(), sizeof(Float32), kDefaultValue_BufferSize); 
+	mAudioBuffer->Allocate(GetNumberOfChannels(), bytesPerFrame, mHistoryFrames); 
 	// unlike the spectral buffers we write one number at a time, the spectral ones do entire analysis at a time
 
 	CAStreamBasicDescription	bufClientDesc;		
@@ -258,7 +447,23 @@ void			WaveformViewDemo::AllocateBuffers()
 		delete(mFetchingBufferList);
 	}
 	mFetchingBufferList = CABufferList::New("fetch buffer", bufClientDesc );
-	mFetchingBufferList->AllocateBuffers(sizeof(Float32) * kDefaultValue_BufferSize);
+	mFetchingBufferList->AllocateBuffers(bytesPerFrame * mHistoryFrames);
+	
+	if (mStoringBufferList) {
+		mStoringBufferList->DeallocateBuffers();
+		delete(mStoringBufferList);
+		mStoringBufferList = NULL;
+	}
+	if (mStorageFormat != kWaveformStorage_Float32) {
+		mStoringBufferList = CABufferList::New("store buffer", bufClientDesc );
+		mStoringBufferList->AllocateBuffers(bytesPerFrame * GetMaxFramesPerSlice());
+		mExpandedFrames.resize(mHistoryFrames);
+	}
+	
+	if (mPeaks) delete (mPeaks);
+	mPeaks = new WaveformPeakPyramid(GetNumberOfChannels(), GetMaxFramesPerSlice());
+	mColumnBlocks.resize(kMaxWaveformColumns * WaveformPeakPyramid::kLevelFactor * WaveformPeakPyramid::kLevelFactor + 1);
+	mColumnBlockFrames.resize(mColumnBlocks.size());
 	
 	
 	
@@ -284,8 +489,20 @@ OSStatus	WaveformViewDemo::ProcessBufferLists(	AudioUnitRenderActionFlags &	ioAc
 													UInt32							inFramesToProcess )
 {		
 	SampleTime s = (SampleTime) (mRenderStamp.mSampleTime);
-	mAudioBuffer->Store(&inBuffer, inFramesToProcess, s);
+	if (mStorageFormat == kWaveformStorage_Float32)
+		mAudioBuffer->Store(&inBuffer, inFramesToProcess, s);
+	else {
+		AudioBufferList &packed = mStoringBufferList->GetModifiableBufferList();
+		for (UInt32 c = 0; c < packed.mNumberBuffers; ++c) {
+			WaveformHistoryCodec::Encode(mStorageFormat, (const Float32 *)inBuffer.mBuffers[c].mData,
+										 packed.mBuffers[c].mData, inFramesToProcess);
+			packed.mBuffers[c].mDataByteSize = inFramesToProcess * sizeof(UInt16);
+		}
+		mAudioBuffer->Store(&packed, inFramesToProcess, s);
+	}
+	mPeaks->AddFrames(inBuffer, inFramesToProcess, s);
 	mRenderStamp.mSampleTime += (Float64) inFramesToProcess;
+	mPublisher.Post(SInt64(mRenderStamp.mSampleTime));
 	
 	return AUEffectBase::ProcessBufferLists(ioActionFlags, inBuffer, outBuffer, inFramesToProcess);
 }
@@ -47,8 +47,12 @@
 #include "AUEffectBase.h"
 #include "CARingBuffer.h"
 #include "CABufferList.h"
+#include "WaveformPeakPyramid.h"
+#include "WaveformHistoryCodec.h"
+#include <vector>
 
 #include "CAWaveformViewSharedData.h"
+#include "CAAnalysisMailbox.h"
 
 
 #if AU_DEBUG_DISPATCHER
@@ -57,7 +61,8 @@
 
 
 // Here we define a custom property so the view is able to retrieve the wavefrom overview
-// curve.  The curve changes often...
+// curve.  The curve changes often, so it comes as one WaveformPeak per column of the view
+// rather than as the samples themselves...
 // custom properties id's must be 64000 or greater
 // see <AudioUnit/AudioUnitProperties.h> for a list of Apple-defined standard properties
 //
@@ -65,7 +70,12 @@
 enum
 {
 	kAudioUnitProperty_WaveformOverview = 65536,
-	kAudioUnitProperty_SampleTimeStamp = 65537
+	kAudioUnitProperty_SampleTimeStamp = 65537,
+	kAudioUnitProperty_WaveformSubscribe = 65538,		// CAAnalysisMailbox *, set only: posted the sample
+														// time stamp after every render
+	kAudioUnitProperty_WaveformUnsubscribe = 65539,		// CAAnalysisMailbox *, set only
+	kAudioUnitProperty_WaveformStorageFormat = 65540	// UInt32 kWaveformStorage_*, of the samples the
+														// history keeps; set only while uninitialized
 };
 
 
@@ -156,10 +166,26 @@ public:
 													UInt32							inFramesToProcess );
 			
 	private:
-		CARingBuffer*			mAudioBuffer;		
+		// inNumFrames samples of inChannel from inStart on, or NULL if they're gone; expanded
+		// to Float32 whatever mStorageFormat is
+		const Float32 *			FetchFrames(UInt32 inChannel, SampleTime inStart, UInt32 inNumFrames);
+		// adds frames inBegin to inEnd, inBegin on a block boundary of inLevel, from the
+		// finest blocks under inLevel that are complete and then from the samples
+		void					SumRecentFrames(UInt32 inChannel, UInt32 inLevel, SampleTime inBegin, SampleTime inEnd,
+												WaveformPeakSum &ioSum, UInt32 &ioNumFrames);
+		
+		CARingBuffer*			mAudioBuffer;		// of mStorageFormat samples
 		CABufferList*			mFetchingBufferList;
+		CABufferList*			mStoringBufferList;	// a render's samples packed, unless they're Float32
+		std::vector<Float32>	mExpandedFrames;	// FetchFrames' channel, unless it's Float32
+		UInt32					mStorageFormat;
+		UInt32					mHistoryFrames;		// the frames mAudioBuffer holds
+		WaveformPeakPyramid*	mPeaks;				// of the same frames as mAudioBuffer, and older ones
+		std::vector<WaveformPeakSum>	mColumnBlocks;		// GetWaveformOverview's
+		std::vector<UInt32>				mColumnBlockFrames;
 		
 		AudioTimeStamp			mRenderStamp;
+		CAAnalysisPublisher		mPublisher;			// posted mRenderStamp by ProcessBufferLists
 };
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
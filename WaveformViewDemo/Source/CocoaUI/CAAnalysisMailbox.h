@@ -0,0 +1,184 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	CAAnalysisMailbox.h
+	
+=============================================================================*/
+
+#ifndef __CAAnalysisMailbox_h__
+#define __CAAnalysisMailbox_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+#include <libkern/OSAtomic.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+/*
+	Lets an AU tell its views that new analysis data is there instead of being polled for
+	it. A view opens a mailbox and subscribes it to the AU; the AU posts the time stamp of
+	its newest data whenever it publishes some. Only the first post after the view took
+	the last one writes a byte to the mailbox's pipe, which the view watches on its run
+	loop (with a CFFileDescriptor); the others just move the stamp on. So a view that
+	is slow to take its mail costs the AU nothing, and with the audio stopped nothing
+	happens at all.
+	
+	Posting is lock free and makes at most one non-blocking write, so the AU may post
+	from its render thread.
+	
+	SonogramViewDemo and WaveformViewDemo each build on their own, so each carries this
+	file; keep the two copies identical.
+*/
+
+struct CAAnalysisMailbox
+{
+	volatile SInt64		mPublished;		// the AU writes: the time stamp of its newest data
+	volatile int32_t	mPending;		// 1 from a post until the view takes it
+	int					mNotifyFD;		// the AU writes a byte here to wake the view, or -1
+	int					mWaitFD;		// the view waits on this one
+};
+typedef struct CAAnalysisMailbox CAAnalysisMailbox;
+
+// the view: the pipe, both ends non-blocking. Returns false if there is none to be had.
+static inline bool		CAAnalysisMailboxOpen(CAAnalysisMailbox *ioMailbox)
+{
+	int fds[2];
+	ioMailbox->mPublished = 0;
+	ioMailbox->mPending = 0;
+	ioMailbox->mNotifyFD = ioMailbox->mWaitFD = -1;
+	if (pipe(fds) != 0)
+		return false;
+	fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+	ioMailbox->mWaitFD = fds[0];
+	ioMailbox->mNotifyFD = fds[1];
+	return true;
+}
+
+// the view, after it has unsubscribed
+static inline void		CAAnalysisMailboxClose(CAAnalysisMailbox *ioMailbox)
+{
+	if (ioMailbox->mWaitFD >= 0) close(ioMailbox->mWaitFD);
+	if (ioMailbox->mNotifyFD >= 0) close(ioMailbox->mNotifyFD);
+	ioMailbox->mNotifyFD = ioMailbox->mWaitFD = -1;
+}
+
+// the AU, once its data up to inPublished can be read
+static inline void		CAAnalysisMailboxPost(CAAnalysisMailbox *ioMailbox, SInt64 inPublished)
+{
+	SInt64 old;
+	do {
+		old = ioMailbox->mPublished;
+	} while (!OSAtomicCompareAndSwap64Barrier(old, inPublished, &ioMailbox->mPublished));
+	
+	if (OSAtomicCompareAndSwap32Barrier(0, 1, &ioMailbox->mPending) && ioMailbox->mNotifyFD >= 0) {
+		char wake = 1;
+		(void)write(ioMailbox->mNotifyFD, &wake, 1);
+	}
+}
+
+// the view: the newest time stamp posted. Anything posted from here on wakes it again.
+static inline SInt64	CAAnalysisMailboxTake(CAAnalysisMailbox *ioMailbox)
+{
+	char drain[16];
+	if (ioMailbox->mWaitFD >= 0)
+		while (read(ioMailbox->mWaitFD, drain, sizeof(drain)) > 0) {}
+	
+	// clear before reading, so that a post in between isn't lost
+	OSAtomicCompareAndSwap32Barrier(1, 0, &ioMailbox->mPending);
+	return OSAtomicAdd64Barrier(0, &ioMailbox->mPublished);
+}
+
+// The AU's side: up to kMaxSubscribers mailboxes, posted to from one thread while control
+// threads subscribe and unsubscribe them.
+class CAAnalysisPublisher {
+public:
+	enum { kMaxSubscribers = 8 };
+	
+	CAAnalysisPublisher() : mPosting(0)
+	{
+		for (int i = 0; i < kMaxSubscribers; ++i)
+			mSubscribers[i] = NULL;
+	}
+	
+	// false if all the slots are taken
+	bool			Subscribe(CAAnalysisMailbox *inMailbox)
+	{
+		for (int i = 0; i < kMaxSubscribers; ++i)
+			if (OSAtomicCompareAndSwapPtrBarrier(NULL, inMailbox, (void * volatile *)&mSubscribers[i]))
+				return true;
+		return false;
+	}
+	
+	// once this returns, Post won't touch inMailbox again
+	void			Unsubscribe(CAAnalysisMailbox *inMailbox)
+	{
+		for (int i = 0; i < kMaxSubscribers; ++i)
+			OSAtomicCompareAndSwapPtrBarrier(inMailbox, NULL, (void * volatile *)&mSubscribers[i]);
+		
+		// a post under way may still have it; mPosting is odd until that post is done
+		int32_t posting = mPosting;
+		OSMemoryBarrier();
+		while ((posting & 1) && mPosting == posting)
+			usleep(100);
+	}
+	
+	// the one posting thread
+	void			Post(SInt64 inPublished)
+	{
+		OSAtomicIncrement32Barrier(&mPosting);
+		for (int i = 0; i < kMaxSubscribers; ++i) {
+			CAAnalysisMailbox *mailbox = mSubscribers[i];
+			if (mailbox)
+				CAAnalysisMailboxPost(mailbox, inPublished);
+		}
+		OSAtomicIncrement32Barrier(&mPosting);
+	}
+
+private:
+	CAAnalysisMailbox * volatile	mSubscribers[kMaxSubscribers];
+	volatile int32_t				mPosting;		// odd while Post runs
+};
+
+#endif // __CAAnalysisMailbox_h__
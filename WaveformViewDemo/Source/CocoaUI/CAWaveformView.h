@@ -60,7 +60,8 @@
 	NSColor								*backgroundColor;
 	NSColor								*lineColor;
 	
-	CGPoint*							waveformPoints;
+	CGPoint*							waveformPoints;		// a segment from min to max per column
+	CGPoint*							rmsPoints;			// and one across the RMS
 	UInt32								waveformPointsCount;
 }
 
@@ -74,6 +75,8 @@
 - (IBAction) changeLineColor: (id) sender;
 
 #pragma mark GETTING DATA
-- (void) plotNum: (UInt32) num dataPoints:(Float32*) data;
+// one column per pixel, so this many peaks fill the view
+- (UInt32) numberOfColumns;
+- (void) plotNum: (UInt32) num peaks:(const WaveformPeak*) peaks;
 
 @end
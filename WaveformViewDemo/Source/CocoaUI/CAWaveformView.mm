@@ -67,8 +67,11 @@
 	
 	if (waveformPoints) 
 		free(waveformPoints);	
+	if (rmsPoints)
+		free(rmsPoints);
 		
-	waveformPoints = (CGPoint*) malloc(2*kMaxWaveformSamples*sizeof(CGPoint)); 	
+	waveformPoints = (CGPoint*) malloc(2*kMaxWaveformColumns*sizeof(CGPoint)); 	
+	rmsPoints = (CGPoint*) malloc(2*kMaxWaveformColumns*sizeof(CGPoint));
 
 
 }
@@ -78,6 +81,7 @@
     self = [super initWithFrame:frame];
     if (self) {
 		waveformPoints = NULL;
+		rmsPoints = NULL;
 		[self Initialize];
    }
     return self;
@@ -93,6 +97,10 @@
 		free(waveformPoints);
 		waveformPoints = NULL;
 	}
+	if (rmsPoints) {
+		free(rmsPoints);
+		rmsPoints = NULL;
+	}
 	
 	[super dealloc];
 }
@@ -136,7 +144,13 @@
 	return [self frame];
 }
 
-- (void) plotNum: (UInt32) num dataPoints:(Float32*) data
+- (UInt32) numberOfColumns
+{
+	UInt32 pixelWidth = (UInt32) [self getRect].size.width;
+	return (pixelWidth < kMaxWaveformColumns) ? pixelWidth : kMaxWaveformColumns;
+}
+
+- (void) plotNum: (UInt32) num peaks:(const WaveformPeak*) peaks
 {
 	if (num < 1) return;
 
@@ -148,37 +162,30 @@
 	Float32 height	= r.size.height;
 		
 	Float32 dy = height / 2. / 1.5;
-	UInt32 pixelWidth = (UInt32) width;	
-	UInt32 stride = num / pixelWidth;
+	Float32 dx = width / num;
 	
 	UInt32 mid = (UInt32) ( height / 2.0);
 
-	// make the first point	
+	// a column's min and max are its extremes, so every peak shows however far out we are
 	waveformPointsCount = 0;
-	Float32 value = mid + data[0] * dy;
-	waveformPoints[waveformPointsCount].x = 0;
-    waveformPoints[waveformPointsCount].y = value;
-	waveformPointsCount++;
- 
-	UInt32 sampleIndex;
-	for (UInt32 i= 1; i< pixelWidth; i++){
-		
-		sampleIndex = i*stride;		
-		value = mid + data[sampleIndex] * dy;
+	for (UInt32 i= 0; i< num; i++){
+		Float32 x = (i + 0.5) * dx;
 		
-		waveformPoints[waveformPointsCount].x	= i;
-		waveformPoints[waveformPointsCount].y	= value;
+		waveformPoints[waveformPointsCount].x	= x;
+		waveformPoints[waveformPointsCount].y	= mid + peaks[i].mMin * dy;
+		rmsPoints[waveformPointsCount].x		= x;
+		rmsPoints[waveformPointsCount].y		= mid - peaks[i].mRMS * dy;
 		waveformPointsCount++;
 		
-		waveformPoints[waveformPointsCount].x	= i;
-		waveformPoints[waveformPointsCount].y	= value;
+		// a segment of no length draws nothing, so silence still gets a pixel
+		Float32 top = mid + peaks[i].mMax * dy;
+		if (top < waveformPoints[waveformPointsCount-1].y + 1.) top = waveformPoints[waveformPointsCount-1].y + 1.;
+		waveformPoints[waveformPointsCount].x	= x;
+		waveformPoints[waveformPointsCount].y	= top;
+		rmsPoints[waveformPointsCount].x		= x;
+		rmsPoints[waveformPointsCount].y		= mid + peaks[i].mRMS * dy;
 		waveformPointsCount++;
-		
 	 }
-	
-	value = waveformPoints[waveformPointsCount-1].y;
-	waveformPoints[waveformPointsCount].x		= pixelWidth;
-	waveformPoints[waveformPointsCount].y		= value;	
 	 
 	[self setNeedsDisplay: YES];
 }
@@ -201,6 +208,14 @@
 	[lineColor alphaComponent]);
     CGContextStrokeLineSegments(context, waveformPoints, waveformPointsCount);
 
+	// the RMS half way to the background, over the peaks
+    CGContextSetRGBStrokeColor(context,
+	([lineColor redComponent] + [backgroundColor redComponent]) / 2.,
+	([lineColor greenComponent] + [backgroundColor greenComponent]) / 2.,
+	([lineColor blueComponent] + [backgroundColor blueComponent]) / 2.,
+	[lineColor alphaComponent]);
+    CGContextStrokeLineSegments(context, rmsPoints, waveformPointsCount);
+
 }
 
 @end
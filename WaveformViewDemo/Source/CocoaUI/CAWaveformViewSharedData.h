@@ -48,23 +48,48 @@
 #endif
 
 #define kMaxWaveformSamples 44100
+#define kMaxWaveformColumns 2048
 
 typedef SInt64 SampleTime;
 
 #pragma mark ___CAWaveformView DataStructs
+/*!
+    @struct         WaveformPeak
+    @abstract       What one pixel column of the waveform covers.
+    @field          mMin
+                        The lowest sample.
+	@field			mMax
+						The highest sample.
+	@field			mRMS
+						The root mean square of the samples.
+*/
+struct WaveformPeak
+{
+	Float32			mMin;
+	Float32			mMax;
+	Float32			mRMS;
+};
+typedef struct WaveformPeak  WaveformPeak;
+
 /*!
     @struct         WaveformOverview
-    @abstract       A structure to hold a buffer of audio data for drawing.
+    @abstract       A structure to hold a summary of audio data for drawing.
     @field          mChannel
                         Which channel you want to draw.
-	@field			mOverview
-						The data you get back scaled to the view.
+	@field			mFetchStamp
+						The first sample to summarize; advanced past the last one.
+	@field			mMax
+						The highest sample of them all.
+	@field			mMin
+						The lowest.
 	@field			mNumDataPoints
-						How many to get. 
-						
+						How many samples to summarize.
+	@field			mNumColumns
+						How many columns to split them into, at most kMaxWaveformColumns.
+	@field			mColumns
+						One peak per column that you get back. Samples the AU no longer
+						has come back as silence.
 */
-
-
 struct WaveformOverview
 {
     UInt32			mChannel;
@@ -74,10 +99,9 @@ struct WaveformOverview
 	Float32			mMax;
 	Float32			mMin;
 	
-	// could also pass in the width to determine the sampling
-	
 	SInt64			mNumDataPoints;
-    Float32			mOverview[1];
+	UInt32			mNumColumns;
+    WaveformPeak	mColumns[1];
 	
 };
 typedef struct WaveformOverview  WaveformOverview;
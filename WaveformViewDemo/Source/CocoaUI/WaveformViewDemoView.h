@@ -43,6 +43,7 @@
 #import <AudioToolbox/AudioToolbox.h>
 
 #import "CAWaveformViewSharedData.h"
+#import "CAAnalysisMailbox.h"
 
 #import "CAWaveformView.h"
 
@@ -54,10 +55,14 @@
     // IB Members
     IBOutlet CAWaveformView*	uiWaveformView; // if drawing multichannel, would have several
 		
-   	NSTimer*					mFetchTimer;
-	
 	WaveformOverview			*mData;	
 	
+	// the AU posts here after every render; see CAAnalysisMailbox.h
+	CAAnalysisMailbox			mMailbox;
+	CFFileDescriptorRef			mMailboxFD;
+	CFRunLoopSourceRef			mMailboxSource;
+	CFAbsoluteTime				mLastUpdate;
+	
 	// Other Members
     AudioUnit					mAU;
 	AUEventListenerRef			mAUEventListener;
@@ -66,12 +71,17 @@
 
 #pragma mark ____ PUBLIC FUNCTIONS ____
 - (void)setAU:(AudioUnit)inAU;
+- (void)updateCurve;
 
 
 #pragma mark ____ PRIVATE FUNCTIONS
 - (void)priv_synchronizeUIWithParameterValues;
 - (void)priv_addListeners;
 - (void)priv_removeListeners;
+- (void)priv_addMailbox;
+- (void)priv_removeMailbox;
+- (void)priv_mailboxReady;
+- (void)priv_takeMail;
 
 #pragma mark ____ LISTENER CALLBACK DISPATCHEE ____
 - (void)priv_eventListener:(void *) inObject event:(const AudioUnitEvent *)inEvent value:(Float32)inValue;
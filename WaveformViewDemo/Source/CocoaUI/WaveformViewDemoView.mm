@@ -41,6 +41,8 @@
 #import "WaveformViewDemoView.h"
 #import "WaveformViewDemo.h"
 
+// the AU posts after every render, far more often than the screen can show it
+static const CFAbsoluteTime kMinUpdateInterval = 1.0 / 60.0;
 
 #pragma mark ____ LISTENER CALLBACK DISPATCHER ____
 
@@ -53,6 +55,13 @@ void EventListenerDispatcher (void *inRefCon, void *inObject, const AudioUnitEve
 	[SELF priv_eventListener:inObject event: inEvent value: inValue];
 }
 
+// The mailbox's pipe has something in it: the AU has new samples
+static void MailboxDispatcher (CFFileDescriptorRef inFD, CFOptionFlags inCallBackTypes, void *inInfo)
+{
+	WaveformViewDemoView *SELF = (WaveformViewDemoView *)inInfo;
+	[SELF priv_mailboxReady];
+}
+
 @implementation WaveformViewDemoView
 #pragma mark ____ (INIT /) DEALLOC ____
 - (void)dealloc {
@@ -71,7 +80,7 @@ void EventListenerDispatcher (void *inRefCon, void *inObject, const AudioUnitEve
 
 - (void) removeFromSuperview
 {
-	[mFetchTimer invalidate];
+	[self priv_removeMailbox];
 	//[[NSNotificationCenter defaultCenter] removeObserver: self];
 	 
 	[super removeFromSuperview];
@@ -82,7 +91,7 @@ void EventListenerDispatcher (void *inRefCon, void *inObject, const AudioUnitEve
 
 - (void) priv_initBuffers
 {
-	mData =(WaveformOverview*) malloc(sizeof(WaveformOverview) + (kMaxWaveformSamples-1)*sizeof(Float32));
+	mData =(WaveformOverview*) malloc(sizeof(WaveformOverview) + (kMaxWaveformColumns-1)*sizeof(WaveformPeak));
 
 	memset (&mData->mFetchStamp, 0, sizeof(AudioTimeStamp));
 	mData->mFetchStamp.mFlags = kAudioTimeStampSampleTimeValid;
@@ -96,11 +105,13 @@ void EventListenerDispatcher (void *inRefCon, void *inObject, const AudioUnitEve
 		verify_noerr( AUEventListenerCreate(EventListenerDispatcher, self,
 											CFRunLoopGetCurrent(), kCFRunLoopDefaultMode, 0.05, 0.05, 
 											&mAUEventListener));
+		[self priv_addMailbox];
 	}
 }
 
 - (void)priv_removeListeners 
 {
+	[self priv_removeMailbox];
 	if (mAUEventListener) verify_noerr (AUListenerDispose(mAUEventListener));
 	mAUEventListener = NULL;
 	mAU = NULL;
@@ -111,53 +122,93 @@ void EventListenerDispatcher (void *inRefCon, void *inObject, const AudioUnitEve
 
 }
 
-#pragma mark ___OnTimer___
-- (NSTimer *) timer {
-	return [[mFetchTimer retain] autorelease];
+#pragma mark ____ MAILBOX ____
+
+- (void) priv_mailboxReady
+{
+	// Until we take the mail the AU won't write to the pipe again, so holding off to keep to
+	// kMinUpdateInterval costs nothing; the callback stays off until then.
+	CFAbsoluteTime wait = mLastUpdate + kMinUpdateInterval - CFAbsoluteTimeGetCurrent();
+	if (wait > 0)
+		[self performSelector: @selector(priv_takeMail) withObject: nil afterDelay: wait];
+	else
+		[self priv_takeMail];
 }
 
-- (void) setTimer: (NSTimer *) value {
-	if ( mFetchTimer != value ) {
-		[mFetchTimer release];
-		mFetchTimer = [value retain];
-	}
+- (void) priv_takeMail
+{
+	mLastUpdate = CFAbsoluteTimeGetCurrent();
+	[self updateCurve];
+	if (mMailboxFD) CFFileDescriptorEnableCallBacks(mMailboxFD, kCFFileDescriptorReadCallBack);
+}
+
+- (void) priv_addMailbox
+{
+	if (!CAAnalysisMailboxOpen(&mMailbox)) return;
+	
+	CFFileDescriptorContext context = { 0, self, NULL, NULL, NULL };
+	mMailboxFD = CFFileDescriptorCreate(NULL, mMailbox.mWaitFD, false, MailboxDispatcher, &context);
+	mMailboxSource = CFFileDescriptorCreateRunLoopSource(NULL, mMailboxFD, 0);
+	CFRunLoopAddSource(CFRunLoopGetCurrent(), mMailboxSource, kCFRunLoopDefaultMode);
+	CFFileDescriptorEnableCallBacks(mMailboxFD, kCFFileDescriptorReadCallBack);
+	
+	CAAnalysisMailbox *mailbox = &mMailbox;
+	verify_noerr(AudioUnitSetProperty(mAU, kAudioUnitProperty_WaveformSubscribe, kAudioUnitScope_Global, 0,
+										&mailbox, sizeof(mailbox)));
+}
+
+- (void) priv_removeMailbox
+{
+	if (mMailboxFD == NULL) return;
+	
+	// once the AU has let go, nothing writes to the pipe
+	CAAnalysisMailbox *mailbox = &mMailbox;
+	if (mAU) AudioUnitSetProperty(mAU, kAudioUnitProperty_WaveformUnsubscribe, kAudioUnitScope_Global, 0,
+									&mailbox, sizeof(mailbox));
+	[NSObject cancelPreviousPerformRequestsWithTarget: self selector: @selector(priv_takeMail) object: nil];
+	
+	CFRunLoopSourceInvalidate(mMailboxSource);
+	CFRelease(mMailboxSource);
+	CFFileDescriptorInvalidate(mMailboxFD);
+	CFRelease(mMailboxFD);
+	mMailboxSource = NULL;
+	mMailboxFD = NULL;
+	CAAnalysisMailboxClose(&mMailbox);
 }
 
 #pragma mark ____ PUBLIC FUNCTIONS ____
 
-- (void) updateCurve:(NSTimer*) t
+- (void) updateCurve
 {	
 	mData->mChannel = 0;
 		
-	Float64 tStamp;
-	UInt32 size = sizeof(Float64);
-	ComponentResult result = AudioUnitGetProperty(	mAU,
-													kAudioUnitProperty_SampleTimeStamp,
-													kAudioUnitScope_Global,
-													0,
-													&tStamp,
-													&size);
+	// the AU's latest time stamp comes with the mail
+	Float64 tStamp = CAAnalysisMailboxTake(&mMailbox);
 #pragma mark HOW MUCH TO DISPLAY
 
 	SInt64 numToGet = (SInt64)(tStamp - mData->mFetchStamp.mSampleTime);
 
 	if (numToGet == 0) return;
 	
-	if (numToGet > kMaxWaveformSamples)
+	// fallen behind: show the latest, not the oldest we missed
+	if (numToGet > kMaxWaveformSamples) {
 		numToGet = kMaxWaveformSamples;
+		mData->mFetchStamp.mSampleTime = tStamp - numToGet;
+	}
 	
 	mData->mNumDataPoints = numToGet;
+	mData->mNumColumns = [uiWaveformView numberOfColumns];
 	
 	
-	size = sizeof(WaveformOverview);
-	result = AudioUnitGetProperty(					mAU,
+	UInt32 size = sizeof(WaveformOverview);
+	ComponentResult result = AudioUnitGetProperty(					mAU,
 													kAudioUnitProperty_WaveformOverview,
 													kAudioUnitScope_Global,
 													0,
 													mData,
 													&size);
 	if (result == noErr && tStamp != 0){
-		[uiWaveformView plotNum: numToGet dataPoints: mData->mOverview];	
+		[uiWaveformView plotNum: mData->mNumColumns peaks: mData->mColumns];	
 	}
 }
 
@@ -178,21 +229,13 @@ void EventListenerDispatcher (void *inRefCon, void *inObject, const AudioUnitEve
 	// register for resize notification and data changes
 //	[[NSNotificationCenter defaultCenter]
 //	 addObserver: self selector: @selector(handleWaveformSizeChanged:) name: NSViewFrameDidChangeNotification  object: uiWaveformView];
-
-	[self setTimer: [NSTimer scheduledTimerWithTimeInterval: (1.0/140.0)
-											 target: self
-											 selector: @selector(updateCurve:)
-											 userInfo: nil
-											repeats: YES]];	
-
-
 }
 
 
 #pragma mark ____ INTERFACE ACTIONS ____
 
 - (void) handleWaveformSizeChanged:(NSNotification *) aNotification {
-	[self updateCurve:nil];
+	[self updateCurve];
 }
 
 
@@ -0,0 +1,303 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	HistoryCodecBench.cpp
+	
+=============================================================================*/
+
+/*
+	historycodecbench: checks WaveformHistoryCodec against reference conversions and
+	times Encode and Decode next to EncodeScalar and DecodeScalar. See README for
+	building.
+	
+	The references are written for being obviously right, not fast: a half is decoded
+	with ldexp, a float is encoded to the half nearest to it in double precision (even
+	on a tie, infinity from 65520 up), found by a binary search over the finite halves,
+	whose bit patterns increase with their values. Int16 is rint of the clamped value
+	times 32767. Every half is decoded; floats are encoded at every 4099th bit pattern,
+	which covers subnormals, overs, infinities and NaNs, in buffers of odd lengths at odd
+	offsets so the vector loops' tails run too. NaNs only have to stay NaNs.
+	
+	The exit status is 1 if any conversion differs from the reference.
+*/
+
+#include "WaveformHistoryCodec.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#include <vector>
+
+static double	Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#pragma mark ____Reference
+
+static double	ReferenceHalfValue(UInt16 inHalf)
+{
+	const int exponent = (inHalf >> 10) & 0x1F, mantissa = inHalf & 0x3FF;
+	double value;
+	if (exponent == 0x1F)
+		value = mantissa ? NAN : INFINITY;
+	else if (exponent == 0)
+		value = ldexp(double(mantissa), -24);
+	else
+		value = ldexp(double(1024 + mantissa), exponent - 25);
+	return (inHalf & 0x8000) ? -value : value;
+}
+
+static UInt16	ReferenceHalf(Float32 inValue)
+{
+	const UInt16 sign = signbit(inValue) ? 0x8000 : 0;
+	const double a = fabs(double(inValue));
+	if (a != a) return sign | 0x7E00;
+	if (a >= 65520.) return sign | 0x7C00;
+	
+	// the largest finite half not above a
+	UInt16 lo = 0, hi = 0x7BFF;
+	while (lo < hi) {
+		UInt16 mid = UInt16((lo + hi + 1) / 2);
+		if (ReferenceHalfValue(mid) <= a) lo = mid; else hi = UInt16(mid - 1);
+	}
+	if (lo < 0x7BFF) {
+		const double below = a - ReferenceHalfValue(lo), above = ReferenceHalfValue(lo + 1) - a;
+		if (above < below || (above == below && (lo & 1)))
+			++lo;
+	}
+	return sign | lo;
+}
+
+static SInt16	ReferenceInt16(Float32 inValue)
+{
+	if (inValue != inValue) return -32767;
+	const double x = (inValue < -1.f) ? -1. : (inValue > 1.f) ? 1. : double(inValue);
+	return SInt16(rint(Float32(x * 32767.)));
+}
+
+static bool	SameFloat(Float32 a, Float32 b)
+{
+	return (a != a) ? (b != b) : memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static bool	SameHalf(UInt16 a, UInt16 b)
+{
+	const bool aNaN = (a & 0x7C00) == 0x7C00 && (a & 0x3FF), bNaN = (b & 0x7C00) == 0x7C00 && (b & 0x3FF);
+	return (aNaN || bNaN) ? (aNaN && bNaN) : a == b;
+}
+
+#pragma mark ____Checking
+
+static UInt32	sFailures = 0;
+
+static void	Fail(const char *inWhat, UInt32 inBits, UInt32 inGot, UInt32 inExpected)
+{
+	if (sFailures++ < 10)
+		fprintf(stderr, "historycodecbench: %s of %08lx gave %08lx, expected %08lx\n", inWhat,
+				(unsigned long)inBits, (unsigned long)inGot, (unsigned long)inExpected);
+}
+
+static void	CheckDecode()
+{
+	std::vector<UInt16> halves(65536);
+	std::vector<SInt16> ints(65536);
+	for (UInt32 h = 0; h < 65536; ++h) {
+		halves[h] = UInt16(h);
+		ints[h] = SInt16(UInt16(h));
+	}
+	std::vector<Float32> out(65536), scalar(65536);
+	
+	WaveformHistoryCodec::Decode(kWaveformStorage_Float16, &halves[0], &out[0], 65536);
+	WaveformHistoryCodec::DecodeScalar(kWaveformStorage_Float16, &halves[0], &scalar[0], 65536);
+	for (UInt32 h = 0; h < 65536; ++h) {
+		const Float32 expected = Float32(ReferenceHalfValue(UInt16(h)));
+		UInt32 got, want;
+		if (!SameFloat(out[h], expected) || !SameFloat(scalar[h], expected)) {
+			memcpy(&got, SameFloat(out[h], expected) ? &scalar[h] : &out[h], sizeof(got));
+			memcpy(&want, &expected, sizeof(want));
+			Fail("Float16 decode", h, got, want);
+		}
+	}
+	
+	WaveformHistoryCodec::Decode(kWaveformStorage_Int16, &ints[0], &out[0], 65536);
+	WaveformHistoryCodec::DecodeScalar(kWaveformStorage_Int16, &ints[0], &scalar[0], 65536);
+	for (UInt32 h = 0; h < 65536; ++h) {
+		const Float32 expected = ints[h] * (1.f / 32767.f);
+		if (!SameFloat(out[h], expected) || !SameFloat(scalar[h], expected)) {
+			UInt32 got, want;
+			memcpy(&got, SameFloat(out[h], expected) ? &scalar[h] : &out[h], sizeof(got));
+			memcpy(&want, &expected, sizeof(want));
+			Fail("Int16 decode", h, got, want);
+		}
+	}
+}
+
+static void	CheckEncode()
+{
+	const UInt32 kBlock = 4093;		// odd, so each buffer ends in a tail
+	std::vector<Float32> in(kBlock + 8);
+	std::vector<UInt16> out(kBlock + 8), scalar(kBlock + 8);
+	
+	UInt64 bits = 0;
+	for (UInt32 block = 0; bits < (UInt64(1) << 32); ++block) {
+		const UInt32 offset = block % 8;
+		UInt32 n = 0;
+		for ( ; n < kBlock && bits < (UInt64(1) << 32); ++n, bits += 4099) {
+			const UInt32 pattern = UInt32(bits);
+			memcpy(&in[offset + n], &pattern, sizeof(pattern));
+		}
+		
+		WaveformHistoryCodec::Encode(kWaveformStorage_Float16, &in[offset], &out[offset], n);
+		WaveformHistoryCodec::EncodeScalar(kWaveformStorage_Float16, &in[offset], &scalar[offset], n);
+		for (UInt32 i = offset; i < offset + n; ++i) {
+			const UInt16 expected = ReferenceHalf(in[i]);
+			UInt32 pattern;
+			memcpy(&pattern, &in[i], sizeof(pattern));
+			if (!SameHalf(out[i], expected)) Fail("Float16 Encode", pattern, out[i], expected);
+			if (!SameHalf(scalar[i], expected)) Fail("Float16 EncodeScalar", pattern, scalar[i], expected);
+		}
+		
+		WaveformHistoryCodec::Encode(kWaveformStorage_Int16, &in[offset], &out[offset], n);
+		WaveformHistoryCodec::EncodeScalar(kWaveformStorage_Int16, &in[offset], &scalar[offset], n);
+		for (UInt32 i = offset; i < offset + n; ++i) {
+			const UInt16 expected = UInt16(ReferenceInt16(in[i]));
+			UInt32 pattern;
+			memcpy(&pattern, &in[i], sizeof(pattern));
+			if (out[i] != expected) Fail("Int16 Encode", pattern, out[i], expected);
+			if (scalar[i] != expected) Fail("Int16 EncodeScalar", pattern, scalar[i], expected);
+		}
+	}
+}
+
+#pragma mark ____Timing
+
+typedef void (*EncodeProc)(UInt32 inFormat, const Float32 *inFrames, void *outPacked, UInt32 inNumFrames);
+typedef void (*DecodeProc)(UInt32 inFormat, const void *inPacked, Float32 *outFrames, UInt32 inNumFrames);
+
+// nanoseconds per frame, over about inFrames frames in runs of inLength
+static double	TimeEncode(EncodeProc inProc, UInt32 inFormat, const std::vector<Float32> &inSignal,
+							std::vector<UInt16> &ioPacked, UInt32 inLength, double inFrames)
+{
+	const UInt32 runs = UInt32(inFrames / inLength) + 1;
+	const double start = Now();
+	for (UInt32 r = 0; r < runs; ++r)
+		inProc(inFormat, &inSignal[0], &ioPacked[0], inLength);
+	return (Now() - start) * 1e9 / (double(runs) * inLength);
+}
+
+static double	TimeDecode(DecodeProc inProc, UInt32 inFormat, const std::vector<UInt16> &inPacked,
+							std::vector<Float32> &ioSignal, UInt32 inLength, double inFrames)
+{
+	const UInt32 runs = UInt32(inFrames / inLength) + 1;
+	const double start = Now();
+	for (UInt32 r = 0; r < runs; ++r)
+		inProc(inFormat, &inPacked[0], &ioSignal[0], inLength);
+	return (Now() - start) * 1e9 / (double(runs) * inLength);
+}
+
+#pragma mark ____Options
+
+static void	Usage()
+{
+	fprintf(stderr,
+		"usage: historycodecbench [options]\n"
+		"  -n, --length N         frames per call (4096)\n"
+		"  -f, --frames N         frames to convert per measurement (64M)\n");
+}
+
+int main(int argc, char *const argv[])
+{
+	UInt32 length = 4096;
+	double frames = 64. * 1024 * 1024;
+	
+	static const struct option options[] = {
+		{ "length",		required_argument,	NULL, 'n' },
+		{ "frames",		required_argument,	NULL, 'f' },
+		{ NULL,			0,					NULL, 0 }
+	};
+	
+	int ch;
+	bool ok = true;
+	while (ok && (ch = getopt_long(argc, argv, "n:f:", options, NULL)) != -1) {
+		switch (ch) {
+			case 'n':	length = strtoul(optarg, NULL, 0);		break;
+			case 'f':	frames = strtod(optarg, NULL);			break;
+			default:	ok = false;								break;
+		}
+	}
+	if (!ok || optind != argc || length == 0 || frames <= 0.) {
+		Usage();
+		return 2;
+	}
+	
+	CheckDecode();
+	CheckEncode();
+	printf("WaveformHistoryCodec, %s: %lu conversions differ from the reference\n",
+			WaveformHistoryCodec::InstructionSet(), (unsigned long)sFailures);
+	
+	std::vector<Float32> signal(length);
+	std::vector<UInt16> packed(length);
+	for (UInt32 i = 0; i < length; ++i)
+		signal[i] = 0.8f * sinf(i * 0.01f);
+	
+	static const struct { UInt32 mFormat; const char *mName; } kFormats[] = {
+		{ kWaveformStorage_Float16, "Float16" },
+		{ kWaveformStorage_Int16, "Int16" }
+	};
+	printf("%-8s  %14s  %14s  %8s  %14s  %14s  %8s\n", "format", "encode scalar", "Encode", "speedup",
+			"decode scalar", "Decode", "speedup");
+	for (size_t f = 0; f < sizeof(kFormats) / sizeof(kFormats[0]); ++f) {
+		const UInt32 format = kFormats[f].mFormat;
+		const double encodeScalar = TimeEncode(WaveformHistoryCodec::EncodeScalar, format, signal, packed, length, frames);
+		const double encode = TimeEncode(WaveformHistoryCodec::Encode, format, signal, packed, length, frames);
+		const double decodeScalar = TimeDecode(WaveformHistoryCodec::DecodeScalar, format, packed, signal, length, frames);
+		const double decode = TimeDecode(WaveformHistoryCodec::Decode, format, packed, signal, length, frames);
+		printf("%-8s  %11.3f ns  %11.3f ns  %7.1fx  %11.3f ns  %11.3f ns  %7.1fx\n", kFormats[f].mName,
+				encodeScalar, encode, encodeScalar / encode, decodeScalar, decode, decodeScalar / decode);
+	}
+	
+	return sFailures ? 1 : 0;
+}
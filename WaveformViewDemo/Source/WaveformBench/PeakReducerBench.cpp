@@ -0,0 +1,248 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	PeakReducerBench.cpp
+	
+=============================================================================*/
+
+/*
+	peakreducerbench: checks CAPeakReducer::Reduce against ReduceScalar and a plain
+	reference, and times them. See README for building.
+	
+	The check runs many short, unaligned runs, with signed zeros and exact zeros mixed in,
+	since the vector loops' heads and tails and the sign tests are where they can go
+	wrong. Min, max, peak and zero crossings must match exactly; the sum of squares, which
+	the vector code adds up in lanes, to a relative 1e-5 of the reference's double sum.
+	
+	The timing reduces runs of each length (-n) over and over and reports nanoseconds
+	per frame for ReduceScalar, Reduce, and the three separate passes (min, max, sum of
+	squares) the view used to make. The exit status is 1 if any check failed.
+*/
+
+#include "CAPeakReducer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <getopt.h>
+#include <vector>
+
+static double	Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static UInt32	sRandom = 1;
+
+static Float32	NextRandom()	// -1 to 1
+{
+	sRandom = sRandom * 1664525 + 1013904223;
+	return (sRandom >> 8) / Float32(1 << 23) - 1.f;
+}
+
+#pragma mark ____Reference
+
+static void	ReduceReference(const Float32 *inFrames, UInt32 inNumFrames, CAPeakStatistics &outStats)
+{
+	memset(&outStats, 0, sizeof(outStats));
+	if (inNumFrames == 0) return;
+	
+	double sumSquares = 0.;
+	Float32 lo = inFrames[0], hi = inFrames[0];
+	UInt32 crossings = 0;
+	for (UInt32 i = 0; i < inNumFrames; ++i) {
+		if (inFrames[i] < lo) lo = inFrames[i];
+		if (inFrames[i] > hi) hi = inFrames[i];
+		sumSquares += double(inFrames[i]) * inFrames[i];
+		if (i > 0 && (inFrames[i] < 0.f) != (inFrames[i - 1] < 0.f))
+			++crossings;
+	}
+	outStats.mMin = lo;
+	outStats.mMax = hi;
+	outStats.mAbsMax = (-lo > hi) ? -lo : hi;
+	outStats.mSumSquares = Float32(sumSquares);
+	outStats.mZeroCrossings = crossings;
+}
+
+// min, max and sum of squares one pass each, as the view did before the reducer
+static void	ReduceSeparately(const Float32 *inFrames, UInt32 inNumFrames, CAPeakStatistics &outStats)
+{
+	Float32 lo = inFrames[0], hi = inFrames[0], sumSquares = 0.f;
+	for (UInt32 i = 0; i < inNumFrames; ++i)
+		lo = (inFrames[i] < lo) ? inFrames[i] : lo;
+	for (UInt32 i = 0; i < inNumFrames; ++i)
+		hi = (inFrames[i] > hi) ? inFrames[i] : hi;
+	for (UInt32 i = 0; i < inNumFrames; ++i)
+		sumSquares += inFrames[i] * inFrames[i];
+	outStats.mMin = lo;
+	outStats.mMax = hi;
+	outStats.mAbsMax = (-lo > hi) ? -lo : hi;
+	outStats.mSumSquares = sumSquares;
+	outStats.mZeroCrossings = 0;
+}
+
+static bool	Matches(const CAPeakStatistics &inStats, const CAPeakStatistics &inReference)
+{
+	return inStats.mMin == inReference.mMin && inStats.mMax == inReference.mMax &&
+			inStats.mAbsMax == inReference.mAbsMax && inStats.mZeroCrossings == inReference.mZeroCrossings &&
+			fabsf(inStats.mSumSquares - inReference.mSumSquares) <= 1e-5f * (1.f + inReference.mSumSquares);
+}
+
+#pragma mark ____Checking
+
+static UInt32	Check(UInt32 inTrials)
+{
+	std::vector<Float32> buffer(256 + 8);
+	UInt32 failures = 0;
+	for (UInt32 trial = 0; trial < inTrials; ++trial) {
+		const UInt32 length = sRandom % 200, offset = (sRandom >> 12) % 8;
+		for (UInt32 i = 0; i < length + offset; ++i) {
+			const Float32 x = NextRandom();
+			const UInt32 kind = sRandom % 10;
+			buffer[i] = (kind == 0) ? 0.f : (kind == 1) ? -0.f : x;
+		}
+		NextRandom();
+		
+		CAPeakStatistics reference, dispatched, scalar;
+		ReduceReference(&buffer[offset], length, reference);
+		CAPeakReducer::Reduce(&buffer[offset], length, dispatched);
+		CAPeakReducer::ReduceScalar(&buffer[offset], length, scalar);
+		if (!Matches(dispatched, reference) || !Matches(scalar, reference)) {
+			if (failures++ < 5)
+				fprintf(stderr, "peakreducerbench: %lu frames at offset %lu: Reduce %g %g %lu, ReduceScalar %g %g %lu, reference %g %g %lu\n",
+						(unsigned long)length, (unsigned long)offset,
+						dispatched.mMin, dispatched.mMax, (unsigned long)dispatched.mZeroCrossings,
+						scalar.mMin, scalar.mMax, (unsigned long)scalar.mZeroCrossings,
+						reference.mMin, reference.mMax, (unsigned long)reference.mZeroCrossings);
+		}
+	}
+	return failures;
+}
+
+#pragma mark ____Timing
+
+typedef void (*ReduceProc)(const Float32 *inFrames, UInt32 inNumFrames, CAPeakStatistics &outStats);
+
+// nanoseconds per frame of inProc on runs of inLength frames, over about inFrames frames
+static double	Time(ReduceProc inProc, const std::vector<Float32> &inSignal, UInt32 inLength, double inFrames)
+{
+	const UInt32 runs = UInt32(inFrames / inLength) + 1;
+	volatile Float32 sink = 0.f;
+	const double start = Now();
+	for (UInt32 r = 0, at = 0; r < runs; ++r) {
+		CAPeakStatistics stats;
+		if (at + inLength > inSignal.size()) at = 0;
+		inProc(&inSignal[at], inLength, stats);
+		sink = sink + stats.mMax;
+		at += inLength;
+	}
+	return (Now() - start) * 1e9 / (double(runs) * inLength);
+}
+
+#pragma mark ____Options
+
+static void	Usage()
+{
+	fprintf(stderr,
+		"usage: peakreducerbench [options]\n"
+		"  -n, --length N         frames per run; may be given more than once (16 64 512 4096 65536)\n"
+		"  -f, --frames N         frames to reduce per measurement (64M)\n"
+		"  -c, --checks N         random runs to check (20000)\n");
+}
+
+int main(int argc, char *const argv[])
+{
+	std::vector<UInt32> lengths;
+	double frames = 64. * 1024 * 1024;
+	UInt32 checks = 20000;
+	
+	static const struct option options[] = {
+		{ "length",		required_argument,	NULL, 'n' },
+		{ "frames",		required_argument,	NULL, 'f' },
+		{ "checks",		required_argument,	NULL, 'c' },
+		{ NULL,			0,					NULL, 0 }
+	};
+	
+	int ch;
+	bool ok = true;
+	while (ok && (ch = getopt_long(argc, argv, "n:f:c:", options, NULL)) != -1) {
+		switch (ch) {
+			case 'n':	lengths.push_back(strtoul(optarg, NULL, 0));	ok = lengths.back() > 0;	break;
+			case 'f':	frames = strtod(optarg, NULL);							break;
+			case 'c':	checks = strtoul(optarg, NULL, 0);						break;
+			default:	ok = false;												break;
+		}
+	}
+	if (!ok || optind != argc || frames <= 0.) {
+		Usage();
+		return 2;
+	}
+	if (lengths.empty()) {
+		static const UInt32 kLengths[] = { 16, 64, 512, 4096, 65536 };
+		lengths.assign(kLengths, kLengths + sizeof(kLengths) / sizeof(kLengths[0]));
+	}
+	
+	const UInt32 failures = Check(checks);
+	printf("CAPeakReducer, %s: %lu of %lu random runs wrong\n", CAPeakReducer::InstructionSet(),
+			(unsigned long)failures, (unsigned long)checks);
+	
+	// a sine with some noise, a whole number of the longest runs
+	UInt32 longest = 0;
+	for (size_t i = 0; i < lengths.size(); ++i)
+		if (lengths[i] > longest) longest = lengths[i];
+	std::vector<Float32> signal(longest * ((1 << 20) / longest + 1));
+	for (size_t i = 0; i < signal.size(); ++i)
+		signal[i] = 0.5f * sinf(i * 0.01f) + 0.05f * NextRandom();
+	
+	printf("%7s  %13s  %13s  %8s  %13s\n", "frames", "scalar ns/fr", "Reduce ns/fr", "speedup", "3 passes ns/fr");
+	for (size_t i = 0; i < lengths.size(); ++i) {
+		const double scalar = Time(CAPeakReducer::ReduceScalar, signal, lengths[i], frames);
+		const double dispatched = Time(CAPeakReducer::Reduce, signal, lengths[i], frames);
+		const double separate = Time(ReduceSeparately, signal, lengths[i], frames);
+		printf("%7lu  %13.3f  %13.3f  %7.1fx  %13.3f\n", (unsigned long)lengths[i], scalar, dispatched,
+				scalar / dispatched, separate);
+	}
+	
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,430 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	WaveformPeakFile.cpp
+	
+=============================================================================*/
+
+#include "WaveformPeakFile.h"
+#include "CAPeakReducer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <vector>
+
+#pragma mark ____Checksums
+
+// FNV-1a, a 64 bit word at a time
+static const UInt64 kChecksumStart = 14695981039346656037ULL;
+
+static inline UInt64	Checksum(UInt64 inChecksum, const void *inData, UInt64 inNumBytes)
+{
+	const Byte *p = (const Byte *)inData;
+	for ( ; inNumBytes >= 8; p += 8, inNumBytes -= 8) {
+		UInt64 word;
+		memcpy(&word, p, 8);
+		inChecksum = (inChecksum ^ word) * 1099511628211ULL;
+	}
+	for ( ; inNumBytes; ++p, --inNumBytes)
+		inChecksum = (inChecksum ^ *p) * 1099511628211ULL;
+	return inChecksum;
+}
+
+std::string	WaveformPeakFile::PathFor(const char *inAudioPath)
+{
+	return std::string(inAudioPath) + ".peaks";
+}
+
+bool	WaveformPeakFile::SourceChecksum(const char *inAudioPath, UInt64 &outChecksum)
+{
+	enum { kNumberPieces = 64, kPieceBytes = 4096 };
+	
+	int file = open(inAudioPath, O_RDONLY);
+	if (file < 0) return false;
+	struct stat st;
+	if (fstat(file, &st) != 0) {
+		close(file);
+		return false;
+	}
+	
+#if defined(__APPLE__)
+	SInt64 stamp[3] = { SInt64(st.st_size), SInt64(st.st_mtimespec.tv_sec), SInt64(st.st_mtimespec.tv_nsec) };
+#else
+	SInt64 stamp[3] = { SInt64(st.st_size), SInt64(st.st_mtim.tv_sec), SInt64(st.st_mtim.tv_nsec) };
+#endif
+	UInt64 checksum = Checksum(kChecksumStart, stamp, sizeof(stamp));
+	
+	// the first and last pieces, and evenly between: the header and any edit in place
+	// that kept the modification time are likely to show
+	Byte piece[kPieceBytes];
+	const SInt64 span = std::max(SInt64(st.st_size) - kPieceBytes, SInt64(0));
+	bool ok = true;
+	for (UInt32 i = 0; i < kNumberPieces && ok; ++i) {
+		ssize_t got = pread(file, piece, kPieceBytes, span * i / (kNumberPieces - 1));
+		ok = got >= 0;
+		if (ok) checksum = Checksum(checksum, piece, got);
+	}
+	close(file);
+	outChecksum = checksum;
+	return ok;
+}
+
+#pragma mark ____Building
+
+struct BuildJob {
+	const WaveformPeakSource *	mSource;
+	Byte *						mFile;			// mapped, being written
+	WaveformPeakFileHeader *	mHeader;
+	UInt32						mNumberTasks;
+	volatile SInt32				mNextTask;
+};
+
+// Each task is a run of kTaskBlocks level 0 blocks, kLevelFactor^kTaskLevels of them, so
+// the task can pool the levels above up to kTaskLevels from its own blocks alone.
+enum {
+	kTaskLevels = 6,
+	kTaskBlocks = 1 << (kTaskLevels * WaveformPeakFile::kLevelShift),
+	kReadBlocks = 64								// a read's worth, per channel
+};
+
+static inline WaveformPeakFileBlock *	LevelBlocks(const BuildJob &inJob, UInt32 inLevel, UInt32 inChannel)
+{
+	const WaveformPeakFileLevel &level = inJob.mHeader->mLevels[inLevel];
+	return (WaveformPeakFileBlock *)(inJob.mFile + level.mOffset) + inChannel * level.mNumberBlocks;
+}
+
+// pools blocks inFirst to inEnd of inLevel from the level below
+static void	PoolBlocks(const BuildJob &inJob, UInt32 inLevel, UInt32 inChannel, UInt64 inFirst, UInt64 inEnd)
+{
+	const WaveformPeakFileBlock *below = LevelBlocks(inJob, inLevel - 1, inChannel);
+	const UInt64 numBelow = inJob.mHeader->mLevels[inLevel - 1].mNumberBlocks;
+	WaveformPeakFileBlock *blocks = LevelBlocks(inJob, inLevel, inChannel);
+	for (UInt64 b = inFirst; b < inEnd; ++b) {
+		UInt64 i = b << WaveformPeakFile::kLevelShift, end = std::min(i + WaveformPeakFile::kLevelFactor, numBelow);
+		WaveformPeakFileBlock block = below[i];
+		for (++i; i < end; ++i) {
+			block.mMin = std::min(block.mMin, below[i].mMin);
+			block.mMax = std::max(block.mMax, below[i].mMax);
+		}
+		blocks[b] = block;
+	}
+}
+
+static void	BuildTask(BuildJob &inJob, UInt32 inTask, std::vector<Float32> &ioFrames)
+{
+	const WaveformPeakFileHeader &header = *inJob.mHeader;
+	const SInt64 numFrames = header.mNumberFrames;
+	const UInt64 first = UInt64(inTask) * kTaskBlocks;
+	const UInt64 end = std::min(first + kTaskBlocks, header.mLevels[0].mNumberBlocks);
+	
+	for (UInt32 c = 0; c < header.mNumberChannels; ++c) {
+		WaveformPeakFileBlock *blocks = LevelBlocks(inJob, 0, c);
+		for (UInt64 b = first; b < end; b += kReadBlocks) {
+			const UInt64 readEnd = std::min(b + kReadBlocks, end);
+			const SInt64 frame = SInt64(b) << WaveformPeakFile::kBaseBlockShift;
+			const UInt32 numRead = UInt32(std::min(SInt64(readEnd - b) << WaveformPeakFile::kBaseBlockShift, numFrames - frame));
+			inJob.mSource->ReadFrames(frame, numRead, c, &ioFrames[0]);
+			
+			for (UInt64 i = b; i < readEnd; ++i) {
+				const UInt32 offset = UInt32(i - b) << WaveformPeakFile::kBaseBlockShift;
+				CAPeakStatistics stats;
+				CAPeakReducer::Reduce(&ioFrames[offset], std::min(UInt32(WaveformPeakFile::kBaseBlockFrames), numRead - offset), stats);
+				// outward, so the blocks cover every sample
+				blocks[i].mMin = SInt16(std::max(floorf(stats.mMin * 32767.f), -32767.f));
+				blocks[i].mMax = SInt16(std::min(ceilf(stats.mMax * 32767.f), 32767.f));
+			}
+		}
+		
+		UInt64 levelFirst = first, levelEnd = end;
+		for (UInt32 level = 1; level <= kTaskLevels && level < header.mNumberLevels; ++level) {
+			levelFirst >>= WaveformPeakFile::kLevelShift;
+			levelEnd = (levelEnd + WaveformPeakFile::kLevelFactor - 1) >> WaveformPeakFile::kLevelShift;
+			PoolBlocks(inJob, level, c, levelFirst, levelEnd);
+		}
+	}
+}
+
+static void *	BuildThread(void *inJob)
+{
+	BuildJob &job = *(BuildJob *)inJob;
+	std::vector<Float32> frames(kReadBlocks << WaveformPeakFile::kBaseBlockShift);
+	for (;;) {
+		SInt32 task = __sync_fetch_and_add(&job.mNextTask, 1);
+		if (task >= SInt32(job.mNumberTasks))
+			break;
+		BuildTask(job, UInt32(task), frames);
+	}
+	return NULL;
+}
+
+bool	WaveformPeakFile::Build(const WaveformPeakSource &inSource, UInt64 inSourceChecksum, const char *inPeakPath,
+								UInt32 inNumThreads)
+{
+	const UInt32 numChannels = inSource.NumberChannels();
+	const SInt64 numFrames = std::max(inSource.NumberFrames(), SInt64(0));
+	
+	// the layout: the levels, each rounded up to a cache line, after the header
+	WaveformPeakFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.mMagic = kWaveformPeakFileMagic;
+	header.mVersion = kWaveformPeakFileVersion;
+	header.mHeaderSize = sizeof(WaveformPeakFileHeader);
+	header.mNumberChannels = numChannels;
+	header.mSampleRate = inSource.SampleRate();
+	header.mNumberFrames = numFrames;
+	header.mBaseBlockFrames = kBaseBlockFrames;
+	header.mLevelFactor = kLevelFactor;
+	header.mSourceChecksum = inSourceChecksum;
+	
+	UInt64 size = (sizeof(WaveformPeakFileHeader) + 63) & ~UInt64(63);
+	UInt64 numBlocks = (UInt64(numFrames) + kBaseBlockFrames - 1) >> kBaseBlockShift;
+	for (;;) {
+		WaveformPeakFileLevel &level = header.mLevels[header.mNumberLevels++];
+		level.mOffset = size;
+		level.mNumberBlocks = numBlocks;
+		size += (numBlocks * numChannels * sizeof(WaveformPeakFileBlock) + 63) & ~UInt64(63);
+		if (numBlocks <= 1 || header.mNumberLevels == kMaxLevels)
+			break;
+		numBlocks = (numBlocks + kLevelFactor - 1) >> kLevelShift;
+	}
+	
+	std::string temporary = std::string(inPeakPath) + ".XXXXXX";
+	int file = mkstemp(&temporary[0]);
+	if (file < 0) {
+		snprintf(mError, sizeof(mError), "%s", strerror(errno));
+		return false;
+	}
+	fchmod(file, 0644);
+	void *mapped = MAP_FAILED;
+	if (ftruncate(file, off_t(size)) == 0)
+		mapped = mmap(NULL, size_t(size), PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	if (mapped == MAP_FAILED) {
+		snprintf(mError, sizeof(mError), "%s", strerror(errno));
+		close(file);
+		unlink(temporary.c_str());
+		return false;
+	}
+	
+	BuildJob job;
+	job.mSource = &inSource;
+	job.mFile = (Byte *)mapped;
+	job.mHeader = &header;
+	job.mNumberTasks = UInt32((header.mLevels[0].mNumberBlocks + kTaskBlocks - 1) / kTaskBlocks);
+	job.mNextTask = 0;
+	
+	// the calling thread is one of them
+	if (inNumThreads == 0) {
+		long n = sysconf(_SC_NPROCESSORS_ONLN);
+		inNumThreads = (n > 0) ? UInt32(n) : 1;
+	}
+	inNumThreads = std::max(std::min(inNumThreads, job.mNumberTasks), 1U);
+	std::vector<pthread_t> threads(inNumThreads - 1);
+	UInt32 started = 0;
+	for ( ; started < threads.size(); ++started)
+		if (pthread_create(&threads[started], NULL, BuildThread, &job) != 0)
+			break;
+	BuildThread(&job);
+	for (UInt32 i = 0; i < started; ++i)
+		pthread_join(threads[i], NULL);
+	
+	// the levels above the tasks' are small
+	for (UInt32 level = kTaskLevels + 1; level < header.mNumberLevels; ++level)
+		for (UInt32 c = 0; c < numChannels; ++c)
+			PoolBlocks(job, level, c, 0, header.mLevels[level].mNumberBlocks);
+	
+	header.mPeaksChecksum = Checksum(kChecksumStart, job.mFile + header.mHeaderSize, size - header.mHeaderSize);
+	memcpy(job.mFile, &header, sizeof(header));
+	
+	bool ok = msync(mapped, size_t(size), MS_SYNC) == 0;
+	munmap(mapped, size_t(size));
+	ok = (close(file) == 0) && ok;
+	if (ok)
+		ok = rename(temporary.c_str(), inPeakPath) == 0;
+	if (!ok) {
+		snprintf(mError, sizeof(mError), "%s", strerror(errno));
+		unlink(temporary.c_str());
+	}
+	return ok;
+}
+
+#pragma mark ____Reading
+
+WaveformPeakFile::WaveformPeakFile() :
+	mHeader(NULL), mSize(0)
+{
+	mError[0] = 0;
+}
+
+WaveformPeakFile::~WaveformPeakFile()
+{
+	Close();
+}
+
+void	WaveformPeakFile::Close()
+{
+	if (mHeader)
+		munmap((void *)mHeader, size_t(mSize));
+	mHeader = NULL;
+	mSize = 0;
+}
+
+bool	WaveformPeakFile::Open(const char *inPeakPath, UInt64 inSourceChecksum)
+{
+	Close();
+	
+	int file = open(inPeakPath, O_RDONLY);
+	if (file < 0) {
+		snprintf(mError, sizeof(mError), "%s", strerror(errno));
+		return false;
+	}
+	struct stat st;
+	void *mapped = MAP_FAILED;
+	if (fstat(file, &st) == 0 && st.st_size >= off_t(sizeof(WaveformPeakFileHeader)))
+		mapped = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_SHARED, file, 0);
+	close(file);
+	if (mapped == MAP_FAILED) {
+		snprintf(mError, sizeof(mError), "not a peak file");
+		return false;
+	}
+	mHeader = (const WaveformPeakFileHeader *)mapped;
+	mSize = UInt64(st.st_size);
+	
+	// every level inside the file, before anything is read from one
+	const WaveformPeakFileHeader &header = *mHeader;
+	const char *problem = NULL;
+	if (header.mMagic != kWaveformPeakFileMagic || header.mHeaderSize != sizeof(WaveformPeakFileHeader))
+		problem = "not a peak file";
+	else if (header.mVersion != kWaveformPeakFileVersion || header.mBaseBlockFrames != kBaseBlockFrames
+				|| header.mLevelFactor != kLevelFactor)
+		problem = "an older version";
+	else if (header.mSourceChecksum != inSourceChecksum)
+		problem = "stale: the audio file has changed";
+	else if (header.mNumberLevels == 0 || header.mNumberLevels > kMaxLevels || header.mNumberChannels == 0)
+		problem = "damaged";
+	for (UInt32 i = 0; problem == NULL && i < header.mNumberLevels; ++i) {
+		const WaveformPeakFileLevel &level = header.mLevels[i];
+		UInt64 expected = (i == 0) ? (UInt64(header.mNumberFrames) + kBaseBlockFrames - 1) >> kBaseBlockShift
+								   : (header.mLevels[i - 1].mNumberBlocks + kLevelFactor - 1) >> kLevelShift;
+		if (level.mNumberBlocks != expected || level.mOffset % 64 || level.mOffset > mSize
+				|| (mSize - level.mOffset) / (header.mNumberChannels * sizeof(WaveformPeakFileBlock)) < level.mNumberBlocks)
+			problem = "damaged";
+	}
+	if (problem == NULL && Checksum(kChecksumStart, (const Byte *)mHeader + header.mHeaderSize, mSize - header.mHeaderSize)
+							!= header.mPeaksChecksum)
+		problem = "damaged";
+	
+	if (problem) {
+		snprintf(mError, sizeof(mError), "%s", problem);
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool	WaveformPeakFile::OpenOrBuild(const char *inAudioPath, const WaveformPeakSource &inSource, UInt32 inNumThreads,
+									  bool *outBuilt)
+{
+	if (outBuilt) *outBuilt = false;
+	UInt64 checksum;
+	if (!SourceChecksum(inAudioPath, checksum)) {
+		snprintf(mError, sizeof(mError), "%s", strerror(errno));
+		return false;
+	}
+	const std::string path = PathFor(inAudioPath);
+	if (Open(path.c_str(), checksum))
+		return true;
+	if (!Build(inSource, checksum, path.c_str(), inNumThreads))
+		return false;
+	if (outBuilt) *outBuilt = true;
+	return Open(path.c_str(), checksum);
+}
+
+const WaveformPeakFileBlock *	WaveformPeakFile::Blocks(UInt32 inLevel, UInt32 inChannel) const
+{
+	const WaveformPeakFileLevel &level = mHeader->mLevels[inLevel];
+	return (const WaveformPeakFileBlock *)((const Byte *)mHeader + level.mOffset) + inChannel * level.mNumberBlocks;
+}
+
+bool	WaveformPeakFile::GetPeaks(UInt32 inChannel, SInt64 inStartFrame, SInt64 inEndFrame, UInt32 inNumPixels,
+								   WaveformPeakRange *outPeaks) const
+{
+	if (mHeader == NULL || inChannel >= mHeader->mNumberChannels || inNumPixels == 0 || inEndFrame <= inStartFrame)
+		return false;
+	const SInt64 span = inEndFrame - inStartFrame;
+	const Float64 framesPerPixel = Float64(span) / inNumPixels;
+	if (framesPerPixel < kBaseBlockFrames)
+		return false;
+	
+	UInt32 level = 0;
+	while (level + 1 < mHeader->mNumberLevels && Float64(SInt64(1) << (kBaseBlockShift + (level + 1) * kLevelShift)) <= framesPerPixel)
+		++level;
+	const UInt32 shift = kBaseBlockShift + level * kLevelShift;
+	const WaveformPeakFileBlock *blocks = Blocks(level, inChannel);
+	const SInt64 numBlocks = SInt64(mHeader->mLevels[level].mNumberBlocks);
+	
+	for (UInt32 p = 0; p < inNumPixels; ++p) {
+		// pixel p is frames f0 to f1, of which the file has f0 to f1 clipped to its length
+		SInt64 f0 = inStartFrame + span * p / inNumPixels, f1 = inStartFrame + span * (p + 1) / inNumPixels;
+		SInt64 b0 = std::max(f0, SInt64(0)) >> shift, b1 = std::min((f1 - 1) >> shift, numBlocks - 1);
+		WaveformPeakRange &peak = outPeaks[p];
+		if (f1 <= 0 || b0 > b1) {
+			peak.mMin = peak.mMax = 0.f;
+			continue;
+		}
+		SInt16 mn = blocks[b0].mMin, mx = blocks[b0].mMax;
+		for (SInt64 b = b0 + 1; b <= b1; ++b) {
+			mn = std::min(mn, blocks[b].mMin);
+			mx = std::max(mx, blocks[b].mMax);
+		}
+		peak.mMin = mn * (1.f / 32767.f);
+		peak.mMax = mx * (1.f / 32767.f);
+	}
+	return true;
+}
@@ -0,0 +1,183 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	WaveformPeakFile.h
+	
+=============================================================================*/
+
+#ifndef __WaveformPeakFile_h__
+#define __WaveformPeakFile_h__
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include <CoreAudioTypes.h>
+#endif
+
+#include <string>
+
+/*
+	Peak files keep the waveform overview of a recording next to it, as file.wav.peaks,
+	so that any stretch of hours of audio can be drawn without reading the audio again.
+	
+	A peak file holds, for each channel, the minimum and maximum of every kBaseBlockFrames
+	frames (level 0), of every kLevelFactor level 0 blocks (level 1), and so on until a
+	level has a single block. They are 16 bit fixed point, the minimum rounded down and the
+	maximum up, so an envelope drawn from them never misses a sample; overs clip to full
+	scale. The levels follow the header at fixed, aligned offsets, one channel after
+	another, so a file is used by mapping it into memory as it is. It is in the byte order
+	of the machine that built it; elsewhere the magic number reads backwards, and the file
+	is built again.
+	
+	The header has a checksum of the audio file and one of the peaks. The audio file's
+	covers its size, modification time and 64 pieces from across it, so it costs a few
+	reads, not a pass over the file. Open refuses a peak file whose version or checksums
+	don't match, and OpenOrBuild then builds it again.
+*/
+
+enum {
+	kWaveformPeakFileMagic		= 0x464B5057,		// "WPKF" on a little endian machine
+	kWaveformPeakFileVersion	= 1
+};
+
+struct WaveformPeakFileLevel {
+	UInt64			mOffset;			// bytes from the start of the file to the level's blocks
+	UInt64			mNumberBlocks;		// per channel
+};
+
+struct WaveformPeakFileHeader {
+	UInt32			mMagic;
+	UInt32			mVersion;
+	UInt32			mHeaderSize;
+	UInt32			mNumberChannels;
+	Float64			mSampleRate;
+	SInt64			mNumberFrames;
+	UInt32			mBaseBlockFrames;
+	UInt32			mLevelFactor;
+	UInt32			mNumberLevels;
+	UInt32			mReserved;
+	UInt64			mSourceChecksum;
+	UInt64			mPeaksChecksum;		// of everything after the header
+	WaveformPeakFileLevel	mLevels[16];		// WaveformPeakFile::kMaxLevels
+};
+
+// a level's block of one channel, in 1/32767ths of full scale
+struct WaveformPeakFileBlock {
+	SInt16			mMin;
+	SInt16			mMax;
+};
+
+struct WaveformPeakRange {
+	Float32			mMin;
+	Float32			mMax;
+};
+
+// the audio a peak file is built from
+class WaveformPeakSource {
+public:
+	virtual ~WaveformPeakSource() {}
+	
+	virtual Float64	SampleRate() const = 0;
+	virtual UInt32	NumberChannels() const = 0;
+	virtual SInt64	NumberFrames() const = 0;
+	
+	// from -1 to 1; called from several threads at once
+	virtual void	ReadFrames(SInt64 inStartFrame, UInt32 inNumFrames, UInt32 inChannel, Float32 *outFrames) const = 0;
+};
+
+class WaveformPeakFile {
+public:
+	enum {
+		kBaseBlockShift = 8,
+		kBaseBlockFrames = 1 << kBaseBlockShift,
+		kLevelShift = 2,
+		kLevelFactor = 1 << kLevelShift,
+		kMaxLevels = 16
+	};
+	
+	WaveformPeakFile();
+	~WaveformPeakFile();
+	
+	// inAudioPath with .peaks added
+	static std::string	PathFor(const char *inAudioPath);
+	
+	// false if the audio file can't be read
+	static bool		SourceChecksum(const char *inAudioPath, UInt64 &outChecksum);
+	
+	// Builds inPeakPath from inSource in inNumThreads threads (0: one per processor). The
+	// file is written under another name and renamed, so it appears whole or not at all.
+	bool			Build(const WaveformPeakSource &inSource, UInt64 inSourceChecksum, const char *inPeakPath,
+						  UInt32 inNumThreads);
+	
+	// Maps inPeakPath; false if it can't, or the file isn't a good one of inSourceChecksum.
+	bool			Open(const char *inPeakPath, UInt64 inSourceChecksum);
+	
+	// Opens inAudioPath's peak file, building it from inSource first if it's missing or
+	// stale; outBuilt says which.
+	bool			OpenOrBuild(const char *inAudioPath, const WaveformPeakSource &inSource, UInt32 inNumThreads,
+								bool *outBuilt = NULL);
+	
+	void			Close();
+	const char *	Error() const				{ return mError; }
+	
+	Float64			SampleRate() const			{ return mHeader ? mHeader->mSampleRate : 0.; }
+	UInt32			NumberChannels() const		{ return mHeader ? mHeader->mNumberChannels : 0; }
+	SInt64			NumberFrames() const		{ return mHeader ? mHeader->mNumberFrames : 0; }
+	UInt32			NumberLevels() const		{ return mHeader ? mHeader->mNumberLevels : 0; }
+	UInt64			FileSize() const			{ return mSize; }
+	
+	// The range of inChannel in each of inNumPixels equal parts of inStartFrame to inEndFrame,
+	// from the coarsest level with no more than a pixel's frames a block, so it reads no more
+	// than kLevelFactor + 1 blocks a pixel. Neighbouring pixels share the block they meet in;
+	// pixels past the ends of the file are silent. False if there's no such level, with
+	// fewer than kBaseBlockFrames frames a pixel: the samples themselves are few enough to read.
+	bool			GetPeaks(UInt32 inChannel, SInt64 inStartFrame, SInt64 inEndFrame, UInt32 inNumPixels,
+							 WaveformPeakRange *outPeaks) const;
+
+private:
+	const WaveformPeakFileBlock *	Blocks(UInt32 inLevel, UInt32 inChannel) const;
+	
+	const WaveformPeakFileHeader *	mHeader;	// the mapped file
+	UInt64							mSize;
+	char							mError[256];
+};
+
+#endif // __WaveformPeakFile_h__
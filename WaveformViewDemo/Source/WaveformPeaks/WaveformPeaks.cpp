@@ -0,0 +1,196 @@
+/*	Copyright  2007 Apple Inc. All Rights Reserved.
+	
+	Disclaimer: IMPORTANT:  This Apple software is supplied to you by 
+			Apple Inc. ("Apple") in consideration of your agreement to the
+			following terms, and your use, installation, modification or
+			redistribution of this Apple software constitutes acceptance of these
+			terms.  If you do not agree with these terms, please do not use,
+			install, modify or redistribute this Apple software.
+			
+			In consideration of your agreement to abide by the following terms, and
+			subject to these terms, Apple grants you a personal, non-exclusive
+			license, under Apple's copyrights in this original Apple software (the
+			"Apple Software"), to use, reproduce, modify and redistribute the Apple
+			Software, with or without modifications, in source and/or binary forms;
+			provided that if you redistribute the Apple Software in its entirety and
+			without modifications, you must retain this notice and the following
+			text and disclaimers in all such redistributions of the Apple Software. 
+			Neither the name, trademarks, service marks or logos of Apple Inc. 
+			may be used to endorse or promote products derived from the Apple
+			Software without specific prior written permission from Apple.  Except
+			as expressly stated in this notice, no other rights or licenses, express
+			or implied, are granted by Apple herein, including but not limited to
+			any patent rights that may be infringed by your derivative works or by
+			other works in which the Apple Software may be incorporated.
+			
+			The Apple Software is provided by Apple on an "AS IS" basis.  APPLE
+			MAKES NO WARRANTIES, EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION
+			THE IMPLIED WARRANTIES OF NON-INFRINGEMENT, MERCHANTABILITY AND FITNESS
+			FOR A PARTICULAR PURPOSE, REGARDING THE APPLE SOFTWARE OR ITS USE AND
+			OPERATION ALONE OR IN COMBINATION WITH YOUR PRODUCTS.
+			
+			IN NO EVENT SHALL APPLE BE LIABLE FOR ANY SPECIAL, INDIRECT, INCIDENTAL
+			OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+			SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+			INTERRUPTION) ARISING IN ANY WAY OUT OF THE USE, REPRODUCTION,
+			MODIFICATION AND/OR DISTRIBUTION OF THE APPLE SOFTWARE, HOWEVER CAUSED
+			AND WHETHER UNDER THEORY OF CONTRACT, TORT (INCLUDING NEGLIGENCE),
+			STRICT LIABILITY OR OTHERWISE, EVEN IF APPLE HAS BEEN ADVISED OF THE
+			POSSIBILITY OF SUCH DAMAGE.
+*/
+/*=============================================================================
+	WaveformPeaks.cpp
+	
+=============================================================================*/
+
+/*
+	waveformpeaks: builds the peak file of each WAVE file given, next to it, unless it
+	has a good one already, and can print the peaks of a stretch of one. See README for
+	building and the options.
+	
+	The WAVE files are read with sonogramrender's SonogramWAVFile.
+*/
+
+#include "WaveformPeakFile.h"
+#include "SonogramWAVFile.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <string>
+#include <vector>
+
+class WAVPeakSource : public WaveformPeakSource {
+public:
+	WAVPeakSource(const SonogramWAVFile &inFile) : mFile(inFile) {}
+	
+	virtual Float64	SampleRate() const			{ return mFile.SampleRate(); }
+	virtual UInt32	NumberChannels() const		{ return mFile.NumberChannels(); }
+	virtual SInt64	NumberFrames() const		{ return mFile.NumberFrames(); }
+	virtual void	ReadFrames(SInt64 inStartFrame, UInt32 inNumFrames, UInt32 inChannel, Float32 *outFrames) const
+	{
+		mFile.ReadFrames(inStartFrame, inNumFrames, inChannel, outFrames);
+	}
+
+private:
+	const SonogramWAVFile &	mFile;
+};
+
+struct Query {
+	Float64		mStart;				// seconds
+	Float64		mEnd;
+	UInt32		mPixels;
+	UInt32		mChannel;
+};
+
+static double	Now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static bool	PeakFile(const char *inPath, bool inForce, UInt32 inThreads, const Query *inQuery, double &ioAudioSeconds)
+{
+	SonogramWAVFile file;
+	if (!file.Open(inPath)) {
+		fprintf(stderr, "%s: %s\n", inPath, file.Error());
+		return false;
+	}
+	
+	const double start = Now();
+	if (inForce)
+		unlink(WaveformPeakFile::PathFor(inPath).c_str());
+	WAVPeakSource source(file);
+	WaveformPeakFile peaks;
+	bool built;
+	if (!peaks.OpenOrBuild(inPath, source, inThreads, &built)) {
+		fprintf(stderr, "%s: %s\n", WaveformPeakFile::PathFor(inPath).c_str(), peaks.Error());
+		return false;
+	}
+	const double seconds = Now() - start, audio = file.NumberFrames() / file.SampleRate();
+	if (built) ioAudioSeconds += audio;
+	printf("%s -> %s: %s, %u channel%s, %u levels, %.1f KB for %.1f min of audio, %.2f s\n", inPath,
+			WaveformPeakFile::PathFor(inPath).c_str(), built ? "built" : "up to date",
+			(unsigned)peaks.NumberChannels(), (peaks.NumberChannels() == 1) ? "" : "s", (unsigned)peaks.NumberLevels(),
+			peaks.FileSize() / 1024., audio / 60., seconds);
+	
+	if (inQuery) {
+		const SInt64 first = SInt64(inQuery->mStart * peaks.SampleRate()), end = SInt64(inQuery->mEnd * peaks.SampleRate());
+		std::vector<WaveformPeakRange> pixels(inQuery->mPixels);
+		if (!peaks.GetPeaks(inQuery->mChannel, first, end, inQuery->mPixels, &pixels[0])) {
+			fprintf(stderr, "%s: no peaks for that: less than %u frames a pixel, or no such channel\n", inPath,
+					(unsigned)WaveformPeakFile::kBaseBlockFrames);
+			return false;
+		}
+		for (UInt32 p = 0; p < inQuery->mPixels; ++p)
+			printf("%u %.5f %.5f\n", (unsigned)p, pixels[p].mMin, pixels[p].mMax);
+	}
+	return true;
+}
+
+static void	Usage()
+{
+	fprintf(stderr,
+		"usage: waveformpeaks [options] file.wav ...\n"
+		"  -f, --force            build the peak files even if they are up to date\n"
+		"  -j, --threads N        build threads (one per processor)\n"
+		"  -q, --query S:E:N      print the min and max of N pixels from S to E seconds\n"
+		"  -c, --channel N        channel from 0 for --query (0)\n");
+}
+
+int main(int argc, char *const argv[])
+{
+	bool force = false, query = false;
+	UInt32 threads = 0;
+	Query settings = { 0., 0., 0, 0 };
+	
+	static const struct option options[] = {
+		{ "force",		no_argument,		NULL, 'f' },
+		{ "threads",	required_argument,	NULL, 'j' },
+		{ "query",		required_argument,	NULL, 'q' },
+		{ "channel",	required_argument,	NULL, 'c' },
+		{ NULL,			0,					NULL, 0 }
+	};
+	
+	int ch;
+	bool ok = true;
+	while (ok && (ch = getopt_long(argc, argv, "fj:q:c:", options, NULL)) != -1) {
+		switch (ch) {
+			case 'f':	force = true;											break;
+			case 'j':	threads = strtoul(optarg, NULL, 0);						break;
+			case 'q': {
+				double s, e;
+				unsigned n;
+				query = ok = sscanf(optarg, "%lf:%lf:%u", &s, &e, &n) == 3 && e > s && n > 0;
+				settings.mStart = s;
+				settings.mEnd = e;
+				settings.mPixels = n;
+				break;
+			}
+			case 'c':	settings.mChannel = strtoul(optarg, NULL, 0);			break;
+			default:	ok = false;												break;
+		}
+	}
+	const int numInputs = argc - optind;
+	if (!ok || numInputs < 1) {
+		Usage();
+		return 2;
+	}
+	
+	const double start = Now();
+	double audioSeconds = 0.;
+	int failures = 0;
+	for (int i = optind; i < argc; ++i)
+		if (!PeakFile(argv[i], force, threads, query ? &settings : NULL, audioSeconds))
+			++failures;
+	
+	const double minutes = (Now() - start) / 60.;
+	if (audioSeconds > 0.)
+		printf("built peaks for %.2f h of audio in %.2f min: %.1f audio hours per minute\n",
+				audioSeconds / 3600., minutes, minutes > 0. ? audioSeconds / 3600. / minutes : 0.);
+	return failures ? 1 : 0;
+}